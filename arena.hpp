@@ -0,0 +1,130 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// A reference to a node owned by an Arena. It does not own the node:
+// copying or dropping one never allocates or frees anything, and the node
+// lives until its arena is destroyed. Null when default-constructed.
+template <typename T>
+class NodePtr {
+public:
+    NodePtr() = default;
+    NodePtr(std::nullptr_t) {}
+    explicit NodePtr(T* node) : node(node) {}
+
+    T* get() const { return node; }
+    T& operator*() const { return *node; }
+    T* operator->() const { return node; }
+    explicit operator bool() const { return node != nullptr; }
+
+    friend bool operator==(const NodePtr& ptr, std::nullptr_t) { return ptr.node == nullptr; }
+    friend bool operator!=(const NodePtr& ptr, std::nullptr_t) { return ptr.node != nullptr; }
+
+private:
+    T* node = nullptr;
+};
+
+// Owns every node of a tree of node types Ts..., each type in its own
+// array of chunks filled in order, so the nodes of a type sit next to each
+// other in allocation order. Allocating is a bump of the current chunk's
+// count; destroying the arena runs the node destructors with a linear
+// sweep over each array (nodes never free each other) and then frees a
+// few chunks per type.
+//
+// Not thread-safe: each arena is filled by one thread, and arenas built on
+// several threads are merged with adopt().
+template <typename... Ts>
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <typename T, typename... Args>
+    NodePtr<T> make(Args&&... args) {
+        return NodePtr<T>(std::get<Pool<T>>(pools).make(std::forward<Args>(args)...));
+    }
+
+    // Takes over all of other's nodes; their NodePtrs stay valid
+    void adopt(Arena&& other) {
+        (std::get<Pool<Ts>>(pools).adopt(std::get<Pool<Ts>>(other.pools)), ...);
+    }
+
+    // Number of nodes allocated, of every type
+    size_t size() const {
+        return (std::get<Pool<Ts>>(pools).size() + ... + size_t(0));
+    }
+
+private:
+    template <typename T>
+    class Pool {
+    public:
+        Pool() = default;
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        ~Pool() {
+            for (Chunk& chunk : chunks) {
+                for (uint32_t i = 0; i < chunk.used; i++) chunk.nodes[i].~T();
+                std::allocator<T>().deallocate(chunk.nodes, chunk.capacity);
+            }
+        }
+
+        template <typename... Args>
+        T* make(Args&&... args) {
+            if (chunks.empty() || chunks.back().used == chunks.back().capacity) {
+                // Chunks double in size, so a type used a few times costs
+                // little and a large module needs few chunks
+                uint32_t capacity = chunks.empty()
+                    ? firstChunk : std::min(chunks.back().capacity * 2, maxChunk);
+                chunks.push_back(Chunk{std::allocator<T>().allocate(capacity), 0, capacity});
+            }
+            Chunk& chunk = chunks.back();
+            T* node = new (chunk.nodes + chunk.used) T(std::forward<Args>(args)...);
+            chunk.used++;
+            return node;
+        }
+
+        void adopt(Pool& other) {
+            if (other.chunks.empty()) return;
+            // Keep filling whichever last chunk has more room
+            bool keepOurs = !chunks.empty() && room(chunks.back()) > room(other.chunks.back());
+            size_t ourLast = chunks.size() - 1;
+            chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+            other.chunks.clear();
+            if (keepOurs) std::swap(chunks[ourLast], chunks.back());
+        }
+
+        size_t size() const {
+            size_t count = 0;
+            for (const Chunk& chunk : chunks) count += chunk.used;
+            return count;
+        }
+
+    private:
+        static constexpr uint32_t firstChunk = 16;
+        static constexpr uint32_t maxChunk = 4096;
+
+        struct Chunk {
+            T* nodes;
+            uint32_t used;
+            uint32_t capacity;
+        };
+
+        static uint32_t room(const Chunk& chunk) { return chunk.capacity - chunk.used; }
+
+        std::vector<Chunk> chunks;
+    };
+
+    std::tuple<Pool<Ts>...> pools;
+};
+
+#endif // ARENA_HPP
@@ -0,0 +1,322 @@
+#include "array.hpp"
+#include "environment.hpp"
+#include "list.hpp"
+
+namespace {
+
+const ArrayKernels& kernels() {
+    return ArrayKernels::best();
+}
+
+const char* opSymbol(ArrayOp op) {
+    switch (op) {
+        case ArrayOp::ADD: return "+";
+        case ArrayOp::SUB: return "-";
+        case ArrayOp::MUL: return "*";
+        default: return "/";
+    }
+}
+
+const char* compareSymbol(ArrayCompare op) {
+    switch (op) {
+        case ArrayCompare::LT: return "<";
+        case ArrayCompare::LE: return "<=";
+        case ArrayCompare::GT: return ">";
+        case ArrayCompare::GE: return ">=";
+        case ArrayCompare::EQ: return "==";
+        default: return "!=";
+    }
+}
+
+const PyArray* asArray(const PyValue& value) {
+    const auto* array = std::get_if<std::shared_ptr<PyArray>>(&value);
+    return array ? array->get() : nullptr;
+}
+
+bool isNumber(const PyValue& value) {
+    return std::holds_alternative<long long>(value) || std::holds_alternative<double>(value) ||
+           std::holds_alternative<bool>(value);
+}
+
+// One side of an elementwise operation viewed as T elements: the array's
+// own buffer, a converted copy of it, or a number broadcast across the
+// other side. Filled in place, since `data` may point into it.
+template <typename T>
+struct Operand {
+    const T* data = nullptr;
+    bool scalar = false;
+    T value{};
+    std::vector<T> converted;
+
+    void view(const PyArray& array) {
+        if (array.isFloat() == std::is_same_v<T, double>) {
+            data = array.elementData<T>();
+            return;
+        }
+        array.visitElements([this](const auto* items, size_t size) {
+            converted.assign(items, items + size);
+        });
+        data = converted.data();
+    }
+
+    void view(const PyValue& source) {
+        if (const PyArray* array = asArray(source)) {
+            view(*array);
+            return;
+        }
+        scalar = true;
+        if (std::holds_alternative<double>(source)) {
+            value = static_cast<T>(std::get<double>(source));
+        } else if (std::holds_alternative<long long>(source)) {
+            value = static_cast<T>(std::get<long long>(source));
+        } else {
+            value = static_cast<T>(std::get<bool>(source) ? 1 : 0);
+        }
+        data = &value;
+    }
+};
+
+// Checks the operands of an elementwise operation and returns the length
+// of the result
+size_t broadcastLength(const std::string& symbol, const PyValue& left, const PyValue& right) {
+    const PyArray* a = asArray(left);
+    const PyArray* b = asArray(right);
+    if ((!a && !isNumber(left)) || (!b && !isNumber(right))) {
+        throw RuntimeError("unsupported operand type(s) for " + symbol + ": '" +
+                           pyTypeName(left) + "' and '" + pyTypeName(right) + "'");
+    }
+    if (a && b && a->size() != b->size()) {
+        throw RuntimeError("operands could not be broadcast together with shapes (" +
+                           std::to_string(a->size()) + ",) (" + std::to_string(b->size()) + ",)");
+    }
+    return a ? a->size() : b->size();
+}
+
+// Float64 is used if either side is float64 or a float
+bool needsFloat(const PyValue& value) {
+    const PyArray* array = asArray(value);
+    return array ? array->isFloat() : std::holds_alternative<double>(value);
+}
+
+std::shared_ptr<PyArray> self(const PyValue& value) {
+    return std::get<std::shared_ptr<PyArray>>(value);
+}
+
+PyValue arraySum(const PyValue& array, ArgSpan) {
+    return self(array)->sum();
+}
+
+PyValue arrayMin(const PyValue& array, ArgSpan) {
+    return self(array)->min();
+}
+
+PyValue arrayMax(const PyValue& array, ArgSpan) {
+    return self(array)->max();
+}
+
+PyValue arrayDot(const PyValue& array, ArgSpan args) {
+    const PyArray* other = asArray(args[0]);
+    if (!other) {
+        throw RuntimeError("dot() argument must be an array, not '" + pyTypeName(args[0]) + "'");
+    }
+    return self(array)->dot(*other);
+}
+
+PyValue arrayToList(const PyValue& array, ArgSpan) {
+    const PyArray& items = *self(array);
+    auto list = std::make_shared<PyList>();
+    list->reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++) list->append(items.get(i));
+    return list;
+}
+
+const NativeMethod methods[] = {
+    {"sum", 0, 0, arraySum},
+    {"min", 0, 0, arrayMin},
+    {"max", 0, 0, arrayMax},
+    {"dot", 1, 1, arrayDot},
+    {"tolist", 0, 0, arrayToList},
+};
+
+}  // namespace
+
+size_t PyArray::size() const {
+    if (owner) return borrowedCount;
+    return std::visit([](const auto& items) { return items.size(); }, data);
+}
+
+PyValue PyArray::get(size_t index) const {
+    return visitElements([index](const auto* items, size_t) -> PyValue { return items[index]; });
+}
+
+void PyArray::ownElements() {
+    std::visit([this](auto& items) {
+        using T = typename std::decay_t<decltype(items)>::value_type;
+        const T* elements = static_cast<const T*>(borrowed);
+        items.assign(elements, elements + borrowedCount);
+    }, data);
+    owner.reset();
+    borrowed = nullptr;
+    borrowedCount = 0;
+}
+
+void PyArray::set(size_t index, const PyValue& value) {
+    if (owner) ownElements();
+    if (auto* floats = std::get_if<std::vector<double>>(&data)) {
+        if (std::holds_alternative<double>(value)) {
+            (*floats)[index] = std::get<double>(value);
+            return;
+        }
+        if (std::holds_alternative<long long>(value)) {
+            (*floats)[index] = static_cast<double>(std::get<long long>(value));
+            return;
+        }
+    } else if (std::holds_alternative<long long>(value)) {
+        std::get<std::vector<long long>>(data)[index] = std::get<long long>(value);
+        return;
+    }
+    throw RuntimeError(std::string("array of ") + dtype() + " cannot hold '" +
+                       pyTypeName(value) + "'");
+}
+
+std::shared_ptr<PyArray> PyArray::slice(const SliceBounds& bounds) const {
+    return visitElements([&bounds](const auto* items, size_t) {
+        std::vector<std::decay_t<decltype(*items)>> result;
+        result.reserve(bounds.count);
+        long long index = bounds.start;
+        for (size_t i = 0; i < bounds.count; i++, index += bounds.step) {
+            result.push_back(items[static_cast<size_t>(index)]);
+        }
+        return std::make_shared<PyArray>(std::move(result));
+    });
+}
+
+PyValue PyArray::sum() const {
+    if (isFloat()) return kernels().sumF64(elementData<double>(), size());
+    return kernels().sumI64(elementData<long long>(), size());
+}
+
+PyValue PyArray::min() const {
+    if (size() == 0) throw RuntimeError("min() arg is an empty array");
+    if (isFloat()) return kernels().minF64(elementData<double>(), size());
+    return kernels().minI64(elementData<long long>(), size());
+}
+
+PyValue PyArray::max() const {
+    if (size() == 0) throw RuntimeError("max() arg is an empty array");
+    if (isFloat()) return kernels().maxF64(elementData<double>(), size());
+    return kernels().maxI64(elementData<long long>(), size());
+}
+
+PyValue PyArray::dot(const PyArray& other) const {
+    if (size() != other.size()) {
+        throw RuntimeError("dot() arrays have different lengths (" + std::to_string(size()) +
+                           " and " + std::to_string(other.size()) + ")");
+    }
+    if (isFloat() || other.isFloat()) {
+        Operand<double> a;
+        Operand<double> b;
+        a.view(*this);
+        b.view(other);
+        return kernels().dotF64(a.data, b.data, size());
+    }
+    return kernels().dotI64(elementData<long long>(), other.elementData<long long>(), size());
+}
+
+std::shared_ptr<PyArray> PyArray::create(ArgSpan args) {
+    bool wantFloat = false;
+    bool inferType = args.size() < 2;
+    if (!inferType) {
+        if (!std::holds_alternative<std::string>(args[1])) {
+            throw RuntimeError("array() dtype must be a string, not '" + pyTypeName(args[1]) + "'");
+        }
+        const std::string& dtype = std::get<std::string>(args[1]);
+        if (dtype != "int64" && dtype != "float64") {
+            throw RuntimeError("array() dtype must be 'int64' or 'float64', not '" + dtype + "'");
+        }
+        wantFloat = dtype == "float64";
+    }
+
+    // Packed lists and arrays copy their buffers directly
+    const PyValue& source = args[0];
+    if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&source)) {
+        if ((*list)->storage() == PyList::Storage::INT && (inferType || !wantFloat)) {
+            return std::make_shared<PyArray>((*list)->intData());
+        }
+        if ((*list)->storage() == PyList::Storage::FLOAT && (inferType || wantFloat)) {
+            return std::make_shared<PyArray>((*list)->floatData());
+        }
+    }
+    if (const PyArray* array = asArray(source)) {
+        if (inferType || array->isFloat() == wantFloat) {
+            return std::make_shared<PyArray>(*array);  // Borrowed elements stay shared
+        }
+    }
+
+    std::vector<PyValue> elements;
+    forEachElement(source, [&](const PyValue& element) {
+        if (!std::holds_alternative<long long>(element) && !std::holds_alternative<double>(element)) {
+            throw RuntimeError("array() elements must be numbers, not '" +
+                               pyTypeName(element) + "'");
+        }
+        if (inferType && std::holds_alternative<double>(element)) wantFloat = true;
+        elements.push_back(element);
+    });
+
+    auto result = std::make_shared<PyArray>(
+        wantFloat ? Data(std::vector<double>(elements.size()))
+                  : Data(std::vector<long long>(elements.size())));
+    for (size_t i = 0; i < elements.size(); i++) {
+        result->set(i, elements[i]);
+    }
+    return result;
+}
+
+PyValue PyArray::arithmetic(ArrayOp op, const PyValue& left, const PyValue& right) {
+    size_t n = broadcastLength(opSymbol(op), left, right);
+
+    if (op == ArrayOp::DIV || needsFloat(left) || needsFloat(right)) {
+        Operand<double> a;
+        Operand<double> b;
+        a.view(left);
+        b.view(right);
+        std::vector<double> out(n);
+        kernels().binaryF64(op, a.data, a.scalar, b.data, b.scalar, out.data(), n);
+        return std::make_shared<PyArray>(std::move(out));
+    }
+
+    Operand<long long> a;
+    Operand<long long> b;
+    a.view(left);
+    b.view(right);
+    std::vector<long long> out(n);
+    kernels().binaryI64(op, a.data, a.scalar, b.data, b.scalar, out.data(), n);
+    return std::make_shared<PyArray>(std::move(out));
+}
+
+PyValue PyArray::compare(ArrayCompare op, const PyValue& left, const PyValue& right) {
+    size_t n = broadcastLength(compareSymbol(op), left, right);
+    std::vector<long long> out(n);
+
+    if (needsFloat(left) || needsFloat(right)) {
+        Operand<double> a;
+        Operand<double> b;
+        a.view(left);
+        b.view(right);
+        kernels().compareF64(op, a.data, a.scalar, b.data, b.scalar, out.data(), n);
+    } else {
+        Operand<long long> a;
+        Operand<long long> b;
+        a.view(left);
+        b.view(right);
+        kernels().compareI64(op, a.data, a.scalar, b.data, b.scalar, out.data(), n);
+    }
+    return std::make_shared<PyArray>(std::move(out));
+}
+
+const NativeMethod* PyArray::findMethod(const std::string& name) {
+    for (const NativeMethod& method : methods) {
+        if (name == method.name) return &method;
+    }
+    return nullptr;
+}
@@ -0,0 +1,86 @@
+#ifndef ARRAY_HPP
+#define ARRAY_HPP
+
+#include <memory>
+#include <variant>
+#include <vector>
+#include "array_kernels.hpp"
+#include "value.hpp"
+
+// Typed numeric array: a packed buffer of int64 or float64 elements (the
+// long long and double alternatives of PyValue). Arithmetic, comparisons
+// and reductions run whole-array on the SIMD kernels in array_kernels
+// rather than element by element through the interpreter.
+//
+// Operands broadcast like numpy's one-dimensional case: array op array
+// requires equal lengths, and a number on either side applies to every
+// element. int64 op float64 gives float64, `/` always gives float64, and
+// comparisons give an int64 array of 1s and 0s.
+//
+// An array may also borrow its elements from memory kept alive by an
+// owner, such as a shared mapping a worker process wrote them into. They
+// are read in place and copied into the array's own buffer the first time
+// one is set.
+class PyArray {
+public:
+    using Data = std::variant<std::vector<long long>, std::vector<double>>;
+
+    explicit PyArray(Data data) : data(std::move(data)) {}
+    // `count` elements at `elements`, which `owner` keeps valid
+    template <typename T>
+    PyArray(std::shared_ptr<const void> owner, const T* elements, size_t count)
+        : data(std::vector<T>()), owner(std::move(owner)), borrowed(elements),
+          borrowedCount(count) {}
+
+    bool isFloat() const { return std::holds_alternative<std::vector<double>>(data); }
+    const char* dtype() const { return isFloat() ? "float64" : "int64"; }
+    // The packed elements, if the array is of T (long long or double);
+    // otherwise nullptr
+    template <typename T>
+    const T* elementData() const {
+        const auto* own = std::get_if<std::vector<T>>(&data);
+        if (!own) return nullptr;
+        return owner ? static_cast<const T*>(borrowed) : own->data();
+    }
+    bool isBorrowed() const { return owner != nullptr; }
+    // Calls f(elements, size) with the packed elements of either dtype
+    template <typename F>
+    auto visitElements(F f) const {
+        if (isFloat()) return f(elementData<double>(), size());
+        return f(elementData<long long>(), size());
+    }
+    size_t size() const;
+    PyValue get(size_t index) const;
+    // Ints convert to float64; a float stored into an int64 array throws
+    void set(size_t index, const PyValue& value);
+
+    std::shared_ptr<PyArray> slice(const SliceBounds& bounds) const;
+
+    // Reductions; min and max throw for an empty array
+    PyValue sum() const;
+    PyValue min() const;
+    PyValue max() const;
+    PyValue dot(const PyArray& other) const;
+
+    // array(iterable[, dtype]): dtype is "int64" or "float64", inferred from
+    // the elements if omitted
+    static std::shared_ptr<PyArray> create(ArgSpan args);
+
+    // left op right where at least one side is an array
+    static PyValue arithmetic(ArrayOp op, const PyValue& left, const PyValue& right);
+    static PyValue compare(ArrayCompare op, const PyValue& left, const PyValue& right);
+
+    // sum, min, max, dot, tolist; nullptr for unknown names
+    static const NativeMethod* findMethod(const std::string& name);
+
+private:
+    Data data;  // Empty while the elements are borrowed
+    std::shared_ptr<const void> owner;
+    const void* borrowed = nullptr;
+    size_t borrowedCount = 0;
+
+    // Copies borrowed elements into `data`, before one is set
+    void ownElements();
+};
+
+#endif // ARRAY_HPP
@@ -0,0 +1,307 @@
+#include "array_kernels.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Index step for an operand: 0 for a broadcast scalar, 1 for an array
+inline size_t step(bool scalar) {
+    return scalar ? 0 : 1;
+}
+
+template <typename T, typename R, typename F>
+void elementwise(const T* a, bool aScalar, const T* b, bool bScalar, R* out, size_t n, F f) {
+    size_t sa = step(aScalar);
+    size_t sb = step(bScalar);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = f(a[i * sa], b[i * sb]);
+    }
+}
+
+// Portable kernels, also used for the tails of the vector loops
+
+template <typename T>
+void binaryScalar(ArrayOp op, const T* a, bool aScalar, const T* b, bool bScalar, T* out,
+                  size_t n) {
+    switch (op) {
+        case ArrayOp::ADD:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) { return x + y; });
+            break;
+        case ArrayOp::SUB:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) { return x - y; });
+            break;
+        case ArrayOp::MUL:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) { return x * y; });
+            break;
+        case ArrayOp::DIV:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) { return x / y; });
+            break;
+    }
+}
+
+void binaryI64Scalar(ArrayOp op, const long long* a, bool aScalar, const long long* b,
+                     bool bScalar, long long* out, size_t n) {
+    if (op != ArrayOp::DIV) binaryScalar(op, a, aScalar, b, bScalar, out, n);
+}
+
+template <typename T>
+void compareScalar(ArrayCompare op, const T* a, bool aScalar, const T* b, bool bScalar,
+                   long long* out, size_t n) {
+    switch (op) {
+        case ArrayCompare::LT:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x < y; });
+            break;
+        case ArrayCompare::LE:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x <= y; });
+            break;
+        case ArrayCompare::GT:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x > y; });
+            break;
+        case ArrayCompare::GE:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x >= y; });
+            break;
+        case ArrayCompare::EQ:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x == y; });
+            break;
+        case ArrayCompare::NE:
+            elementwise(a, aScalar, b, bScalar, out, n, [](T x, T y) -> long long { return x != y; });
+            break;
+    }
+}
+
+template <typename T>
+T sumScalar(const T* a, size_t n) {
+    T total = 0;
+    for (size_t i = 0; i < n; i++) total += a[i];
+    return total;
+}
+
+template <typename T>
+T minScalar(const T* a, size_t n) {
+    T best = a[0];
+    for (size_t i = 1; i < n; i++) best = a[i] < best ? a[i] : best;
+    return best;
+}
+
+template <typename T>
+T maxScalar(const T* a, size_t n) {
+    T best = a[0];
+    for (size_t i = 1; i < n; i++) best = a[i] > best ? a[i] : best;
+    return best;
+}
+
+template <typename T>
+T dotScalar(const T* a, const T* b, size_t n) {
+    T total = 0;
+    for (size_t i = 0; i < n; i++) total += a[i] * b[i];
+    return total;
+}
+
+const ArrayKernels scalarKernels = {
+    "scalar",
+    binaryScalar<double>,
+    binaryI64Scalar,
+    compareScalar<double>,
+    compareScalar<long long>,
+    sumScalar<double>,
+    minScalar<double>,
+    maxScalar<double>,
+    dotScalar<double>,
+    sumScalar<long long>,
+    minScalar<long long>,
+    maxScalar<long long>,
+    dotScalar<long long>,
+};
+
+#if defined(__SSE2__)
+
+// SSE2 is part of the x86-64 baseline, so these need no dispatch. They
+// vectorize the float kernels two lanes at a time; SSE2 has no 64-bit
+// integer compare or multiply, so integer kernels stay scalar.
+
+template <typename V, typename S>
+void binarySse2(const double* a, bool aScalar, const double* b, bool bScalar, double* out,
+                size_t n, V vector, S scalar) {
+    if (n == 0) return;
+    const __m128d va = _mm_set1_pd(a[0]);
+    const __m128d vb = _mm_set1_pd(b[0]);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = aScalar ? va : _mm_loadu_pd(a + i);
+        __m128d y = bScalar ? vb : _mm_loadu_pd(b + i);
+        _mm_storeu_pd(out + i, vector(x, y));
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void binaryF64Sse2(ArrayOp op, const double* a, bool aScalar, const double* b, bool bScalar,
+                   double* out, size_t n) {
+    switch (op) {
+        case ArrayOp::ADD:
+            binarySse2(a, aScalar, b, bScalar, out, n,
+                       [](__m128d x, __m128d y) { return _mm_add_pd(x, y); },
+                       [](double x, double y) { return x + y; });
+            break;
+        case ArrayOp::SUB:
+            binarySse2(a, aScalar, b, bScalar, out, n,
+                       [](__m128d x, __m128d y) { return _mm_sub_pd(x, y); },
+                       [](double x, double y) { return x - y; });
+            break;
+        case ArrayOp::MUL:
+            binarySse2(a, aScalar, b, bScalar, out, n,
+                       [](__m128d x, __m128d y) { return _mm_mul_pd(x, y); },
+                       [](double x, double y) { return x * y; });
+            break;
+        case ArrayOp::DIV:
+            binarySse2(a, aScalar, b, bScalar, out, n,
+                       [](__m128d x, __m128d y) { return _mm_div_pd(x, y); },
+                       [](double x, double y) { return x / y; });
+            break;
+    }
+}
+
+// `mask` yields all-ones lanes where the comparison holds
+template <typename V, typename S>
+void compareSse2(const double* a, bool aScalar, const double* b, bool bScalar, long long* out,
+                 size_t n, V mask, S scalar) {
+    if (n == 0) return;
+    const __m128d va = _mm_set1_pd(a[0]);
+    const __m128d vb = _mm_set1_pd(b[0]);
+    const __m128i one = _mm_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = aScalar ? va : _mm_loadu_pd(a + i);
+        __m128d y = bScalar ? vb : _mm_loadu_pd(b + i);
+        __m128i bits = _mm_and_si128(_mm_castpd_si128(mask(x, y)), one);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bits);
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void compareF64Sse2(ArrayCompare op, const double* a, bool aScalar, const double* b,
+                    bool bScalar, long long* out, size_t n) {
+    switch (op) {
+        case ArrayCompare::LT:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmplt_pd(x, y); },
+                        [](double x, double y) -> long long { return x < y; });
+            break;
+        case ArrayCompare::LE:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmple_pd(x, y); },
+                        [](double x, double y) -> long long { return x <= y; });
+            break;
+        case ArrayCompare::GT:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmpgt_pd(x, y); },
+                        [](double x, double y) -> long long { return x > y; });
+            break;
+        case ArrayCompare::GE:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmpge_pd(x, y); },
+                        [](double x, double y) -> long long { return x >= y; });
+            break;
+        case ArrayCompare::EQ:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmpeq_pd(x, y); },
+                        [](double x, double y) -> long long { return x == y; });
+            break;
+        case ArrayCompare::NE:
+            compareSse2(a, aScalar, b, bScalar, out, n,
+                        [](__m128d x, __m128d y) { return _mm_cmpneq_pd(x, y); },
+                        [](double x, double y) -> long long { return x != y; });
+            break;
+    }
+}
+
+double horizontalSum(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+double sumF64Sse2(const double* a, size_t n) {
+    // Two accumulators to hide the add latency
+    __m128d s0 = _mm_setzero_pd();
+    __m128d s1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+    }
+    double total = horizontalSum(_mm_add_pd(s0, s1));
+    for (; i < n; i++) total += a[i];
+    return total;
+}
+
+double dotF64Sse2(const double* a, const double* b, size_t n) {
+    __m128d s0 = _mm_setzero_pd();
+    __m128d s1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double total = horizontalSum(_mm_add_pd(s0, s1));
+    for (; i < n; i++) total += a[i] * b[i];
+    return total;
+}
+
+double minF64Sse2(const double* a, size_t n) {
+    if (n < 2) return a[0];
+    __m128d best = _mm_loadu_pd(a);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) best = _mm_min_pd(best, _mm_loadu_pd(a + i));
+    double result = _mm_cvtsd_f64(_mm_min_sd(best, _mm_unpackhi_pd(best, best)));
+    for (; i < n; i++) result = a[i] < result ? a[i] : result;
+    return result;
+}
+
+double maxF64Sse2(const double* a, size_t n) {
+    if (n < 2) return a[0];
+    __m128d best = _mm_loadu_pd(a);
+    size_t i = 2;
+    for (; i + 2 <= n; i += 2) best = _mm_max_pd(best, _mm_loadu_pd(a + i));
+    double result = _mm_cvtsd_f64(_mm_max_sd(best, _mm_unpackhi_pd(best, best)));
+    for (; i < n; i++) result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+const ArrayKernels sse2Kernels = {
+    "sse2",
+    binaryF64Sse2,
+    binaryI64Scalar,
+    compareF64Sse2,
+    compareScalar<long long>,
+    sumF64Sse2,
+    minF64Sse2,
+    maxF64Sse2,
+    dotF64Sse2,
+    sumScalar<long long>,
+    minScalar<long long>,
+    maxScalar<long long>,
+    dotScalar<long long>,
+};
+
+#endif  // __SSE2__
+
+}  // namespace
+
+std::vector<const ArrayKernels*> ArrayKernels::available() {
+    std::vector<const ArrayKernels*> sets{&scalarKernels};
+#if defined(__SSE2__)
+    sets.push_back(&sse2Kernels);
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    const ArrayKernels* avx2 = avx2ArrayKernels();
+    if (avx2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        sets.push_back(avx2);
+    }
+#endif
+    return sets;
+}
+
+const ArrayKernels& ArrayKernels::best() {
+    static const ArrayKernels& chosen = *available().back();
+    return chosen;
+}
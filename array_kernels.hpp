@@ -0,0 +1,51 @@
+#ifndef ARRAY_KERNELS_HPP
+#define ARRAY_KERNELS_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Elementwise and reduction loops behind the array type, in one set per
+// instruction set level. best() picks the widest set the CPU supports the
+// first time it is called; the others remain available for testing.
+//
+// Binary and compare kernels take each operand either as an array of n
+// elements or, when its `scalar` flag is set, as a single element
+// broadcast across the array. Comparisons write 1 or 0 per element.
+// Reductions over floats may add in a different order than a sequential
+// loop, so their results can differ in the last bits, and min/max do not
+// propagate NaN. All reductions require n > 0 except sum and dot.
+enum class ArrayOp { ADD, SUB, MUL, DIV };
+enum class ArrayCompare { LT, LE, GT, GE, EQ, NE };
+
+struct ArrayKernels {
+    const char* name;  // "avx2", "sse2" or "scalar"
+
+    void (*binaryF64)(ArrayOp op, const double* a, bool aScalar, const double* b, bool bScalar,
+                      double* out, size_t n);
+    // DIV is not supported (integer arrays divide as floats)
+    void (*binaryI64)(ArrayOp op, const long long* a, bool aScalar, const long long* b,
+                      bool bScalar, long long* out, size_t n);
+    void (*compareF64)(ArrayCompare op, const double* a, bool aScalar, const double* b,
+                       bool bScalar, long long* out, size_t n);
+    void (*compareI64)(ArrayCompare op, const long long* a, bool aScalar, const long long* b,
+                       bool bScalar, long long* out, size_t n);
+
+    double (*sumF64)(const double* a, size_t n);
+    double (*minF64)(const double* a, size_t n);
+    double (*maxF64)(const double* a, size_t n);
+    double (*dotF64)(const double* a, const double* b, size_t n);
+    long long (*sumI64)(const long long* a, size_t n);
+    long long (*minI64)(const long long* a, size_t n);
+    long long (*maxI64)(const long long* a, size_t n);
+    long long (*dotI64)(const long long* a, const long long* b, size_t n);
+
+    static const ArrayKernels& best();
+    // Every set this CPU can run, scalar first
+    static std::vector<const ArrayKernels*> available();
+};
+
+// Defined in array_kernels_avx2.cpp, which is the only file compiled with
+// AVX2 enabled; nullptr when the build has no AVX2 support
+const ArrayKernels* avx2ArrayKernels();
+
+#endif // ARRAY_KERNELS_HPP
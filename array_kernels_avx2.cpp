@@ -0,0 +1,373 @@
+// AVX2 + FMA kernels. This is the only file built with -mavx2 -mfma, and
+// it is only called after ArrayKernels::available() has checked the CPU.
+// Keep it free of standard library templates: an inline function compiled
+// here could be picked by the linker for the rest of the program.
+#include "array_kernels.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include <immintrin.h>
+
+namespace {
+
+inline size_t step(bool scalar) {
+    return scalar ? 0 : 1;
+}
+
+template <typename T, typename R, typename F>
+void elementwise(const T* a, bool aScalar, const T* b, bool bScalar, R* out, size_t n, F f) {
+    size_t sa = step(aScalar);
+    size_t sb = step(bScalar);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = f(a[i * sa], b[i * sb]);
+    }
+}
+
+inline __m256i loadI64(const long long* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+inline void storeI64(long long* p, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+// Float kernels, four lanes at a time
+
+template <typename V, typename S>
+void binaryF64Loop(const double* a, bool aScalar, const double* b, bool bScalar, double* out,
+                   size_t n, V vector, S scalar) {
+    if (n == 0) return;
+    const __m256d va = _mm256_set1_pd(a[0]);
+    const __m256d vb = _mm256_set1_pd(b[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = aScalar ? va : _mm256_loadu_pd(a + i);
+        __m256d y = bScalar ? vb : _mm256_loadu_pd(b + i);
+        _mm256_storeu_pd(out + i, vector(x, y));
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void binaryF64(ArrayOp op, const double* a, bool aScalar, const double* b, bool bScalar,
+               double* out, size_t n) {
+    switch (op) {
+        case ArrayOp::ADD:
+            binaryF64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256d x, __m256d y) { return _mm256_add_pd(x, y); },
+                          [](double x, double y) { return x + y; });
+            break;
+        case ArrayOp::SUB:
+            binaryF64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256d x, __m256d y) { return _mm256_sub_pd(x, y); },
+                          [](double x, double y) { return x - y; });
+            break;
+        case ArrayOp::MUL:
+            binaryF64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256d x, __m256d y) { return _mm256_mul_pd(x, y); },
+                          [](double x, double y) { return x * y; });
+            break;
+        case ArrayOp::DIV:
+            binaryF64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256d x, __m256d y) { return _mm256_div_pd(x, y); },
+                          [](double x, double y) { return x / y; });
+            break;
+    }
+}
+
+// _mm256_cmp_pd takes its predicate as an immediate, hence one lambda each
+template <typename V, typename S>
+void compareF64Loop(const double* a, bool aScalar, const double* b, bool bScalar,
+                    long long* out, size_t n, V mask, S scalar) {
+    if (n == 0) return;
+    const __m256d va = _mm256_set1_pd(a[0]);
+    const __m256d vb = _mm256_set1_pd(b[0]);
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = aScalar ? va : _mm256_loadu_pd(a + i);
+        __m256d y = bScalar ? vb : _mm256_loadu_pd(b + i);
+        storeI64(out + i, _mm256_and_si256(_mm256_castpd_si256(mask(x, y)), one));
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void compareF64(ArrayCompare op, const double* a, bool aScalar, const double* b, bool bScalar,
+                long long* out, size_t n) {
+    switch (op) {
+        case ArrayCompare::LT:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); },
+                           [](double x, double y) -> long long { return x < y; });
+            break;
+        case ArrayCompare::LE:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); },
+                           [](double x, double y) -> long long { return x <= y; });
+            break;
+        case ArrayCompare::GT:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); },
+                           [](double x, double y) -> long long { return x > y; });
+            break;
+        case ArrayCompare::GE:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_GE_OQ); },
+                           [](double x, double y) -> long long { return x >= y; });
+            break;
+        case ArrayCompare::EQ:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); },
+                           [](double x, double y) -> long long { return x == y; });
+            break;
+        case ArrayCompare::NE:
+            compareF64Loop(a, aScalar, b, bScalar, out, n,
+                           [](__m256d x, __m256d y) { return _mm256_cmp_pd(x, y, _CMP_NEQ_UQ); },
+                           [](double x, double y) -> long long { return x != y; });
+            break;
+    }
+}
+
+double horizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+double sumF64(const double* a, size_t n) {
+    // Two accumulators to hide the add latency
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+        s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
+    }
+    double total = horizontalSum(_mm256_add_pd(s0, s1));
+    for (; i < n; i++) total += a[i];
+    return total;
+}
+
+double dotF64(const double* a, const double* b, size_t n) {
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+    }
+    double total = horizontalSum(_mm256_add_pd(s0, s1));
+    for (; i < n; i++) total += a[i] * b[i];
+    return total;
+}
+
+double minF64(const double* a, size_t n) {
+    if (n < 4) {
+        double best = a[0];
+        for (size_t i = 1; i < n; i++) best = a[i] < best ? a[i] : best;
+        return best;
+    }
+    __m256d best = _mm256_loadu_pd(a);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) best = _mm256_min_pd(best, _mm256_loadu_pd(a + i));
+    __m128d pair = _mm_min_pd(_mm256_castpd256_pd128(best), _mm256_extractf128_pd(best, 1));
+    double result = _mm_cvtsd_f64(_mm_min_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    for (; i < n; i++) result = a[i] < result ? a[i] : result;
+    return result;
+}
+
+double maxF64(const double* a, size_t n) {
+    if (n < 4) {
+        double best = a[0];
+        for (size_t i = 1; i < n; i++) best = a[i] > best ? a[i] : best;
+        return best;
+    }
+    __m256d best = _mm256_loadu_pd(a);
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) best = _mm256_max_pd(best, _mm256_loadu_pd(a + i));
+    __m128d pair = _mm_max_pd(_mm256_castpd256_pd128(best), _mm256_extractf128_pd(best, 1));
+    double result = _mm_cvtsd_f64(_mm_max_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    for (; i < n; i++) result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+// Integer kernels. AVX2 has 64-bit add, subtract and compare but no 64-bit
+// multiply, so multiplication and dot stay scalar loops (which the
+// compiler may still vectorize with AVX2 here).
+
+template <typename V, typename S>
+void binaryI64Loop(const long long* a, bool aScalar, const long long* b, bool bScalar,
+                   long long* out, size_t n, V vector, S scalar) {
+    if (n == 0) return;
+    const __m256i va = _mm256_set1_epi64x(a[0]);
+    const __m256i vb = _mm256_set1_epi64x(b[0]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = aScalar ? va : loadI64(a + i);
+        __m256i y = bScalar ? vb : loadI64(b + i);
+        storeI64(out + i, vector(x, y));
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void binaryI64(ArrayOp op, const long long* a, bool aScalar, const long long* b, bool bScalar,
+               long long* out, size_t n) {
+    switch (op) {
+        case ArrayOp::ADD:
+            binaryI64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256i x, __m256i y) { return _mm256_add_epi64(x, y); },
+                          [](long long x, long long y) { return x + y; });
+            break;
+        case ArrayOp::SUB:
+            binaryI64Loop(a, aScalar, b, bScalar, out, n,
+                          [](__m256i x, __m256i y) { return _mm256_sub_epi64(x, y); },
+                          [](long long x, long long y) { return x - y; });
+            break;
+        case ArrayOp::MUL:
+            elementwise(a, aScalar, b, bScalar, out, n,
+                        [](long long x, long long y) { return x * y; });
+            break;
+        case ArrayOp::DIV:
+            break;
+    }
+}
+
+// Only > and == exist as integer compares; the others swap the operands
+// and/or invert the mask
+template <typename V, typename S>
+void compareI64Loop(const long long* a, bool aScalar, const long long* b, bool bScalar,
+                    long long* out, size_t n, bool invert, V mask, S scalar) {
+    if (n == 0) return;
+    const __m256i va = _mm256_set1_epi64x(a[0]);
+    const __m256i vb = _mm256_set1_epi64x(b[0]);
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = aScalar ? va : loadI64(a + i);
+        __m256i y = bScalar ? vb : loadI64(b + i);
+        __m256i m = mask(x, y);
+        storeI64(out + i, invert ? _mm256_andnot_si256(m, one) : _mm256_and_si256(m, one));
+    }
+    elementwise(aScalar ? a : a + i, aScalar, bScalar ? b : b + i, bScalar, out + i, n - i, scalar);
+}
+
+void compareI64(ArrayCompare op, const long long* a, bool aScalar, const long long* b,
+                bool bScalar, long long* out, size_t n) {
+    auto greater = [](__m256i x, __m256i y) { return _mm256_cmpgt_epi64(x, y); };
+    auto less = [](__m256i x, __m256i y) { return _mm256_cmpgt_epi64(y, x); };
+    auto equal = [](__m256i x, __m256i y) { return _mm256_cmpeq_epi64(x, y); };
+    switch (op) {
+        case ArrayCompare::LT:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, false, less,
+                           [](long long x, long long y) -> long long { return x < y; });
+            break;
+        case ArrayCompare::LE:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, true, greater,
+                           [](long long x, long long y) -> long long { return x <= y; });
+            break;
+        case ArrayCompare::GT:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, false, greater,
+                           [](long long x, long long y) -> long long { return x > y; });
+            break;
+        case ArrayCompare::GE:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, true, less,
+                           [](long long x, long long y) -> long long { return x >= y; });
+            break;
+        case ArrayCompare::EQ:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, false, equal,
+                           [](long long x, long long y) -> long long { return x == y; });
+            break;
+        case ArrayCompare::NE:
+            compareI64Loop(a, aScalar, b, bScalar, out, n, true, equal,
+                           [](long long x, long long y) -> long long { return x != y; });
+            break;
+    }
+}
+
+long long horizontalSum(__m256i v) {
+    long long lanes[4];
+    storeI64(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+long long sumI64(const long long* a, size_t n) {
+    __m256i s0 = _mm256_setzero_si256();
+    __m256i s1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_epi64(s0, loadI64(a + i));
+        s1 = _mm256_add_epi64(s1, loadI64(a + i + 4));
+    }
+    long long total = horizontalSum(_mm256_add_epi64(s0, s1));
+    for (; i < n; i++) total += a[i];
+    return total;
+}
+
+// `replace(best, x)` is all-ones in lanes where x should replace best;
+// `better(x, best)` is the same test on one element
+template <typename V, typename S>
+long long extremeI64(const long long* a, size_t n, V replace, S better) {
+    long long result = a[0];
+    size_t i = 1;
+    if (n >= 4) {
+        __m256i best = loadI64(a);
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m256i x = loadI64(a + i);
+            best = _mm256_blendv_epi8(best, x, replace(best, x));
+        }
+        long long lanes[4];
+        storeI64(lanes, best);
+        result = lanes[0];
+        for (int lane = 1; lane < 4; lane++) {
+            if (better(lanes[lane], result)) result = lanes[lane];
+        }
+    }
+    for (; i < n; i++) {
+        if (better(a[i], result)) result = a[i];
+    }
+    return result;
+}
+
+long long minI64(const long long* a, size_t n) {
+    return extremeI64(a, n, [](__m256i best, __m256i x) { return _mm256_cmpgt_epi64(best, x); },
+                      [](long long x, long long best) { return x < best; });
+}
+
+long long maxI64(const long long* a, size_t n) {
+    return extremeI64(a, n, [](__m256i best, __m256i x) { return _mm256_cmpgt_epi64(x, best); },
+                      [](long long x, long long best) { return x > best; });
+}
+
+long long dotI64(const long long* a, const long long* b, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < n; i++) total += a[i] * b[i];
+    return total;
+}
+
+const ArrayKernels avx2Kernels = {
+    "avx2",
+    binaryF64,
+    binaryI64,
+    compareF64,
+    compareI64,
+    sumF64,
+    minF64,
+    maxF64,
+    dotF64,
+    sumI64,
+    minI64,
+    maxI64,
+    dotI64,
+};
+
+}  // namespace
+
+const ArrayKernels* avx2ArrayKernels() {
+    return &avx2Kernels;
+}
+
+#else
+
+const ArrayKernels* avx2ArrayKernels() {
+    return nullptr;
+}
+
+#endif
@@ -1,11 +1,16 @@
 #ifndef AST_HPP
 #define AST_HPP
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <variant>
+#include "arena.hpp"
+#include "shape.hpp"
 #include "token.hpp"
+#include "value.hpp"
 
 // Forward declarations
 struct BinaryExpr;
@@ -15,6 +20,15 @@ struct VariableExpr;
 struct AssignExpr;
 struct CallExpr;
 struct GroupingExpr;
+struct GetExpr;
+struct ListExpr;
+struct IndexExpr;
+struct SliceExpr;
+struct IndexAssignExpr;
+struct AttributeAssignExpr;
+struct DictExpr;
+struct SetExpr;
+struct AwaitExpr;
 
 struct ExpressionStmt;
 struct PrintStmt;
@@ -22,62 +36,108 @@ struct VarStmt;
 struct BlockStmt;
 struct IfStmt;
 struct WhileStmt;
+struct ForStmt;
 struct FunctionStmt;
 struct ReturnStmt;
 struct AssertStmt;
+struct YieldStmt;
+struct ClassStmt;
+
+class AstArena;
+
+// Every node is allocated in the AstArena of the module it was parsed
+// from (see the end of this file) and referred to by a NodePtr, so an
+// Expr or Stmt is a tagged pointer into the arena that can be copied
+// freely and owns nothing.
 
 // Expression variant
 using Expr = std::variant<
-    std::unique_ptr<BinaryExpr>,
-    std::unique_ptr<UnaryExpr>,
-    std::unique_ptr<LiteralExpr>,
-    std::unique_ptr<VariableExpr>,
-    std::unique_ptr<AssignExpr>,
-    std::unique_ptr<CallExpr>,
-    std::unique_ptr<GroupingExpr>
+    NodePtr<BinaryExpr>,
+    NodePtr<UnaryExpr>,
+    NodePtr<LiteralExpr>,
+    NodePtr<VariableExpr>,
+    NodePtr<AssignExpr>,
+    NodePtr<CallExpr>,
+    NodePtr<GroupingExpr>,
+    NodePtr<GetExpr>,
+    NodePtr<ListExpr>,
+    NodePtr<IndexExpr>,
+    NodePtr<SliceExpr>,
+    NodePtr<IndexAssignExpr>,
+    NodePtr<DictExpr>,
+    NodePtr<SetExpr>,
+    NodePtr<AwaitExpr>,
+    NodePtr<AttributeAssignExpr>
 >;
 
 // Statement variant
 using Stmt = std::variant<
-    std::unique_ptr<ExpressionStmt>,
-    std::unique_ptr<PrintStmt>,
-    std::unique_ptr<VarStmt>,
-    std::unique_ptr<BlockStmt>,
-    std::unique_ptr<IfStmt>,
-    std::unique_ptr<WhileStmt>,
-    std::unique_ptr<FunctionStmt>,
-    std::unique_ptr<ReturnStmt>,
-    std::unique_ptr<AssertStmt>
+    NodePtr<ExpressionStmt>,
+    NodePtr<PrintStmt>,
+    NodePtr<VarStmt>,
+    NodePtr<BlockStmt>,
+    NodePtr<IfStmt>,
+    NodePtr<WhileStmt>,
+    NodePtr<ForStmt>,
+    NodePtr<FunctionStmt>,
+    NodePtr<ReturnStmt>,
+    NodePtr<AssertStmt>,
+    NodePtr<YieldStmt>,
+    NodePtr<ClassStmt>
 >;
 
-// Python value type
-struct PyNone {};
-struct PyFunction;
-
-using PyValue = std::variant<
-    PyNone,
-    bool,
-    long long,
-    double,
-    std::string,
-    std::shared_ptr<PyFunction>
->;
+// Compact token references stored in AST nodes. A node only needs the
+// kind and position of an operator or keyword, or the spelling of a name,
+// so it does not carry a full Token (lexeme plus literal variant).
+struct OpToken {
+    TokenType type;
+    int line;
+    int column;
+
+    OpToken(TokenType type, int line, int column)
+        : type(type), line(line), column(column) {}
+    OpToken(const Token& token)
+        : type(token.type), line(token.line), column(token.column) {}
+};
+
+struct NameToken {
+    std::string lexeme;
+    int line;
+    int column;
+
+    NameToken(std::string lexeme, int line, int column)
+        : lexeme(std::move(lexeme)), line(line), column(column) {}
+    NameToken(const Token& token)
+        : lexeme(token.lexeme), line(token.line), column(token.column) {}
+};
+
+// Where a variable lives, as worked out by the Resolver (resolver.hpp)
+// before the function using it first runs: a slot in the function's
+// frame, a cell the frame shares with nested functions, or a cell in the
+// function's closure. Names outside any function, and names a function
+// neither binds nor finds in an enclosing one, are GLOBAL and looked up
+// by name.
+struct VariableSlot {
+    enum class Kind : uint8_t { GLOBAL, LOCAL, CELL, FREE };
+    Kind kind = Kind::GLOBAL;
+    uint32_t index = 0;
+};
 
 // Expression nodes
 struct BinaryExpr {
     Expr left;
-    Token op;
+    OpToken op;
     Expr right;
 
-    BinaryExpr(Expr left, Token op, Expr right)
+    BinaryExpr(Expr left, OpToken op, Expr right)
         : left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
 };
 
 struct UnaryExpr {
-    Token op;
+    OpToken op;
     Expr operand;
 
-    UnaryExpr(Token op, Expr operand)
+    UnaryExpr(OpToken op, Expr operand)
         : op(std::move(op)), operand(std::move(operand)) {}
 };
 
@@ -88,25 +148,27 @@ struct LiteralExpr {
 };
 
 struct VariableExpr {
-    Token name;
+    NameToken name;
+    mutable VariableSlot slot;
 
-    explicit VariableExpr(Token name) : name(std::move(name)) {}
+    explicit VariableExpr(NameToken name) : name(std::move(name)) {}
 };
 
 struct AssignExpr {
-    Token name;
+    NameToken name;
     Expr value;
+    mutable VariableSlot slot;
 
-    AssignExpr(Token name, Expr value)
+    AssignExpr(NameToken name, Expr value)
         : name(std::move(name)), value(std::move(value)) {}
 };
 
 struct CallExpr {
     Expr callee;
-    Token paren;  // For error reporting
+    OpToken paren;  // For error reporting
     std::vector<Expr> arguments;
 
-    CallExpr(Expr callee, Token paren, std::vector<Expr> arguments)
+    CallExpr(Expr callee, OpToken paren, std::vector<Expr> arguments)
         : callee(std::move(callee)), paren(std::move(paren)), arguments(std::move(arguments)) {}
 };
 
@@ -116,6 +178,106 @@ struct GroupingExpr {
     explicit GroupingExpr(Expr expression) : expression(std::move(expression)) {}
 };
 
+// Attribute access: object.name. Also the callee of a method call,
+// object.name(...), which calls the method without binding it first.
+struct GetExpr {
+    Expr object;
+    NameToken name;
+    mutable InlineCache cache;  // For instances
+
+    GetExpr(Expr object, NameToken name)
+        : object(std::move(object)), name(std::move(name)) {}
+};
+
+// List display: [a, b, c]
+struct ListExpr {
+    OpToken bracket;
+    std::vector<Expr> elements;
+
+    ListExpr(OpToken bracket, std::vector<Expr> elements)
+        : bracket(bracket), elements(std::move(elements)) {}
+};
+
+// Dict display: {k1: v1, k2: v2}; keys[i] maps to values[i]
+struct DictExpr {
+    OpToken brace;
+    std::vector<Expr> keys;
+    std::vector<Expr> values;
+
+    DictExpr(OpToken brace, std::vector<Expr> keys, std::vector<Expr> values)
+        : brace(brace), keys(std::move(keys)), values(std::move(values)) {}
+};
+
+// Set display: {a, b, c} (never empty; {} is a dict)
+struct SetExpr {
+    OpToken brace;
+    std::vector<Expr> elements;
+
+    SetExpr(OpToken brace, std::vector<Expr> elements)
+        : brace(brace), elements(std::move(elements)) {}
+};
+
+// await operand; only valid inside an async def
+struct AwaitExpr {
+    OpToken keyword;
+    Expr operand;
+
+    AwaitExpr(OpToken keyword, Expr operand)
+        : keyword(keyword), operand(std::move(operand)) {}
+};
+
+// Subscript: object[index]
+struct IndexExpr {
+    Expr object;
+    OpToken bracket;  // For error reporting
+    Expr index;
+
+    IndexExpr(Expr object, OpToken bracket, Expr index)
+        : object(std::move(object)), bracket(bracket), index(std::move(index)) {}
+};
+
+// Slice: object[lower:upper:step], each bound optional
+struct SliceExpr {
+    Expr object;
+    OpToken bracket;
+    NodePtr<Expr> lower;
+    NodePtr<Expr> upper;
+    NodePtr<Expr> step;
+
+    SliceExpr(Expr object, OpToken bracket, NodePtr<Expr> lower,
+              NodePtr<Expr> upper, NodePtr<Expr> step)
+        : object(std::move(object)), bracket(bracket), lower(std::move(lower)),
+          upper(std::move(upper)), step(std::move(step)) {}
+};
+
+// object[index] = value, or a compound object[index] op= value, which
+// evaluates object and index once. op is ASSIGN for plain assignment,
+// otherwise the binary operator (PLUS for +=, ...).
+struct IndexAssignExpr {
+    Expr object;
+    OpToken bracket;
+    Expr index;
+    OpToken op;
+    Expr value;
+
+    IndexAssignExpr(Expr object, OpToken bracket, Expr index, OpToken op, Expr value)
+        : object(std::move(object)), bracket(bracket), index(std::move(index)),
+          op(op), value(std::move(value)) {}
+};
+
+// object.name = value, or a compound object.name op= value, which
+// evaluates object once; op as for IndexAssignExpr
+struct AttributeAssignExpr {
+    Expr object;
+    NameToken name;
+    OpToken op;
+    Expr value;
+    mutable InlineCache cache;  // For instances
+
+    AttributeAssignExpr(Expr object, NameToken name, OpToken op, Expr value)
+        : object(std::move(object)), name(std::move(name)), op(op), value(std::move(value)) {}
+};
+
 // Statement nodes
 struct ExpressionStmt {
     Expr expression;
@@ -130,10 +292,11 @@ struct PrintStmt {
 };
 
 struct VarStmt {
-    Token name;
+    NameToken name;
     Expr initializer;
+    mutable VariableSlot slot;
 
-    VarStmt(Token name, Expr initializer)
+    VarStmt(NameToken name, Expr initializer)
         : name(std::move(name)), initializer(std::move(initializer)) {}
 };
 
@@ -147,11 +310,11 @@ struct IfStmt {
     Expr condition;
     Stmt thenBranch;
     std::vector<std::pair<Expr, Stmt>> elifBranches;
-    std::unique_ptr<Stmt> elseBranch;
+    NodePtr<Stmt> elseBranch;
 
     IfStmt(Expr condition, Stmt thenBranch,
            std::vector<std::pair<Expr, Stmt>> elifBranches,
-           std::unique_ptr<Stmt> elseBranch)
+           NodePtr<Stmt> elseBranch)
         : condition(std::move(condition)), thenBranch(std::move(thenBranch)),
           elifBranches(std::move(elifBranches)), elseBranch(std::move(elseBranch)) {}
 };
@@ -164,91 +327,138 @@ struct WhileStmt {
         : condition(std::move(condition)), body(std::move(body)) {}
 };
 
-struct FunctionStmt {
-    Token name;
-    std::vector<Token> params;
-    std::vector<Stmt> body;
+// for variable in iterable: body
+struct ForStmt {
+    OpToken keyword;  // For error reporting
+    NameToken variable;
+    Expr iterable;
+    Stmt body;  // Always a BlockStmt
+    mutable VariableSlot slot;  // The variable's
+
+    ForStmt(OpToken keyword, NameToken variable, Expr iterable, Stmt body)
+        : keyword(keyword), variable(std::move(variable)),
+          iterable(std::move(iterable)), body(std::move(body)) {}
+};
 
-    FunctionStmt(Token name, std::vector<Token> params, std::vector<Stmt> body)
-        : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
+// A function body the parser skipped over in lazy mode: the tokens from
+// just after the body's INDENT up to (not including) the token that closes
+// it, which is the matching DEDENT or END_OF_FILE.
+struct DeferredBody {
+    std::shared_ptr<const std::vector<Token>> tokens;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+struct FunctionStmt {
+    NameToken name;
+    std::vector<NameToken> params;
+    // The body contains a yield (outside any nested def), so calling the
+    // function returns a generator instead of running it
+    bool isGenerator;
+    // Declared `async def`: calling it returns a coroutine, and its body
+    // may await
+    bool isAsync;
+
+    FunctionStmt(NameToken name, std::vector<NameToken> params, std::vector<Stmt> body,
+                 bool isGenerator = false, bool isAsync = false)
+        : name(std::move(name)), params(std::move(params)), isGenerator(isGenerator),
+          isAsync(isAsync), parsedBody(std::move(body)) {}
+
+    FunctionStmt(NameToken name, std::vector<NameToken> params, DeferredBody body,
+                 bool isGenerator = false, bool isAsync = false)
+        : name(std::move(name)), params(std::move(params)), isGenerator(isGenerator),
+          isAsync(isAsync), deferredBody(std::move(body)) {}
+
+    // The function body. A deferred body is parsed on first use, into an
+    // arena of its own; this is thread-safe, and a ParseError is rethrown
+    // on every call until it succeeds. Defined in parser.cpp.
+    const std::vector<Stmt>& body() const;
+
+    bool hasDeferredBody() const { return deferredBody.tokens != nullptr; }
+    const DeferredBody& getDeferredBody() const { return deferredBody; }
+
+    // Filled in by the Resolver: where the def binds its name, the size
+    // of a call's frame, where each parameter goes in it, for a nested
+    // def, the defining frame's cells (CELL) or closure cells (FREE) its
+    // closure is made of, and the names the body and the defs nested in
+    // it look up as globals
+    mutable VariableSlot slot;
+    mutable uint32_t localCount = 0;
+    mutable uint32_t cellCount = 0;
+    mutable std::vector<VariableSlot> paramSlots;
+    mutable std::vector<VariableSlot> captures;
+    mutable std::vector<std::string> globalNames;
+
+private:
+    friend class Resolver;
+
+    DeferredBody deferredBody;
+    mutable std::vector<Stmt> parsedBody;
+    mutable std::shared_ptr<AstArena> bodyArena;  // Holds a deferred body's nodes
+    mutable std::once_flag bodyParsed;
+    mutable std::once_flag resolved;
 };
 
 struct ReturnStmt {
-    Token keyword;
-    std::unique_ptr<Expr> value;
+    OpToken keyword;
+    NodePtr<Expr> value;
 
-    ReturnStmt(Token keyword, std::unique_ptr<Expr> value)
+    ReturnStmt(OpToken keyword, NodePtr<Expr> value)
         : keyword(std::move(keyword)), value(std::move(value)) {}
 };
 
 struct AssertStmt {
-    Token keyword;
+    OpToken keyword;
     Expr condition;
-    std::unique_ptr<Expr> message;  // Optional message
+    NodePtr<Expr> message;  // Optional message
 
-    AssertStmt(Token keyword, Expr condition, std::unique_ptr<Expr> message = nullptr)
+    AssertStmt(OpToken keyword, Expr condition, NodePtr<Expr> message = nullptr)
         : keyword(std::move(keyword)), condition(std::move(condition)), message(std::move(message)) {}
 };
 
-// Function definition for runtime
-struct PyFunction {
-    std::string name;
-    std::vector<std::string> params;
-    const FunctionStmt* declaration;  // Points to the AST node
-
-    PyFunction(std::string name, std::vector<std::string> params, const FunctionStmt* declaration)
-        : name(std::move(name)), params(std::move(params)), declaration(declaration) {}
-};
-
-// Helper to convert PyValue to string
-inline std::string pyValueToString(const PyValue& value) {
-    return std::visit([](auto&& arg) -> std::string {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, PyNone>) {
-            return "None";
-        } else if constexpr (std::is_same_v<T, bool>) {
-            return arg ? "True" : "False";
-        } else if constexpr (std::is_same_v<T, long long>) {
-            return std::to_string(arg);
-        } else if constexpr (std::is_same_v<T, double>) {
-            std::string s = std::to_string(arg);
-            // Remove trailing zeros
-            size_t dot = s.find('.');
-            if (dot != std::string::npos) {
-                size_t last = s.find_last_not_of('0');
-                if (last > dot) {
-                    s = s.substr(0, last + 1);
-                } else {
-                    s = s.substr(0, dot + 2);
-                }
-            }
-            return s;
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            return arg;
-        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
-            return "<function " + arg->name + ">";
-        }
-    }, value);
-}
-
-// Helper to check truthiness
-inline bool isTruthy(const PyValue& value) {
-    return std::visit([](auto&& arg) -> bool {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, PyNone>) {
-            return false;
-        } else if constexpr (std::is_same_v<T, bool>) {
-            return arg;
-        } else if constexpr (std::is_same_v<T, long long>) {
-            return arg != 0;
-        } else if constexpr (std::is_same_v<T, double>) {
-            return arg != 0.0;
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            return !arg.empty();
-        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
-            return true;
-        }
-    }, value);
-}
+// yield [value]; only valid inside a function, which it makes a generator
+struct YieldStmt {
+    OpToken keyword;
+    NodePtr<Expr> value;  // Optional; yields None if absent
+
+    YieldStmt(OpToken keyword, NodePtr<Expr> value)
+        : keyword(keyword), value(std::move(value)) {}
+};
+
+// class name: body. The parser only lets the body hold defs, which become
+// methods, and name = value assignments, which become class attributes;
+// neither binds a variable. The methods do not see the class's names, as
+// in Python, so they resolve as if defined where the class is.
+struct ClassStmt {
+    NameToken name;
+    std::vector<Stmt> body;
+    mutable VariableSlot slot;  // Where the statement binds the class
+
+    ClassStmt(NameToken name, std::vector<Stmt> body)
+        : name(std::move(name)), body(std::move(body)) {}
+};
+
+class AstArena : public Arena<
+    BinaryExpr, UnaryExpr, LiteralExpr, VariableExpr, AssignExpr, CallExpr,
+    GroupingExpr, GetExpr, ListExpr, IndexExpr, SliceExpr, IndexAssignExpr,
+    AttributeAssignExpr, DictExpr, SetExpr, AwaitExpr,
+    ExpressionStmt, PrintStmt, VarStmt, BlockStmt, IfStmt, WhileStmt, ForStmt,
+    FunctionStmt, ReturnStmt, AssertStmt, YieldStmt, ClassStmt,
+    Expr, Stmt  // The optional operands and else branches
+> {};
+
+// A parsed module: its top-level statements and the arena holding every
+// node under them. Indexes and iterates like the statement vector; the
+// nodes are freed all at once when the last copy of the arena goes.
+struct Module {
+    std::vector<Stmt> statements;
+    std::shared_ptr<AstArena> arena = std::make_shared<AstArena>();
+
+    size_t size() const { return statements.size(); }
+    bool empty() const { return statements.empty(); }
+    const Stmt& operator[](size_t i) const { return statements[i]; }
+    std::vector<Stmt>::const_iterator begin() const { return statements.begin(); }
+    std::vector<Stmt>::const_iterator end() const { return statements.end(); }
+};
 
 #endif // AST_HPP
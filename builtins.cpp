@@ -0,0 +1,400 @@
+#include "builtins.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+#include "array.hpp"
+#include "dict.hpp"
+#include "environment.hpp"
+#include "event_loop.hpp"
+#include "gc.hpp"
+#include "generator.hpp"
+#include "list.hpp"
+
+namespace {
+
+bool isNumber(const PyValue& value) {
+    return std::holds_alternative<long long>(value) || std::holds_alternative<double>(value) ||
+           std::holds_alternative<bool>(value);
+}
+
+double toDouble(const std::string& function, const PyValue& value) {
+    if (std::holds_alternative<double>(value)) return std::get<double>(value);
+    if (std::holds_alternative<long long>(value)) {
+        return static_cast<double>(std::get<long long>(value));
+    }
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1.0 : 0.0;
+    throw RuntimeError(function + "() argument must be a number, not '" +
+                       pyTypeName(value) + "'");
+}
+
+long long toInteger(const PyValue& value) {
+    if (std::holds_alternative<long long>(value)) return std::get<long long>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1 : 0;
+    throw RuntimeError("'" + pyTypeName(value) + "' object cannot be interpreted as an integer");
+}
+
+// Orders two numbers or two strings for min() and max()
+bool lessThan(const std::string& function, const PyValue& a, const PyValue& b) {
+    if (std::holds_alternative<std::string>(a) && std::holds_alternative<std::string>(b)) {
+        return std::get<std::string>(a) < std::get<std::string>(b);
+    }
+    if (std::holds_alternative<long long>(a) && std::holds_alternative<long long>(b)) {
+        return std::get<long long>(a) < std::get<long long>(b);
+    }
+    if (isNumber(a) && isNumber(b)) {
+        return toDouble(function, a) < toDouble(function, b);
+    }
+    throw RuntimeError("'<' not supported between instances of '" + pyTypeName(a) +
+                       "' and '" + pyTypeName(b) + "'");
+}
+
+PyValue extreme(const std::string& function, ArgSpan args, bool wantMax) {
+    if (args.size() == 1 && std::holds_alternative<std::shared_ptr<PyArray>>(args[0])) {
+        const PyArray& array = *std::get<std::shared_ptr<PyArray>>(args[0]);
+        return wantMax ? array.max() : array.min();
+    }
+    if (args.size() == 1 && std::holds_alternative<PyRange>(args[0])) {
+        const PyRange& range = std::get<PyRange>(args[0]);
+        long long length = range.length();
+        if (length == 0) throw RuntimeError(function + "() arg is an empty sequence");
+        // Unsigned, so the offset can exceed LLONG_MAX; it wraps back onto
+        // the last element
+        using Span = unsigned long long;
+        auto last = static_cast<long long>(Span(range.start) +
+                                           Span(length - 1) * Span(range.step));
+        return (range.step > 0) == wantMax ? last : range.start;
+    }
+    if (args.size() == 1 && std::holds_alternative<std::shared_ptr<PyList>>(args[0])) {
+        const PyList& list = *std::get<std::shared_ptr<PyList>>(args[0]);
+        if (list.size() == 0) throw RuntimeError(function + "() arg is an empty sequence");
+        // Packed lists are scanned in place, with the same comparisons
+        if (list.storage() == PyList::Storage::INT) {
+            const auto& data = list.intData();
+            return wantMax ? *std::max_element(data.begin(), data.end())
+                           : *std::min_element(data.begin(), data.end());
+        }
+        if (list.storage() == PyList::Storage::FLOAT) {
+            const auto& data = list.floatData();
+            return wantMax ? *std::max_element(data.begin(), data.end())
+                           : *std::min_element(data.begin(), data.end());
+        }
+        PyValue best = list.get(0);
+        for (size_t i = 1; i < list.size(); i++) {
+            PyValue value = list.get(i);
+            if (wantMax ? lessThan(function, best, value) : lessThan(function, value, best)) {
+                best = std::move(value);
+            }
+        }
+        return best;
+    }
+    if (args.size() == 1) {
+        // Any other iterable, generators included, in one pass
+        bool empty = true;
+        PyValue best;
+        forEachElement(args[0], [&](const PyValue& value) {
+            if (empty || (wantMax ? lessThan(function, best, value)
+                                  : lessThan(function, value, best))) {
+                best = value;
+            }
+            empty = false;
+        });
+        if (empty) throw RuntimeError(function + "() arg is an empty sequence");
+        return best;
+    }
+
+    const PyValue* best = &args[0];
+    for (const PyValue& value : args) {
+        if (wantMax ? lessThan(function, *best, value) : lessThan(function, value, *best)) {
+            best = &value;
+        }
+    }
+    return *best;
+}
+
+// sum(iterable[, start]) of numbers. Packed int and float lists are
+// added straight from their dense arrays.
+PyValue builtinSum(ArgSpan args) {
+    PyValue total = args.size() > 1 ? args[1] : PyValue(0LL);
+    if (!isNumber(total)) {
+        throw RuntimeError("sum() start must be a number, not '" + pyTypeName(total) + "'");
+    }
+    if (std::holds_alternative<bool>(total)) total = toInteger(total);
+
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(args[0])) {
+        PyValue partial = std::get<std::shared_ptr<PyArray>>(args[0])->sum();
+        if (std::holds_alternative<long long>(total) && std::holds_alternative<long long>(partial)) {
+            return std::get<long long>(total) + std::get<long long>(partial);
+        }
+        return toDouble("sum", total) + toDouble("sum", partial);
+    }
+
+    if (std::holds_alternative<std::shared_ptr<PyList>>(args[0])) {
+        const PyList& list = *std::get<std::shared_ptr<PyList>>(args[0]);
+        if (list.storage() == PyList::Storage::INT && std::holds_alternative<long long>(total)) {
+            const auto& data = list.intData();
+            return std::accumulate(data.begin(), data.end(), std::get<long long>(total));
+        }
+        if (list.storage() == PyList::Storage::FLOAT) {
+            const auto& data = list.floatData();
+            return std::accumulate(data.begin(), data.end(), toDouble("sum", total));
+        }
+    }
+
+    forEachElement(args[0], [&](const PyValue& value) {
+        if (!isNumber(value)) {
+            throw RuntimeError("unsupported operand type(s) for +: '" + pyTypeName(total) +
+                               "' and '" + pyTypeName(value) + "'");
+        }
+        if (std::holds_alternative<long long>(total) && !std::holds_alternative<double>(value)) {
+            total = std::get<long long>(total) + toInteger(value);
+        } else {
+            total = toDouble("sum", total) + toDouble("sum", value);
+        }
+    });
+    return total;
+}
+
+PyValue builtinLen(ArgSpan args) {
+    if (std::holds_alternative<std::string>(args[0])) {
+        return static_cast<long long>(std::get<std::string>(args[0]).size());
+    }
+    if (std::holds_alternative<PyRange>(args[0])) {
+        return std::get<PyRange>(args[0]).length();
+    }
+    if (std::holds_alternative<std::shared_ptr<PyList>>(args[0])) {
+        return static_cast<long long>(std::get<std::shared_ptr<PyList>>(args[0])->size());
+    }
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(args[0])) {
+        return static_cast<long long>(std::get<std::shared_ptr<PyDict>>(args[0])->table.size());
+    }
+    if (std::holds_alternative<std::shared_ptr<PySet>>(args[0])) {
+        return static_cast<long long>(std::get<std::shared_ptr<PySet>>(args[0])->table.size());
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(args[0])) {
+        return static_cast<long long>(std::get<std::shared_ptr<PyArray>>(args[0])->size());
+    }
+    throw RuntimeError("object of type '" + pyTypeName(args[0]) + "' has no len()");
+}
+
+PyValue builtinAbs(ArgSpan args) {
+    if (std::holds_alternative<long long>(args[0])) return std::llabs(std::get<long long>(args[0]));
+    if (std::holds_alternative<bool>(args[0])) return std::get<bool>(args[0]) ? 1LL : 0LL;
+    if (std::holds_alternative<double>(args[0])) return std::fabs(std::get<double>(args[0]));
+    throw RuntimeError("bad operand type for abs(): '" + pyTypeName(args[0]) + "'");
+}
+
+PyValue builtinInt(ArgSpan args) {
+    if (args.size() == 0) return 0LL;
+    const PyValue& value = args[0];
+    if (std::holds_alternative<long long>(value)) return value;
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1LL : 0LL;
+    if (std::holds_alternative<double>(value)) {
+        double d = std::get<double>(value);
+        if (!std::isfinite(d)) throw RuntimeError("cannot convert float to integer");
+        return static_cast<long long>(std::trunc(d));
+    }
+    if (std::holds_alternative<std::string>(value)) {
+        const std::string& text = std::get<std::string>(value);
+        const char* begin = text.c_str();
+        char* end = nullptr;
+        errno = 0;
+        long long result = std::strtoll(begin, &end, 10);
+        while (*end == ' ' || *end == '\t' || *end == '\n') end++;
+        if (end == begin || *end != '\0' || errno == ERANGE) {
+            throw RuntimeError("invalid literal for int() with base 10: '" + text + "'");
+        }
+        return result;
+    }
+    throw RuntimeError("int() argument must be a string or a number, not '" +
+                       pyTypeName(value) + "'");
+}
+
+PyValue builtinFloat(ArgSpan args) {
+    if (args.size() == 0) return 0.0;
+    const PyValue& value = args[0];
+    if (std::holds_alternative<std::string>(value)) {
+        const std::string& text = std::get<std::string>(value);
+        const char* begin = text.c_str();
+        char* end = nullptr;
+        double result = std::strtod(begin, &end);
+        while (*end == ' ' || *end == '\t' || *end == '\n') end++;
+        if (end == begin || *end != '\0') {
+            throw RuntimeError("could not convert string to float: '" + text + "'");
+        }
+        return result;
+    }
+    return toDouble("float", value);
+}
+
+PyValue builtinRange(ArgSpan args) {
+    PyRange result{0, 0, 1};
+    if (args.size() == 1) {
+        result.stop = toInteger(args[0]);
+    } else {
+        result.start = toInteger(args[0]);
+        result.stop = toInteger(args[1]);
+        if (args.size() == 3) result.step = toInteger(args[2]);
+    }
+    if (result.step == 0) throw RuntimeError("range() arg 3 must not be zero");
+    return result;
+}
+
+PyValue builtinList(ArgSpan args) {
+    auto list = std::make_shared<PyList>();
+    if (args.size() == 0) return list;
+
+    const PyValue& source = args[0];
+    if (std::holds_alternative<std::shared_ptr<PyList>>(source)) {
+        const PyList& items = *std::get<std::shared_ptr<PyList>>(source);
+        return items.slice(SliceBounds{0, 1, items.size()});
+    }
+    if (std::holds_alternative<PyRange>(source)) {
+        const PyRange& range = std::get<PyRange>(source);
+        long long length = range.length();
+        list->reserve(static_cast<size_t>(length));
+        // Stepped unsigned, like a for loop over a range
+        using Span = unsigned long long;
+        Span value = Span(range.start);
+        for (long long i = 0; i < length; i++, value += Span(range.step)) {
+            list->append(static_cast<long long>(value));
+        }
+        return list;
+    }
+    forEachElement(source, [&](const PyValue& element) { list->append(element); });
+    return list;
+}
+
+// dict() or dict(mapping): a copy of a dict, or of an iterable of
+// [key, value] pairs
+PyValue builtinDict(ArgSpan args) {
+    auto dict = std::make_shared<PyDict>();
+    if (args.size() == 0) return dict;
+
+    const PyValue& source = args[0];
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(source)) {
+        dict->table = std::get<std::shared_ptr<PyDict>>(source)->table;
+        return dict;
+    }
+    forEachElement(source, [&](const PyValue& pair) {
+        const auto* items = std::get_if<std::shared_ptr<PyList>>(&pair);
+        if (!items || (*items)->size() != 2) {
+            throw RuntimeError("dict() sequence elements must be [key, value] pairs");
+        }
+        dict->table.findOrInsert((*items)->get(0)).value = (*items)->get(1);
+    });
+    return dict;
+}
+
+PyValue builtinSet(ArgSpan args) {
+    auto set = std::make_shared<PySet>();
+    if (args.size() == 0) return set;
+    forEachElement(args[0], [&](const PyValue& element) { set->table.findOrInsert(element); });
+    return set;
+}
+
+// next(generator[, default]): the generator's next value, or `default`
+// once it is exhausted
+PyValue builtinNext(ArgSpan args) {
+    const auto* generator = std::get_if<std::shared_ptr<PyGenerator>>(&args[0]);
+    if (!generator) {
+        throw RuntimeError("'" + pyTypeName(args[0]) + "' object is not an iterator");
+    }
+    if ((*generator)->next()) return (*generator)->current();
+    if (args.size() > 1) return args[1];
+    throw RuntimeError("StopIteration");
+}
+
+// math functions of one float argument
+template <typename F>
+NativeFn unaryMath(const char* name, F f) {
+    return [name, f](ArgSpan args) -> PyValue { return f(toDouble(name, args[0])); };
+}
+
+PyValue mathSqrt(ArgSpan args) {
+    double x = toDouble("sqrt", args[0]);
+    if (x < 0) throw RuntimeError("math domain error");
+    return std::sqrt(x);
+}
+
+PyValue mathLog(ArgSpan args) {
+    double x = toDouble("log", args[0]);
+    if (x <= 0) throw RuntimeError("math domain error");
+    if (args.size() == 2) return std::log(x) / std::log(toDouble("log", args[1]));
+    return std::log(x);
+}
+
+PyValue mathFloor(ArgSpan args) {
+    if (std::holds_alternative<long long>(args[0])) return args[0];
+    return static_cast<long long>(std::floor(toDouble("floor", args[0])));
+}
+
+PyValue mathCeil(ArgSpan args) {
+    if (std::holds_alternative<long long>(args[0])) return args[0];
+    return static_cast<long long>(std::ceil(toDouble("ceil", args[0])));
+}
+
+std::shared_ptr<PyModule> makeMathModule() {
+    auto math = std::make_shared<PyModule>("math");
+    auto add = [&](const char* name, int minArity, int maxArity, NativeFn fn) {
+        math->members[name] = Builtins::makeNative(name, minArity, maxArity, std::move(fn));
+    };
+    add("sqrt", 1, 1, mathSqrt);
+    add("floor", 1, 1, mathFloor);
+    add("ceil", 1, 1, mathCeil);
+    add("log", 1, 2, mathLog);
+    add("exp", 1, 1, unaryMath("exp", [](double x) { return std::exp(x); }));
+    add("sin", 1, 1, unaryMath("sin", [](double x) { return std::sin(x); }));
+    add("cos", 1, 1, unaryMath("cos", [](double x) { return std::cos(x); }));
+    add("tan", 1, 1, unaryMath("tan", [](double x) { return std::tan(x); }));
+    add("fabs", 1, 1, unaryMath("fabs", [](double x) { return std::fabs(x); }));
+    add("pow", 2, 2, [](ArgSpan args) -> PyValue {
+        return std::pow(toDouble("pow", args[0]), toDouble("pow", args[1]));
+    });
+    math->members["pi"] = 3.141592653589793;
+    math->members["e"] = 2.718281828459045;
+    return math;
+}
+
+}  // namespace
+
+std::shared_ptr<NativeFunction> Builtins::makeNative(std::string name, int minArity,
+                                                     int maxArity, NativeFn fn) {
+    return std::make_shared<NativeFunction>(std::move(name), minArity, maxArity, std::move(fn));
+}
+
+const std::vector<std::pair<std::string, PyValue>>& Builtins::all() {
+    static const auto table = [] {
+        std::vector<std::pair<std::string, PyValue>> entries;
+        auto add = [&](const char* name, int minArity, int maxArity, NativeFn fn) {
+            entries.emplace_back(name, makeNative(name, minArity, maxArity, std::move(fn)));
+        };
+
+        add("len", 1, 1, builtinLen);
+        add("abs", 1, 1, builtinAbs);
+        add("sum", 1, 2, builtinSum);
+        add("min", 1, -1, [](ArgSpan args) { return extreme("min", args, false); });
+        add("max", 1, -1, [](ArgSpan args) { return extreme("max", args, true); });
+        add("int", 0, 1, builtinInt);
+        add("float", 0, 1, builtinFloat);
+        add("str", 0, 1, [](ArgSpan args) -> PyValue {
+            return args.size() == 0 ? std::string() : pyValueToString(args[0]);
+        });
+        add("bool", 0, 1, [](ArgSpan args) -> PyValue {
+            return args.size() != 0 && isTruthy(args[0]);
+        });
+        add("range", 1, 3, builtinRange);
+        add("list", 0, 1, builtinList);
+        add("dict", 0, 1, builtinDict);
+        add("set", 0, 1, builtinSet);
+        add("array", 1, 2, [](ArgSpan args) -> PyValue { return PyArray::create(args); });
+        add("next", 1, 2, builtinNext);
+
+        entries.emplace_back("math", makeMathModule());
+        entries.emplace_back("asyncio", EventLoop::module());
+        entries.emplace_back("gc", GarbageCollector::module());
+        return entries;
+    }();
+    return table;
+}
@@ -0,0 +1,22 @@
+#ifndef BUILTINS_HPP
+#define BUILTINS_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.hpp"
+
+// The builtin namespace: native functions (len, abs, min, max, int, float,
+// str, bool, range, list) and modules (math, asyncio). The table is built
+// once and shared read-only by every Interpreter, which copies the handles
+// into its globals. Embedders add their own natives with
+// Interpreter::defineNative.
+class Builtins {
+public:
+    static const std::vector<std::pair<std::string, PyValue>>& all();
+
+    static std::shared_ptr<NativeFunction> makeNative(std::string name, int minArity,
+                                                      int maxArity, NativeFn fn);
+};
+
+#endif // BUILTINS_HPP
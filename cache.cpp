@@ -0,0 +1,647 @@
+#include "cache.hpp"
+#include "version.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char cacheMagic[4] = {'M', 'P', 'Y', 'C'};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    uint64_t versionHash;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+};
+
+// FNV-1a, 64-bit
+uint64_t hashBytes(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t versionHash() {
+    const char* version = PYINTERP_VERSION;
+    return hashBytes(version, std::strlen(version));
+}
+
+class CacheFormatError {};
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Literal tags; LiteralExpr only ever holds these PyValue alternatives
+enum class LiteralTag : uint8_t { NONE, BOOL, INTEGER, FLOAT, STRING };
+
+class Writer {
+public:
+    std::string out;
+
+    template<typename T>
+    void pod(T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void string(const std::string& value) {
+        pod<uint32_t>(static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    void op(const OpToken& token) {
+        pod<uint8_t>(static_cast<uint8_t>(token.type));
+        pod<int32_t>(token.line);
+        pod<int32_t>(token.column);
+    }
+
+    void name(const NameToken& token) {
+        string(token.lexeme);
+        pod<int32_t>(token.line);
+        pod<int32_t>(token.column);
+    }
+
+    void token(const Token& token) {
+        pod<uint8_t>(static_cast<uint8_t>(token.type));
+        string(token.lexeme);
+        if (std::holds_alternative<long long>(token.literal)) {
+            pod(LiteralTag::INTEGER);
+            pod<int64_t>(std::get<long long>(token.literal));
+        } else if (std::holds_alternative<double>(token.literal)) {
+            pod(LiteralTag::FLOAT);
+            pod<double>(std::get<double>(token.literal));
+        } else if (std::holds_alternative<std::string>(token.literal)) {
+            pod(LiteralTag::STRING);
+            string(std::get<std::string>(token.literal));
+        } else {
+            pod(LiteralTag::NONE);
+        }
+        pod<int32_t>(token.line);
+        pod<int32_t>(token.column);
+    }
+
+    void literal(const PyValue& value) {
+        if (std::holds_alternative<bool>(value)) {
+            pod(LiteralTag::BOOL);
+            pod<uint8_t>(std::get<bool>(value));
+        } else if (std::holds_alternative<long long>(value)) {
+            pod(LiteralTag::INTEGER);
+            pod<int64_t>(std::get<long long>(value));
+        } else if (std::holds_alternative<double>(value)) {
+            pod(LiteralTag::FLOAT);
+            pod<double>(std::get<double>(value));
+        } else if (std::holds_alternative<std::string>(value)) {
+            pod(LiteralTag::STRING);
+            string(std::get<std::string>(value));
+        } else {
+            pod(LiteralTag::NONE);
+        }
+    }
+
+    void optionalExpr(const NodePtr<Expr>& expr) {
+        pod<uint8_t>(expr != nullptr);
+        if (expr) this->expr(*expr);
+    }
+
+    void exprs(const std::vector<Expr>& list) {
+        pod<uint32_t>(static_cast<uint32_t>(list.size()));
+        for (const auto& e : list) expr(e);
+    }
+
+    void stmts(const std::vector<Stmt>& list) {
+        pod<uint32_t>(static_cast<uint32_t>(list.size()));
+        for (const auto& s : list) stmt(s);
+    }
+
+    void expr(const Expr& expr) {
+        pod<uint8_t>(static_cast<uint8_t>(expr.index()));
+        std::visit([this](auto&& node) {
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, NodePtr<BinaryExpr>>) {
+                this->expr(node->left);
+                op(node->op);
+                this->expr(node->right);
+            } else if constexpr (std::is_same_v<T, NodePtr<UnaryExpr>>) {
+                op(node->op);
+                this->expr(node->operand);
+            } else if constexpr (std::is_same_v<T, NodePtr<LiteralExpr>>) {
+                literal(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<VariableExpr>>) {
+                name(node->name);
+            } else if constexpr (std::is_same_v<T, NodePtr<AssignExpr>>) {
+                name(node->name);
+                this->expr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<CallExpr>>) {
+                this->expr(node->callee);
+                op(node->paren);
+                exprs(node->arguments);
+            } else if constexpr (std::is_same_v<T, NodePtr<GroupingExpr>>) {
+                this->expr(node->expression);
+            } else if constexpr (std::is_same_v<T, NodePtr<GetExpr>>) {
+                this->expr(node->object);
+                name(node->name);
+            } else if constexpr (std::is_same_v<T, NodePtr<ListExpr>>) {
+                op(node->bracket);
+                exprs(node->elements);
+            } else if constexpr (std::is_same_v<T, NodePtr<IndexExpr>>) {
+                this->expr(node->object);
+                op(node->bracket);
+                this->expr(node->index);
+            } else if constexpr (std::is_same_v<T, NodePtr<SliceExpr>>) {
+                this->expr(node->object);
+                op(node->bracket);
+                optionalExpr(node->lower);
+                optionalExpr(node->upper);
+                optionalExpr(node->step);
+            } else if constexpr (std::is_same_v<T, NodePtr<DictExpr>>) {
+                op(node->brace);
+                exprs(node->keys);
+                exprs(node->values);
+            } else if constexpr (std::is_same_v<T, NodePtr<SetExpr>>) {
+                op(node->brace);
+                exprs(node->elements);
+            } else if constexpr (std::is_same_v<T, NodePtr<AwaitExpr>>) {
+                op(node->keyword);
+                this->expr(node->operand);
+            } else if constexpr (std::is_same_v<T, NodePtr<IndexAssignExpr>>) {
+                this->expr(node->object);
+                op(node->bracket);
+                this->expr(node->index);
+                op(node->op);
+                this->expr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<AttributeAssignExpr>>) {
+                this->expr(node->object);
+                name(node->name);
+                op(node->op);
+                this->expr(node->value);
+            }
+        }, expr);
+    }
+
+    void stmt(const Stmt& stmt) {
+        pod<uint8_t>(static_cast<uint8_t>(stmt.index()));
+        std::visit([this](auto&& node) {
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, NodePtr<ExpressionStmt>>) {
+                expr(node->expression);
+            } else if constexpr (std::is_same_v<T, NodePtr<PrintStmt>>) {
+                exprs(node->expressions);
+            } else if constexpr (std::is_same_v<T, NodePtr<VarStmt>>) {
+                name(node->name);
+                expr(node->initializer);
+            } else if constexpr (std::is_same_v<T, NodePtr<BlockStmt>>) {
+                stmts(node->statements);
+            } else if constexpr (std::is_same_v<T, NodePtr<IfStmt>>) {
+                expr(node->condition);
+                this->stmt(node->thenBranch);
+                pod<uint32_t>(static_cast<uint32_t>(node->elifBranches.size()));
+                for (const auto& [condition, branch] : node->elifBranches) {
+                    expr(condition);
+                    this->stmt(branch);
+                }
+                pod<uint8_t>(node->elseBranch != nullptr);
+                if (node->elseBranch) this->stmt(*node->elseBranch);
+            } else if constexpr (std::is_same_v<T, NodePtr<WhileStmt>>) {
+                expr(node->condition);
+                this->stmt(node->body);
+            } else if constexpr (std::is_same_v<T, NodePtr<ForStmt>>) {
+                op(node->keyword);
+                name(node->variable);
+                expr(node->iterable);
+                this->stmt(node->body);
+            } else if constexpr (std::is_same_v<T, NodePtr<FunctionStmt>>) {
+                name(node->name);
+                pod<uint32_t>(static_cast<uint32_t>(node->params.size()));
+                for (const auto& param : node->params) name(param);
+                pod<uint8_t>(node->isGenerator);
+                pod<uint8_t>(node->isAsync);
+                // A body that was skipped by the lazy parser is stored as
+                // its tokens, so it stays unparsed until first called
+                pod<uint8_t>(node->hasDeferredBody());
+                if (node->hasDeferredBody()) {
+                    const DeferredBody& body = node->getDeferredBody();
+                    // Include the closing DEDENT/EOF so the body parses the same
+                    pod<uint32_t>(static_cast<uint32_t>(body.end - body.begin + 1));
+                    for (size_t i = body.begin; i <= body.end; i++) {
+                        token((*body.tokens)[i]);
+                    }
+                } else {
+                    stmts(node->body());
+                }
+            } else if constexpr (std::is_same_v<T, NodePtr<ReturnStmt>>) {
+                op(node->keyword);
+                optionalExpr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<AssertStmt>>) {
+                op(node->keyword);
+                expr(node->condition);
+                optionalExpr(node->message);
+            } else if constexpr (std::is_same_v<T, NodePtr<YieldStmt>>) {
+                op(node->keyword);
+                optionalExpr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<ClassStmt>>) {
+                name(node->name);
+                stmts(node->body);
+            }
+        }, stmt);
+    }
+};
+
+// Index of alternative T in variant V, usable as a case label
+template<typename T, typename V, size_t I = 0>
+constexpr uint8_t indexOf() {
+    if constexpr (std::is_same_v<std::variant_alternative_t<I, V>, T>) {
+        return I;
+    } else {
+        return indexOf<T, V, I + 1>();
+    }
+}
+
+// Reads the layout produced by Writer, straight out of the mapped file.
+// Every read is bounds-checked; malformed input throws CacheFormatError.
+class Reader {
+public:
+    Reader(const char* data, size_t size, AstArena& arena)
+        : data(data), end(data + size), arena(arena) {}
+
+    bool atEnd() const { return data == end; }
+
+    template<typename T>
+    T pod() {
+        if (static_cast<size_t>(end - data) < sizeof(T)) throw CacheFormatError();
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+
+    std::string string() {
+        uint32_t length = pod<uint32_t>();
+        if (static_cast<size_t>(end - data) < length) throw CacheFormatError();
+        std::string value(data, length);
+        data += length;
+        return value;
+    }
+
+    OpToken op() {
+        uint8_t type = pod<uint8_t>();
+        if (type > static_cast<uint8_t>(TokenType::INVALID)) throw CacheFormatError();
+        int line = pod<int32_t>();
+        int column = pod<int32_t>();
+        return OpToken(static_cast<TokenType>(type), line, column);
+    }
+
+    NameToken name() {
+        std::string lexeme = string();
+        int line = pod<int32_t>();
+        int column = pod<int32_t>();
+        return NameToken(std::move(lexeme), line, column);
+    }
+
+    Token token() {
+        uint8_t type = pod<uint8_t>();
+        if (type > static_cast<uint8_t>(TokenType::INVALID)) throw CacheFormatError();
+        std::string lexeme = string();
+        LiteralTag tag = pod<LiteralTag>();
+        switch (tag) {
+            case LiteralTag::INTEGER: {
+                long long value = pod<int64_t>();
+                int line = pod<int32_t>();
+                int column = pod<int32_t>();
+                return Token(static_cast<TokenType>(type), std::move(lexeme), value, line, column);
+            }
+            case LiteralTag::FLOAT: {
+                double value = pod<double>();
+                int line = pod<int32_t>();
+                int column = pod<int32_t>();
+                return Token(static_cast<TokenType>(type), std::move(lexeme), value, line, column);
+            }
+            case LiteralTag::STRING: {
+                std::string value = string();
+                int line = pod<int32_t>();
+                int column = pod<int32_t>();
+                return Token(static_cast<TokenType>(type), std::move(lexeme),
+                             std::move(value), line, column);
+            }
+            case LiteralTag::NONE: {
+                int line = pod<int32_t>();
+                int column = pod<int32_t>();
+                return Token(static_cast<TokenType>(type), std::move(lexeme), line, column);
+            }
+            default:
+                throw CacheFormatError();
+        }
+    }
+
+    PyValue literal() {
+        switch (pod<LiteralTag>()) {
+            case LiteralTag::NONE: return PyNone{};
+            case LiteralTag::BOOL: return pod<uint8_t>() != 0;
+            case LiteralTag::INTEGER: return static_cast<long long>(pod<int64_t>());
+            case LiteralTag::FLOAT: return pod<double>();
+            case LiteralTag::STRING: return string();
+        }
+        throw CacheFormatError();
+    }
+
+    NodePtr<Expr> optionalExpr() {
+        if (!pod<uint8_t>()) return nullptr;
+        return make<Expr>(expr());
+    }
+
+    std::vector<Expr> exprs() {
+        uint32_t count = pod<uint32_t>();
+        std::vector<Expr> list;
+        for (uint32_t i = 0; i < count; i++) list.push_back(expr());
+        return list;
+    }
+
+    std::vector<Stmt> stmts() {
+        uint32_t count = pod<uint32_t>();
+        std::vector<Stmt> list;
+        for (uint32_t i = 0; i < count; i++) list.push_back(stmt());
+        return list;
+    }
+
+    Expr expr() {
+        switch (pod<uint8_t>()) {
+            case indexOf<NodePtr<BinaryExpr>, Expr>(): {
+                Expr left = expr();
+                OpToken opToken = op();
+                Expr right = expr();
+                return make<BinaryExpr>(std::move(left), opToken, std::move(right));
+            }
+            case indexOf<NodePtr<UnaryExpr>, Expr>(): {
+                OpToken opToken = op();
+                return make<UnaryExpr>(opToken, expr());
+            }
+            case indexOf<NodePtr<LiteralExpr>, Expr>():
+                return make<LiteralExpr>(literal());
+            case indexOf<NodePtr<VariableExpr>, Expr>():
+                return make<VariableExpr>(name());
+            case indexOf<NodePtr<AssignExpr>, Expr>(): {
+                NameToken target = name();
+                return make<AssignExpr>(std::move(target), expr());
+            }
+            case indexOf<NodePtr<CallExpr>, Expr>(): {
+                Expr callee = expr();
+                OpToken paren = op();
+                return make<CallExpr>(std::move(callee), paren, exprs());
+            }
+            case indexOf<NodePtr<GroupingExpr>, Expr>():
+                return make<GroupingExpr>(expr());
+            case indexOf<NodePtr<GetExpr>, Expr>(): {
+                Expr object = expr();
+                return make<GetExpr>(std::move(object), name());
+            }
+            case indexOf<NodePtr<ListExpr>, Expr>(): {
+                OpToken bracket = op();
+                return make<ListExpr>(bracket, exprs());
+            }
+            case indexOf<NodePtr<IndexExpr>, Expr>(): {
+                Expr object = expr();
+                OpToken bracket = op();
+                return make<IndexExpr>(std::move(object), bracket, expr());
+            }
+            case indexOf<NodePtr<SliceExpr>, Expr>(): {
+                Expr object = expr();
+                OpToken bracket = op();
+                auto lower = optionalExpr();
+                auto upper = optionalExpr();
+                auto step = optionalExpr();
+                return make<SliceExpr>(std::move(object), bracket, std::move(lower),
+                                                   std::move(upper), std::move(step));
+            }
+            case indexOf<NodePtr<DictExpr>, Expr>(): {
+                OpToken brace = op();
+                std::vector<Expr> keys = exprs();
+                std::vector<Expr> values = exprs();
+                if (keys.size() != values.size()) throw CacheFormatError();
+                return make<DictExpr>(brace, std::move(keys), std::move(values));
+            }
+            case indexOf<NodePtr<SetExpr>, Expr>(): {
+                OpToken brace = op();
+                return make<SetExpr>(brace, exprs());
+            }
+            case indexOf<NodePtr<AwaitExpr>, Expr>(): {
+                OpToken keyword = op();
+                return make<AwaitExpr>(keyword, expr());
+            }
+            case indexOf<NodePtr<IndexAssignExpr>, Expr>(): {
+                Expr object = expr();
+                OpToken bracket = op();
+                Expr index = expr();
+                OpToken opToken = op();
+                return make<IndexAssignExpr>(std::move(object), bracket,
+                                                         std::move(index), opToken, expr());
+            }
+            case indexOf<NodePtr<AttributeAssignExpr>, Expr>(): {
+                Expr object = expr();
+                NameToken attribute = name();
+                OpToken opToken = op();
+                Expr value = expr();
+                return make<AttributeAssignExpr>(std::move(object),
+                                                             std::move(attribute), opToken,
+                                                             std::move(value));
+            }
+        }
+        throw CacheFormatError();
+    }
+
+    Stmt stmt() {
+        switch (pod<uint8_t>()) {
+            case indexOf<NodePtr<ExpressionStmt>, Stmt>():
+                return make<ExpressionStmt>(expr());
+            case indexOf<NodePtr<PrintStmt>, Stmt>():
+                return make<PrintStmt>(exprs());
+            case indexOf<NodePtr<VarStmt>, Stmt>(): {
+                NameToken target = name();
+                return make<VarStmt>(std::move(target), expr());
+            }
+            case indexOf<NodePtr<BlockStmt>, Stmt>():
+                return make<BlockStmt>(stmts());
+            case indexOf<NodePtr<IfStmt>, Stmt>(): {
+                Expr condition = expr();
+                Stmt thenBranch = stmt();
+                std::vector<std::pair<Expr, Stmt>> elifBranches;
+                uint32_t count = pod<uint32_t>();
+                for (uint32_t i = 0; i < count; i++) {
+                    Expr elifCondition = expr();
+                    elifBranches.emplace_back(std::move(elifCondition), stmt());
+                }
+                NodePtr<Stmt> elseBranch = nullptr;
+                if (pod<uint8_t>()) elseBranch = make<Stmt>(stmt());
+                return make<IfStmt>(std::move(condition), std::move(thenBranch),
+                                                std::move(elifBranches), std::move(elseBranch));
+            }
+            case indexOf<NodePtr<WhileStmt>, Stmt>(): {
+                Expr condition = expr();
+                return make<WhileStmt>(std::move(condition), stmt());
+            }
+            case indexOf<NodePtr<ForStmt>, Stmt>(): {
+                OpToken keyword = op();
+                NameToken variable = name();
+                Expr iterable = expr();
+                return make<ForStmt>(keyword, std::move(variable),
+                                                 std::move(iterable), stmt());
+            }
+            case indexOf<NodePtr<FunctionStmt>, Stmt>(): {
+                NameToken functionName = name();
+                std::vector<NameToken> params;
+                uint32_t count = pod<uint32_t>();
+                for (uint32_t i = 0; i < count; i++) params.push_back(name());
+                bool isGenerator = pod<uint8_t>() != 0;
+                bool isAsync = pod<uint8_t>() != 0;
+                if (pod<uint8_t>()) {
+                    uint32_t tokenCount = pod<uint32_t>();
+                    if (tokenCount == 0) throw CacheFormatError();
+                    auto tokens = std::make_shared<std::vector<Token>>();
+                    for (uint32_t i = 0; i < tokenCount; i++) tokens->push_back(token());
+                    const Token& last = tokens->back();
+                    tokens->emplace_back(TokenType::END_OF_FILE, "", last.line, last.column);
+                    DeferredBody body{std::move(tokens), 0, tokenCount - 1};
+                    return make<FunctionStmt>(std::move(functionName),
+                                                          std::move(params), std::move(body),
+                                                          isGenerator, isAsync);
+                }
+                std::vector<Stmt> body = stmts();
+                return make<FunctionStmt>(std::move(functionName),
+                                                      std::move(params), std::move(body),
+                                                      isGenerator, isAsync);
+            }
+            case indexOf<NodePtr<ReturnStmt>, Stmt>(): {
+                OpToken keyword = op();
+                return make<ReturnStmt>(keyword, optionalExpr());
+            }
+            case indexOf<NodePtr<AssertStmt>, Stmt>(): {
+                OpToken keyword = op();
+                Expr condition = expr();
+                return make<AssertStmt>(keyword, std::move(condition), optionalExpr());
+            }
+            case indexOf<NodePtr<YieldStmt>, Stmt>(): {
+                OpToken keyword = op();
+                return make<YieldStmt>(keyword, optionalExpr());
+            }
+            case indexOf<NodePtr<ClassStmt>, Stmt>(): {
+                NameToken className = name();
+                return make<ClassStmt>(std::move(className), stmts());
+            }
+        }
+        throw CacheFormatError();
+    }
+
+private:
+    const char* data;
+    const char* end;
+    AstArena& arena;
+
+    template<typename T, typename... Args>
+    NodePtr<T> make(Args&&... args) {
+        return arena.make<T>(std::forward<Args>(args)...);
+    }
+};
+
+} // namespace
+
+std::string CodeCache::serialize(const std::vector<Stmt>& statements) {
+    Writer writer;
+    writer.stmts(statements);
+    return std::move(writer.out);
+}
+
+bool CodeCache::deserialize(const char* data, size_t size, Module& module) {
+    try {
+        Module result;
+        Reader reader(data, size, *result.arena);
+        result.statements = reader.stmts();
+        if (!reader.atEnd()) return false;
+        module = std::move(result);
+        return true;
+    } catch (const CacheFormatError&) {
+        return false;
+    }
+}
+
+std::string CodeCache::cachePath(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    // The whole file name, extension included, so foo.py and foo.txt
+    // side by side get entries of their own
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    return dir + "__pycache__/" + file + ".mpyc";
+}
+
+bool CodeCache::load(const std::string& path, std::string_view source, Module& module) {
+    int fd = ::open(cachePath(path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const char* data = static_cast<const char*>(mapping);
+    CacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    bool loaded = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+                  header.formatVersion == formatVersion &&
+                  header.versionHash == versionHash() &&
+                  header.sourceSize == source.size() &&
+                  header.sourceHash == hashBytes(source.data(), source.size()) &&
+                  deserialize(data + sizeof(header), size - sizeof(header), module);
+
+    ::munmap(mapping, size);
+    return loaded;
+}
+
+void CodeCache::store(const std::string& path, std::string_view source,
+                      const std::vector<Stmt>& statements) {
+    std::string target = cachePath(path);
+    std::string dir = target.substr(0, target.find_last_of('/'));
+    ::mkdir(dir.c_str(), 0755);
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.formatVersion = formatVersion;
+    header.versionHash = versionHash();
+    header.sourceHash = hashBytes(source.data(), source.size());
+    header.sourceSize = source.size();
+
+    std::string payload = serialize(statements);
+
+    // Write to a private temporary and rename, so concurrent runs (other
+    // processes, or --jobs threads) never observe a partially written entry
+    static std::atomic<unsigned> tempCounter{0};
+    std::string temp = target + "." + std::to_string(::getpid()) + "." +
+                       std::to_string(tempCounter++) + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    bool ok = writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+              writeAll(fd, payload.data(), payload.size());
+    ::close(fd);
+
+    if (!ok || ::rename(temp.c_str(), target.c_str()) != 0) {
+        ::unlink(temp.c_str());
+    }
+}
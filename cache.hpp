@@ -0,0 +1,33 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ast.hpp"
+
+// On-disk cache of parsed modules, the equivalent of Python's .pyc files.
+// Entries live next to the script, in __pycache__/run.py.mpyc for run.py,
+// and are keyed by a hash of the source text and the interpreter and cache
+// format versions. Loading maps the file read-only and rebuilds the AST from it
+// without running the Lexer or Parser.
+class CodeCache {
+public:
+    // Bump whenever the AST or the serialized layout changes
+    static constexpr unsigned formatVersion = 9;
+
+    // Loads the cached AST for `path` if present and built from `source`
+    static bool load(const std::string& path, std::string_view source, Module& module);
+
+    // Writes the cache entry for `path`. Failures are silently ignored:
+    // the cache is only an optimization.
+    static void store(const std::string& path, std::string_view source,
+                      const std::vector<Stmt>& statements);
+
+    static std::string serialize(const std::vector<Stmt>& statements);
+    static bool deserialize(const char* data, size_t size, Module& module);
+
+    static std::string cachePath(const std::string& path);
+};
+
+#endif // CACHE_HPP
@@ -0,0 +1,441 @@
+#include "copy.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_set>
+#include "array.hpp"
+#include "dict.hpp"
+#include "function.hpp"
+#include "list.hpp"
+#include "object.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+
+namespace {
+
+// referencedGlobals(), past the objects in `seen`
+void addReferences(const PyValue& value, std::unordered_set<const void*>& seen,
+                   std::vector<std::string>& names) {
+    if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&value)) {
+        // Packed lists hold only numbers
+        if ((*list)->storage() != PyList::Storage::OBJECT) return;
+        if (!seen.insert(list->get()).second) return;
+        for (size_t i = 0; i < (*list)->size(); i++) {
+            addReferences((*list)->get(i), seen, names);
+        }
+    } else if (const auto* dict = std::get_if<std::shared_ptr<PyDict>>(&value)) {
+        if (!seen.insert(dict->get()).second) return;
+        for (const HashTable::Entry& entry : (*dict)->table.entries()) {
+            if (!entry.erased) addReferences(entry.value, seen, names);
+        }
+    } else if (const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&value)) {
+        if (!*function || !seen.insert(function->get()).second) return;
+        const FunctionStmt& declaration = *(*function)->declaration;
+        try {
+            Resolver::resolve(declaration);
+            const std::vector<std::string>& globals = declaration.globalNames;
+            names.insert(names.end(), globals.begin(), globals.end());
+        } catch (const ParseError&) {
+            // Calling it fails the same way on any thread, before it looks
+            // anything up
+        }
+        for (const auto& cell : (*function)->closure) {
+            addReferences(cell->value, seen, names);
+        }
+        if ((*function)->self) addReferences((*function)->self, seen, names);
+    } else if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&value)) {
+        if (!seen.insert(cls->get()).second) return;
+        size_t count = (*cls)->attributeNames().size();
+        for (uint32_t i = 0; i < count; i++) {
+            addReferences((*cls)->attributeAt(i), seen, names);
+        }
+    } else if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&value)) {
+        if (!seen.insert(instance->get()).second) return;
+        addReferences((*instance)->type(), seen, names);
+        for (uint32_t i = 0; i < (*instance)->slotCount(); i++) {
+            addReferences((*instance)->slot(i), seen, names);
+        }
+    }
+}
+
+// Pointers keyed by pointers, in one open-addressed array, since a
+// comparison pairs every container it meets
+class PointerMap {
+public:
+    // The value of `key`, after setting it to `value` if it had none, and
+    // whether it did
+    std::pair<const void*, bool> findOrInsert(const void* key, const void* value) {
+        if ((used + 1) * 2 > slots.size()) grow();
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i].first == key) return {slots[i].second, true};
+            if (!slots[i].first) {
+                slots[i] = {key, value};
+                used++;
+                return {value, false};
+            }
+        }
+    }
+
+private:
+    std::vector<std::pair<const void*, const void*>> slots;
+    size_t used = 0;
+
+    static size_t hash(const void* key) {
+        uintptr_t bits = reinterpret_cast<uintptr_t>(key) >> 4;
+        return static_cast<size_t>(bits * 0x9E3779B97F4A7C15ull);
+    }
+
+    void grow() {
+        decltype(slots) old(std::max<size_t>(64, slots.size() * 2));
+        old.swap(slots);
+        used = 0;
+        for (const auto& [key, value] : old) {
+            if (key) findOrInsert(key, value);
+        }
+    }
+};
+
+// The originals sameValue() has matched with copies, and the copies, so a
+// structure shared or cyclic on one side must be so on the other
+class Pairing {
+public:
+    enum class Result { MISMATCH, SEEN, NEW };
+
+    Result pair(const void* original, const void* copy) {
+        auto [paired, seen] = copies.findOrInsert(original, copy);
+        if (seen) return paired == copy ? Result::SEEN : Result::MISMATCH;
+        return originals.findOrInsert(copy, original).second ? Result::MISMATCH : Result::NEW;
+    }
+
+private:
+    PointerMap copies;
+    PointerMap originals;  // Of the copies paired
+};
+
+// Pairs two containers, unless each is held by just the reference being
+// followed, so that neither can be met again
+template <typename T>
+Pairing::Result pairShared(const std::shared_ptr<T>& original, const std::shared_ptr<T>& copy,
+                           Pairing& pairs) {
+    if (original.use_count() == 1 && copy.use_count() == 1) return Pairing::Result::NEW;
+    return pairs.pair(original.get(), copy.get());
+}
+
+// Whether `copy` is what copyValue() would make of `original` now: the
+// same types, contents and sharing. Immutable values compare by contents,
+// functions without cells by identity.
+bool sameValue(const PyValue& original, const PyValue& copy, Pairing& pairs);
+
+// Whether two tables hold the same keys in the same order, erased entries
+// aside, and for a dict the same values
+bool sameEntries(const HashTable& original, const HashTable& copy, bool values, Pairing& pairs) {
+    if (original.size() != copy.size()) return false;
+    const auto& copies = copy.entries();
+    size_t j = 0;
+    for (const HashTable::Entry& entry : original.entries()) {
+        if (entry.erased) continue;
+        while (copies[j].erased) j++;
+        const HashTable::Entry& other = copies[j++];
+        if (!sameValue(entry.key, other.key, pairs)) return false;
+        if (values && !sameValue(entry.value, other.value, pairs)) return false;
+    }
+    return true;
+}
+
+bool sameValue(const PyValue& original, const PyValue& copy, Pairing& pairs) {
+    if (original.index() != copy.index()) return false;
+
+    if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PyList>>(copy);
+        Pairing::Result paired = pairShared(*list, other, pairs);
+        const PyList& a = **list;
+        const PyList& b = *other;
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        if (a.size() != b.size()) return false;
+        if (a.storage() == PyList::Storage::INT && b.storage() == PyList::Storage::INT) {
+            return a.intData() == b.intData();
+        }
+        if (a.storage() == PyList::Storage::FLOAT && b.storage() == PyList::Storage::FLOAT) {
+            const auto& x = a.floatData();
+            return x.empty() ||
+                   std::memcmp(x.data(), b.floatData().data(), x.size() * sizeof(double)) == 0;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (!sameValue(a.get(i), b.get(i), pairs)) return false;
+        }
+        return true;
+    }
+    if (const auto* dict = std::get_if<std::shared_ptr<PyDict>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PyDict>>(copy);
+        Pairing::Result paired = pairShared(*dict, other, pairs);
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        return sameEntries((*dict)->table, other->table, true, pairs);
+    }
+    if (const auto* set = std::get_if<std::shared_ptr<PySet>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PySet>>(copy);
+        Pairing::Result paired = pairShared(*set, other, pairs);
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        return sameEntries((*set)->table, other->table, false, pairs);
+    }
+    if (const auto* array = std::get_if<std::shared_ptr<PyArray>>(&original)) {
+        const PyArray& a = **array;
+        const PyArray& b = *std::get<std::shared_ptr<PyArray>>(copy);
+        if (a.isFloat() != b.isFloat() || a.size() != b.size()) return false;
+        if (a.size() == 0) return true;
+        size_t bytes = a.size() * (a.isFloat() ? sizeof(double) : sizeof(long long));
+        const void* x = a.isFloat() ? static_cast<const void*>(a.elementData<double>())
+                                    : static_cast<const void*>(a.elementData<long long>());
+        const void* y = b.isFloat() ? static_cast<const void*>(b.elementData<double>())
+                                    : static_cast<const void*>(b.elementData<long long>());
+        return std::memcmp(x, y, bytes) == 0;
+    }
+    if (const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PyFunction>>(copy);
+        if (*function == other) return true;
+        if (!*function || !other) return false;
+        Pairing::Result paired = pairShared(*function, other, pairs);
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        const PyFunction& a = **function;
+        if (a.declaration != other->declaration || a.closure.size() != other->closure.size() ||
+            !a.self != !other->self) {
+            return false;
+        }
+        for (size_t i = 0; i < a.closure.size(); i++) {
+            paired = pairs.pair(a.closure[i].get(), other->closure[i].get());
+            if (paired == Pairing::Result::MISMATCH) return false;
+            if (paired == Pairing::Result::NEW &&
+                !sameValue(a.closure[i]->value, other->closure[i]->value, pairs)) {
+                return false;
+            }
+        }
+        return !a.self || sameValue(a.self, other->self, pairs);
+    }
+    if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PyClass>>(copy);
+        if (*cls == other) return true;  // Shared, not copied
+        Pairing::Result paired = pairs.pair(cls->get(), other.get());
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        std::vector<std::string> names = (*cls)->attributeNames();
+        if ((*cls)->name != other->name || names != other->attributeNames()) return false;
+        for (uint32_t i = 0; i < names.size(); i++) {
+            if (!sameValue((*cls)->attributeAt(i), other->attributeAt(i), pairs)) return false;
+        }
+        return true;
+    }
+    if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&original)) {
+        const auto& other = std::get<std::shared_ptr<PyInstance>>(copy);
+        Pairing::Result paired = pairShared(*instance, other, pairs);
+        const PyInstance& a = **instance;
+        const PyInstance& b = *other;
+        if (paired != Pairing::Result::NEW) return paired == Pairing::Result::SEEN;
+        if (!sameValue(a.type(), b.type(), pairs) || a.slotCount() != b.slotCount()) return false;
+        for (uint32_t i = 0; i < a.slotCount(); i++) {
+            if (a.shape().nameAt(i) != b.shape().nameAt(i)) return false;
+            if (!sameValue(a.slot(i), b.slot(i), pairs)) return false;
+        }
+        return true;
+    }
+    if (const auto* number = std::get_if<double>(&original)) {
+        double other = std::get<double>(copy);
+        return std::memcmp(number, &other, sizeof(double)) == 0;  // NaN and -0.0 too
+    }
+    if (const auto* number = std::get_if<long long>(&original)) {
+        return *number == std::get<long long>(copy);
+    }
+    if (const auto* flag = std::get_if<bool>(&original)) {
+        return *flag == std::get<bool>(copy);
+    }
+    if (const auto* text = std::get_if<std::string>(&original)) {
+        return *text == std::get<std::string>(copy);
+    }
+    if (const auto* range = std::get_if<PyRange>(&original)) {
+        const PyRange& other = std::get<PyRange>(copy);
+        return range->start == other.start && range->stop == other.stop &&
+               range->step == other.step;
+    }
+    if (const auto* native = std::get_if<std::shared_ptr<NativeFunction>>(&original)) {
+        return *native == std::get<std::shared_ptr<NativeFunction>>(copy);
+    }
+    if (const auto* module = std::get_if<std::shared_ptr<PyModule>>(&original)) {
+        return *module == std::get<std::shared_ptr<PyModule>>(copy);
+    }
+    if (const auto* task = std::get_if<std::shared_ptr<PyTask>>(&original)) {
+        return *task == std::get<std::shared_ptr<PyTask>>(copy);
+    }
+    // None; generators and coroutines are never copied
+    return std::holds_alternative<PyNone>(original);
+}
+
+bool cannotCopy(const PyValue& value) {
+    return std::holds_alternative<std::shared_ptr<PyGenerator>>(value) ||
+           std::holds_alternative<std::shared_ptr<PyCoroutine>>(value) ||
+           std::holds_alternative<std::shared_ptr<PyAwaitable>>(value);
+}
+
+}  // namespace
+
+PyValue copyValue(const PyValue& value, CopyMemo& memo) {
+    if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&value)) {
+        auto found = memo.find(list->get());
+        if (found != memo.end()) return found->second;
+        std::shared_ptr<PyList> copy;
+        if ((*list)->storage() == PyList::Storage::OBJECT) {
+            copy = std::make_shared<PyList>();
+            memo[list->get()] = copy;
+            copy->reserve((*list)->size());
+            for (size_t i = 0; i < (*list)->size(); i++) {
+                copy->append(copyValue((*list)->get(i), memo));
+            }
+        } else {
+            copy = (*list)->concat(PyList());  // Packed elements copy in bulk
+            memo[list->get()] = copy;
+        }
+        return copy;
+    }
+    if (const auto* dict = std::get_if<std::shared_ptr<PyDict>>(&value)) {
+        auto found = memo.find(dict->get());
+        if (found != memo.end()) return found->second;
+        auto copy = std::make_shared<PyDict>();
+        memo[dict->get()] = copy;
+        for (const HashTable::Entry& entry : (*dict)->table.entries()) {
+            if (entry.erased) continue;
+            copy->table.findOrInsert(entry.key).value = copyValue(entry.value, memo);
+        }
+        return copy;
+    }
+    if (const auto* set = std::get_if<std::shared_ptr<PySet>>(&value)) {
+        auto found = memo.find(set->get());
+        if (found != memo.end()) return found->second;
+        auto copy = std::make_shared<PySet>();
+        copy->table = (*set)->table;  // Keys are immutable
+        memo[set->get()] = copy;
+        return copy;
+    }
+    if (const auto* array = std::get_if<std::shared_ptr<PyArray>>(&value)) {
+        return std::make_shared<PyArray>(**array);  // Borrowed elements are read-only
+    }
+    if (const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&value)) {
+        // A closure gets cells of its own, holding copies of the values,
+        // and a bound method a copy of its instance
+        if (!*function || ((*function)->closure.empty() && !(*function)->self)) return value;
+        auto found = memo.find(function->get());
+        if (found != memo.end()) return found->second;
+        auto copy = std::make_shared<PyFunction>((*function)->name, (*function)->declaration);
+        memo[function->get()] = copy;
+        for (const auto& cell : (*function)->closure) {
+            auto copiedCell = std::make_shared<Cell>();
+            copiedCell->value = copyValue(cell->value, memo);
+            copy->closure.push_back(std::move(copiedCell));
+        }
+        if ((*function)->self) {
+            PyValue self = copyValue((*function)->self, memo);
+            copy->self = std::get<std::shared_ptr<PyInstance>>(self);
+        }
+        return copy;
+    }
+    if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&value)) {
+        auto found = memo.find(cls->get());
+        if (found != memo.end()) return found->second;
+        if (!memo.copyClasses) return value;
+        auto copy = std::make_shared<PyClass>((*cls)->name);
+        memo[cls->get()] = copy;
+        memo.classes.emplace_back(*cls, copy);
+        std::vector<std::string> names = (*cls)->attributeNames();
+        for (uint32_t i = 0; i < names.size(); i++) {
+            copy->setAttribute(names[i], copyValue((*cls)->attributeAt(i), memo));
+        }
+        return copy;
+    }
+    if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&value)) {
+        auto found = memo.find(instance->get());
+        if (found != memo.end()) return found->second;
+        PyValue type = copyValue((*instance)->type(), memo);
+        auto copy = (*instance)->shallowCopy(std::get<std::shared_ptr<PyClass>>(type));
+        memo[instance->get()] = copy;
+        for (uint32_t i = 0; i < copy->slotCount(); i++) {
+            copy->setSlot(i, copyValue(copy->slot(i), memo));
+        }
+        return copy;
+    }
+    if (std::holds_alternative<std::shared_ptr<PyGenerator>>(value) ||
+        std::holds_alternative<std::shared_ptr<PyCoroutine>>(value) ||
+        std::holds_alternative<std::shared_ptr<PyAwaitable>>(value)) {
+        throw RuntimeError("cannot copy '" + pyTypeName(value) + "' object to another thread");
+    }
+    // Immutable, or a task handle, which is safe to share
+    return value;
+}
+
+void referencedGlobals(const PyValue& value, std::vector<std::string>& names) {
+    std::unordered_set<const void*> seen;
+    addReferences(value, seen, names);
+}
+
+GlobalsSnapshot::GlobalsSnapshot(const Environment& from, const std::vector<std::string>& roots,
+                                 const GlobalsSnapshot* previous, bool copyClasses) {
+    std::vector<std::string> pending(roots);
+    if (previous) {
+        // Kept, so spawning functions that need different globals in turn
+        // does not take a new snapshot each time
+        for (const auto& [name, global] : previous->globals) pending.push_back(name);
+    }
+
+    const auto& variables = from.variables();
+    std::unordered_set<std::string> seen;
+    CopyMemo memo;
+    memo.copyClasses = copyClasses;
+    while (!pending.empty()) {
+        std::string name = std::move(pending.back());
+        pending.pop_back();
+        auto found = variables.find(name);
+        if (found == variables.end() || !seen.insert(name).second) continue;
+
+        Global global;
+        referencedGlobals(found->second, global.references);
+        try {
+            global.copy = copyValue(found->second, memo);
+            global.copied = true;
+        } catch (const RuntimeError&) {
+            global.copied = false;
+        }
+        pending.insert(pending.end(), global.references.begin(), global.references.end());
+        globals.emplace(std::move(name), std::move(global));
+    }
+    classCopies = std::make_shared<const ClassCopies>(std::move(memo.classes));
+}
+
+bool GlobalsSnapshot::matches(const Environment& from,
+                              const std::vector<std::string>& roots) const {
+    const auto& variables = from.variables();
+    std::vector<const std::string*> pending;
+    for (const std::string& root : roots) pending.push_back(&root);
+    std::unordered_set<std::string> seen;
+    Pairing pairs;
+    while (!pending.empty()) {
+        const std::string& name = *pending.back();
+        pending.pop_back();
+        if (!seen.insert(name).second) continue;
+
+        auto found = variables.find(name);
+        auto held = globals.find(name);
+        if (found == variables.end()) {
+            if (held != globals.end()) return false;
+            continue;
+        }
+        if (held == globals.end()) return false;
+        const Global& global = held->second;
+        bool same = global.copied ? sameValue(found->second, global.copy, pairs)
+                                  : cannotCopy(found->second);
+        if (!same) return false;
+        for (const std::string& reference : global.references) pending.push_back(&reference);
+    }
+    return true;
+}
+
+void GlobalsSnapshot::copyInto(Environment& to) const {
+    CopyMemo memo;
+    for (const auto& [name, global] : globals) {
+        if (global.copied) to.define(name, copyValue(global.copy, memo));
+    }
+}
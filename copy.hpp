@@ -0,0 +1,77 @@
+#ifndef COPY_HPP
+#define COPY_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "environment.hpp"
+
+// Classes copied for another thread: (the original, the copy)
+using ClassCopies = std::vector<std::pair<std::shared_ptr<PyClass>, std::shared_ptr<PyClass>>>;
+
+// The copies made by one deep copy, so shared and cyclic structures keep
+// their shape. Classes are only copied (copyClasses) on their way from a
+// spawner into a task's snapshot, and listed in `classes`; otherwise a
+// class is taken as is, unless `copies` maps it to another.
+struct CopyMemo {
+    std::unordered_map<const void*, PyValue> copies;
+    bool copyClasses = false;
+    ClassCopies classes;
+
+    auto find(const void* original) { return copies.find(original); }
+    auto end() { return copies.end(); }
+    PyValue& operator[](const void* original) { return copies[original]; }
+};
+
+// A deep copy of `value` for another thread: lists, dicts, sets, arrays,
+// instances and the cells of closures are copied, everything immutable is
+// shared. Throws RuntimeError for generators and coroutines, which belong
+// to the thread running them.
+PyValue copyValue(const PyValue& value, CopyMemo& memo);
+
+// Appends the names that the functions reachable from `value` (in
+// containers, closures, classes and instances) look up as globals. Their
+// bodies are resolved, and so parsed, if they were not yet.
+void referencedGlobals(const PyValue& value, std::vector<std::string>& names);
+
+// A copy of the globals that code run on other threads can reach, from
+// which each of those threads copies globals of its own. Only the globals
+// reachable from some root names are copied: those, the names that the
+// functions among their values look up, and so on.
+//
+// Taking one costs as much as copying what it holds, so callers keep a
+// snapshot for as long as matches() says the globals are unchanged, which
+// only compares them. Globals that cannot be copied (they hold a generator
+// or coroutine) are left out.
+class GlobalsSnapshot {
+public:
+    // Copies the globals of `from` reachable from `roots` or held by
+    // `previous`, if given. With `copyClasses`, classes are copied too,
+    // and listed in classes().
+    GlobalsSnapshot(const Environment& from, const std::vector<std::string>& roots,
+                    const GlobalsSnapshot* previous, bool copyClasses);
+
+    // True if every global of `from` reachable from `roots` is as it was
+    // copied: bound to a value of the same shape and contents, or unbound
+    // in both
+    bool matches(const Environment& from, const std::vector<std::string>& roots) const;
+
+    // Defines a copy of each global held in `to`
+    void copyInto(Environment& to) const;
+
+    const std::shared_ptr<const ClassCopies>& classes() const { return classCopies; }
+
+private:
+    struct Global {
+        PyValue copy;
+        bool copied;  // False when the value could not be copied
+        std::vector<std::string> references;  // What its functions look up
+    };
+
+    std::unordered_map<std::string, Global> globals;
+    std::shared_ptr<const ClassCopies> classCopies;
+};
+
+#endif // COPY_HPP
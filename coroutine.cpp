@@ -0,0 +1,24 @@
+#include "coroutine.hpp"
+#include "interpreter.hpp"
+
+PyValue PyCoroutine::run() {
+    if (!env) throw RuntimeError("cannot reuse already awaited coroutine");
+
+    std::shared_ptr<Environment> frame = std::move(env);
+    try {
+        interpreter.executeBlock(function->declaration->body(), std::move(frame));
+    } catch (const ReturnException& ret) {
+        return ret.value;
+    }
+    return PyNone{};
+}
+
+const char* PyAwaitable::name() const {
+    switch (kind) {
+        case Kind::SLEEP: return "sleep";
+        case Kind::READ: return "read";
+        case Kind::WRITE: return "write";
+        case Kind::GATHER: return "gather";
+    }
+    return "awaitable";
+}
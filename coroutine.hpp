@@ -0,0 +1,54 @@
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+#include <memory>
+#include <vector>
+#include "environment.hpp"
+#include "function.hpp"
+
+class Interpreter;
+
+// The object returned by calling an `async def`: the call's arguments,
+// bound in a frame, waiting to be awaited. Awaiting it runs the body on
+// the awaiting task's own stack, like an ordinary call; an I/O wait at any
+// depth then suspends the whole task (see EventLoop). So an await of a
+// coroutine costs a function call, not a task switch.
+//
+// A coroutine must be run by the Interpreter that created it.
+class PyCoroutine {
+public:
+    PyCoroutine(Interpreter& interpreter, std::shared_ptr<PyFunction> function,
+                std::shared_ptr<Environment> env)
+        : interpreter(interpreter), function(std::move(function)), env(std::move(env)) {}
+
+    PyCoroutine(const PyCoroutine&) = delete;
+    PyCoroutine& operator=(const PyCoroutine&) = delete;
+
+    const std::string& name() const { return function->name; }
+    Interpreter& owner() const { return interpreter; }
+
+    // Runs the body to completion and returns its value. A coroutine can
+    // only be run once.
+    PyValue run();
+
+private:
+    Interpreter& interpreter;
+    std::shared_ptr<PyFunction> function;
+    std::shared_ptr<Environment> env;  // Null once run
+};
+
+// An awaitable made by the asyncio module: an operation the running
+// EventLoop performs when it is awaited. Like a coroutine it does nothing
+// until then.
+struct PyAwaitable {
+    enum class Kind { SLEEP, READ, WRITE, GATHER };
+
+    Kind kind;
+    std::vector<PyValue> args;  // Already checked by the module function
+
+    PyAwaitable(Kind kind, std::vector<PyValue> args) : kind(kind), args(std::move(args)) {}
+
+    const char* name() const;
+};
+
+#endif // COROUTINE_HPP
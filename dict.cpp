@@ -0,0 +1,113 @@
+#include "dict.hpp"
+#include "environment.hpp"
+#include "list.hpp"
+
+namespace {
+
+HashTable& dictTable(const PyValue& self) {
+    return std::get<std::shared_ptr<PyDict>>(self)->table;
+}
+
+HashTable& setTable(const PyValue& self) {
+    return std::get<std::shared_ptr<PySet>>(self)->table;
+}
+
+// dict.keys(), values() and items() return lists (there are no view or
+// tuple types); each item is a [key, value] list
+template <typename F>
+PyValue collect(const PyValue& self, F project) {
+    const HashTable& table = dictTable(self);
+    auto list = std::make_shared<PyList>();
+    list->reserve(table.size());
+    for (const auto& entry : table.entries()) {
+        if (!entry.erased) list->append(project(entry));
+    }
+    return list;
+}
+
+PyValue dictGet(const PyValue& self, ArgSpan args) {
+    const HashTable::Entry* entry = dictTable(self).find(args[0]);
+    if (entry) return entry->value;
+    return args.size() > 1 ? args[1] : PyNone{};
+}
+
+PyValue dictKeys(const PyValue& self, ArgSpan) {
+    return collect(self, [](const HashTable::Entry& entry) { return entry.key; });
+}
+
+PyValue dictValues(const PyValue& self, ArgSpan) {
+    return collect(self, [](const HashTable::Entry& entry) { return entry.value; });
+}
+
+PyValue dictItems(const PyValue& self, ArgSpan) {
+    return collect(self, [](const HashTable::Entry& entry) -> PyValue {
+        return std::make_shared<PyList>(std::vector<PyValue>{entry.key, entry.value});
+    });
+}
+
+PyValue dictPop(const PyValue& self, ArgSpan args) {
+    PyValue value;
+    if (dictTable(self).erase(args[0], &value)) return value;
+    if (args.size() > 1) return args[1];
+    throw RuntimeError("KeyError: " + pyRepr(args[0]));
+}
+
+PyValue setAdd(const PyValue& self, ArgSpan args) {
+    setTable(self).findOrInsert(args[0]);
+    return PyNone{};
+}
+
+PyValue setRemove(const PyValue& self, ArgSpan args) {
+    if (!setTable(self).erase(args[0])) {
+        throw RuntimeError("KeyError: " + pyRepr(args[0]));
+    }
+    return PyNone{};
+}
+
+PyValue setDiscard(const PyValue& self, ArgSpan args) {
+    setTable(self).erase(args[0]);
+    return PyNone{};
+}
+
+const NativeMethod dictMethods[] = {
+    {"get", 1, 2, dictGet},
+    {"keys", 0, 0, dictKeys},
+    {"values", 0, 0, dictValues},
+    {"items", 0, 0, dictItems},
+    {"pop", 1, 2, dictPop},
+};
+
+const NativeMethod setMethods[] = {
+    {"add", 1, 1, setAdd},
+    {"remove", 1, 1, setRemove},
+    {"discard", 1, 1, setDiscard},
+};
+
+}  // namespace
+
+const NativeMethod* PyDict::findMethod(const std::string& name) {
+    for (const NativeMethod& method : dictMethods) {
+        if (name == method.name) return &method;
+    }
+    return nullptr;
+}
+
+void PyDict::traverse(Visit visit, void* context) const {
+    for (const HashTable::Entry& entry : table.entries()) {
+        if (entry.erased) continue;
+        visitValue(entry.key, visit, context);
+        visitValue(entry.value, visit, context);
+    }
+}
+
+void PyDict::clearReferences() {
+    HashTable doomed;
+    std::swap(doomed, table);  // Entries are freed once the dict is consistent
+}
+
+const NativeMethod* PySet::findMethod(const std::string& name) {
+    for (const NativeMethod& method : setMethods) {
+        if (name == method.name) return &method;
+    }
+    return nullptr;
+}
@@ -0,0 +1,36 @@
+#ifndef DICT_HPP
+#define DICT_HPP
+
+#include <memory>
+#include "gc.hpp"
+#include "hash_table.hpp"
+
+// Python dict: keys map to values, iterated in insertion order. Tracked
+// by the cycle collector, since values can be lists and dicts.
+class PyDict : public GcObject, public std::enable_shared_from_this<PyDict> {
+public:
+    HashTable table;
+
+    PyDict() { track(); }
+    ~PyDict() override { untrack(); }
+
+    // get, keys, values, items, pop; nullptr for unknown names
+    static const NativeMethod* findMethod(const std::string& name);
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+};
+
+// Python set, sharing the dict's table layout (values are unused)
+class PySet {
+public:
+    HashTable table;
+
+    // add, remove, discard; nullptr for unknown names
+    static const NativeMethod* findMethod(const std::string& name);
+};
+
+#endif // DICT_HPP
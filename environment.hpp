@@ -5,8 +5,11 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <vector>
 #include "ast.hpp"
 
+struct Cell;
+
 class RuntimeError : public std::runtime_error {
 public:
     int line;
@@ -21,10 +24,19 @@ public:
         : std::runtime_error(msg), line(line) {}
 };
 
+// Variables by name: the globals, whose enclosing is null. A function
+// call's frame is an Environment enclosed by the globals, with the
+// function's own variables in slots the Resolver assigned instead.
 class Environment {
 public:
     std::shared_ptr<Environment> enclosing;
 
+    // A frame's LOCAL and CELL slots, and the function whose closure has
+    // its FREE ones
+    std::vector<PyValue> locals;
+    std::vector<std::shared_ptr<Cell>> cells;
+    std::shared_ptr<PyFunction> function;
+
     Environment() : enclosing(nullptr) {}
     explicit Environment(std::shared_ptr<Environment> enclosing)
         : enclosing(std::move(enclosing)) {}
@@ -62,6 +74,22 @@ public:
         values[name] = std::move(value);
     }
 
+    // The storage assign(name, ...) would write to, created if needed.
+    // Stays valid for the Environment's lifetime (values never move), so
+    // loops can bind their variable once and update it in place.
+    PyValue& slot(const std::string& name) {
+        for (Environment* env = this; env; env = env->enclosing.get()) {
+            auto it = env->values.find(name);
+            if (it != env->values.end()) {
+                return it->second;
+            }
+            if (!env->enclosing) {
+                return env->values[name];
+            }
+        }
+        return values[name];  // Unreachable
+    }
+
     bool contains(const std::string& name) const {
         if (values.find(name) != values.end()) {
             return true;
@@ -72,6 +100,9 @@ public:
         return false;
     }
 
+    // The variables defined in this environment itself
+    const std::unordered_map<std::string, PyValue>& variables() const { return values; }
+
 private:
     std::unordered_map<std::string, PyValue> values;
 };
@@ -0,0 +1,474 @@
+#include "event_loop.hpp"
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "builtins.hpp"
+#include "interpreter.hpp"
+#include "list.hpp"
+
+namespace {
+
+// Thrown from the suspended await of a task being cancelled. It is not a
+// RuntimeError, so nothing in the interpreter catches it on the way out.
+struct TaskCancelled {};
+
+constexpr int maxEvents = 64;
+constexpr long long defaultReadSize = 65536;
+// Longer sleeps are clamped; a timespec cannot hold arbitrary doubles
+constexpr double maxSleep = 1e9;
+
+RuntimeError systemError(const std::string& what) {
+    return RuntimeError(what + ": " + std::strerror(errno));
+}
+
+long long monotonicNow() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+bool isAwaitable(const PyValue& value) {
+    return std::holds_alternative<std::shared_ptr<PyCoroutine>>(value) ||
+           std::holds_alternative<std::shared_ptr<PyAwaitable>>(value);
+}
+
+int fdArgument(const std::string& function, const PyValue& value) {
+    const auto* fd = std::get_if<long long>(&value);
+    if (!fd) {
+        throw RuntimeError(function + "() file descriptor must be an int, not '" +
+                           pyTypeName(value) + "'");
+    }
+    if (*fd < 0 || *fd > INT_MAX) throw RuntimeError(function + "(): bad file descriptor");
+    return static_cast<int>(*fd);
+}
+
+PyValue descriptorPair(const int fds[2]) {
+    auto pair = std::make_shared<PyList>();
+    pair->append(static_cast<long long>(fds[0]));
+    pair->append(static_cast<long long>(fds[1]));
+    return pair;
+}
+
+// asyncio.run(coroutine)
+PyValue asyncioRun(ArgSpan args) {
+    const auto* coroutine = std::get_if<std::shared_ptr<PyCoroutine>>(&args[0]);
+    if (!coroutine) {
+        throw RuntimeError("a coroutine was expected, got '" + pyTypeName(args[0]) + "'");
+    }
+    return EventLoop::run(*coroutine);
+}
+
+// asyncio.sleep(seconds[, result])
+PyValue asyncioSleep(ArgSpan args) {
+    double seconds;
+    if (const auto* i = std::get_if<long long>(&args[0])) {
+        seconds = static_cast<double>(*i);
+    } else if (const auto* d = std::get_if<double>(&args[0])) {
+        seconds = *d;
+    } else {
+        throw RuntimeError("sleep() argument must be a number, not '" +
+                           pyTypeName(args[0]) + "'");
+    }
+    PyValue result = args.size() > 1 ? args[1] : PyValue(PyNone{});
+    return std::make_shared<PyAwaitable>(PyAwaitable::Kind::SLEEP,
+                                         std::vector<PyValue>{seconds, std::move(result)});
+}
+
+// asyncio.read(fd[, size]): up to `size` bytes as a str, "" at end of file
+PyValue asyncioRead(ArgSpan args) {
+    int fd = fdArgument("read", args[0]);
+    long long size = defaultReadSize;
+    if (args.size() > 1) {
+        const auto* given = std::get_if<long long>(&args[1]);
+        if (!given || *given < 0) throw RuntimeError("read() size must be a non-negative int");
+        size = *given;
+    }
+    return std::make_shared<PyAwaitable>(
+        PyAwaitable::Kind::READ, std::vector<PyValue>{static_cast<long long>(fd), size});
+}
+
+// asyncio.write(fd, data): writes all of `data` and returns its length
+PyValue asyncioWrite(ArgSpan args) {
+    int fd = fdArgument("write", args[0]);
+    if (!std::holds_alternative<std::string>(args[1])) {
+        throw RuntimeError("write() argument must be str, not '" + pyTypeName(args[1]) + "'");
+    }
+    return std::make_shared<PyAwaitable>(
+        PyAwaitable::Kind::WRITE, std::vector<PyValue>{static_cast<long long>(fd), args[1]});
+}
+
+// asyncio.gather(*awaitables): runs each as its own task; the results in
+// argument order
+PyValue asyncioGather(ArgSpan args) {
+    std::vector<PyValue> awaitables;
+    awaitables.reserve(args.size());
+    for (const PyValue& arg : args) {
+        if (!isAwaitable(arg)) {
+            throw RuntimeError("'" + pyTypeName(arg) + "' object is not awaitable");
+        }
+        awaitables.push_back(arg);
+    }
+    return std::make_shared<PyAwaitable>(PyAwaitable::Kind::GATHER, std::move(awaitables));
+}
+
+// asyncio.pipe(): [read end, write end]
+PyValue asyncioPipe(ArgSpan) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) throw systemError("pipe");
+    return descriptorPair(fds);
+}
+
+// asyncio.socketpair(): two connected Unix stream sockets
+PyValue asyncioSocketpair(ArgSpan) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0) {
+        throw systemError("socketpair");
+    }
+    return descriptorPair(fds);
+}
+
+// asyncio.open(path[, mode]): a descriptor; mode is "r", "w" or "a"
+PyValue asyncioOpen(ArgSpan args) {
+    const auto* path = std::get_if<std::string>(&args[0]);
+    if (!path) throw RuntimeError("open() path must be str, not '" + pyTypeName(args[0]) + "'");
+    std::string mode = "r";
+    if (args.size() > 1) {
+        const auto* given = std::get_if<std::string>(&args[1]);
+        if (!given) throw RuntimeError("open() mode must be str");
+        mode = *given;
+    }
+
+    int flags = O_NONBLOCK | O_CLOEXEC;
+    if (mode == "r") {
+        flags |= O_RDONLY;
+    } else if (mode == "w") {
+        flags |= O_WRONLY | O_CREAT | O_TRUNC;
+    } else if (mode == "a") {
+        flags |= O_WRONLY | O_CREAT | O_APPEND;
+    } else {
+        throw RuntimeError("invalid mode: '" + mode + "'");
+    }
+
+    int fd = open(path->c_str(), flags, 0644);
+    if (fd < 0) throw systemError(*path);
+    return static_cast<long long>(fd);
+}
+
+PyValue asyncioClose(ArgSpan args) {
+    if (close(fdArgument("close", args[0])) < 0) throw systemError("close");
+    return PyNone{};
+}
+
+}  // namespace
+
+EventLoop::EventLoop(Interpreter& interpreter)
+    : interpreter(interpreter), epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      timerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    if (epollFd < 0 || timerFd < 0) {
+        RuntimeError error = systemError("event loop");
+        if (epollFd >= 0) close(epollFd);
+        if (timerFd >= 0) close(timerFd);
+        throw error;
+    }
+    // The timer is the one registration without a task
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &event);
+    interpreter.eventLoop = this;
+}
+
+EventLoop::~EventLoop() {
+    // Unwind the tasks still suspended, so the values on their stacks are
+    // released. A task that never started has nothing to unwind.
+    for (auto& entry : tasks) {
+        Task* task = entry.first;
+        if (task->fiber.started() && !task->fiber.finished()) {
+            task->cancelled = true;
+            step(task);
+        }
+    }
+    interpreter.eventLoop = nullptr;
+    close(timerFd);
+    close(epollFd);
+}
+
+PyValue EventLoop::run(std::shared_ptr<PyCoroutine> main) {
+    Interpreter& interpreter = main->owner();
+    if (interpreter.eventLoop) {
+        throw RuntimeError("asyncio.run() cannot be called from a running event loop");
+    }
+
+    // The loop is destroyed, cancelling what is left, before the result or
+    // error is handed back
+    PyValue result;
+    std::exception_ptr error;
+    {
+        EventLoop loop(interpreter);
+        try {
+            Task* task = loop.spawn(std::move(main));
+            while (!task->fiber.finished()) {
+                if (loop.ready.empty()) {
+                    loop.poll();
+                    continue;
+                }
+                Task* next = loop.ready.front();
+                loop.ready.pop_front();
+                loop.step(next);
+            }
+            result = std::move(task->result);
+            error = task->error;
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+    return result;
+}
+
+PyValue EventLoop::await(const PyValue& value) {
+    if (const auto* coroutine = std::get_if<std::shared_ptr<PyCoroutine>>(&value)) {
+        return (*coroutine)->run();
+    }
+    const auto* awaitable = std::get_if<std::shared_ptr<PyAwaitable>>(&value);
+    if (!awaitable) {
+        throw RuntimeError("object " + pyTypeName(value) + " can't be used in 'await' expression");
+    }
+
+    const std::vector<PyValue>& args = (*awaitable)->args;
+    switch ((*awaitable)->kind) {
+        case PyAwaitable::Kind::SLEEP:
+            return sleep(std::get<double>(args[0]), args[1]);
+        case PyAwaitable::Kind::READ:
+            return read(static_cast<int>(std::get<long long>(args[0])),
+                        static_cast<size_t>(std::get<long long>(args[1])));
+        case PyAwaitable::Kind::WRITE:
+            return write(static_cast<int>(std::get<long long>(args[0])),
+                         std::get<std::string>(args[1]));
+        case PyAwaitable::Kind::GATHER:
+            return gather(args);
+    }
+    return PyNone{};
+}
+
+EventLoop::Task* EventLoop::spawn(PyValue awaitable) {
+    auto task = std::make_unique<Task>([this, awaitable = std::move(awaitable)] {
+        Task* self = current;
+        try {
+            self->result = await(awaitable);
+        } catch (const TaskCancelled&) {
+        } catch (...) {
+            self->error = std::current_exception();
+        }
+    });
+    Task* handle = task.get();
+    tasks.emplace(handle, std::move(task));
+    ready.push_back(handle);
+    return handle;
+}
+
+void EventLoop::step(Task* task) {
+    // A task keeps its own current environment across suspensions, so the
+    // loop's is moved aside rather than copied
+    std::shared_ptr<Environment> loopEnv = std::move(interpreter.currentEnv);
+    PyGenerator* loopGenerator = interpreter.activeGenerator;
+    interpreter.activeGenerator = nullptr;
+    current = task;
+
+    task->fiber.resume();  // The body catches everything
+
+    current = nullptr;
+    interpreter.currentEnv = std::move(loopEnv);
+    interpreter.activeGenerator = loopGenerator;
+
+    // A gather resumes once all of its tasks have finished, or as soon as
+    // one fails
+    Task* parent = task->fiber.finished() ? task->parent : nullptr;
+    if (parent && parent->pending > 0 && (task->error || --parent->pending == 0)) {
+        parent->pending = 0;
+        ready.push_back(parent);
+    }
+}
+
+void EventLoop::suspend() {
+    Task* task = current;
+    task->fiber.suspend();
+    if (task->cancelled) throw TaskCancelled();
+}
+
+void EventLoop::waitFor(int fd, uint32_t events) {
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = current;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        if (errno == EPERM) return;  // A regular file, which is always ready
+        if (errno == EEXIST) {
+            throw RuntimeError("file descriptor " + std::to_string(fd) +
+                               " is already awaited by another task");
+        }
+        throw systemError("epoll_ctl");
+    }
+
+    // Unregistered however the wait ends, including by cancellation
+    struct Registration {
+        EventLoop& loop;
+        int fd;
+        ~Registration() {
+            epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            loop.waiting--;
+        }
+    } registration{*this, fd};
+    waiting++;
+    suspend();
+}
+
+void EventLoop::poll() {
+    if (waiting == 0) throw RuntimeError("event loop has no task to run");
+
+    epoll_event events[maxEvents];
+    int count = epoll_wait(epollFd, events, maxEvents, -1);
+    if (count < 0) {
+        if (errno == EINTR) return;
+        throw systemError("epoll_wait");
+    }
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.ptr) {
+            ready.push_back(static_cast<Task*>(events[i].data.ptr));
+        } else {
+            expireTimers();
+        }
+    }
+}
+
+void EventLoop::armTimer() {
+    itimerspec spec{};
+    if (!timers.empty()) {
+        long long deadline = timers.top().deadline;
+        spec.it_value.tv_sec = deadline / 1000000000LL;
+        spec.it_value.tv_nsec = deadline % 1000000000LL;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void EventLoop::expireTimers() {
+    uint64_t expirations;
+    ssize_t drained = ::read(timerFd, &expirations, sizeof expirations);
+    (void)drained;
+
+    long long now = monotonicNow();
+    while (!timers.empty() && timers.top().deadline <= now) {
+        ready.push_back(timers.top().task);
+        timers.pop();
+    }
+    armTimer();
+}
+
+PyValue EventLoop::sleep(double seconds, PyValue result) {
+    if (!(seconds > 0)) {
+        // sleep(0) only lets the other ready tasks run first
+        ready.push_back(current);
+        suspend();
+        return result;
+    }
+
+    long long deadline = monotonicNow() +
+                         std::max(1LL, std::llround(std::min(seconds, maxSleep) * 1e9));
+    timers.push(Timer{deadline, timerSequence++, current});
+    if (timers.top().task == current) armTimer();
+
+    struct Waiting {
+        size_t& count;
+        ~Waiting() { count--; }
+    } counted{++waiting};
+    suspend();
+    return result;
+}
+
+PyValue EventLoop::read(int fd, size_t size) {
+    std::string buffer(size, '\0');
+    while (true) {
+        ssize_t count = ::read(fd, buffer.data(), size);
+        if (count >= 0) {
+            buffer.resize(static_cast<size_t>(count));
+            return buffer;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) throw systemError("read");
+        waitFor(fd, EPOLLIN);
+    }
+}
+
+PyValue EventLoop::write(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+        if (count >= 0) {
+            written += static_cast<size_t>(count);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) throw systemError("write");
+        waitFor(fd, EPOLLOUT);
+    }
+    return static_cast<long long>(written);
+}
+
+PyValue EventLoop::gather(const std::vector<PyValue>& awaitables) {
+    Task* task = current;
+    std::vector<Task*> children;
+    children.reserve(awaitables.size());
+    for (const PyValue& awaitable : awaitables) {
+        Task* child = spawn(awaitable);
+        child->parent = task;
+        children.push_back(child);
+    }
+
+    task->pending = children.size();
+    if (task->pending > 0) suspend();
+
+    // On a failure the tasks still running are left to finish on their
+    // own, as in Python; the first error in argument order is raised
+    std::exception_ptr error;
+    for (Task* child : children) {
+        child->parent = nullptr;
+        if (child->error && !error) error = child->error;
+    }
+    if (error) {
+        for (Task* child : children) {
+            if (child->fiber.finished()) tasks.erase(child);
+        }
+        std::rethrow_exception(error);
+    }
+
+    auto results = std::make_shared<PyList>();
+    results->reserve(children.size());
+    for (Task* child : children) {
+        results->append(std::move(child->result));
+        tasks.erase(child);
+    }
+    return results;
+}
+
+std::shared_ptr<PyModule> EventLoop::module() {
+    auto asyncio = std::make_shared<PyModule>("asyncio");
+    auto add = [&](const char* name, int minArity, int maxArity, NativeFn fn) {
+        asyncio->members[name] = Builtins::makeNative(name, minArity, maxArity, std::move(fn));
+    };
+    add("run", 1, 1, asyncioRun);
+    add("sleep", 1, 2, asyncioSleep);
+    add("gather", 0, -1, asyncioGather);
+    add("read", 1, 2, asyncioRead);
+    add("write", 2, 2, asyncioWrite);
+    add("open", 1, 2, asyncioOpen);
+    add("close", 1, 1, asyncioClose);
+    add("pipe", 0, 0, asyncioPipe);
+    add("socketpair", 0, 0, asyncioSocketpair);
+    return asyncio;
+}
@@ -0,0 +1,91 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include "coroutine.hpp"
+#include "fiber.hpp"
+
+// The event loop behind asyncio.run(). Each task is a Fiber running a
+// coroutine; a task that awaits I/O registers its file descriptor with
+// epoll and suspends, and the loop resumes other ready tasks until the
+// kernel reports the descriptor ready. Sleeping tasks wait in a deadline
+// heap behind a single timerfd, so any number can sleep at once.
+// Everything runs on the calling thread: tasks overlap their waits, not
+// their computation.
+//
+// Regular files cannot be polled and are always ready, so their reads
+// and writes complete on the spot.
+class EventLoop {
+public:
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // asyncio.run(main): runs `main` as the first task on a new loop in its
+    // Interpreter until it finishes, then cancels the tasks still waiting
+    // and returns main's value (or rethrows its exception)
+    static PyValue run(std::shared_ptr<PyCoroutine> main);
+
+    // `await awaitable` in the running task: runs a coroutine, or performs
+    // a PyAwaitable, suspending the task while it waits
+    PyValue await(const PyValue& awaitable);
+
+    // The asyncio module: run, sleep, gather, and read, write, open, close,
+    // pipe and socketpair on raw file descriptors
+    static std::shared_ptr<PyModule> module();
+
+private:
+    struct Task {
+        Fiber fiber;
+        PyValue result;
+        std::exception_ptr error;
+        Task* parent = nullptr;  // The task gathering this one
+        size_t pending = 0;      // Gathered tasks this one still waits for
+        bool cancelled = false;
+
+        explicit Task(std::function<void()> body) : fiber(std::move(body)) {}
+    };
+
+    struct Timer {
+        long long deadline;  // CLOCK_MONOTONIC nanoseconds
+        unsigned long long sequence;  // Equal deadlines wake in order
+        Task* task;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline
+                                              : sequence > other.sequence;
+        }
+    };
+
+    Interpreter& interpreter;
+    int epollFd;
+    int timerFd;  // Armed for the earliest deadline in `timers`
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    unsigned long long timerSequence = 0;
+    std::unordered_map<Task*, std::unique_ptr<Task>> tasks;
+    std::deque<Task*> ready;
+    Task* current = nullptr;
+    size_t waiting = 0;  // Tasks suspended on a file descriptor or timer
+
+    explicit EventLoop(Interpreter& interpreter);
+    ~EventLoop();
+
+    Task* spawn(PyValue awaitable);
+    void step(Task* task);
+    void suspend();
+    void waitFor(int fd, uint32_t events);
+    void poll();
+    void armTimer();
+    void expireTimers();
+
+    PyValue sleep(double seconds, PyValue result);
+    PyValue read(int fd, size_t size);
+    PyValue write(int fd, const std::string& data);
+    PyValue gather(const std::vector<PyValue>& awaitables);
+};
+
+#endif // EVENT_LOOP_HPP
@@ -0,0 +1,203 @@
+#include "fiber.hpp"
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__ELF__)
+#define FIBER_ASM_SWITCH 1
+#else
+#include <ucontext.h>
+#endif
+
+namespace {
+
+// Usable stack per fiber, as for a main thread by default, so code nests
+// as deeply inside a generator as outside one. Only touched pages are ever
+// backed by memory; the size reserves address space.
+constexpr size_t stackSize = 8 << 20;
+// Stacks kept for reuse per thread, so creating a fiber is usually free
+constexpr size_t pooledStacks = 64;
+
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+struct StackPool {
+    std::vector<void*> free;
+
+    ~StackPool() {
+        for (void* stack : free) {
+            munmap(static_cast<char*>(stack) - pageSize(), stackSize + pageSize());
+        }
+    }
+};
+
+thread_local StackPool stackPool;
+
+// Returns the lowest usable address; the page below it is a guard page
+void* acquireStack() {
+    if (!stackPool.free.empty()) {
+        void* stack = stackPool.free.back();
+        stackPool.free.pop_back();
+        return stack;
+    }
+    size_t guard = pageSize();
+    void* region = mmap(nullptr, stackSize + guard, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (region == MAP_FAILED) throw std::bad_alloc();
+    mprotect(region, guard, PROT_NONE);
+    return static_cast<char*>(region) + guard;
+}
+
+void releaseStack(void* stack) {
+    if (stackPool.free.size() < pooledStacks) {
+        stackPool.free.push_back(stack);
+        return;
+    }
+    munmap(static_cast<char*>(stack) - pageSize(), stackSize + pageSize());
+}
+
+// The fiber being started; read by Fiber::entry on its first switch in
+thread_local Fiber* startingFiber = nullptr;
+
+}  // namespace
+
+#if FIBER_ASM_SWITCH
+
+// fiberSwitch(save, load): pushes the callee-saved registers and the SSE
+// and x87 control words, stores the stack pointer to *save, then pops the
+// same frame off the stack `load` and returns into it
+extern "C" void fiberSwitch(void** save, void* load);
+
+asm(R"(
+    .text
+    .p2align 4
+    .hidden fiberSwitch
+    .globl fiberSwitch
+    .type fiberSwitch, @function
+fiberSwitch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size fiberSwitch, .-fiberSwitch
+)");
+
+namespace {
+
+// A frame for fiberSwitch to pop: zeroed registers, the current control
+// words, and `entry` as the return address, leaving the stack aligned as
+// at a function's entry
+void* initialContext(void* stack, void (*entry)()) {
+    uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stackSize) & ~uintptr_t(15);
+    void** sp = reinterpret_cast<void**>(top);
+    *--sp = nullptr;  // entry's return address: ends backtraces and unwinding
+    *--sp = reinterpret_cast<void*>(entry);
+    for (int i = 0; i < 6; i++) *--sp = nullptr;
+
+    uint32_t controlWords[2] = {0, 0};
+    asm volatile("stmxcsr %0" : "=m"(controlWords[0]));
+    asm volatile("fnstcw %0" : "=m"(controlWords[1]));
+    --sp;
+    *reinterpret_cast<uint64_t*>(sp) =
+        controlWords[0] | (static_cast<uint64_t>(controlWords[1] & 0xffff) << 32);
+    return sp;
+}
+
+void switchContext(void** save, void* load) {
+    fiberSwitch(save, load);
+}
+
+void freeContexts(void*&, void*&) {}
+
+}  // namespace
+
+#else  // Portable fallback on ucontext, which also saves the signal mask
+
+namespace {
+
+void* initialContext(void* stack, void (*entry)()) {
+    auto* context = new ucontext_t();
+    getcontext(context);
+    context->uc_stack.ss_sp = stack;
+    context->uc_stack.ss_size = stackSize;
+    context->uc_link = nullptr;
+    makecontext(context, entry, 0);
+    return context;
+}
+
+void switchContext(void** save, void* load) {
+    if (!*save) *save = new ucontext_t();
+    swapcontext(static_cast<ucontext_t*>(*save), static_cast<ucontext_t*>(load));
+}
+
+void freeContexts(void*& fiber, void*& caller) {
+    delete static_cast<ucontext_t*>(fiber);
+    delete static_cast<ucontext_t*>(caller);
+    fiber = caller = nullptr;
+}
+
+}  // namespace
+
+#endif  // FIBER_ASM_SWITCH
+
+Fiber::Fiber(std::function<void()> body) : body(std::move(body)) {}
+
+Fiber::~Fiber() {
+    if (stack) releaseStack(stack);
+    freeContexts(fiberContext, callerContext);
+}
+
+void Fiber::resume() {
+    if (done) return;
+    if (!stack) {
+        stack = acquireStack();
+        fiberContext = initialContext(stack, entry);
+        startingFiber = this;
+    }
+    switchContext(&callerContext, fiberContext);
+
+    if (done && error) {
+        std::exception_ptr escaped = error;
+        error = nullptr;
+        std::rethrow_exception(escaped);
+    }
+}
+
+void Fiber::suspend() {
+    switchContext(&fiberContext, callerContext);
+}
+
+void Fiber::entry() {
+    Fiber* self = startingFiber;
+    // Nothing may unwind past this frame: there is no caller to return to
+    try {
+        self->body();
+    } catch (...) {
+        self->error = std::current_exception();
+    }
+    self->body = nullptr;
+    self->done = true;
+    switchContext(&self->fiberContext, self->callerContext);
+    __builtin_unreachable();
+}
@@ -0,0 +1,45 @@
+#ifndef FIBER_HPP
+#define FIBER_HPP
+
+#include <exception>
+#include <functional>
+
+// A stackful coroutine: `body` runs on its own stack and can suspend()
+// itself, returning control to whoever called resume(), which later
+// continues it exactly where it stopped. Switching saves only the
+// callee-saved registers, so it costs a few nanoseconds and no allocation.
+//
+// Stacks are mmap'd with a guard page below them and recycled through a
+// small per-thread pool. A fiber belongs to the thread that first resumes
+// it. An exception escaping `body` finishes the fiber and is rethrown
+// from resume(). A fiber destroyed while suspended simply drops its stack
+// without unwinding it, so owners that hold resources on the fiber's
+// stack must first make the body return.
+class Fiber {
+public:
+    explicit Fiber(std::function<void()> body);
+    ~Fiber();
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    // Runs the body until it suspends or returns
+    void resume();
+    // Called from inside the body: switches back to resume()'s caller
+    void suspend();
+
+    bool started() const { return stack != nullptr; }
+    bool finished() const { return done; }
+
+private:
+    std::function<void()> body;
+    void* stack = nullptr;  // Lowest usable address; null until started
+    void* fiberContext = nullptr;
+    void* callerContext = nullptr;
+    std::exception_ptr error;
+    bool done = false;
+
+    static void entry();
+};
+
+#endif // FIBER_HPP
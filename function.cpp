@@ -0,0 +1,24 @@
+#include "function.hpp"
+#include <utility>
+#include "object.hpp"
+
+void Cell::traverse(Visit visit, void* context) const {
+    visitValue(value, visit, context);
+}
+
+void Cell::clearReferences() {
+    PyValue doomed = std::exchange(value, unboundValue());
+}
+
+void PyFunction::traverse(Visit visit, void* context) const {
+    for (const auto& cell : closure) {
+        visit(cell.get(), context);
+    }
+    if (self) visit(self.get(), context);
+}
+
+void PyFunction::clearReferences() {
+    std::vector<std::shared_ptr<Cell>> doomed;
+    doomed.swap(closure);  // Freed once the function is consistent again
+    std::shared_ptr<PyInstance> receiver = std::move(self);
+}
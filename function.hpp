@@ -0,0 +1,66 @@
+#ifndef FUNCTION_HPP
+#define FUNCTION_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "gc.hpp"
+#include "value.hpp"
+
+struct FunctionStmt;
+
+// What a frame's locals and cells hold until they are first assigned: a
+// null function, which no expression can produce
+inline PyValue unboundValue() {
+    return std::shared_ptr<PyFunction>();
+}
+
+inline bool isUnbound(const PyValue& value) {
+    const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&value);
+    return function && !*function;
+}
+
+// A local variable that nested functions refer to. The frame that binds
+// it and every closure made over it share the cell, so a closure sees the
+// variable's latest value, and reaching it is one indirection however
+// deeply the functions nest.
+struct Cell : public GcObject, public std::enable_shared_from_this<Cell> {
+    PyValue value = unboundValue();
+
+    Cell() { track(); }
+    ~Cell() override { untrack(); }
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+};
+
+// Function definition for runtime. A def nested in another function is a
+// closure: it holds the cells of the enclosing variables it uses (and
+// only those), taken from the defining frame when the def runs. Cells can
+// hold the function itself, so functions are tracked by the collector.
+// A method looked up on an instance without being called is a copy of
+// the function bound to the instance, which calls pass as `self`.
+struct PyFunction : public GcObject, public std::enable_shared_from_this<PyFunction> {
+    std::string name;
+    const FunctionStmt* declaration;  // Points to the AST node
+    // Indexed by the FREE slots the Resolver gave the body's names
+    std::vector<std::shared_ptr<Cell>> closure;
+    std::shared_ptr<PyInstance> self;  // Set on a bound method
+
+    PyFunction(std::string name, const FunctionStmt* declaration)
+        : name(std::move(name)), declaration(declaration) {
+        track();
+    }
+    ~PyFunction() override { untrack(); }
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+};
+
+#endif // FUNCTION_HPP
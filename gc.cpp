@@ -0,0 +1,428 @@
+#include "gc.hpp"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "builtins.hpp"
+#include "dict.hpp"
+#include "environment.hpp"
+#include "function.hpp"
+#include "list.hpp"
+#include "object.hpp"
+
+namespace {
+
+void insert(GcNode& list, GcNode* node) {
+    node->prev = list.prev;
+    node->next = &list;
+    list.prev->next = node;
+    list.prev = node;
+}
+
+void remove(GcNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = node;
+}
+
+// Moves every node of `from` to the end of `to`
+void splice(GcNode& from, GcNode& to) {
+    if (from.next == &from) return;
+    from.next->prev = to.prev;
+    from.prev->next = &to;
+    to.prev->next = from.next;
+    to.prev = from.prev;
+    from.prev = from.next = &from;
+}
+
+GcObject* objectAt(uintptr_t state) {
+    return reinterpret_cast<GcObject*>(state & ~uintptr_t(1));
+}
+
+std::atomic<long> middleThreshold{10};
+std::atomic<long> oldThreshold{10};
+std::atomic<bool> enabled{true};
+std::atomic<int> pauses{0};
+
+}  // namespace
+
+// The objects tracked by one thread. Only that thread links, unlinks and
+// collects them, so the lists take no lock; an object freed on another
+// thread just clears its node, which the owner sweeps the next time it
+// collects the node's generation.
+//
+// Objects still alive when their thread exits move to the orphan heap,
+// which no thread owns: it is locked, and collected along with the oldest
+// generation of whichever thread gets to it first.
+class GcHeap {
+public:
+    GcNode lists[GarbageCollector::generations];
+    // counts[g] for g > 0: collections of generation g - 1 since the last
+    // of generation g. (counts[0] is GarbageCollector::youngObjects.)
+    long counts[GarbageCollector::generations] = {};
+
+    // This thread's heap. Objects made while the thread is exiting, after
+    // its heap is gone, go to the orphan heap.
+    static GcHeap& current() {
+        if (threadHeap) return *threadHeap;
+        if (threadHeapGone) return orphans();
+        static thread_local GcHeap heap(true);
+        return heap;
+    }
+
+    static GcHeap& orphans() {
+        static GcHeap* heap = new GcHeap(false);
+        return *heap;
+    }
+
+    ~GcHeap() {
+        if (this != threadHeap) return;
+        threadHeap = nullptr;
+        threadHeapGone = true;
+
+        // Pinned so no other thread frees them while they move
+        std::vector<std::shared_ptr<void>> pinned;
+        GcHeap& orphanage = orphans();
+        {
+            std::lock_guard<std::mutex> guard(orphanage.lock);
+            for (GcNode& list : lists) {
+                for (GcNode* node = list.next; node != &list;) {
+                    GcNode* next = node->next;
+                    if (std::shared_ptr<void> owner = pin(node)) {
+                        GcObject* object = objectAt(node->object.load(std::memory_order_relaxed));
+                        object->heap.store(&orphanage, std::memory_order_release);
+                        object->generation = GarbageCollector::generations - 1;
+                        pinned.push_back(std::move(owner));
+                    } else if (node->object.load(std::memory_order_acquire) == 0) {
+                        remove(node);
+                        delete node;
+                    }
+                    node = next;
+                }
+                splice(list, orphanage.lists[GarbageCollector::generations - 1]);
+            }
+        }
+        while (freeNodes) {
+            GcNode* node = freeNodes;
+            freeNodes = node->next;
+            delete node;
+        }
+    }
+
+    void link(GcObject* object) {
+        std::unique_lock<std::mutex> guard(lock, std::defer_lock);
+        if (shared) guard.lock();
+        GcNode* node = freeNodes;
+        if (node) {
+            freeNodes = node->next;
+            node->prev = node->next = node;
+        } else {
+            node = new GcNode;
+        }
+        node->object.store(reinterpret_cast<uintptr_t>(object), std::memory_order_relaxed);
+        object->node = node;
+        object->generation = 0;
+        insert(lists[0], node);
+        object->heap.store(this, std::memory_order_release);
+    }
+
+    static void unlink(GcObject* object) {
+        GcHeap* heap = object->heap.load(std::memory_order_acquire);
+        if (!heap) return;
+        GcNode* node = object->node;
+        if (heap == threadHeap) {
+            remove(node);
+            heap->recycle(node);
+            if (object->generation == 0) GarbageCollector::youngObjects--;
+        } else {
+            // Left for the heap's own thread, or the orphans' collector
+            for (;;) {
+                uintptr_t state = node->object.load(std::memory_order_acquire);
+                if (state & 1) {
+                    std::this_thread::yield();  // Pinned for a moment
+                } else if (node->object.compare_exchange_weak(state, 0,
+                                                              std::memory_order_acq_rel)) {
+                    break;
+                }
+            }
+        }
+        object->heap.store(nullptr, std::memory_order_relaxed);
+        object->node = nullptr;
+    }
+
+    // Collects this thread's heap, and with its oldest generation the
+    // orphan heap unless another thread is collecting that already
+    static size_t collectCurrent(int generation) {
+        size_t freed = 0;
+        GcHeap& heap = current();
+        if (!heap.shared) freed = heap.collect(generation);
+        if (generation == GarbageCollector::generations - 1) {
+            GcHeap& orphanage = orphans();
+            std::unique_lock<std::mutex> guard(orphanage.lock, std::try_to_lock);
+            if (guard) freed += orphanage.collect(generation);
+        }
+        return freed;
+    }
+
+private:
+    static inline thread_local GcHeap* threadHeap = nullptr;
+    static inline thread_local bool threadHeapGone = false;
+
+    const bool shared;  // The orphan heap, whose lock guards the rest
+    std::mutex lock;
+    GcNode* freeNodes = nullptr;  // Chained through `next`
+
+    explicit GcHeap(bool forThread) : shared(!forThread) {
+        if (forThread) threadHeap = this;
+    }
+
+    void recycle(GcNode* node) {
+        node->next = freeNodes;
+        freeNodes = node;
+    }
+
+    // An owning reference to the object at `node`, which keeps other
+    // threads from freeing it until released. Null if the object is
+    // already being freed, or is not owned by a shared_ptr (it lives on
+    // the C++ stack, and counts as referenced from outside).
+    static std::shared_ptr<void> pin(GcNode* node) {
+        uintptr_t state = node->object.load(std::memory_order_acquire);
+        if (state == 0 ||
+            !node->object.compare_exchange_strong(state, state | 1, std::memory_order_acq_rel)) {
+            return nullptr;
+        }
+        std::shared_ptr<void> owner = objectAt(state)->retain();
+        node->object.store(state, std::memory_order_release);
+        return owner;
+    }
+
+    size_t collect(int generation);
+
+    // The generation being collected, for the traversal callbacks
+    struct Collection {
+        GcHeap* heap;
+        unsigned char generation;
+        std::vector<GcObject*> work;
+
+        bool contains(const GcObject* object) const {
+            return object->heap.load(std::memory_order_relaxed) == heap &&
+                   object->generation == generation;
+        }
+    };
+
+    static void subtractReference(GcObject* child, void* context) {
+        auto* collection = static_cast<Collection*>(context);
+        if (collection->contains(child) && child->gcRefs > 0) child->gcRefs--;
+    }
+
+    static void markReachable(GcObject* child, void* context) {
+        auto* collection = static_cast<Collection*>(context);
+        if (collection->contains(child) && !child->reachable) {
+            child->reachable = true;
+            collection->work.push_back(child);
+        }
+    }
+};
+
+size_t GcHeap::collect(int generation) {
+    GcNode& candidates = lists[generation];
+    for (int younger = 0; younger < generation; younger++) {
+        splice(lists[younger], candidates);
+    }
+
+    // Every candidate is pinned until the end, so none is freed under us
+    std::vector<GcObject*> members;
+    std::vector<std::shared_ptr<void>> pinned;
+    Collection collection{this, static_cast<unsigned char>(generation), {}};
+    for (GcNode* node = candidates.next; node != &candidates;) {
+        GcNode* next = node->next;
+        if (std::shared_ptr<void> owner = pin(node)) {
+            GcObject* object = objectAt(node->object.load(std::memory_order_relaxed));
+            object->generation = collection.generation;
+            object->reachable = false;
+            object->gcRefs = object->useCount() - 1;  // Less the pin
+            members.push_back(object);
+            pinned.push_back(std::move(owner));
+        } else if (node->object.load(std::memory_order_acquire) == 0) {
+            remove(node);  // Freed on another thread
+            recycle(node);
+        }
+        node = next;
+    }
+
+    // What is left of gcRefs is references from outside the generation
+    for (GcObject* object : members) {
+        object->traverse(subtractReference, &collection);
+    }
+    for (GcObject* object : members) {
+        if (object->gcRefs > 0) {
+            object->reachable = true;
+            collection.work.push_back(object);
+        }
+    }
+    while (!collection.work.empty()) {
+        GcObject* object = collection.work.back();
+        collection.work.pop_back();
+        object->traverse(markReachable, &collection);
+    }
+
+    // Survivors move up a generation; the rest stay until freed
+    int older = std::min(generation + 1, GarbageCollector::generations - 1);
+    GcNode survivors;
+    std::vector<GcObject*> garbage;
+    for (GcObject* object : members) {
+        if (object->reachable) {
+            remove(object->node);
+            insert(survivors, object->node);
+            object->generation = static_cast<unsigned char>(older);
+        } else {
+            garbage.push_back(object);
+        }
+    }
+    splice(survivors, lists[older]);
+
+    if (!shared) GarbageCollector::youngObjects = 0;
+    for (int g = 1; g <= generation; g++) counts[g] = 0;
+    if (generation + 1 < GarbageCollector::generations) counts[generation + 1]++;
+
+    // Clearing breaks the cycles; dropping the pins then frees the
+    // objects (and anything only they referred to) through their
+    // reference counts
+    for (GcObject* object : garbage) {
+        object->clearReferences();
+    }
+    pinned.clear();
+    return garbage.size();
+}
+
+void GcObject::visitValue(const PyValue& value, Visit visit, void* context) {
+    if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&value)) {
+        visit(list->get(), context);
+    } else if (const auto* dict = std::get_if<std::shared_ptr<PyDict>>(&value)) {
+        visit(dict->get(), context);
+    } else if (const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&value)) {
+        if (*function) visit(function->get(), context);  // Null while unbound
+    } else if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&value)) {
+        visit(cls->get(), context);
+    } else if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&value)) {
+        visit(instance->get(), context);
+    }
+}
+
+void GcObject::track() {
+    GcHeap::current().link(this);
+    GarbageCollector::youngObjects++;
+}
+
+void GcObject::untrack() {
+    GcHeap::unlink(this);
+}
+
+size_t GarbageCollector::collect(int generation) {
+    if (pauses.load() > 0) return 0;
+    generation = std::clamp(generation, 0, generations - 1);
+    return GcHeap::collectCurrent(generation);
+}
+
+void GarbageCollector::collectDue() {
+    if (!enabled.load() || pauses.load() > 0 || youngThreshold.load() == 0) {
+        youngObjects = 0;  // Check again after as many new objects
+        return;
+    }
+    GcHeap& heap = GcHeap::current();
+    int generation = 0;
+    if (heap.counts[2] >= oldThreshold.load()) {
+        generation = 2;
+    } else if (heap.counts[1] >= middleThreshold.load()) {
+        generation = 1;
+    }
+    GcHeap::collectCurrent(generation);
+}
+
+std::array<long, GarbageCollector::generations> GarbageCollector::thresholds() {
+    return {youngThreshold.load(), middleThreshold.load(), oldThreshold.load()};
+}
+
+void GarbageCollector::setThresholds(long young, long middle, long old) {
+    youngThreshold = young;
+    middleThreshold = middle;
+    oldThreshold = old;
+}
+
+bool GarbageCollector::isEnabled() {
+    return enabled.load();
+}
+
+void GarbageCollector::setEnabled(bool value) {
+    enabled = value;
+}
+
+std::array<long, GarbageCollector::generations> GarbageCollector::counts() {
+    GcHeap& heap = GcHeap::current();
+    return {youngObjects, heap.counts[1], heap.counts[2]};
+}
+
+GarbageCollector::Pause::Pause() {
+    pauses++;
+}
+
+GarbageCollector::Pause::~Pause() {
+    pauses--;
+}
+
+namespace {
+
+long thresholdArgument(const PyValue& value) {
+    if (!std::holds_alternative<long long>(value) || std::get<long long>(value) < 0) {
+        throw RuntimeError("set_threshold() arguments must be non-negative integers");
+    }
+    return static_cast<long>(std::get<long long>(value));
+}
+
+PyValue toList(const std::array<long, GarbageCollector::generations>& values) {
+    std::vector<PyValue> items;
+    for (long value : values) items.push_back(static_cast<long long>(value));
+    return std::make_shared<PyList>(std::move(items));
+}
+
+}  // namespace
+
+std::shared_ptr<PyModule> GarbageCollector::module() {
+    auto gc = std::make_shared<PyModule>("gc");
+    auto add = [&](const char* name, int minArity, int maxArity, NativeFn fn) {
+        gc->members[name] = Builtins::makeNative(name, minArity, maxArity, std::move(fn));
+    };
+    add("collect", 0, 1, [](ArgSpan args) -> PyValue {
+        int generation = generations - 1;
+        if (args.size() == 1) {
+            if (!std::holds_alternative<long long>(args[0]) ||
+                std::get<long long>(args[0]) < 0 ||
+                std::get<long long>(args[0]) >= generations) {
+                throw RuntimeError("collect() generation must be 0, 1 or 2");
+            }
+            generation = static_cast<int>(std::get<long long>(args[0]));
+        }
+        return static_cast<long long>(collect(generation));
+    });
+    add("enable", 0, 0, [](ArgSpan) -> PyValue {
+        setEnabled(true);
+        return PyNone{};
+    });
+    add("disable", 0, 0, [](ArgSpan) -> PyValue {
+        setEnabled(false);
+        return PyNone{};
+    });
+    add("isenabled", 0, 0, [](ArgSpan) -> PyValue { return isEnabled(); });
+    add("get_count", 0, 0, [](ArgSpan) { return toList(counts()); });
+    add("get_threshold", 0, 0, [](ArgSpan) { return toList(thresholds()); });
+    add("set_threshold", 1, 3, [](ArgSpan args) -> PyValue {
+        std::array<long, generations> values = thresholds();
+        for (size_t i = 0; i < args.size(); i++) {
+            values[i] = thresholdArgument(args[i]);
+        }
+        setThresholds(values[0], values[1], values[2]);
+        return PyNone{};
+    });
+    return gc;
+}
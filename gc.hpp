@@ -0,0 +1,131 @@
+#ifndef GC_HPP
+#define GC_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "value.hpp"
+
+class GcHeap;
+
+// A tracked object's entry in one of its heap's generation lists (the
+// lists' own heads have no object). Nodes belong to the heap, so an object
+// freed on another thread can leave its node behind, cleared, for the
+// heap's thread to sweep.
+struct GcNode {
+    GcNode* prev = this;
+    GcNode* next = this;
+    // The GcObject, or 0 once it is freed from another thread. The low bit
+    // is set while a collection pins the object.
+    std::atomic<uintptr_t> object{0};
+};
+
+// Base of the objects that can hold references to each other (lists,
+// dicts, functions and their cells, classes and instances) and so form
+// cycles that reference counting never frees.
+// Each is tracked on the heap of the thread that made it. Derived classes
+// call track() once constructed and untrack() first thing in their
+// destructor, while their members are still intact.
+class GcObject {
+public:
+    using Visit = void (*)(GcObject* child, void* context);
+
+    // Calls visit(child, context) for the list, dict, function, class or
+    // instance `value` refers to, if any
+    static void visitValue(const PyValue& value, Visit visit, void* context);
+
+protected:
+    GcObject() = default;
+    GcObject(const GcObject&) = delete;
+    GcObject& operator=(const GcObject&) = delete;
+    virtual ~GcObject() { untrack(); }
+
+    void track();
+    void untrack();
+
+    // The tracked objects this one refers to directly
+    virtual void traverse(Visit visit, void* context) const = 0;
+    // Drops every reference this one holds, breaking the cycles through it
+    virtual void clearReferences() = 0;
+    // Owning references (shared_ptrs) to this object; 0 if it is not
+    // owned by one, which makes it a root
+    virtual long useCount() const = 0;
+    // An owning reference that keeps this object alive while it is cleared
+    virtual std::shared_ptr<void> retain() = 0;
+
+private:
+    friend class GcHeap;
+
+    std::atomic<GcHeap*> heap{nullptr};  // Null when untracked
+    GcNode* node = nullptr;
+    unsigned char generation = 0;
+    bool reachable = false;
+    long gcRefs = 0;
+};
+
+// A generational cycle collector in the style of CPython's: objects stay
+// reference counted, and a collection finds groups of tracked containers
+// that are referenced only by each other. For each object it subtracts
+// the references coming from other tracked objects from its use count;
+// whatever is left over is a reference from outside (a variable, the C++
+// stack, another thread), which makes the object a root. Objects that no
+// root reaches are cleared, and their reference counts then free them.
+//
+// New objects go in generation 0, and each generation's survivors move up
+// one. Generation 0 is collected once the number of new objects exceeds
+// the first threshold, at the next statement boundary; an older
+// generation is collected once the younger one has been collected as many
+// times as its own threshold. Each thread has its own heap and collects
+// only that, without locking; objects left when a thread exits are
+// collected with the oldest generation of whichever thread gets to them.
+class GarbageCollector {
+public:
+    static constexpr int generations = 3;
+
+    // Objects tracked on this thread since the last collection, less those
+    // freed. Read on every statement, so kept out of the heap.
+    static inline thread_local long youngObjects = 0;
+    static inline std::atomic<long> youngThreshold{700};
+
+    // Called by the interpreter between statements
+    static void collectIfDue() {
+        if (youngObjects > youngThreshold.load(std::memory_order_relaxed)) collectDue();
+    }
+
+    // Collects generations 0 through `generation` of this thread's heap
+    // (and, with the oldest, the orphaned objects of exited threads) and
+    // returns the number of unreachable objects freed
+    static size_t collect(int generation = generations - 1);
+
+    static std::array<long, generations> thresholds();
+    static void setThresholds(long young, long middle, long old);
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    // New objects, and collections of the two younger generations since
+    // the next older one was last collected, for this thread's heap
+    static std::array<long, generations> counts();
+
+    // Holds off collection, automatic or by collect(), on every thread
+    // while another thread may be walking this one's containers (see
+    // PyTask::run). collect() frees nothing meanwhile, so a pause should
+    // only last as long as such a copy.
+    class Pause {
+    public:
+        Pause();
+        ~Pause();
+        Pause(const Pause&) = delete;
+        Pause& operator=(const Pause&) = delete;
+    };
+
+    // The gc module: collect, enable, disable, isenabled, get_count,
+    // get_threshold, set_threshold
+    static std::shared_ptr<PyModule> module();
+
+private:
+    static void collectDue();
+};
+
+#endif // GC_HPP
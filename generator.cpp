@@ -0,0 +1,82 @@
+#include "generator.hpp"
+#include "interpreter.hpp"
+
+namespace {
+
+// Thrown from the suspended yield of a generator being closed. It is not a
+// RuntimeError, so nothing in the interpreter catches it on the way out.
+struct GeneratorExit {};
+
+}  // namespace
+
+PyGenerator::PyGenerator(Interpreter& interpreter, std::shared_ptr<PyFunction> function,
+                         std::shared_ptr<Environment> env)
+    : interpreter(&interpreter), function(std::move(function)), env(std::move(env)),
+      fiber([this] {
+          try {
+              this->interpreter->executeBlock(this->function->declaration->body(), this->env);
+          } catch (const ReturnException&) {
+              // `return` ends the generator; its value is discarded
+          } catch (const GeneratorExit&) {
+          }
+      }) {
+    interpreter.generators.insert(this);
+}
+
+PyGenerator::~PyGenerator() {
+    close();
+    if (interpreter) interpreter->generators.erase(this);
+}
+
+bool PyGenerator::next() {
+    if (!env) return false;
+    if (running) throw RuntimeError("generator already executing");
+
+    // The body keeps its own current environment across yields, so the
+    // caller's is moved aside rather than copied
+    Interpreter& interp = *interpreter;
+    std::shared_ptr<Environment> callerEnv = std::move(interp.currentEnv);
+    PyGenerator* callerGenerator = interp.activeGenerator;
+    interp.activeGenerator = this;
+    running = true;
+
+    try {
+        fiber.resume();
+    } catch (...) {
+        running = false;
+        interp.currentEnv = std::move(callerEnv);
+        interp.activeGenerator = callerGenerator;
+        finish();
+        throw;
+    }
+
+    running = false;
+    interp.currentEnv = std::move(callerEnv);
+    interp.activeGenerator = callerGenerator;
+    if (fiber.finished()) {
+        finish();
+        return false;
+    }
+    return true;
+}
+
+void PyGenerator::yield(PyValue result) {
+    value = std::move(result);
+    fiber.suspend();
+    if (closing) throw GeneratorExit();
+}
+
+void PyGenerator::close() {
+    if (!env || running) return;
+    if (!fiber.started()) {
+        finish();
+        return;
+    }
+    closing = true;
+    next();
+}
+
+void PyGenerator::finish() {
+    env = nullptr;
+    value = PyNone{};
+}
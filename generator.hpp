@@ -0,0 +1,58 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <memory>
+#include "environment.hpp"
+#include "fiber.hpp"
+#include "function.hpp"
+
+class Interpreter;
+
+// The object returned by calling a generator function (one whose body
+// contains `yield`). Its frame is a Fiber: the body runs on the fiber's
+// own stack with the interpreter's ordinary recursive evaluator, and a
+// yield suspends it there, deep inside any loops and ifs, until the next
+// next(). Nothing is copied out per element, so iterating costs two
+// context switches and no allocation.
+//
+// A generator that is dropped while suspended is closed: its stack is
+// unwound so that the values it holds are released. The Interpreter
+// closes its remaining generators when it is destroyed.
+class PyGenerator {
+public:
+    PyGenerator(Interpreter& interpreter, std::shared_ptr<PyFunction> function,
+                std::shared_ptr<Environment> env);
+    ~PyGenerator();
+
+    PyGenerator(const PyGenerator&) = delete;
+    PyGenerator& operator=(const PyGenerator&) = delete;
+
+    const std::string& name() const { return function->name; }
+
+    // Runs the body to its next yield and returns true, with the yielded
+    // value in current(); returns false once the body has finished. An
+    // exception from the body finishes the generator and propagates.
+    bool next();
+    const PyValue& current() const { return value; }
+
+    // Called by the body: hands `result` to next() and suspends
+    void yield(PyValue result);
+
+    // Unwinds a suspended body and finishes the generator
+    void close();
+
+private:
+    friend class Interpreter;
+
+    Interpreter* interpreter;  // Null once the Interpreter is destroyed
+    std::shared_ptr<PyFunction> function;
+    std::shared_ptr<Environment> env;  // Released when the body finishes
+    Fiber fiber;
+    PyValue value;
+    bool running = false;
+    bool closing = false;
+
+    void finish();
+};
+
+#endif // GENERATOR_HPP
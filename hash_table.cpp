@@ -0,0 +1,165 @@
+#include "hash_table.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int8_t emptyControl = -128;   // 0b10000000
+constexpr int8_t deletedControl = -2;   // 0b11111110
+// Full slots store the low 7 bits of the hash: 0b0xxxxxxx
+
+// The upper hash bits pick the starting group, the low 7 are stored in
+// the control byte
+inline size_t groupOf(uint64_t hash) { return static_cast<size_t>(hash >> 7); }
+inline int8_t controlOf(uint64_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+// Bit i is set if control byte i of the group equals `byte`
+inline uint32_t matchByte(const int8_t* group, int8_t byte) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(byte))));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; i++) {
+        if (group[i] == byte) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit i is set if slot i of the group is empty or deleted (sign bit set)
+inline uint32_t matchFree(const int8_t* group) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 16; i++) {
+        if (group[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+inline int lowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+
+}  // namespace
+
+size_t HashTable::findSlot(const PyValue& key, uint64_t hash) const {
+    if (control.empty()) return notFound;
+
+    size_t groupMask = control.size() / groupSize - 1;
+    size_t group = groupOf(hash) & groupMask;
+    int8_t tag = controlOf(hash);
+
+    // Triangular probing visits every group once when the group count is
+    // a power of two; a group with an empty slot ends the search
+    for (size_t step = 1;; step++) {
+        const int8_t* bytes = &control[group * groupSize];
+        for (uint32_t matches = matchByte(bytes, tag); matches; matches &= matches - 1) {
+            size_t slot = group * groupSize + lowestBit(matches);
+            const Entry& entry = items[slots[slot]];
+            if (entry.hash == hash && pyEquals(entry.key, key)) {
+                return slot;
+            }
+        }
+        if (matchByte(bytes, emptyControl)) {
+            return notFound;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+size_t HashTable::insertSlot(uint64_t hash) const {
+    size_t groupMask = control.size() / groupSize - 1;
+    size_t group = groupOf(hash) & groupMask;
+    for (size_t step = 1;; step++) {
+        uint32_t free = matchFree(&control[group * groupSize]);
+        if (free) {
+            return group * groupSize + lowestBit(free);
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+const HashTable::Entry* HashTable::find(const PyValue& key) const {
+    size_t slot = findSlot(key, pyHash(key));
+    return slot == notFound ? nullptr : &items[slots[slot]];
+}
+
+HashTable::Entry* HashTable::find(const PyValue& key) {
+    size_t slot = findSlot(key, pyHash(key));
+    return slot == notFound ? nullptr : &items[slots[slot]];
+}
+
+HashTable::Entry& HashTable::findOrInsert(const PyValue& key, bool* inserted) {
+    uint64_t hash = pyHash(key);
+    size_t slot = findSlot(key, hash);
+    if (inserted) *inserted = slot == notFound;
+    if (slot != notFound) {
+        return items[slots[slot]];
+    }
+
+    // Keep at most 7/8 of the slots in use (tombstones included)
+    if ((used + 1) * 8 > control.size() * 7) {
+        size_t capacity = groupSize;
+        while ((count + 1) * 16 > capacity * 7) capacity *= 2;  // Grow to <= 7/16 full
+        rebuild(capacity);
+    }
+
+    slot = insertSlot(hash);
+    if (control[slot] == emptyControl) used++;
+    control[slot] = controlOf(hash);
+    slots[slot] = static_cast<uint32_t>(items.size());
+    items.push_back(Entry{key, PyNone{}, hash, false});
+    count++;
+    return items.back();
+}
+
+bool HashTable::erase(const PyValue& key, PyValue* value) {
+    size_t slot = findSlot(key, pyHash(key));
+    if (slot == notFound) return false;
+
+    Entry& entry = items[slots[slot]];
+    if (value) *value = std::move(entry.value);
+    entry.key = PyNone{};
+    entry.value = PyNone{};
+    entry.erased = true;
+    control[slot] = deletedControl;
+    count--;
+
+    if (count == 0) {
+        clear();
+    }
+    return true;
+}
+
+void HashTable::clear() {
+    control.clear();
+    slots.clear();
+    items.clear();
+    count = 0;
+    used = 0;
+}
+
+void HashTable::rebuild(size_t capacity) {
+    // Drop erased entries, then re-index using the cached hashes
+    if (count != items.size()) {
+        std::vector<Entry> live;
+        live.reserve(count);
+        for (Entry& entry : items) {
+            if (!entry.erased) live.push_back(std::move(entry));
+        }
+        items = std::move(live);
+    }
+
+    control.assign(capacity, emptyControl);
+    slots.assign(capacity, 0);
+    for (size_t i = 0; i < items.size(); i++) {
+        size_t slot = insertSlot(items[i].hash);
+        control[slot] = controlOf(items[i].hash);
+        slots[slot] = static_cast<uint32_t>(i);
+    }
+    used = items.size();
+}
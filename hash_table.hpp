@@ -0,0 +1,64 @@
+#ifndef HASH_TABLE_HPP
+#define HASH_TABLE_HPP
+
+#include <cstdint>
+#include <vector>
+#include "value.hpp"
+
+// Insertion-ordered hash table behind dict and set, laid out like
+// CPython's compact dict with an open-addressing index in the style of
+// Abseil's Swiss tables:
+//
+//  - `items` holds the entries densely in insertion order, each with its
+//    hash cached, so iteration is a linear scan and growing the table
+//    never hashes a key again.
+//  - The index is an array of slots in groups of 16. Every slot has one
+//    control byte (empty, deleted, or the low 7 bits of the hash of the
+//    entry it points to), so a lookup compares a whole group of control
+//    bytes at once with SSE2 (or a scalar loop) and only touches entries
+//    whose 7 hash bits match.
+//
+// Erasing leaves a tombstone in both arrays; they are dropped the next
+// time the index is rebuilt.
+class HashTable {
+public:
+    struct Entry {
+        PyValue key;
+        PyValue value;  // PyNone for sets
+        uint64_t hash;
+        bool erased;
+    };
+
+    size_t size() const { return count; }
+
+    // Throws RuntimeError for unhashable keys
+    const Entry* find(const PyValue& key) const;
+    Entry* find(const PyValue& key);
+
+    // The entry for `key`, appended with a None value if absent
+    Entry& findOrInsert(const PyValue& key, bool* inserted = nullptr);
+
+    // Returns false if the key was not present
+    bool erase(const PyValue& key, PyValue* value = nullptr);
+    void clear();
+
+    // All entries in insertion order, including erased ones (skip those).
+    // Positions are stable until the next insertion.
+    const std::vector<Entry>& entries() const { return items; }
+
+private:
+    static constexpr size_t groupSize = 16;
+    static constexpr size_t notFound = static_cast<size_t>(-1);
+
+    std::vector<int8_t> control;
+    std::vector<uint32_t> slots;  // Index into `items` for each full slot
+    std::vector<Entry> items;
+    size_t count = 0;  // Live entries
+    size_t used = 0;   // Slots that are not empty (live or deleted)
+
+    size_t findSlot(const PyValue& key, uint64_t hash) const;
+    size_t insertSlot(uint64_t hash) const;
+    void rebuild(size_t capacity);
+};
+
+#endif // HASH_TABLE_HPP
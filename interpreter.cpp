@@ -1,64 +1,392 @@
 #include "interpreter.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <sstream>
+#include "array.hpp"
+#include "builtins.hpp"
+#include "copy.hpp"
+#include "coroutine.hpp"
+#include "dict.hpp"
+#include "event_loop.hpp"
+#include "function.hpp"
+#include "gc.hpp"
+#include "generator.hpp"
+#include "list.hpp"
+#include "object.hpp"
+#include "resolver.hpp"
+#include "task.hpp"
+#include "work_pool.hpp"
+
+namespace {
+
+// Arguments to a call are evaluated into a buffer on the caller's stack
+// unless there are more than this many
+constexpr size_t inlineArgumentCount = 4;
+
+void checkArity(const std::string& name, int minArity, int maxArity, size_t given, int line) {
+    int count = static_cast<int>(given);
+    if (count >= minArity && (maxArity < 0 || count <= maxArity)) {
+        return;
+    }
+
+    std::ostringstream oss;
+    oss << name << "() takes ";
+    if (minArity == maxArity) {
+        oss << minArity;
+    } else if (maxArity < 0) {
+        oss << "at least " << minArity;
+    } else {
+        oss << minArity << " to " << maxArity;
+    }
+    oss << (maxArity == 1 ? " argument (" : " arguments (") << count << " given)";
+    throw RuntimeError(oss.str(), line);
+}
+
+// Maps a Python index (negative counts from the end) into [0, size)
+size_t sequenceIndex(const PyValue& index, size_t size, const char* type, int line) {
+    long long position;
+    if (std::holds_alternative<long long>(index)) {
+        position = std::get<long long>(index);
+    } else if (std::holds_alternative<bool>(index)) {
+        position = std::get<bool>(index) ? 1 : 0;
+    } else {
+        throw RuntimeError(std::string(type) + " indices must be integers, not '" +
+                           pyTypeName(index) + "'", line);
+    }
+
+    long long length = static_cast<long long>(size);
+    if (position < 0) position += length;
+    if (position < 0 || position >= length) {
+        throw RuntimeError(std::string(type) + " index out of range", line);
+    }
+    return static_cast<size_t>(position);
+}
+
+// A method found on an instance's class, bound to the instance
+std::shared_ptr<PyFunction> bindMethod(const PyFunction& method,
+                                       const std::shared_ptr<PyInstance>& instance) {
+    auto bound = std::make_shared<PyFunction>(method.name, method.declaration);
+    bound->closure = method.closure;
+    bound->self = instance;
+    return bound;
+}
+
+// A function among a class's attributes, which instances call as a method
+bool isMethod(const PyValue& attribute) {
+    const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&attribute);
+    return function && *function && !(*function)->self;
+}
+
+RuntimeError noAttribute(const PyValue& object, const NameToken& name) {
+    return RuntimeError("'" + pyTypeName(object) + "' object has no attribute '" +
+                        name.lexeme + "'", name.line);
+}
+
+// pmap never starts more worker threads than this
+constexpr long long maxParallelWorkers = 256;
 
-Interpreter::Interpreter() {
+// An operator with an array on either side, applied elementwise
+PyValue arrayOperation(const OpToken& op, const PyValue& left, const PyValue& right) {
+    try {
+        switch (op.type) {
+            case TokenType::PLUS: return PyArray::arithmetic(ArrayOp::ADD, left, right);
+            case TokenType::MINUS: return PyArray::arithmetic(ArrayOp::SUB, left, right);
+            case TokenType::STAR: return PyArray::arithmetic(ArrayOp::MUL, left, right);
+            case TokenType::SLASH: return PyArray::arithmetic(ArrayOp::DIV, left, right);
+            case TokenType::LT: return PyArray::compare(ArrayCompare::LT, left, right);
+            case TokenType::LE: return PyArray::compare(ArrayCompare::LE, left, right);
+            case TokenType::GT: return PyArray::compare(ArrayCompare::GT, left, right);
+            case TokenType::GE: return PyArray::compare(ArrayCompare::GE, left, right);
+            case TokenType::EQ: return PyArray::compare(ArrayCompare::EQ, left, right);
+            case TokenType::NE: return PyArray::compare(ArrayCompare::NE, left, right);
+            default:
+                throw RuntimeError("Operator not supported for arrays");
+        }
+    } catch (RuntimeError& e) {
+        e.line = op.line;
+        throw;
+    }
+}
+
+}  // namespace
+
+Interpreter::Interpreter(std::ostream& out) : out(out) {
     globalEnv = std::make_shared<Environment>();
     currentEnv = globalEnv;
+
+    for (const auto& [name, value] : Builtins::all()) {
+        globalEnv->define(name, value);
+    }
+    defineContextNatives();
 }
 
-void Interpreter::interpret(std::vector<Stmt> statements) {
-    // Store statements to keep AST alive (for function bodies)
-    storedStatements.push_back(std::move(statements));
+Interpreter::~Interpreter() {
+    // Suspended generator bodies hold values on their fiber stacks and run
+    // on this interpreter, so they are unwound while it still exists. Each
+    // close may release, and so remove, other generators.
+    while (!generators.empty()) {
+        PyGenerator* generator = *generators.begin();
+        generator->close();
+        generator->interpreter = nullptr;
+        generators.erase(generator);
+    }
+}
+
+void Interpreter::run(const Program& program) {
+    // Function values point into the AST, so hold on to it
+    if (programs.empty() || programs.back() != program.body) {
+        programs.push_back(program.body);
+    }
 
-    // Execute from the stored copy
-    for (const auto& stmt : storedStatements.back()) {
+    for (const auto& stmt : *program.body) {
         execute(stmt);
     }
 }
 
+void Interpreter::interpret(Module module) {
+    run(Program(std::move(module)));
+}
+
+void Interpreter::setGlobal(const std::string& name, PyValue value) {
+    globalEnv->define(name, std::move(value));
+}
+
+PyValue Interpreter::getGlobal(const std::string& name) const {
+    return globalEnv->get(name);
+}
+
+bool Interpreter::hasGlobal(const std::string& name) const {
+    return globalEnv->contains(name);
+}
+
+void Interpreter::defineNative(const std::string& name, int minArity, int maxArity,
+                               NativeFn fn) {
+    globalEnv->define(name, Builtins::makeNative(name, minArity, maxArity, std::move(fn)));
+}
+
+void Interpreter::defineContextNatives() {
+    defineNative("pmap", 2, 3, [this](ArgSpan args) { return parallelMap(args); });
+    defineNative("spawn", 1, -1, [this](ArgSpan args) -> PyValue {
+        return PyTask::spawn(*this, args);
+    });
+    defineNative("join", 1, 1, [this](ArgSpan args) {
+        const auto* task = std::get_if<std::shared_ptr<PyTask>>(&args[0]);
+        if (!task) {
+            throw RuntimeError("join() argument must be a task, not '" +
+                               pyTypeName(args[0]) + "'");
+        }
+        return (*task)->join(*this);
+    });
+}
+
+// pmap(f, iterable, workers): calls f on every item on a pool of threads
+// and returns the results in order. Each thread runs on an Interpreter
+// whose globals are a deep copy of those of this one's that f can reach,
+// and each call gets a deep copy of its item, so whatever f changes stays
+// on its thread (classes, which are shared, cannot be assigned to). An
+// Interpreter is kept for later pmaps while neither these globals nor its
+// copies of them have changed. print output is buffered per thread and
+// written after the last call finishes. If calls fail, the error from the
+// earliest item is raised.
+PyValue Interpreter::parallelMap(ArgSpan args) {
+    const PyValue& function = args[0];
+    if (std::holds_alternative<std::shared_ptr<PyFunction>>(function)) {
+        const auto& declaration = std::get<std::shared_ptr<PyFunction>>(function)->declaration;
+        if (declaration->isGenerator || declaration->isAsync) {
+            throw RuntimeError("pmap() function must not be a generator or async");
+        }
+    } else if (!std::holds_alternative<std::shared_ptr<NativeFunction>>(function)) {
+        throw RuntimeError("'" + pyTypeName(function) + "' object is not callable");
+    }
+
+    // Errors in the workers report the line of the pmap call
+    OpToken paren = nativeCall ? *nativeCall : OpToken(TokenType::RPAREN, 0, 0);
+
+    std::vector<PyValue> items;
+    forEachElement(args[1], [&](const PyValue& item) { items.push_back(item); });
+    if (items.empty()) {
+        return std::make_shared<PyList>();
+    }
+
+    long long requested = WorkPool::defaultSize();
+    if (args.size() == 3) {
+        if (!std::holds_alternative<long long>(args[2])) {
+            throw RuntimeError("pmap() workers must be an int, not '" +
+                               pyTypeName(args[2]) + "'");
+        }
+        requested = std::get<long long>(args[2]);
+        if (requested < 1) {
+            throw RuntimeError("pmap() workers must be at least 1");
+        }
+    }
+    unsigned workers = static_cast<unsigned>(std::min(
+        {requested, maxParallelWorkers, static_cast<long long>(items.size())}));
+
+    // Each worker has its own copies of the globals f and the items can
+    // reach, taken from a snapshot that is only retaken once they change,
+    // and of the function's closure, so whatever one changes no other
+    // thread can reach. A worker's Interpreter is kept for the next call
+    // only if its globals are still as copied.
+    std::vector<std::string> roots;
+    referencedGlobals(function, roots);
+    for (const PyValue& item : items) {
+        referencedGlobals(item, roots);
+    }
+    if (!pmapGlobals || !pmapGlobals->matches(*globalEnv, roots)) {
+        pmapGlobals = std::make_shared<const GlobalsSnapshot>(
+            *globalEnv, roots, pmapGlobals.get(), false);
+        pmapContexts.clear();
+    }
+    pmapContexts.resize(std::max<size_t>(pmapContexts.size(), workers));
+    pmapOutputs.resize(pmapContexts.size());
+    std::vector<PyValue> callees;
+    for (unsigned i = 0; i < workers; i++) {
+        if (!pmapContexts[i]) {
+            pmapOutputs[i] = std::make_unique<std::ostringstream>();
+            pmapContexts[i] = std::make_unique<Interpreter>(*pmapOutputs[i]);
+            pmapGlobals->copyInto(*pmapContexts[i]->globalEnv);
+            pmapContexts[i]->defineContextNatives();  // The snapshot's pmap is bound to this
+        }
+        pmapContexts[i]->programs = programs;
+        try {
+            CopyMemo memo;
+            callees.push_back(copyValue(function, memo));
+        } catch (RuntimeError& e) {
+            e.line = paren.line;
+            throw;
+        }
+    }
+
+    // Items go out in chunks, several per worker, so a worker that finishes
+    // early can steal the rest of a slow one's share
+    size_t chunk = std::max<size_t>(1, items.size() / (workers * 8));
+    std::vector<PyValue> results(items.size());
+    std::vector<std::exception_ptr> errors(items.size());
+    std::atomic<size_t> firstFailure{items.size()};
+    {
+        WorkPool pool(workers);
+        for (size_t begin = 0; begin < items.size(); begin += chunk) {
+            size_t end = std::min(items.size(), begin + chunk);
+            pool.submit([&, begin, end](unsigned worker) {
+                Interpreter& context = *pmapContexts[worker];
+                for (size_t i = begin; i < end && i < firstFailure.load(); i++) {
+                    try {
+                        PyValue item;
+                        try {
+                            // The items are on the caller's heap
+                            GarbageCollector::Pause pauseCollection;
+                            CopyMemo memo;
+                            item = copyValue(items[i], memo);
+                        } catch (RuntimeError& e) {
+                            e.line = paren.line;
+                            throw;
+                        }
+                        results[i] = context.callValue(callees[worker], ArgSpan(&item, 1), paren);
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                        size_t failed = firstFailure.load();
+                        while (i < failed && !firstFailure.compare_exchange_weak(failed, i)) {
+                        }
+                        return;
+                    }
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    for (unsigned i = 0; i < workers; i++) {
+        out << pmapOutputs[i]->str();
+        pmapOutputs[i]->str("");
+        if (!pmapGlobals->matches(*pmapContexts[i]->globalEnv, roots)) {
+            pmapContexts[i].reset();  // f changed its globals
+        }
+    }
+    if (firstFailure.load() < items.size()) {
+        std::rethrow_exception(errors[firstFailure.load()]);
+    }
+    return std::make_shared<PyList>(std::move(results));
+}
+
+void Interpreter::setPreemption(unsigned budget, std::function<void()> hook) {
+    preemptBudget = hook ? budget : 0;
+    preemptCountdown = preemptBudget;
+    preemptHook = std::move(hook);
+}
+
 PyValue Interpreter::evaluate(const Expr& expr) {
     return std::visit([this](auto&& arg) -> PyValue {
         using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::unique_ptr<BinaryExpr>>) {
+        if constexpr (std::is_same_v<T, NodePtr<BinaryExpr>>) {
             return visitBinaryExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<UnaryExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<UnaryExpr>>) {
             return visitUnaryExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<LiteralExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<LiteralExpr>>) {
             return visitLiteralExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<VariableExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<VariableExpr>>) {
             return visitVariableExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<AssignExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<AssignExpr>>) {
             return visitAssignExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<CallExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<CallExpr>>) {
             return visitCallExpr(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<GroupingExpr>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<GroupingExpr>>) {
             return visitGroupingExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<GetExpr>>) {
+            return visitGetExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<ListExpr>>) {
+            return visitListExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<IndexExpr>>) {
+            return visitIndexExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<SliceExpr>>) {
+            return visitSliceExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<IndexAssignExpr>>) {
+            return visitIndexAssignExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<DictExpr>>) {
+            return visitDictExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<SetExpr>>) {
+            return visitSetExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<AwaitExpr>>) {
+            return visitAwaitExpr(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<AttributeAssignExpr>>) {
+            return visitAttributeAssignExpr(*arg);
         }
     }, expr);
 }
 
 void Interpreter::execute(const Stmt& stmt) {
+    if (preemptCountdown != 0 && --preemptCountdown == 0) {
+        preemptCountdown = preemptBudget;
+        preemptHook();
+    }
+    GarbageCollector::collectIfDue();
+
     std::visit([this](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, std::unique_ptr<ExpressionStmt>>) {
+        if constexpr (std::is_same_v<T, NodePtr<ExpressionStmt>>) {
             visitExpressionStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<PrintStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<PrintStmt>>) {
             visitPrintStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<VarStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<VarStmt>>) {
             visitVarStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<BlockStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<BlockStmt>>) {
             visitBlockStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<IfStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<IfStmt>>) {
             visitIfStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<WhileStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<WhileStmt>>) {
             visitWhileStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<FunctionStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<ForStmt>>) {
+            visitForStmt(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<FunctionStmt>>) {
             visitFunctionStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<ReturnStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<ReturnStmt>>) {
             visitReturnStmt(*arg);
-        } else if constexpr (std::is_same_v<T, std::unique_ptr<AssertStmt>>) {
+        } else if constexpr (std::is_same_v<T, NodePtr<AssertStmt>>) {
             visitAssertStmt(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<YieldStmt>>) {
+            visitYieldStmt(*arg);
+        } else if constexpr (std::is_same_v<T, NodePtr<ClassStmt>>) {
+            visitClassStmt(*arg);
         }
     }, stmt);
 }
@@ -68,8 +396,18 @@ void Interpreter::execute(const Stmt& stmt) {
 PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
     PyValue left = evaluate(expr.left);
     PyValue right = evaluate(expr.right);
+    return binaryOperation(expr.op, left, right);
+}
 
-    switch (expr.op.type) {
+PyValue Interpreter::binaryOperation(const OpToken& op, const PyValue& left,
+                                     const PyValue& right) {
+    if ((std::holds_alternative<std::shared_ptr<PyArray>>(left) ||
+         std::holds_alternative<std::shared_ptr<PyArray>>(right)) &&
+        op.type != TokenType::IN && op.type != TokenType::AND && op.type != TokenType::OR) {
+        return arrayOperation(op, left, right);
+    }
+
+    switch (op.type) {
         case TokenType::PLUS: {
             // Handle string concatenation
             if (std::holds_alternative<std::string>(left) &&
@@ -77,6 +415,13 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 return std::get<std::string>(left) + std::get<std::string>(right);
             }
 
+            // List concatenation
+            if (std::holds_alternative<std::shared_ptr<PyList>>(left) &&
+                std::holds_alternative<std::shared_ptr<PyList>>(right)) {
+                return std::get<std::shared_ptr<PyList>>(left)->concat(
+                    *std::get<std::shared_ptr<PyList>>(right));
+            }
+
             // Numeric addition
             if (std::holds_alternative<double>(left) ||
                 std::holds_alternative<double>(right)) {
@@ -94,7 +439,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 return std::get<long long>(left) + std::get<long long>(right);
             }
 
-            throw RuntimeError("Operands must be numbers or strings", expr.op.line);
+            throw RuntimeError("Operands must be numbers or strings", op.line);
         }
 
         case TokenType::MINUS: {
@@ -114,10 +459,20 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 return std::get<long long>(left) - std::get<long long>(right);
             }
 
-            throw RuntimeError("Operands must be numbers", expr.op.line);
+            throw RuntimeError("Operands must be numbers", op.line);
         }
 
         case TokenType::STAR: {
+            // List repetition
+            if (std::holds_alternative<std::shared_ptr<PyList>>(left) &&
+                std::holds_alternative<long long>(right)) {
+                return std::get<std::shared_ptr<PyList>>(left)->repeat(std::get<long long>(right));
+            }
+            if (std::holds_alternative<long long>(left) &&
+                std::holds_alternative<std::shared_ptr<PyList>>(right)) {
+                return std::get<std::shared_ptr<PyList>>(right)->repeat(std::get<long long>(left));
+            }
+
             // Handle string repetition
             if (std::holds_alternative<std::string>(left) &&
                 std::holds_alternative<long long>(right)) {
@@ -145,7 +500,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 return std::get<long long>(left) * std::get<long long>(right);
             }
 
-            throw RuntimeError("Operands must be numbers", expr.op.line);
+            throw RuntimeError("Operands must be numbers", op.line);
         }
 
         case TokenType::SLASH: {
@@ -157,7 +512,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 : static_cast<double>(std::get<long long>(right));
 
             if (r == 0.0) {
-                throw RuntimeError("Division by zero", expr.op.line);
+                throw RuntimeError("Division by zero", op.line);
             }
 
             return l / r;
@@ -172,7 +527,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 : static_cast<double>(std::get<long long>(right));
 
             if (r == 0.0) {
-                throw RuntimeError("Division by zero", expr.op.line);
+                throw RuntimeError("Division by zero", op.line);
             }
 
             double result = std::floor(l / r);
@@ -191,7 +546,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 std::holds_alternative<long long>(right)) {
                 long long r = std::get<long long>(right);
                 if (r == 0) {
-                    throw RuntimeError("Modulo by zero", expr.op.line);
+                    throw RuntimeError("Modulo by zero", op.line);
                 }
                 return std::get<long long>(left) % r;
             }
@@ -204,7 +559,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
                 : static_cast<double>(std::get<long long>(right));
 
             if (r == 0.0) {
-                throw RuntimeError("Modulo by zero", expr.op.line);
+                throw RuntimeError("Modulo by zero", op.line);
             }
 
             return std::fmod(l, r);
@@ -231,65 +586,19 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
             return result;
         }
 
-        case TokenType::EQ: {
-            // Handle equality comparison
-            if (std::holds_alternative<PyNone>(left) && std::holds_alternative<PyNone>(right)) {
-                return true;
-            }
-            if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right)) {
-                return std::get<bool>(left) == std::get<bool>(right);
-            }
-            if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
-                return std::get<std::string>(left) == std::get<std::string>(right);
-            }
-            if (std::holds_alternative<std::shared_ptr<PyFunction>>(left) &&
-                std::holds_alternative<std::shared_ptr<PyFunction>>(right)) {
-                return std::get<std::shared_ptr<PyFunction>>(left).get() ==
-                       std::get<std::shared_ptr<PyFunction>>(right).get();
-            }
-            // Numeric comparison
-            if ((std::holds_alternative<long long>(left) || std::holds_alternative<double>(left)) &&
-                (std::holds_alternative<long long>(right) || std::holds_alternative<double>(right))) {
-                double l = std::holds_alternative<double>(left)
-                    ? std::get<double>(left)
-                    : static_cast<double>(std::get<long long>(left));
-                double r = std::holds_alternative<double>(right)
-                    ? std::get<double>(right)
-                    : static_cast<double>(std::get<long long>(right));
-                return l == r;
-            }
-            return false;
-        }
+        case TokenType::EQ:
+            return pyEquals(left, right);
 
-        case TokenType::NE: {
-            // Handle inequality - just negate equality
-            if (std::holds_alternative<PyNone>(left) && std::holds_alternative<PyNone>(right)) {
-                return false;
-            }
-            if (std::holds_alternative<bool>(left) && std::holds_alternative<bool>(right)) {
-                return std::get<bool>(left) != std::get<bool>(right);
-            }
-            if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
-                return std::get<std::string>(left) != std::get<std::string>(right);
-            }
-            if (std::holds_alternative<std::shared_ptr<PyFunction>>(left) &&
-                std::holds_alternative<std::shared_ptr<PyFunction>>(right)) {
-                return std::get<std::shared_ptr<PyFunction>>(left).get() !=
-                       std::get<std::shared_ptr<PyFunction>>(right).get();
-            }
-            // Numeric comparison
-            if ((std::holds_alternative<long long>(left) || std::holds_alternative<double>(left)) &&
-                (std::holds_alternative<long long>(right) || std::holds_alternative<double>(right))) {
-                double l = std::holds_alternative<double>(left)
-                    ? std::get<double>(left)
-                    : static_cast<double>(std::get<long long>(left));
-                double r = std::holds_alternative<double>(right)
-                    ? std::get<double>(right)
-                    : static_cast<double>(std::get<long long>(right));
-                return l != r;
+        case TokenType::NE:
+            return !pyEquals(left, right);
+
+        case TokenType::IN:
+            try {
+                return pyContains(right, left);
+            } catch (RuntimeError& e) {
+                e.line = op.line;
+                throw;
             }
-            return true;  // Different types are not equal
-        }
 
         case TokenType::LT:
         case TokenType::LE:
@@ -302,7 +611,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
             } else if (std::holds_alternative<double>(left)) {
                 l = std::get<double>(left);
             } else {
-                throw RuntimeError("Operands must be numbers", expr.op.line);
+                throw RuntimeError("Operands must be numbers", op.line);
             }
 
             if (std::holds_alternative<long long>(right)) {
@@ -310,10 +619,10 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
             } else if (std::holds_alternative<double>(right)) {
                 r = std::get<double>(right);
             } else {
-                throw RuntimeError("Operands must be numbers", expr.op.line);
+                throw RuntimeError("Operands must be numbers", op.line);
             }
 
-            switch (expr.op.type) {
+            switch (op.type) {
                 case TokenType::LT: return l < r;
                 case TokenType::LE: return l <= r;
                 case TokenType::GT: return l > r;
@@ -329,7 +638,7 @@ PyValue Interpreter::visitBinaryExpr(const BinaryExpr& expr) {
             return isTruthy(left) ? left : right;
 
         default:
-            throw RuntimeError("Unknown binary operator", expr.op.line);
+            throw RuntimeError("Unknown binary operator", op.line);
     }
 }
 
@@ -359,35 +668,348 @@ PyValue Interpreter::visitLiteralExpr(const LiteralExpr& expr) {
 }
 
 PyValue Interpreter::visitVariableExpr(const VariableExpr& expr) {
-    return currentEnv->get(expr.name.lexeme);
+    const PyValue* value;
+    switch (expr.slot.kind) {
+        case VariableSlot::Kind::LOCAL:
+            value = &currentEnv->locals[expr.slot.index];
+            if (isUnbound(*value)) {
+                throw RuntimeError("local variable '" + expr.name.lexeme +
+                                   "' referenced before assignment", expr.name.line);
+            }
+            return *value;
+        case VariableSlot::Kind::CELL:
+            value = &currentEnv->cells[expr.slot.index]->value;
+            break;
+        case VariableSlot::Kind::FREE:
+            value = &currentEnv->function->closure[expr.slot.index]->value;
+            break;
+        default:
+            return globalEnv->get(expr.name.lexeme);
+    }
+    if (isUnbound(*value)) {
+        throw RuntimeError("free variable '" + expr.name.lexeme +
+                           "' referenced before assignment in enclosing scope", expr.name.line);
+    }
+    return *value;
 }
 
 PyValue Interpreter::visitAssignExpr(const AssignExpr& expr) {
     PyValue value = evaluate(expr.value);
-    currentEnv->assign(expr.name.lexeme, value);
+    variable(expr.slot, expr.name.lexeme) = value;
     return value;
 }
 
 PyValue Interpreter::visitCallExpr(const CallExpr& expr) {
-    PyValue callee = evaluate(expr.callee);
-
-    std::vector<PyValue> arguments;
-    for (const auto& arg : expr.arguments) {
-        arguments.push_back(evaluate(arg));
+    // object.method(...) on a builtin type or an instance calls the method
+    // directly rather than creating a bound method first; an instance goes
+    // first in the arguments, as self
+    PyValue callee;
+    const NativeMethod* method = nullptr;
+    std::shared_ptr<PyInstance> receiver;
+    if (std::holds_alternative<NodePtr<GetExpr>>(expr.callee)) {
+        const GetExpr& get = *std::get<NodePtr<GetExpr>>(expr.callee);
+        callee = evaluate(get.object);
+        if (auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&callee)) {
+            receiver = std::move(*instance);
+            bool unbound = false;
+            callee = instanceAttribute(receiver, get, &unbound);
+            if (!unbound) receiver.reset();  // Not a method: called as is
+        } else {
+            method = findMethod(callee, get.name.lexeme);
+            if (!method) {
+                callee = getAttribute(callee, get.name);
+            }
+        }
+    } else {
+        callee = evaluate(expr.callee);
     }
 
-    if (!std::holds_alternative<std::shared_ptr<PyFunction>>(callee)) {
-        throw RuntimeError("Can only call functions", expr.paren.line);
+    size_t first = receiver ? 1 : 0;
+    size_t count = first + expr.arguments.size();
+    PyValue inlineArguments[inlineArgumentCount];
+    std::vector<PyValue> heapArguments;
+    PyValue* arguments = inlineArguments;
+    if (count > inlineArgumentCount) {
+        heapArguments.resize(count);
+        arguments = heapArguments.data();
+    }
+    if (receiver) arguments[0] = std::move(receiver);
+    for (size_t i = first; i < count; i++) {
+        arguments[i] = evaluate(expr.arguments[i - first]);
     }
 
-    auto function = std::get<std::shared_ptr<PyFunction>>(callee);
-    return callFunction(function, arguments, expr.paren);
+    if (method) {
+        return callMethod(*method, callee, ArgSpan(arguments, count), expr.paren);
+    }
+    return callValue(callee, ArgSpan(arguments, count), expr.paren);
 }
 
 PyValue Interpreter::visitGroupingExpr(const GroupingExpr& expr) {
     return evaluate(expr.expression);
 }
 
+PyValue Interpreter::visitGetExpr(const GetExpr& expr) {
+    PyValue object = evaluate(expr.object);
+    if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&object)) {
+        return instanceAttribute(*instance, expr, nullptr);
+    }
+    return getAttribute(object, expr.name);
+}
+
+PyValue Interpreter::instanceAttribute(const std::shared_ptr<PyInstance>& instance,
+                                       const GetExpr& expr, bool* unboundMethod) {
+    AttributeSlot slot;
+    if (!instance->lookup(expr.name.lexeme, expr.cache, slot)) {
+        throw noAttribute(instance, expr.name);
+    }
+    const PyValue& value = instance->get(slot);
+    if (!slot.inClass || !isMethod(value)) return value;
+    if (unboundMethod) {
+        *unboundMethod = true;
+        return value;
+    }
+    return bindMethod(*std::get<std::shared_ptr<PyFunction>>(value), instance);
+}
+
+PyValue Interpreter::visitListExpr(const ListExpr& expr) {
+    auto list = std::make_shared<PyList>();
+    list->reserve(expr.elements.size());
+    for (const auto& element : expr.elements) {
+        list->append(evaluate(element));
+    }
+    return list;
+}
+
+PyValue Interpreter::visitIndexExpr(const IndexExpr& expr) {
+    PyValue object = evaluate(expr.object);
+    PyValue index = evaluate(expr.index);
+
+    if (std::holds_alternative<std::shared_ptr<PyList>>(object)) {
+        const auto& list = std::get<std::shared_ptr<PyList>>(object);
+        return list->get(sequenceIndex(index, list->size(), "list", expr.bracket.line));
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(object)) {
+        const auto& array = std::get<std::shared_ptr<PyArray>>(object);
+        return array->get(sequenceIndex(index, array->size(), "array", expr.bracket.line));
+    }
+    if (std::holds_alternative<std::string>(object)) {
+        const std::string& text = std::get<std::string>(object);
+        return std::string(1, text[sequenceIndex(index, text.size(), "string", expr.bracket.line)]);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(object)) {
+        const HashTable::Entry* entry;
+        try {
+            entry = std::get<std::shared_ptr<PyDict>>(object)->table.find(index);
+        } catch (RuntimeError& e) {
+            e.line = expr.bracket.line;
+            throw;
+        }
+        if (!entry) throw RuntimeError("KeyError: " + pyRepr(index), expr.bracket.line);
+        return entry->value;
+    }
+    throw RuntimeError("'" + pyTypeName(object) + "' object is not subscriptable",
+                       expr.bracket.line);
+}
+
+PyValue Interpreter::visitSliceExpr(const SliceExpr& expr) {
+    PyValue object = evaluate(expr.object);
+    PyValue lower = expr.lower ? evaluate(*expr.lower) : PyNone{};
+    PyValue upper = expr.upper ? evaluate(*expr.upper) : PyNone{};
+    PyValue step = expr.step ? evaluate(*expr.step) : PyNone{};
+
+    size_t size;
+    if (std::holds_alternative<std::shared_ptr<PyList>>(object)) {
+        size = std::get<std::shared_ptr<PyList>>(object)->size();
+    } else if (std::holds_alternative<std::shared_ptr<PyArray>>(object)) {
+        size = std::get<std::shared_ptr<PyArray>>(object)->size();
+    } else if (std::holds_alternative<std::string>(object)) {
+        size = std::get<std::string>(object).size();
+    } else {
+        throw RuntimeError("'" + pyTypeName(object) + "' object is not subscriptable",
+                           expr.bracket.line);
+    }
+
+    SliceBounds bounds;
+    try {
+        bounds = resolveSlice(size, lower, upper, step);
+    } catch (RuntimeError& e) {
+        e.line = expr.bracket.line;
+        throw;
+    }
+
+    if (std::holds_alternative<std::shared_ptr<PyList>>(object)) {
+        return std::get<std::shared_ptr<PyList>>(object)->slice(bounds);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(object)) {
+        return std::get<std::shared_ptr<PyArray>>(object)->slice(bounds);
+    }
+    const std::string& text = std::get<std::string>(object);
+    if (bounds.step == 1) {
+        return text.substr(static_cast<size_t>(bounds.start), bounds.count);
+    }
+    std::string result;
+    result.reserve(bounds.count);
+    long long index = bounds.start;
+    for (size_t i = 0; i < bounds.count; i++, index += bounds.step) {
+        result += text[static_cast<size_t>(index)];
+    }
+    return result;
+}
+
+PyValue Interpreter::visitIndexAssignExpr(const IndexAssignExpr& expr) {
+    PyValue object = evaluate(expr.object);
+    PyValue index = evaluate(expr.index);
+
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(object)) {
+        return assignDictItem(*std::get<std::shared_ptr<PyDict>>(object), index, expr);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(object)) {
+        return assignArrayItem(*std::get<std::shared_ptr<PyArray>>(object), index, expr);
+    }
+    if (!std::holds_alternative<std::shared_ptr<PyList>>(object)) {
+        throw RuntimeError("'" + pyTypeName(object) + "' object does not support item assignment",
+                           expr.bracket.line);
+    }
+    const auto& list = std::get<std::shared_ptr<PyList>>(object);
+    // The value may resize the list, so the index is checked after it
+    PyValue value = evaluate(expr.value);
+    size_t position = sequenceIndex(index, list->size(), "list", expr.bracket.line);
+    if (expr.op.type != TokenType::ASSIGN) {
+        value = binaryOperation(expr.op, list->get(position), value);
+    }
+    list->set(position, value);
+    return value;
+}
+
+PyValue Interpreter::visitAttributeAssignExpr(const AttributeAssignExpr& expr) {
+    PyValue object = evaluate(expr.object);
+
+    if (const auto* instance = std::get_if<std::shared_ptr<PyInstance>>(&object)) {
+        PyValue value = evaluate(expr.value);
+        if (expr.op.type != TokenType::ASSIGN) {
+            // Compound assignment reads the attribute first, which may be
+            // the class's; the result goes on the instance
+            AttributeSlot slot;
+            if (!(*instance)->lookup(expr.name.lexeme, expr.cache, slot)) {
+                throw noAttribute(object, expr.name);
+            }
+            value = binaryOperation(expr.op, (*instance)->get(slot), value);
+        }
+        (*instance)->set(expr.name.lexeme, value, expr.cache);
+        return value;
+    }
+    if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&object)) {
+        if ((*cls)->definer() != this) {
+            throw RuntimeError("cannot set attribute '" + expr.name.lexeme + "' of class '" +
+                               (*cls)->name + "' here: other threads share the class",
+                               expr.name.line);
+        }
+        PyValue value = evaluate(expr.value);
+        if (expr.op.type != TokenType::ASSIGN) {
+            uint32_t slot = (*cls)->attributeSlot(expr.name.lexeme);
+            if (slot == Shape::notFound) {
+                throw RuntimeError("type object '" + (*cls)->name + "' has no attribute '" +
+                                   expr.name.lexeme + "'", expr.name.line);
+            }
+            value = binaryOperation(expr.op, (*cls)->attributeAt(slot), value);
+        }
+        (*cls)->setAttribute(expr.name.lexeme, value);
+        return value;
+    }
+    throw noAttribute(object, expr.name);
+}
+
+PyValue Interpreter::assignDictItem(PyDict& dict, const PyValue& key,
+                                    const IndexAssignExpr& expr) {
+    PyValue value = evaluate(expr.value);
+    HashTable::Entry* entry;
+    try {
+        if (expr.op.type == TokenType::ASSIGN) {
+            entry = &dict.table.findOrInsert(key);
+        } else {
+            entry = dict.table.find(key);
+        }
+    } catch (RuntimeError& e) {
+        e.line = expr.bracket.line;
+        throw;
+    }
+
+    if (expr.op.type != TokenType::ASSIGN) {
+        // Compound assignment reads the existing value first
+        if (!entry) throw RuntimeError("KeyError: " + pyRepr(key), expr.bracket.line);
+        value = binaryOperation(expr.op, entry->value, value);
+        // binaryOperation cannot touch the dict, so the entry is still valid
+    }
+    entry->value = value;
+    return value;
+}
+
+PyValue Interpreter::assignArrayItem(PyArray& array, const PyValue& index,
+                                     const IndexAssignExpr& expr) {
+    PyValue value = evaluate(expr.value);
+    size_t position = sequenceIndex(index, array.size(), "array", expr.bracket.line);
+    if (expr.op.type != TokenType::ASSIGN) {
+        value = binaryOperation(expr.op, array.get(position), value);
+    }
+    try {
+        array.set(position, value);
+    } catch (RuntimeError& e) {
+        e.line = expr.bracket.line;
+        throw;
+    }
+    return value;
+}
+
+PyValue Interpreter::visitDictExpr(const DictExpr& expr) {
+    auto dict = std::make_shared<PyDict>();
+    for (size_t i = 0; i < expr.keys.size(); i++) {
+        PyValue key = evaluate(expr.keys[i]);
+        PyValue value = evaluate(expr.values[i]);
+        try {
+            dict->table.findOrInsert(key).value = std::move(value);
+        } catch (RuntimeError& e) {
+            e.line = expr.brace.line;
+            throw;
+        }
+    }
+    return dict;
+}
+
+PyValue Interpreter::visitSetExpr(const SetExpr& expr) {
+    auto set = std::make_shared<PySet>();
+    for (const auto& element : expr.elements) {
+        PyValue value = evaluate(element);
+        try {
+            set->table.findOrInsert(value);
+        } catch (RuntimeError& e) {
+            e.line = expr.brace.line;
+            throw;
+        }
+    }
+    return set;
+}
+
+PyValue Interpreter::visitAwaitExpr(const AwaitExpr& expr) {
+    PyValue operand = evaluate(expr.operand);
+
+    // The parser only accepts await inside an async def, whose body only
+    // runs as a task of a loop. The task may suspend here, so its
+    // environment is set aside as across a yield.
+    std::shared_ptr<Environment> env = std::move(currentEnv);
+    try {
+        PyValue result = eventLoop->await(operand);
+        currentEnv = std::move(env);
+        return result;
+    } catch (RuntimeError& e) {
+        currentEnv = std::move(env);
+        if (e.line == 0) e.line = expr.keyword.line;
+        throw;
+    } catch (...) {
+        currentEnv = std::move(env);
+        throw;
+    }
+}
+
 // Statement visitors
 
 void Interpreter::visitExpressionStmt(const ExpressionStmt& stmt) {
@@ -398,24 +1020,24 @@ void Interpreter::visitExpressionStmt(const ExpressionStmt& stmt) {
 void Interpreter::visitPrintStmt(const PrintStmt& stmt) {
     bool first = true;
     for (const auto& expr : stmt.expressions) {
-        if (!first) std::cout << " ";
+        if (!first) out << " ";
         first = false;
 
         PyValue value = evaluate(expr);
-        std::cout << pyValueToString(value);
+        out << pyValueToString(value);
     }
-    std::cout << std::endl;
+    out << std::endl;
     lastValueSet = false;
 }
 
 void Interpreter::visitVarStmt(const VarStmt& stmt) {
     PyValue value = evaluate(stmt.initializer);
-    currentEnv->define(stmt.name.lexeme, value);
+    variable(stmt.slot, stmt.name.lexeme) = std::move(value);
     lastValueSet = false;
 }
 
 void Interpreter::visitBlockStmt(const BlockStmt& stmt) {
-    executeBlock(stmt.statements, std::make_shared<Environment>(currentEnv));
+    executeStatements(stmt.statements);
 }
 
 void Interpreter::visitIfStmt(const IfStmt& stmt) {
@@ -443,20 +1065,108 @@ void Interpreter::visitWhileStmt(const WhileStmt& stmt) {
     }
 }
 
+void Interpreter::visitForStmt(const ForStmt& stmt) {
+    PyValue iterable = evaluate(stmt.iterable);
+    const auto& body = std::get<NodePtr<BlockStmt>>(stmt.body)->statements;
+
+    // The loop variable is resolved once and updated in place
+    PyValue& variable = this->variable(stmt.slot, stmt.variable.lexeme);
+
+    if (std::holds_alternative<PyRange>(iterable)) {
+        // Native counted loop: no range elements are materialized. It steps
+        // unsigned, since the step past the last element can overflow.
+        const PyRange range = std::get<PyRange>(iterable);
+        auto value = static_cast<unsigned long long>(range.start);
+        for (long long remaining = range.length(); remaining > 0; remaining--) {
+            variable = static_cast<long long>(value);
+            executeStatements(body);
+            value += static_cast<unsigned long long>(range.step);
+        }
+    } else if (std::holds_alternative<std::shared_ptr<PyList>>(iterable)) {
+        // By index, like Python, so the body may append to the list
+        auto list = std::get<std::shared_ptr<PyList>>(iterable);
+        for (size_t i = 0; i < list->size(); i++) {
+            variable = list->get(i);
+            executeStatements(body);
+        }
+    } else if (std::holds_alternative<std::shared_ptr<PyDict>>(iterable) ||
+               std::holds_alternative<std::shared_ptr<PySet>>(iterable)) {
+        // Walk the entries by position, holding a reference to the container;
+        // like CPython, adding or removing keys in the body is an error
+        auto owner = iterable;
+        const HashTable& table = std::holds_alternative<std::shared_ptr<PyDict>>(owner)
+            ? std::get<std::shared_ptr<PyDict>>(owner)->table
+            : std::get<std::shared_ptr<PySet>>(owner)->table;
+        const char* kind = std::holds_alternative<std::shared_ptr<PyDict>>(owner)
+            ? "dictionary" : "set";
+        size_t size = table.size();
+        for (size_t i = 0; i < table.entries().size(); i++) {
+            if (table.entries()[i].erased) continue;
+            variable = table.entries()[i].key;
+            executeStatements(body);
+            if (table.size() != size) {
+                throw RuntimeError(std::string(kind) + " changed size during iteration",
+                                   stmt.keyword.line);
+            }
+        }
+    } else if (std::holds_alternative<std::shared_ptr<PyArray>>(iterable)) {
+        auto array = std::get<std::shared_ptr<PyArray>>(iterable);
+        for (size_t i = 0; i < array->size(); i++) {
+            variable = array->get(i);
+            executeStatements(body);
+        }
+    } else if (std::holds_alternative<std::shared_ptr<PyGenerator>>(iterable)) {
+        // Each element is handed over in the generator, not allocated
+        auto generator = std::get<std::shared_ptr<PyGenerator>>(iterable);
+        while (generator->next()) {
+            variable = generator->current();
+            executeStatements(body);
+        }
+    } else if (std::holds_alternative<std::string>(iterable)) {
+        const std::string text = std::get<std::string>(iterable);
+        for (char c : text) {
+            variable = std::string(1, c);
+            executeStatements(body);
+        }
+    } else {
+        throw RuntimeError("'" + pyTypeName(iterable) + "' object is not iterable",
+                           stmt.keyword.line);
+    }
+}
+
 void Interpreter::visitFunctionStmt(const FunctionStmt& stmt) {
-    std::vector<std::string> paramNames;
-    for (const auto& param : stmt.params) {
-        paramNames.push_back(param.lexeme);
+    variable(stmt.slot, stmt.name.lexeme) = makeFunction(stmt);
+    lastValueSet = false;
+}
+
+std::shared_ptr<PyFunction> Interpreter::makeFunction(const FunctionStmt& stmt) {
+    auto function = std::make_shared<PyFunction>(stmt.name.lexeme, &stmt);
+
+    // A nested def closes over the cells of the enclosing variables it
+    // uses (its enclosing function has been resolved, so it has too)
+    function->closure.reserve(stmt.captures.size());
+    for (const VariableSlot& capture : stmt.captures) {
+        function->closure.push_back(capture.kind == VariableSlot::Kind::CELL
+            ? currentEnv->cells[capture.index]
+            : currentEnv->function->closure[capture.index]);
     }
+    return function;
+}
 
-    auto function = std::make_shared<PyFunction>(
-        stmt.name.lexeme,
-        paramNames,
-        &stmt  // Store pointer to the AST node
-    );
+void Interpreter::visitClassStmt(const ClassStmt& stmt) {
+    auto cls = std::make_shared<PyClass>(stmt.name.lexeme, this);
+    for (const Stmt& member : stmt.body) {
+        if (const auto* method = std::get_if<NodePtr<FunctionStmt>>(&member)) {
+            cls->setAttribute((*method)->name.lexeme, makeFunction(**method));
+        } else {
+            // The parser lets nothing else into a class body
+            const auto& statement = std::get<NodePtr<ExpressionStmt>>(member);
+            const auto& assignment = std::get<NodePtr<AssignExpr>>(statement->expression);
+            cls->setAttribute(assignment->name.lexeme, evaluate(assignment->value));
+        }
+    }
 
-    // Store the function in the environment
-    currentEnv->define(stmt.name.lexeme, function);
+    variable(stmt.slot, stmt.name.lexeme) = std::move(cls);
     lastValueSet = false;
 }
 
@@ -482,44 +1192,231 @@ void Interpreter::visitAssertStmt(const AssertStmt& stmt) {
     lastValueSet = false;
 }
 
+void Interpreter::visitYieldStmt(const YieldStmt& stmt) {
+    PyValue value = PyNone{};
+    if (stmt.value) {
+        value = evaluate(*stmt.value);
+    }
+
+    // The parser only accepts yield inside a def, which then always runs
+    // as a generator
+    PyGenerator* generator = activeGenerator;
+    std::shared_ptr<Environment> env = std::move(currentEnv);
+    generator->yield(std::move(value));
+    currentEnv = std::move(env);
+    lastValueSet = false;
+}
+
 void Interpreter::executeBlock(const std::vector<Stmt>& statements,
                                 std::shared_ptr<Environment> env) {
-    auto previous = currentEnv;
-    currentEnv = env;
+    // Moved rather than copied: every call enters a block, so this saves
+    // atomic reference count updates on the hottest path
+    auto previous = std::move(currentEnv);
+    currentEnv = std::move(env);
 
     try {
         for (const auto& stmt : statements) {
             execute(stmt);
         }
     } catch (...) {
-        currentEnv = previous;
+        currentEnv = std::move(previous);
         throw;
     }
 
-    currentEnv = previous;
+    currentEnv = std::move(previous);
+}
+
+void Interpreter::executeStatements(const std::vector<Stmt>& statements) {
+    for (const auto& stmt : statements) {
+        execute(stmt);
+    }
+}
+
+PyValue& Interpreter::variable(const VariableSlot& slot, const std::string& name) {
+    switch (slot.kind) {
+        case VariableSlot::Kind::LOCAL: return currentEnv->locals[slot.index];
+        case VariableSlot::Kind::CELL: return currentEnv->cells[slot.index]->value;
+        case VariableSlot::Kind::FREE: return currentEnv->function->closure[slot.index]->value;
+        default: return globalEnv->slot(name);
+    }
 }
 
 PyValue Interpreter::callFunction(std::shared_ptr<PyFunction> function,
-                                   const std::vector<PyValue>& arguments,
-                                   const Token& paren) {
-    if (arguments.size() != function->params.size()) {
+                                   ArgSpan arguments, const OpToken& paren) {
+    const FunctionStmt& declaration = *function->declaration;
+    if (arguments.size() != declaration.params.size()) {
         std::ostringstream oss;
-        oss << "Expected " << function->params.size()
+        oss << "Expected " << declaration.params.size()
             << " arguments but got " << arguments.size();
         throw RuntimeError(oss.str(), paren.line);
     }
+    Resolver::resolve(declaration);
 
+    // The frame: flat slots for the locals, fresh cells for those nested
+    // defs capture, and the function for its own closure
     auto env = std::make_shared<Environment>(globalEnv);
+    env->locals.resize(declaration.localCount, unboundValue());
+    env->cells.reserve(declaration.cellCount);
+    for (uint32_t i = 0; i < declaration.cellCount; i++) {
+        env->cells.push_back(std::make_shared<Cell>());
+    }
+    env->function = std::move(function);
+    for (size_t i = 0; i < arguments.size(); i++) {
+        const VariableSlot& slot = declaration.paramSlots[i];
+        if (slot.kind == VariableSlot::Kind::CELL) {
+            env->cells[slot.index]->value = arguments[i];
+        } else {
+            env->locals[slot.index] = arguments[i];
+        }
+    }
 
-    for (size_t i = 0; i < function->params.size(); i++) {
-        env->define(function->params[i], arguments[i]);
+    // The body runs later, one step per next()
+    if (declaration.isGenerator) {
+        auto generatorFunction = env->function;
+        return std::make_shared<PyGenerator>(*this, std::move(generatorFunction), std::move(env));
+    }
+    // The body runs when the coroutine is awaited
+    if (declaration.isAsync) {
+        auto coroutineFunction = env->function;
+        return std::make_shared<PyCoroutine>(*this, std::move(coroutineFunction), std::move(env));
     }
 
     try {
-        executeBlock(function->declaration->body, env);
+        executeBlock(declaration.body(), std::move(env));
     } catch (const ReturnException& ret) {
         return ret.value;
     }
 
     return PyNone{};
 }
+
+PyValue Interpreter::callValue(const PyValue& callee, ArgSpan arguments, const OpToken& paren) {
+    if (std::holds_alternative<std::shared_ptr<PyFunction>>(callee)) {
+        auto function = std::get<std::shared_ptr<PyFunction>>(callee);
+        if (function && function->self) {
+            return callWithReceiver(callee, function->self, arguments, paren);
+        }
+        return callFunction(function, arguments, paren);
+    }
+    if (std::holds_alternative<std::shared_ptr<NativeFunction>>(callee)) {
+        const auto& native = std::get<std::shared_ptr<NativeFunction>>(callee);
+        return callNative(*native, arguments, paren);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyClass>>(callee)) {
+        return instantiate(std::get<std::shared_ptr<PyClass>>(callee), arguments, paren);
+    }
+    throw RuntimeError("'" + pyTypeName(callee) + "' object is not callable", paren.line);
+}
+
+PyValue Interpreter::callWithReceiver(const PyValue& callee,
+                                      const std::shared_ptr<PyInstance>& self,
+                                      ArgSpan arguments, const OpToken& paren) {
+    size_t count = arguments.size() + 1;
+    PyValue inlineArguments[inlineArgumentCount];
+    std::vector<PyValue> heapArguments;
+    PyValue* withSelf = inlineArguments;
+    if (count > inlineArgumentCount) {
+        heapArguments.resize(count);
+        withSelf = heapArguments.data();
+    }
+    withSelf[0] = self;
+    std::copy(arguments.begin(), arguments.end(), withSelf + 1);
+
+    if (const auto* function = std::get_if<std::shared_ptr<PyFunction>>(&callee)) {
+        if (*function) return callFunction(*function, ArgSpan(withSelf, count), paren);
+    }
+    return callValue(callee, ArgSpan(withSelf, count), paren);
+}
+
+PyValue Interpreter::instantiate(const std::shared_ptr<PyClass>& cls, ArgSpan arguments,
+                                 const OpToken& paren) {
+    auto instance = std::make_shared<PyInstance>(cls);
+    const PyValue* initializer = cls->initializer();
+    if (!initializer) {
+        if (arguments.size() != 0) {
+            throw RuntimeError(cls->name + "() takes no arguments", paren.line);
+        }
+        return instance;
+    }
+
+    PyValue init = *initializer;  // The call may add class attributes
+    PyValue result = callWithReceiver(init, instance, arguments, paren);
+    if (!std::holds_alternative<PyNone>(result)) {
+        throw RuntimeError("__init__() should return None, not '" + pyTypeName(result) + "'",
+                           paren.line);
+    }
+    return instance;
+}
+
+PyValue Interpreter::callNative(const NativeFunction& function, ArgSpan arguments,
+                                const OpToken& paren) {
+    checkArity(function.name, function.minArity, function.maxArity, arguments.size(), paren.line);
+    struct CallSite {
+        const OpToken*& current;
+        const OpToken* enclosing;
+        ~CallSite() { current = enclosing; }
+    } site{nativeCall, nativeCall};
+    nativeCall = &paren;
+    try {
+        return function.fn(arguments);
+    } catch (RuntimeError& e) {
+        if (e.line == 0) e.line = paren.line;
+        throw;
+    }
+}
+
+PyValue Interpreter::callMethod(const NativeMethod& method, const PyValue& self,
+                                ArgSpan arguments, const OpToken& paren) {
+    checkArity(method.name, method.minArity, method.maxArity, arguments.size(), paren.line);
+    try {
+        return method.fn(self, arguments);
+    } catch (RuntimeError& e) {
+        if (e.line == 0) e.line = paren.line;
+        throw;
+    }
+}
+
+const NativeMethod* Interpreter::findMethod(const PyValue& object, const std::string& name) {
+    if (std::holds_alternative<std::shared_ptr<PyList>>(object)) {
+        return PyList::findMethod(name);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(object)) {
+        return PyDict::findMethod(name);
+    }
+    if (std::holds_alternative<std::shared_ptr<PySet>>(object)) {
+        return PySet::findMethod(name);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(object)) {
+        return PyArray::findMethod(name);
+    }
+    return nullptr;
+}
+
+PyValue Interpreter::getAttribute(const PyValue& object, const NameToken& name) {
+    if (std::holds_alternative<std::shared_ptr<PyModule>>(object)) {
+        const auto& module = std::get<std::shared_ptr<PyModule>>(object);
+        auto it = module->members.find(name.lexeme);
+        if (it != module->members.end()) {
+            return it->second;
+        }
+        throw RuntimeError("module '" + module->name + "' has no attribute '" +
+                           name.lexeme + "'", name.line);
+    }
+
+    if (const auto* cls = std::get_if<std::shared_ptr<PyClass>>(&object)) {
+        // A method looked up on the class itself stays a plain function
+        uint32_t slot = (*cls)->attributeSlot(name.lexeme);
+        if (slot != Shape::notFound) return (*cls)->attributeAt(slot);
+        throw RuntimeError("type object '" + (*cls)->name + "' has no attribute '" +
+                           name.lexeme + "'", name.line);
+    }
+
+    // A method referenced without calling it becomes a bound method
+    if (const NativeMethod* method = findMethod(object, name.lexeme)) {
+        return Builtins::makeNative(method->name, method->minArity, method->maxArity,
+                                    [object, method](ArgSpan args) {
+                                        return method->fn(object, args);
+                                    });
+    }
+    throw noAttribute(object, name);
+}
@@ -1,11 +1,19 @@
 #ifndef INTERPRETER_HPP
 #define INTERPRETER_HPP
 
+#include <functional>
 #include <memory>
+#include <sstream>
+#include <unordered_set>
 #include <vector>
 #include <iostream>
 #include "ast.hpp"
 #include "environment.hpp"
+#include "program.hpp"
+
+class EventLoop;
+class GlobalsSnapshot;
+struct TaskScope;
 
 // Exception for return statements
 class ReturnException : public std::exception {
@@ -16,9 +24,20 @@ public:
 
 class Interpreter {
 public:
-    Interpreter();
+    // Output of print() goes to `out`; instances share no mutable state, so
+    // separate Interpreters can run on separate threads.
+    explicit Interpreter(std::ostream& out = std::cout);
+    // Closes the generators still suspended in this interpreter
+    ~Interpreter();
+
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
 
-    void interpret(std::vector<Stmt> statements);
+    // Runs a compiled Program against this interpreter's globals. The
+    // interpreter keeps the Program alive for as long as any function it
+    // defined may still be called.
+    void run(const Program& program);
+    void interpret(Module module);
     PyValue evaluate(const Expr& expr);
     void execute(const Stmt& stmt);
 
@@ -27,14 +46,69 @@ public:
     PyValue getLastValue() const { return lastValue; }
     void clearLastValue() { lastValueSet = false; }
 
+    std::ostream& output() { return out; }
+
+    // Embedding: inject inputs before run() and read results after it.
+    // getGlobal throws RuntimeError if the name is not defined.
+    void setGlobal(const std::string& name, PyValue value);
+    PyValue getGlobal(const std::string& name) const;
+    bool hasGlobal(const std::string& name) const;
+
+    // Registers a native function as a global. `fn` receives the evaluated
+    // arguments as an ArgSpan after the count is checked against
+    // [minArity, maxArity] (maxArity -1 means variadic).
+    void defineNative(const std::string& name, int minArity, int maxArity, NativeFn fn);
+
+    // Cooperative multitasking: `hook` is called after every `budget`
+    // statements executed, and may switch away from the running script
+    // (see Scheduler). A budget of 0 turns preemption off.
+    void setPreemption(unsigned budget, std::function<void()> hook);
+
 private:
+    friend class PyGenerator;
+    friend class PyCoroutine;
+    friend class EventLoop;
+    friend class PyTask;
+
+    std::ostream& out;
     std::shared_ptr<Environment> globalEnv;
     std::shared_ptr<Environment> currentEnv;
     PyValue lastValue;
     bool lastValueSet = false;
 
-    // Store AST to keep function bodies alive
-    std::vector<std::vector<Stmt>> storedStatements;
+    // Programs run so far, kept alive for the function bodies they define
+    std::vector<std::shared_ptr<const Module>> programs;
+
+    // Generators created by this interpreter that are still alive, and the
+    // one whose body is running (the target of `yield`)
+    std::unordered_set<PyGenerator*> generators;
+    PyGenerator* activeGenerator = nullptr;
+
+    // The loop of the asyncio.run() in progress, which runs every
+    // coroutine body
+    EventLoop* eventLoop = nullptr;
+
+    // Set on the interpreters that run spawned tasks: the scope whose
+    // globals they were copied from, which tasks they spawn share
+    TaskScope* taskScope = nullptr;
+    // Where this interpreter's own spawns go while the globals they reach
+    // are unchanged
+    std::shared_ptr<TaskScope> spawnScope;
+
+    // pmap's worker contexts, made from pmapGlobals, and each kept for as
+    // long as both its globals and this one's match it
+    std::shared_ptr<const GlobalsSnapshot> pmapGlobals;
+    std::vector<std::unique_ptr<std::ostringstream>> pmapOutputs;
+    std::vector<std::unique_ptr<Interpreter>> pmapContexts;
+
+    // The call of the native function running, for natives that call back
+    // into Python code (pmap) and report errors at their own call
+    const OpToken* nativeCall = nullptr;
+
+    // Statements left before the preemption hook runs; 0 when disabled
+    unsigned preemptCountdown = 0;
+    unsigned preemptBudget = 0;
+    std::function<void()> preemptHook;
 
     // Expression evaluation
     PyValue visitBinaryExpr(const BinaryExpr& expr);
@@ -44,6 +118,15 @@ private:
     PyValue visitAssignExpr(const AssignExpr& expr);
     PyValue visitCallExpr(const CallExpr& expr);
     PyValue visitGroupingExpr(const GroupingExpr& expr);
+    PyValue visitGetExpr(const GetExpr& expr);
+    PyValue visitListExpr(const ListExpr& expr);
+    PyValue visitIndexExpr(const IndexExpr& expr);
+    PyValue visitSliceExpr(const SliceExpr& expr);
+    PyValue visitIndexAssignExpr(const IndexAssignExpr& expr);
+    PyValue visitDictExpr(const DictExpr& expr);
+    PyValue visitSetExpr(const SetExpr& expr);
+    PyValue visitAwaitExpr(const AwaitExpr& expr);
+    PyValue visitAttributeAssignExpr(const AttributeAssignExpr& expr);
 
     // Statement execution
     void visitExpressionStmt(const ExpressionStmt& stmt);
@@ -52,16 +135,50 @@ private:
     void visitBlockStmt(const BlockStmt& stmt);
     void visitIfStmt(const IfStmt& stmt);
     void visitWhileStmt(const WhileStmt& stmt);
+    void visitForStmt(const ForStmt& stmt);
     void visitFunctionStmt(const FunctionStmt& stmt);
     void visitReturnStmt(const ReturnStmt& stmt);
     void visitAssertStmt(const AssertStmt& stmt);
+    void visitYieldStmt(const YieldStmt& stmt);
+    void visitClassStmt(const ClassStmt& stmt);
 
     // Helpers
     void executeBlock(const std::vector<Stmt>& statements,
                       std::shared_ptr<Environment> env);
+    // Runs statements in the current environment (blocks are not scopes)
+    void executeStatements(const std::vector<Stmt>& statements);
+    // The storage of a resolved variable in the current frame, or of the
+    // global `name` (created if needed). Assigning to it binds the name.
+    PyValue& variable(const VariableSlot& slot, const std::string& name);
     PyValue callFunction(std::shared_ptr<PyFunction> function,
-                         const std::vector<PyValue>& arguments,
-                         const Token& paren);
+                         ArgSpan arguments, const OpToken& paren);
+    PyValue callNative(const NativeFunction& function, ArgSpan arguments,
+                       const OpToken& paren);
+    PyValue callMethod(const NativeMethod& method, const PyValue& self,
+                       ArgSpan arguments, const OpToken& paren);
+    PyValue callValue(const PyValue& callee, ArgSpan arguments, const OpToken& paren);
+    // Calls `callee` with `self` before the arguments
+    PyValue callWithReceiver(const PyValue& callee, const std::shared_ptr<PyInstance>& self,
+                             ArgSpan arguments, const OpToken& paren);
+    // Calling a class: a new instance, passed to __init__ if there is one
+    PyValue instantiate(const std::shared_ptr<PyClass>& cls, ArgSpan arguments,
+                        const OpToken& paren);
+    // The function a def statement makes, with its closure
+    std::shared_ptr<PyFunction> makeFunction(const FunctionStmt& stmt);
+
+    // Natives that act on this interpreter: pmap, spawn and join
+    void defineContextNatives();
+    PyValue parallelMap(ArgSpan arguments);
+    PyValue binaryOperation(const OpToken& op, const PyValue& left, const PyValue& right);
+    PyValue assignDictItem(PyDict& dict, const PyValue& key, const IndexAssignExpr& expr);
+    PyValue assignArrayItem(PyArray& array, const PyValue& index, const IndexAssignExpr& expr);
+    static const NativeMethod* findMethod(const PyValue& object, const std::string& name);
+    static PyValue getAttribute(const PyValue& object, const NameToken& name);
+    // expr.name on an instance, through the site's inline cache. A method
+    // found on the class is bound to the instance, unless `unboundMethod`
+    // is given: then it is returned as is, and *unboundMethod set.
+    static PyValue instanceAttribute(const std::shared_ptr<PyInstance>& instance,
+                                     const GetExpr& expr, bool* unboundMethod);
 };
 
 #endif // INTERPRETER_HPP
@@ -1,9 +1,23 @@
 #include "lexer.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <sstream>
+#include <thread>
 
-const std::unordered_map<std::string, TokenType> Lexer::keywords = {
+namespace {
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+// Reserved words. The lookup table below is generated from this list at
+// compile time, so adding a keyword only needs a new entry here.
+constexpr Keyword keywordList[] = {
     {"def", TokenType::DEF},
+    {"async", TokenType::ASYNC},
+    {"await", TokenType::AWAIT},
     {"return", TokenType::RETURN},
     {"if", TokenType::IF},
     {"elif", TokenType::ELIF},
@@ -18,10 +32,99 @@ const std::unordered_map<std::string, TokenType> Lexer::keywords = {
     {"False", TokenType::FALSE},
     {"None", TokenType::NONE},
     {"print", TokenType::PRINT},
-    {"assert", TokenType::ASSERT}
+    {"assert", TokenType::ASSERT},
+    {"yield", TokenType::YIELD},
+    {"class", TokenType::CLASS}
+};
+
+constexpr size_t keywordCount = sizeof(keywordList) / sizeof(keywordList[0]);
+constexpr size_t maxKeywordTableSize = 256;
+
+constexpr size_t minKeywordLength() {
+    size_t result = keywordList[0].text.size();
+    for (const auto& kw : keywordList) {
+        if (kw.text.size() < result) result = kw.text.size();
+    }
+    return result;
+}
+
+constexpr size_t maxKeywordLength() {
+    size_t result = 0;
+    for (const auto& kw : keywordList) {
+        if (kw.text.size() > result) result = kw.text.size();
+    }
+    return result;
+}
+
+// Hash on length, first and last byte: no loop over the identifier.
+constexpr size_t keywordHash(std::string_view text, size_t tableSize) {
+    return (text.size() * 7 +
+            static_cast<unsigned char>(text.front()) * 31 +
+            static_cast<unsigned char>(text.back())) % tableSize;
+}
+
+constexpr bool isCollisionFree(size_t tableSize) {
+    bool used[maxKeywordTableSize] = {};
+    for (const auto& kw : keywordList) {
+        size_t slot = keywordHash(kw.text, tableSize);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+// Smallest table size for which keywordHash is a perfect hash.
+constexpr size_t findKeywordTableSize() {
+    for (size_t size = keywordCount; size <= maxKeywordTableSize; size++) {
+        if (isCollisionFree(size)) return size;
+    }
+    return 0;
+}
+
+constexpr size_t keywordTableSize = findKeywordTableSize();
+static_assert(keywordTableSize != 0,
+              "keywordHash has collisions for every table size; extend the hash");
+
+struct KeywordTable {
+    signed char slots[keywordTableSize];  // Index into keywordList, or -1
 };
 
-Lexer::Lexer(std::string source) : source(std::move(source)) {
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table{};
+    for (size_t i = 0; i < keywordTableSize; i++) {
+        table.slots[i] = -1;
+    }
+    for (size_t i = 0; i < keywordCount; i++) {
+        table.slots[keywordHash(keywordList[i].text, keywordTableSize)] =
+            static_cast<signed char>(i);
+    }
+    return table;
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+} // namespace
+
+TokenType Lexer::keywordType(std::string_view text) {
+    if (text.size() < minKeywordLength() || text.size() > maxKeywordLength()) {
+        return TokenType::IDENTIFIER;
+    }
+    int slot = keywordTable.slots[keywordHash(text, keywordTableSize)];
+    if (slot >= 0 && keywordList[slot].text == text) {
+        return keywordList[slot].type;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+Lexer::Lexer(std::string source)
+    : ownedSource(std::move(source)), source(ownedSource) {
+    indentStack.push_back(0);
+}
+
+Lexer::Lexer(const SourceBuffer& source) : Lexer(source.text(), false) {}
+
+Lexer::Lexer(std::string_view source, bool rawIndentation)
+    : source(source), rawIndentation(rawIndentation) {
     indentStack.push_back(0);
 }
 
@@ -58,22 +161,22 @@ void Lexer::error(const std::string& message) {
 }
 
 void Lexer::addToken(TokenType type) {
-    std::string text = source.substr(start, current - start);
+    std::string text(source.substr(start, current - start));
     tokens.emplace_back(type, text, line, startColumn);
 }
 
 void Lexer::addToken(TokenType type, long long value) {
-    std::string text = source.substr(start, current - start);
+    std::string text(source.substr(start, current - start));
     tokens.emplace_back(type, text, value, line, startColumn);
 }
 
 void Lexer::addToken(TokenType type, double value) {
-    std::string text = source.substr(start, current - start);
+    std::string text(source.substr(start, current - start));
     tokens.emplace_back(type, text, value, line, startColumn);
 }
 
 void Lexer::addToken(TokenType type, const std::string& value) {
-    std::string text = source.substr(start, current - start);
+    std::string text(source.substr(start, current - start));
     tokens.emplace_back(type, text, value, line, startColumn);
 }
 
@@ -94,6 +197,13 @@ void Lexer::handleIndentation() {
         return;
     }
 
+    if (rawIndentation) {
+        tokens.emplace_back(TokenType::INDENT, "", static_cast<long long>(indent),
+                            line, column);
+        atLineStart = false;
+        return;
+    }
+
     int currentIndent = indentStack.back();
 
     if (indent > currentIndent) {
@@ -139,7 +249,7 @@ void Lexer::number() {
         while (std::isdigit(peek())) advance();
     }
 
-    std::string numStr = source.substr(start, current - start);
+    std::string numStr(source.substr(start, current - start));
     if (isFloat) {
         addToken(TokenType::FLOAT, std::stod(numStr));
     } else {
@@ -150,13 +260,7 @@ void Lexer::number() {
 void Lexer::identifier() {
     while (std::isalnum(peek()) || peek() == '_') advance();
 
-    std::string text = source.substr(start, current - start);
-    auto it = keywords.find(text);
-    if (it != keywords.end()) {
-        addToken(it->second);
-    } else {
-        addToken(TokenType::IDENTIFIER);
-    }
+    addToken(keywordType(source.substr(start, current - start)));
 }
 
 void Lexer::string(char quote) {
@@ -209,8 +313,13 @@ void Lexer::scanToken() {
     switch (c) {
         case '(': addToken(TokenType::LPAREN); break;
         case ')': addToken(TokenType::RPAREN); break;
+        case '[': addToken(TokenType::LBRACKET); break;
+        case ']': addToken(TokenType::RBRACKET); break;
+        case '{': addToken(TokenType::LBRACE); break;
+        case '}': addToken(TokenType::RBRACE); break;
         case ':': addToken(TokenType::COLON); break;
         case ',': addToken(TokenType::COMMA); break;
+        case '.': addToken(TokenType::DOT); break;
 
         case '+':
             if (match('=')) addToken(TokenType::PLUS_ASSIGN);
@@ -261,8 +370,10 @@ void Lexer::scanToken() {
 
         case '\n':
             // Only add NEWLINE if there's meaningful content before it
-            if (!tokens.empty() && tokens.back().type != TokenType::NEWLINE &&
-                tokens.back().type != TokenType::INDENT) {
+            // (decided by the fix-up pass for raw chunks)
+            if (rawIndentation ||
+                (!tokens.empty() && tokens.back().type != TokenType::NEWLINE &&
+                 tokens.back().type != TokenType::INDENT)) {
                 addToken(TokenType::NEWLINE);
             }
             line++;
@@ -306,6 +417,10 @@ std::vector<Token> Lexer::tokenize() {
         scanToken();
     }
 
+    if (rawIndentation) {
+        return tokens;
+    }
+
     // Add remaining DEDENTs
     while (indentStack.size() > 1) {
         indentStack.pop_back();
@@ -320,3 +435,117 @@ std::vector<Token> Lexer::tokenize() {
     tokens.emplace_back(TokenType::END_OF_FILE, "", line, column);
     return tokens;
 }
+
+
+std::vector<Token> Lexer::tokenizeParallel(std::string_view source, unsigned workers) {
+    std::vector<std::string_view> chunks;
+    size_t chunkSize = source.size() / std::max(workers, 1u) + 1;
+    for (size_t begin = 0; begin < source.size();) {
+        size_t newline = source.find('\n', begin + chunkSize);
+        size_t end = newline == std::string_view::npos ? source.size() : newline + 1;
+        chunks.push_back(source.substr(begin, end - begin));
+        begin = end;
+    }
+
+    if (chunks.size() <= 1) {
+        return Lexer(source, false).tokenize();
+    }
+
+    struct ChunkResult {
+        std::vector<Token> tokens;
+        int lines = 0;
+        int endColumn = 1;
+        bool failed = false;
+    };
+    std::vector<ChunkResult> results(chunks.size());
+    std::atomic<size_t> nextChunk{0};
+
+    auto worker = [&] {
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+            Lexer lexer(chunks[i], true);
+            try {
+                results[i].tokens = lexer.tokenize();
+                results[i].lines = lexer.line - 1;
+                results[i].endColumn = lexer.column;
+            } catch (const LexerError&) {
+                results[i].failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned threadCount = std::min<unsigned>(workers, static_cast<unsigned>(chunks.size()));
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // A chunk can fail on its own where the whole source would not (e.g. an
+    // escaped newline inside a string at a chunk edge), and its error has
+    // chunk-relative positions: redo the whole source sequentially.
+    for (const auto& result : results) {
+        if (result.failed) {
+            return Lexer(source, false).tokenize();
+        }
+    }
+
+    // Fix-up pass: same indentation and NEWLINE rules as the sequential lexer
+    size_t total = 0;
+    for (const auto& result : results) {
+        total += result.tokens.size();
+    }
+
+    std::vector<Token> tokens;
+    tokens.reserve(total + 2);
+    std::vector<int> indentStack{0};
+    int lineOffset = 0;
+
+    for (auto& result : results) {
+        for (Token& token : result.tokens) {
+            token.line += lineOffset;
+
+            if (token.type == TokenType::INDENT) {
+                int indent = static_cast<int>(std::get<long long>(token.literal));
+                if (indent > indentStack.back()) {
+                    indentStack.push_back(indent);
+                    tokens.emplace_back(TokenType::INDENT, "", token.line, token.column);
+                } else if (indent < indentStack.back()) {
+                    while (!indentStack.empty() && indentStack.back() > indent) {
+                        indentStack.pop_back();
+                        tokens.emplace_back(TokenType::DEDENT, "", token.line, token.column);
+                    }
+                    if (indentStack.empty() || indentStack.back() != indent) {
+                        throw LexerError("Inconsistent indentation", token.line, token.column);
+                    }
+                }
+                continue;
+            }
+
+            if (token.type == TokenType::NEWLINE &&
+                (tokens.empty() || tokens.back().type == TokenType::NEWLINE ||
+                 tokens.back().type == TokenType::INDENT)) {
+                continue;
+            }
+
+            tokens.push_back(std::move(token));
+        }
+        lineOffset += result.lines;
+    }
+
+    int line = lineOffset + 1;
+    int column = results.back().endColumn;
+
+    while (indentStack.size() > 1) {
+        indentStack.pop_back();
+        tokens.emplace_back(TokenType::DEDENT, "", line, column);
+    }
+
+    if (!tokens.empty() && tokens.back().type != TokenType::NEWLINE) {
+        tokens.emplace_back(TokenType::NEWLINE, "", line, column);
+    }
+
+    tokens.emplace_back(TokenType::END_OF_FILE, "", line, column);
+    return tokens;
+}
@@ -3,8 +3,9 @@
 
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <string_view>
 #include <stdexcept>
+#include "source_buffer.hpp"
 #include "token.hpp"
 
 class LexerError : public std::runtime_error {
@@ -17,10 +18,28 @@ public:
 class Lexer {
 public:
     explicit Lexer(std::string source);
+    // Lexes the buffer in place; it must outlive the Lexer
+    explicit Lexer(const SourceBuffer& source);
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+
     std::vector<Token> tokenize();
 
+    // Lexes `source` in newline-aligned chunks on up to `workers` threads.
+    // Chunks record raw indentation widths, and a sequential pass turns them
+    // into INDENT/DEDENT tokens and absolute line numbers. Produces the same
+    // tokens (and errors) as tokenize().
+    static std::vector<Token> tokenizeParallel(std::string_view source, unsigned workers);
+
 private:
-    std::string source;
+    // Lexes a view of source the caller keeps alive. With rawIndentation,
+    // every logical line starts with an INDENT token whose literal is the
+    // line's indentation width, and no DEDENT/EOF tokens are produced.
+    Lexer(std::string_view source, bool rawIndentation);
+
+    std::string ownedSource;
+    std::string_view source;
+    bool rawIndentation = false;
     std::vector<Token> tokens;
     size_t start = 0;
     size_t current = 0;
@@ -32,7 +51,8 @@ private:
     std::vector<int> indentStack;
     bool atLineStart = true;
 
-    static const std::unordered_map<std::string, TokenType> keywords;
+    // Classifies an identifier as a keyword (or IDENTIFIER) without copying it
+    static TokenType keywordType(std::string_view text);
 
     bool isAtEnd() const;
     char peek() const;
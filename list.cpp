@@ -0,0 +1,264 @@
+#include "list.hpp"
+#include <algorithm>
+#include "environment.hpp"
+
+namespace {
+
+PyList& self(const PyValue& value) {
+    return *std::get<std::shared_ptr<PyList>>(value);
+}
+
+long long toIndex(const PyValue& value) {
+    if (std::holds_alternative<long long>(value)) return std::get<long long>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1 : 0;
+    throw RuntimeError("'" + pyTypeName(value) + "' object cannot be interpreted as an integer");
+}
+
+PyValue append(const PyValue& list, ArgSpan args) {
+    self(list).append(args[0]);
+    return PyNone{};
+}
+
+PyValue pop(const PyValue& list, ArgSpan args) {
+    PyList& items = self(list);
+    if (items.size() == 0) {
+        throw RuntimeError("pop from empty list");
+    }
+    long long index = args.size() == 0 ? -1 : toIndex(args[0]);
+    return items.pop(items.checkIndex(index));
+}
+
+const NativeMethod methods[] = {
+    {"append", 1, 1, append},
+    {"pop", 0, 1, pop},
+};
+
+}  // namespace
+
+namespace {
+
+template <typename T>
+void copySlice(const std::vector<T>& from, const SliceBounds& bounds, std::vector<T>& to) {
+    if (bounds.step == 1) {
+        auto first = from.begin() + bounds.start;
+        to.assign(first, first + static_cast<std::ptrdiff_t>(bounds.count));
+        return;
+    }
+    to.reserve(bounds.count);
+    long long index = bounds.start;
+    for (size_t i = 0; i < bounds.count; i++, index += bounds.step) {
+        to.push_back(from[static_cast<size_t>(index)]);
+    }
+}
+
+template <typename T>
+void appendTimes(std::vector<T>& to, const std::vector<T>& from, long long times) {
+    to.reserve(from.size() * static_cast<size_t>(times));
+    for (long long i = 0; i < times; i++) {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+}
+
+}  // namespace
+
+PyList::PyList(std::vector<PyValue> items) {
+    reserve(items.size());
+    for (auto& item : items) append(std::move(item));
+    track();
+}
+
+void PyList::traverse(Visit visit, void* context) const {
+    if (kind != Storage::OBJECT) return;  // Packed numbers refer to nothing
+    for (const PyValue& item : objects) {
+        visitValue(item, visit, context);
+    }
+}
+
+void PyList::clearReferences() {
+    std::vector<PyValue> doomed;
+    doomed.swap(objects);  // Freed once the list is consistent again
+    ints.clear();
+    floats.clear();
+    kind = Storage::EMPTY;
+}
+
+size_t PyList::size() const {
+    switch (kind) {
+        case Storage::INT: return ints.size();
+        case Storage::FLOAT: return floats.size();
+        case Storage::OBJECT: return objects.size();
+        default: return 0;
+    }
+}
+
+PyValue PyList::get(size_t index) const {
+    switch (kind) {
+        case Storage::INT: return ints[index];
+        case Storage::FLOAT: return floats[index];
+        default: return objects[index];
+    }
+}
+
+void PyList::set(size_t index, PyValue value) {
+    if (kind == Storage::INT && std::holds_alternative<long long>(value)) {
+        ints[index] = std::get<long long>(value);
+    } else if (kind == Storage::FLOAT && std::holds_alternative<double>(value)) {
+        floats[index] = std::get<double>(value);
+    } else {
+        generalize();
+        objects[index] = std::move(value);
+    }
+}
+
+void PyList::append(PyValue value) {
+    if (kind == Storage::EMPTY) adopt(value);
+
+    if (kind == Storage::INT && std::holds_alternative<long long>(value)) {
+        ints.push_back(std::get<long long>(value));
+    } else if (kind == Storage::FLOAT && std::holds_alternative<double>(value)) {
+        floats.push_back(std::get<double>(value));
+    } else {
+        generalize();
+        objects.push_back(std::move(value));
+    }
+}
+
+void PyList::reserve(size_t count) {
+    switch (kind) {
+        case Storage::INT: ints.reserve(count); break;
+        case Storage::FLOAT: floats.reserve(count); break;
+        case Storage::OBJECT: objects.reserve(count); break;
+        default: reserved = count; break;
+    }
+}
+
+void PyList::adopt(const PyValue& value) {
+    if (std::holds_alternative<long long>(value)) {
+        kind = Storage::INT;
+        ints.reserve(reserved);
+    } else if (std::holds_alternative<double>(value)) {
+        kind = Storage::FLOAT;
+        floats.reserve(reserved);
+    } else {
+        kind = Storage::OBJECT;
+        objects.reserve(reserved);
+    }
+    reserved = 0;
+}
+
+void PyList::generalize() {
+    if (kind == Storage::OBJECT) return;
+    if (kind == Storage::INT) {
+        objects.assign(ints.begin(), ints.end());
+        std::vector<long long>().swap(ints);
+    } else if (kind == Storage::FLOAT) {
+        objects.assign(floats.begin(), floats.end());
+        std::vector<double>().swap(floats);
+    } else {
+        objects.reserve(reserved);
+        reserved = 0;
+    }
+    kind = Storage::OBJECT;
+}
+
+PyValue PyList::pop(size_t index) {
+    PyValue value = get(index);
+    auto offset = static_cast<std::ptrdiff_t>(index);
+    switch (kind) {
+        case Storage::INT: ints.erase(ints.begin() + offset); break;
+        case Storage::FLOAT: floats.erase(floats.begin() + offset); break;
+        default: objects.erase(objects.begin() + offset); break;
+    }
+    return value;
+}
+
+size_t PyList::checkIndex(long long index) const {
+    long long size = static_cast<long long>(this->size());
+    if (index < 0) index += size;
+    if (index < 0 || index >= size) {
+        throw RuntimeError("list index out of range");
+    }
+    return static_cast<size_t>(index);
+}
+
+bool PyList::contains(const PyValue& item) const {
+    if (kind == Storage::INT && std::holds_alternative<long long>(item)) {
+        return std::find(ints.begin(), ints.end(), std::get<long long>(item)) != ints.end();
+    }
+    if (kind == Storage::FLOAT && std::holds_alternative<double>(item)) {
+        return std::find(floats.begin(), floats.end(), std::get<double>(item)) != floats.end();
+    }
+    for (size_t i = 0; i < size(); i++) {
+        if (pyEquals(get(i), item)) return true;
+    }
+    return false;
+}
+
+bool PyList::equals(const PyList& other) const {
+    if (kind == other.kind) {
+        if (kind == Storage::INT) return ints == other.ints;
+        if (kind == Storage::FLOAT) return floats == other.floats;
+    }
+    if (size() != other.size()) return false;
+    for (size_t i = 0; i < size(); i++) {
+        if (!pyEquals(get(i), other.get(i))) return false;
+    }
+    return true;
+}
+
+std::shared_ptr<PyList> PyList::slice(const SliceBounds& bounds) const {
+    auto result = std::make_shared<PyList>();
+    if (bounds.count == 0) return result;
+    result->kind = kind;
+    switch (kind) {
+        case Storage::INT: copySlice(ints, bounds, result->ints); break;
+        case Storage::FLOAT: copySlice(floats, bounds, result->floats); break;
+        default: copySlice(objects, bounds, result->objects); break;
+    }
+    return result;
+}
+
+std::shared_ptr<PyList> PyList::concat(const PyList& other) const {
+    if (other.kind == Storage::EMPTY) return slice(SliceBounds{0, 1, size()});
+    if (kind == Storage::EMPTY) return other.slice(SliceBounds{0, 1, other.size()});
+
+    auto result = std::make_shared<PyList>();
+    if (kind == other.kind && kind != Storage::OBJECT) {
+        result->kind = kind;
+        if (kind == Storage::INT) {
+            result->ints.reserve(ints.size() + other.ints.size());
+            result->ints.insert(result->ints.end(), ints.begin(), ints.end());
+            result->ints.insert(result->ints.end(), other.ints.begin(), other.ints.end());
+        } else {
+            result->floats.reserve(floats.size() + other.floats.size());
+            result->floats.insert(result->floats.end(), floats.begin(), floats.end());
+            result->floats.insert(result->floats.end(), other.floats.begin(), other.floats.end());
+        }
+        return result;
+    }
+
+    result->kind = Storage::OBJECT;
+    result->objects.reserve(size() + other.size());
+    for (size_t i = 0; i < size(); i++) result->objects.push_back(get(i));
+    for (size_t i = 0; i < other.size(); i++) result->objects.push_back(other.get(i));
+    return result;
+}
+
+std::shared_ptr<PyList> PyList::repeat(long long times) const {
+    auto result = std::make_shared<PyList>();
+    if (times <= 0 || kind == Storage::EMPTY) return result;
+    result->kind = kind;
+    switch (kind) {
+        case Storage::INT: appendTimes(result->ints, ints, times); break;
+        case Storage::FLOAT: appendTimes(result->floats, floats, times); break;
+        default: appendTimes(result->objects, objects, times); break;
+    }
+    return result;
+}
+
+const NativeMethod* PyList::findMethod(const std::string& name) {
+    for (const NativeMethod& method : methods) {
+        if (name == method.name) return &method;
+    }
+    return nullptr;
+}
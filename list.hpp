@@ -0,0 +1,80 @@
+#ifndef LIST_HPP
+#define LIST_HPP
+
+#include <memory>
+#include <vector>
+#include "gc.hpp"
+#include "value.hpp"
+
+// Python list. Elements live in one contiguous buffer that grows
+// geometrically, so indexing is O(1) and append is amortized O(1). Lists
+// are shared by reference, like in Python.
+//
+// The buffer is specialized to the contents (a storage strategy, as in
+// PyPy): while every element is an int the list is a packed long long
+// array, while every element is a float a packed double array, and
+// otherwise an array of PyValue. An empty list adopts the type of its
+// first element. Storing an element of any other type switches the list
+// to generic storage for good. Callers see PyValues either way; hot paths
+// can check storage() and read the dense arrays directly.
+//
+// Lists can hold themselves, directly or through other lists and dicts,
+// so they are tracked by the cycle collector (see gc.hpp).
+class PyList : public GcObject, public std::enable_shared_from_this<PyList> {
+public:
+    enum class Storage { EMPTY, INT, FLOAT, OBJECT };
+
+    PyList() { track(); }
+    explicit PyList(std::vector<PyValue> items);
+    ~PyList() override { untrack(); }
+
+    Storage storage() const { return kind; }
+    size_t size() const;
+    PyValue get(size_t index) const;
+    void set(size_t index, PyValue value);
+    void append(PyValue value);
+    void reserve(size_t count);
+
+    // The packed elements; valid only while storage() is INT or FLOAT
+    const std::vector<long long>& intData() const { return ints; }
+    const std::vector<double>& floatData() const { return floats; }
+
+    // Removes and returns the element at `index` (already checked)
+    PyValue pop(size_t index);
+
+    // Maps a possibly negative Python index to a position; throws
+    // RuntimeError if it is out of range
+    size_t checkIndex(long long index) const;
+
+    bool contains(const PyValue& item) const;
+    bool equals(const PyList& other) const;
+
+    // New lists with the same storage where possible; a step-1 slice is a
+    // single bulk copy of the range
+    std::shared_ptr<PyList> slice(const SliceBounds& bounds) const;
+    std::shared_ptr<PyList> concat(const PyList& other) const;
+    std::shared_ptr<PyList> repeat(long long times) const;
+
+    // append, pop; nullptr for unknown names
+    static const NativeMethod* findMethod(const std::string& name);
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+
+private:
+    Storage kind = Storage::EMPTY;
+    std::vector<long long> ints;
+    std::vector<double> floats;
+    std::vector<PyValue> objects;
+    size_t reserved = 0;  // Capacity requested while EMPTY
+
+    // Switches to OBJECT storage, boxing the packed elements
+    void generalize();
+    // Makes an EMPTY list take the storage that suits `value`
+    void adopt(const PyValue& value);
+};
+
+#endif // LIST_HPP
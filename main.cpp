@@ -1,50 +1,231 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include "cache.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "interpreter.hpp"
+#include "list.hpp"
+#include "process_pool.hpp"
+#include "program.hpp"
+#include "scheduler.hpp"
+#include "version.hpp"
+#include "work_pool.hpp"
 
-int runFile(const std::string& path, Interpreter& interpreter);
+int runFile(const std::string& path, Interpreter& interpreter,
+            std::ostream& err = std::cerr);
+int runFiles(const std::vector<std::string>& paths, unsigned jobs);
+int runFilesGreen(const std::vector<std::string>& paths);
+int runFilesInWorkers(const std::vector<std::string>& paths, unsigned workers);
 void runRepl(Interpreter& interpreter);
-void run(const std::string& source, Interpreter& interpreter, bool isRepl = false);
+bool run(const SourceBuffer& source, Interpreter& interpreter, bool isRepl = false,
+         const std::string& path = "", std::ostream& err = std::cerr);
 
 int main(int argc, char* argv[]) {
-    Interpreter interpreter;
+    unsigned jobs = 1;
+    unsigned workers = 0;
+    bool green = false;
+    std::vector<std::string> paths;
 
-    if (argc > 2) {
-        std::cerr << "Usage: pyinterp [script]" << std::endl;
-        return 1;
-    } else if (argc == 2) {
-        return runFile(argv[1], interpreter);
-    } else {
-        runRepl(interpreter);
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 1) {
+                std::cerr << "Error: --jobs expects a positive number" << std::endl;
+                return 1;
+            }
+            jobs = static_cast<unsigned>(value);
+        } else if (arg == "--workers" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 1) {
+                std::cerr << "Error: --workers expects a positive number" << std::endl;
+                return 1;
+            }
+            workers = static_cast<unsigned>(value);
+        } else if (arg == "--green") {
+            green = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int value = std::atoi(argv[++i]);
+            if (value < 1) {
+                std::cerr << "Error: --threads expects a positive number" << std::endl;
+                return 1;
+            }
+            WorkPool::setDefaultSize(static_cast<unsigned>(value));
+        } else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            std::cerr << "Usage: pyinterp [--jobs N | --workers N | --green] [--threads N] "
+                         "[script ...]" << std::endl;
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (workers > 0 && !paths.empty()) {
+        return runFilesInWorkers(paths, workers);
+    } else if (paths.size() == 1) {
+        Interpreter interpreter;
+        return runFile(paths[0], interpreter);
+    } else if (!paths.empty()) {
+        return green ? runFilesGreen(paths) : runFiles(paths, jobs);
     }
 
+    Interpreter interpreter;
+    runRepl(interpreter);
     return 0;
 }
 
-int runFile(const std::string& path, Interpreter& interpreter) {
-    std::ifstream file(path);
-    if (!file) {
-        std::cerr << "Error: Could not open file '" << path << "'" << std::endl;
+// Returns 1 if the file cannot be read or the script raises an error
+int runFile(const std::string& path, Interpreter& interpreter, std::ostream& err) {
+    SourceBuffer source("");
+    try {
+        source = SourceBuffer::open(path);
+    } catch (const std::runtime_error&) {
+        err << "Error: Could not open file '" << path << "'" << std::endl;
         return 1;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-
     try {
-        run(buffer.str(), interpreter);
+        if (!run(source, interpreter, false, source.isRegularFile() ? path : "", err)) {
+            return 1;
+        }
     } catch (const AssertionError&) {
         return 1;  // Test failed
     }
     return 0;
 }
 
+// Runs independent scripts on a pool of `jobs` threads. Each script gets its
+// own Interpreter and captured stdout/stderr, which are written out in
+// command-line order as soon as every earlier script has finished. Returns
+// non-zero if any script failed.
+int runFiles(const std::vector<std::string>& paths, unsigned jobs) {
+    struct Job {
+        std::ostringstream out;
+        std::ostringstream err;
+        int status = 0;
+        bool done = false;
+    };
+    std::vector<Job> results(paths.size());
+    std::atomic<size_t> nextJob{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    auto worker = [&] {
+        for (size_t i = nextJob++; i < paths.size(); i = nextJob++) {
+            Job& job = results[i];
+            Interpreter interpreter(job.out);
+            int status = runFile(paths[i], interpreter, job.err);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            job.status = status;
+            job.done = true;
+            finished.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned threadCount = std::min<unsigned>(jobs, static_cast<unsigned>(paths.size()));
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+
+    int status = 0;
+    for (Job& job : results) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return job.done; });
+        }
+        std::cout << job.out.str() << std::flush;
+        std::cerr << job.err.str() << std::flush;
+        if (job.status != 0) status = 1;
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return status;
+}
+
+// Runs independent scripts concurrently on this thread, as green threads
+// interleaved by a Scheduler. Output is captured and written out in
+// command-line order, as by runFiles.
+int runFilesGreen(const std::vector<std::string>& paths) {
+    struct Job {
+        std::ostringstream out;
+        std::ostringstream err;
+        std::unique_ptr<Interpreter> interpreter;
+        int status = 0;
+    };
+    std::vector<Job> results(paths.size());
+
+    Scheduler scheduler;
+    for (size_t i = 0; i < paths.size(); i++) {
+        Job& job = results[i];
+        job.interpreter = std::make_unique<Interpreter>(job.out);
+        const std::string& path = paths[i];
+        scheduler.spawn(*job.interpreter, [&job, &path] {
+            job.status = runFile(path, *job.interpreter, job.err);
+        });
+    }
+    scheduler.run();
+
+    int status = 0;
+    for (Job& job : results) {
+        std::cout << job.out.str() << std::flush;
+        std::cerr << job.err.str() << std::flush;
+        if (job.status != 0) status = 1;
+    }
+    return status;
+}
+
+// Runs independent scripts in `workers` forked processes, each running
+// one script at a time in a fresh Interpreter. A script that crashes its
+// process fails alone; the process is replaced and the others carry on.
+// Output is written in command-line order, as by runFiles.
+int runFilesInWorkers(const std::vector<std::string>& paths, unsigned workers) {
+    // Request: the script's path. Reply: [status, stdout, stderr].
+    ProcessPool pool(std::min<size_t>(workers, paths.size()), [](const PyValue& request) {
+        std::ostringstream out;
+        std::ostringstream err;
+        Interpreter interpreter(out);
+        int status = runFile(std::get<std::string>(request), interpreter, err);
+        return PyValue(std::make_shared<PyList>(std::vector<PyValue>{
+            static_cast<long long>(status), out.str(), err.str()}));
+    });
+
+    std::vector<PyValue> requests(paths.begin(), paths.end());
+    std::vector<ProcessPool::Reply> replies(paths.size());
+    std::vector<bool> done(paths.size(), false);
+    size_t written = 0;
+    int status = 0;
+    pool.run(requests, [&](size_t index, ProcessPool::Reply reply) {
+        replies[index] = std::move(reply);
+        done[index] = true;
+        for (; written < paths.size() && done[written]; written++) {
+            const ProcessPool::Reply& result = replies[written];
+            if (!result.error.empty()) {
+                std::cerr << "Error: " << paths[written] << ": " << result.error << std::endl;
+                status = 1;
+                continue;
+            }
+            const auto& fields = std::get<std::shared_ptr<PyList>>(result.value);
+            std::cout << std::get<std::string>(fields->get(1)) << std::flush;
+            std::cerr << std::get<std::string>(fields->get(2)) << std::flush;
+            if (std::get<long long>(fields->get(0)) != 0) status = 1;
+            replies[written] = ProcessPool::Reply{};
+        }
+    });
+    return status;
+}
+
 void runRepl(Interpreter& interpreter) {
-    std::cout << "MiniPython Interpreter v0.1" << std::endl;
+    std::cout << "MiniPython Interpreter v" PYINTERP_VERSION << std::endl;
     std::cout << "Type 'exit()' or Ctrl+D to quit" << std::endl;
     std::cout << std::endl;
 
@@ -76,7 +257,7 @@ void runRepl(Interpreter& interpreter) {
             if (inBlock) {
                 // Empty line ends the block
                 inBlock = false;
-                run(buffer, interpreter, true);
+                run(SourceBuffer(buffer), interpreter, true);
                 buffer.clear();
                 indentLevel = 0;
             }
@@ -113,47 +294,60 @@ void runRepl(Interpreter& interpreter) {
             buffer = line + "\n";
         } else {
             // Single line execution
-            run(line, interpreter, true);
+            run(SourceBuffer(line), interpreter, true);
         }
     }
 }
 
-void run(const std::string& source, Interpreter& interpreter, bool isRepl) {
+// `path` is set for scripts run from a file and enables the compiled-code
+// cache in __pycache__. Returns false if the source raised an error, which
+// is reported on `err`; a failed assert is rethrown.
+bool run(const SourceBuffer& source, Interpreter& interpreter, bool isRepl,
+         const std::string& path, std::ostream& err) {
     try {
-        Lexer lexer(source);
-        std::vector<Token> tokens = lexer.tokenize();
-
-        Parser parser(tokens);
-        std::vector<Stmt> statements = parser.parse();
-
-        interpreter.clearLastValue();
-        interpreter.interpret(std::move(statements));
+        Module module;
+        if (!path.empty() && CodeCache::load(path, source.text(), module)) {
+            interpreter.clearLastValue();
+            interpreter.run(Program(std::move(module)));
+        } else {
+            // REPL input is parsed eagerly; scripts defer function bodies
+            Program program = Program::compile(source, !isRepl);
+            if (!path.empty()) {
+                CodeCache::store(path, source.text(), program.statements());
+            }
+            interpreter.clearLastValue();
+            interpreter.run(program);
+        }
 
         // In REPL mode, print the result of expressions
         if (isRepl && interpreter.hasLastValue()) {
             PyValue value = interpreter.getLastValue();
             // Don't print None for expression statements in REPL
             if (!std::holds_alternative<PyNone>(value)) {
-                std::cout << pyValueToString(value) << std::endl;
+                interpreter.output() << pyValueToString(value) << std::endl;
             }
         }
     } catch (const LexerError& e) {
-        std::cerr << "Lexer Error [line " << e.line << ", col " << e.column << "]: "
+        err << "Lexer Error [line " << e.line << ", col " << e.column << "]: "
                   << e.what() << std::endl;
+        return false;
     } catch (const ParseError& e) {
-        std::cerr << e.what() << std::endl;
+        err << e.what() << std::endl;
+        return false;
     } catch (const AssertionError& e) {
-        std::cerr << e.what();
+        err << e.what();
         if (e.line > 0) {
-            std::cerr << " (line " << e.line << ")";
+            err << " (line " << e.line << ")";
         }
-        std::cerr << std::endl;
+        err << std::endl;
         throw;  // Re-throw to signal test failure
     } catch (const RuntimeError& e) {
-        std::cerr << "Runtime Error";
+        err << "Runtime Error";
         if (e.line > 0) {
-            std::cerr << " [line " << e.line << "]";
+            err << " [line " << e.line << "]";
         }
-        std::cerr << ": " << e.what() << std::endl;
+        err << ": " << e.what() << std::endl;
+        return false;
     }
+    return true;
 }
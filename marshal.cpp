@@ -0,0 +1,339 @@
+#include "marshal.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "array.hpp"
+#include "dict.hpp"
+#include "environment.hpp"
+#include "list.hpp"
+
+SharedSegment::SharedSegment() {
+    fd = memfd_create("pyinterp-segment", MFD_CLOEXEC);
+    if (fd < 0) throw RuntimeError("could not create shared memory segment");
+}
+
+SharedSegment::SharedSegment(int fd) : fd(fd) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        throw RuntimeError("bad shared memory segment");
+    }
+    try {
+        remap(static_cast<size_t>(info.st_size), PROT_READ);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    used = mapped;
+}
+
+SharedSegment::~SharedSegment() {
+    if (base) munmap(base, mapped);
+    close(fd);
+}
+
+void SharedSegment::remap(size_t size, int protection) {
+    if (base) munmap(base, mapped);
+    base = nullptr;
+    mapped = 0;
+    void* address = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) throw RuntimeError("could not map shared memory segment");
+    base = static_cast<char*>(address);
+    mapped = size;
+}
+
+size_t SharedSegment::append(const char* data, size_t size) {
+    size_t offset = (used + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    if (offset + size > mapped) {
+        // Grow geometrically, in whole pages
+        size_t capacity = std::max<size_t>(mapped * 2, 1 << 20);
+        while (capacity < offset + size) capacity *= 2;
+        if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            throw RuntimeError("could not grow shared memory segment");
+        }
+        remap(capacity, PROT_READ | PROT_WRITE);
+    }
+    std::memcpy(base + offset, data, size);
+    used = offset + size;
+    return offset;
+}
+
+int SharedSegment::finish() {
+    // The pages past `used` are only touched by ftruncate itself
+    if (ftruncate(fd, static_cast<off_t>(used)) != 0) {
+        throw RuntimeError("could not trim shared memory segment");
+    }
+    return fd;
+}
+
+std::string_view SharedSegment::view(size_t offset, size_t size) const {
+    if (offset + size < offset || offset + size > used) throw RuntimeError("bad marshal data");
+    return std::string_view(base + offset, size);
+}
+
+namespace {
+
+enum class Tag : uint8_t {
+    NONE, FALSE, TRUE, INTEGER, FLOAT, STRING, RANGE,
+    LIST, INT_LIST, FLOAT_LIST, DICT, SET, INT_ARRAY, FLOAT_ARRAY,
+};
+
+// Where the bytes after a STRING, INT_LIST, ... tag are
+enum class Placement : uint8_t { INLINE, SHARED };
+
+class Writer {
+public:
+    std::string out;
+    std::unique_ptr<SharedSegment>* segment;
+
+    explicit Writer(std::unique_ptr<SharedSegment>* segment) : segment(segment) {}
+
+    template<typename T>
+    void pod(T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // A length-prefixed run of bytes, inline or in the segment
+    void bytes(Tag tag, const void* data, size_t size) {
+        pod<Tag>(tag);
+        if (segment && size >= Marshal::sharedThreshold) {
+            pod<Placement>(Placement::SHARED);
+            if (!*segment) *segment = std::make_unique<SharedSegment>();
+            pod<uint64_t>((*segment)->append(static_cast<const char*>(data), size));
+            pod<uint64_t>(size);
+        } else {
+            pod<Placement>(Placement::INLINE);
+            pod<uint64_t>(size);
+            out.append(static_cast<const char*>(data), size);
+        }
+    }
+
+    void value(const PyValue& value) {
+        if (std::holds_alternative<PyNone>(value)) {
+            pod<Tag>(Tag::NONE);
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            pod<Tag>(*flag ? Tag::TRUE : Tag::FALSE);
+        } else if (const long long* integer = std::get_if<long long>(&value)) {
+            pod<Tag>(Tag::INTEGER);
+            pod<int64_t>(*integer);
+        } else if (const double* number = std::get_if<double>(&value)) {
+            pod<Tag>(Tag::FLOAT);
+            pod<double>(*number);
+        } else if (const auto* text = std::get_if<std::string>(&value)) {
+            bytes(Tag::STRING, text->data(), text->size());
+        } else if (const auto* range = std::get_if<PyRange>(&value)) {
+            pod<Tag>(Tag::RANGE);
+            pod<int64_t>(range->start);
+            pod<int64_t>(range->stop);
+            pod<int64_t>(range->step);
+        } else if (const auto* list = std::get_if<std::shared_ptr<PyList>>(&value)) {
+            enter(list->get());
+            writeList(**list);
+            leave();
+        } else if (const auto* dict = std::get_if<std::shared_ptr<PyDict>>(&value)) {
+            enter(dict->get());
+            pod<Tag>(Tag::DICT);
+            pod<uint64_t>((*dict)->table.size());
+            for (const HashTable::Entry& entry : (*dict)->table.entries()) {
+                if (entry.erased) continue;
+                this->value(entry.key);
+                this->value(entry.value);
+            }
+            leave();
+        } else if (const auto* set = std::get_if<std::shared_ptr<PySet>>(&value)) {
+            pod<Tag>(Tag::SET);
+            pod<uint64_t>((*set)->table.size());
+            for (const HashTable::Entry& entry : (*set)->table.entries()) {
+                if (!entry.erased) this->value(entry.key);
+            }
+        } else if (const auto* array = std::get_if<std::shared_ptr<PyArray>>(&value)) {
+            size_t size = (*array)->size();
+            if ((*array)->isFloat()) {
+                bytes(Tag::FLOAT_ARRAY, (*array)->elementData<double>(), size * sizeof(double));
+            } else {
+                bytes(Tag::INT_ARRAY, (*array)->elementData<long long>(), size * sizeof(long long));
+            }
+        } else {
+            throw RuntimeError("cannot marshal '" + pyTypeName(value) + "' object");
+        }
+    }
+
+private:
+    std::vector<const void*> containing;  // The containers being written
+
+    void enter(const void* container) {
+        for (const void* outer : containing) {
+            if (outer == container) {
+                throw RuntimeError("cannot marshal a container that contains itself");
+            }
+        }
+        containing.push_back(container);
+    }
+
+    void leave() { containing.pop_back(); }
+
+    void writeList(const PyList& list) {
+        switch (list.storage()) {
+            case PyList::Storage::INT:
+                bytes(Tag::INT_LIST, list.intData().data(), list.size() * sizeof(long long));
+                return;
+            case PyList::Storage::FLOAT:
+                bytes(Tag::FLOAT_LIST, list.floatData().data(), list.size() * sizeof(double));
+                return;
+            default:
+                pod<Tag>(Tag::LIST);
+                pod<uint64_t>(list.size());
+                for (size_t i = 0; i < list.size(); i++) {
+                    value(list.get(i));
+                }
+        }
+    }
+};
+
+class Reader {
+public:
+    Reader(std::string_view data, std::shared_ptr<const SharedSegment> segment)
+        : data(data.data()), end(data.data() + data.size()), segment(std::move(segment)) {}
+
+    bool atEnd() const { return data == end; }
+
+    template<typename T>
+    T pod() {
+        if (static_cast<size_t>(end - data) < sizeof(T)) throw RuntimeError("bad marshal data");
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+
+    // The bytes written by Writer::bytes, after their tag. `shared` is set
+    // if they are in the segment.
+    std::string_view bytes(bool* shared = nullptr) {
+        Placement placement = pod<Placement>();
+        if (shared) *shared = placement == Placement::SHARED;
+        if (placement == Placement::SHARED) {
+            uint64_t offset = pod<uint64_t>();
+            uint64_t size = pod<uint64_t>();
+            if (!segment) throw RuntimeError("bad marshal data");
+            return segment->view(offset, size);
+        }
+        if (placement != Placement::INLINE) throw RuntimeError("bad marshal data");
+        uint64_t size = pod<uint64_t>();
+        if (static_cast<uint64_t>(end - data) < size) throw RuntimeError("bad marshal data");
+        std::string_view bytes(data, size);
+        data += size;
+        return bytes;
+    }
+
+    template<typename T>
+    std::vector<T> elements(std::string_view raw) {
+        if (raw.size() % sizeof(T) != 0) throw RuntimeError("bad marshal data");
+        std::vector<T> elements(raw.size() / sizeof(T));
+        std::memcpy(elements.data(), raw.data(), raw.size());
+        return elements;
+    }
+
+    // An array, borrowing its elements from the segment if they are there
+    template<typename T>
+    PyValue array() {
+        bool shared = false;
+        std::string_view raw = bytes(&shared);
+        if (raw.size() % sizeof(T) != 0) throw RuntimeError("bad marshal data");
+        if (shared && reinterpret_cast<uintptr_t>(raw.data()) % alignof(T) == 0) {
+            return std::make_shared<PyArray>(std::shared_ptr<const void>(segment),
+                                             reinterpret_cast<const T*>(raw.data()),
+                                             raw.size() / sizeof(T));
+        }
+        return std::make_shared<PyArray>(PyArray::Data(elements<T>(raw)));
+    }
+
+    // A container count, checked against the bytes left so a corrupt
+    // count cannot make us reserve huge amounts of memory
+    uint64_t count() {
+        uint64_t count = pod<uint64_t>();
+        if (count > static_cast<uint64_t>(end - data)) throw RuntimeError("bad marshal data");
+        return count;
+    }
+
+    PyValue value() {
+        switch (pod<Tag>()) {
+            case Tag::NONE: return PyNone{};
+            case Tag::FALSE: return false;
+            case Tag::TRUE: return true;
+            case Tag::INTEGER: return static_cast<long long>(pod<int64_t>());
+            case Tag::FLOAT: return pod<double>();
+            case Tag::STRING: return std::string(bytes());
+            case Tag::RANGE: {
+                long long start = pod<int64_t>();
+                long long stop = pod<int64_t>();
+                long long step = pod<int64_t>();
+                if (step == 0) throw RuntimeError("bad marshal data");
+                return PyRange{start, stop, step};
+            }
+            case Tag::LIST: {
+                uint64_t size = count();
+                auto list = std::make_shared<PyList>();
+                list->reserve(size);
+                for (uint64_t i = 0; i < size; i++) list->append(value());
+                return list;
+            }
+            case Tag::INT_LIST: {
+                auto list = std::make_shared<PyList>();
+                std::vector<long long> items = elements<long long>(bytes());
+                list->reserve(items.size());
+                for (long long item : items) list->append(item);
+                return list;
+            }
+            case Tag::FLOAT_LIST: {
+                auto list = std::make_shared<PyList>();
+                std::vector<double> items = elements<double>(bytes());
+                list->reserve(items.size());
+                for (double item : items) list->append(item);
+                return list;
+            }
+            case Tag::DICT: {
+                uint64_t size = count();
+                auto dict = std::make_shared<PyDict>();
+                for (uint64_t i = 0; i < size; i++) {
+                    PyValue key = value();
+                    dict->table.findOrInsert(key).value = value();
+                }
+                return dict;
+            }
+            case Tag::SET: {
+                uint64_t size = count();
+                auto set = std::make_shared<PySet>();
+                for (uint64_t i = 0; i < size; i++) set->table.findOrInsert(value());
+                return set;
+            }
+            case Tag::INT_ARRAY: return array<long long>();
+            case Tag::FLOAT_ARRAY: return array<double>();
+            default:
+                throw RuntimeError("bad marshal data");
+        }
+    }
+
+private:
+    const char* data;
+    const char* end;
+    std::shared_ptr<const SharedSegment> segment;
+};
+
+}  // namespace
+
+std::string Marshal::dump(const PyValue& value, std::unique_ptr<SharedSegment>* segment) {
+    Writer writer(segment);
+    writer.value(value);
+    return std::move(writer.out);
+}
+
+PyValue Marshal::load(std::string_view data, std::shared_ptr<const SharedSegment> segment) {
+    Reader reader(data, std::move(segment));
+    PyValue value = reader.value();
+    if (!reader.atEnd()) throw RuntimeError("bad marshal data");
+    return value;
+}
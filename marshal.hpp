@@ -0,0 +1,72 @@
+#ifndef MARSHAL_HPP
+#define MARSHAL_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include "value.hpp"
+
+// A memfd-backed memory segment that carries the large parts of one
+// message between a process and the workers it forks. The sender appends
+// blobs to a fresh segment and passes its descriptor along with the
+// message (see ProcessPool); the receiver maps it read-only, and arrays
+// decoded from the message read their elements in place from that
+// mapping, which stays until the last of them is gone.
+class SharedSegment {
+public:
+    // A new, empty segment to append to
+    SharedSegment();
+    // Maps the segment behind a descriptor received from the other side,
+    // and takes over the descriptor. Throws RuntimeError if it cannot.
+    explicit SharedSegment(int fd);
+    ~SharedSegment();
+
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    // Copies `size` bytes into the segment, growing it if needed, and
+    // returns their offset, which is aligned for any element type
+    size_t append(const char* data, size_t size);
+
+    // Trims the segment to what was appended and returns its descriptor,
+    // to send. The descriptor stays owned by the segment.
+    int finish();
+
+    // The bytes at [offset, offset + size). Throws RuntimeError if out of
+    // range.
+    std::string_view view(size_t offset, size_t size) const;
+
+private:
+    int fd = -1;
+    char* base = nullptr;
+    size_t mapped = 0;
+    size_t used = 0;
+
+    void remap(size_t size, int protection);
+};
+
+// Compact binary encoding of PyValues for passing between processes:
+// None, bools, ints, floats, strings, ranges, and lists, dicts, sets and
+// arrays of them. Lists of ints or floats and arrays are written as raw
+// packed elements. Given a segment, strings and packed data of at least
+// sharedThreshold bytes are placed in it and the encoding refers to them.
+class Marshal {
+public:
+    static constexpr size_t sharedThreshold = 64 * 1024;
+
+    // Throws RuntimeError for functions, modules, generators and other
+    // values that only mean something inside one interpreter, and for
+    // containers that contain themselves. Given `segment`, a new segment
+    // is made there for the first large payload (it stays null if the
+    // value has none).
+    static std::string dump(const PyValue& value,
+                            std::unique_ptr<SharedSegment>* segment = nullptr);
+
+    // Arrays whose elements are in `segment` borrow them and keep it
+    // mapped; strings and lists are copied out. Throws RuntimeError if
+    // the data is malformed.
+    static PyValue load(std::string_view data,
+                        std::shared_ptr<const SharedSegment> segment = nullptr);
+};
+
+#endif // MARSHAL_HPP
@@ -0,0 +1,116 @@
+#include "object.hpp"
+#include <utility>
+
+PyClass::PyClass(std::string name, const Interpreter* definer)
+    : name(std::move(name)), definedBy(definer) {
+    track();
+}
+
+uint32_t PyClass::attributeSlot(const std::string& name) const {
+    auto found = slots.find(name);
+    return found == slots.end() ? Shape::notFound : found->second;
+}
+
+void PyClass::setAttribute(const std::string& name, PyValue value) {
+    auto [found, added] = slots.emplace(name, static_cast<uint32_t>(attributes.size()));
+    if (added) {
+        attributes.push_back(std::move(value));
+        if (name == "__init__") initSlot = found->second;
+    } else {
+        attributes[found->second] = std::move(value);
+    }
+}
+
+std::vector<std::string> PyClass::attributeNames() const {
+    std::vector<std::string> names(attributes.size());
+    for (const auto& [name, slot] : slots) names[slot] = name;
+    return names;
+}
+
+void PyClass::noteInstanceSize(uint32_t size) {
+    uint32_t largest = largestInstance.load(std::memory_order_relaxed);
+    while (size > largest &&
+           !largestInstance.compare_exchange_weak(largest, size, std::memory_order_relaxed)) {}
+}
+
+void PyClass::traverse(Visit visit, void* context) const {
+    for (const PyValue& value : attributes) {
+        visitValue(value, visit, context);
+    }
+}
+
+void PyClass::clearReferences() {
+    std::vector<PyValue> doomed;
+    doomed.swap(attributes);  // Freed once the class is consistent again
+    slots.clear();
+    initSlot = Shape::notFound;
+}
+
+PyInstance::PyInstance(std::shared_ptr<PyClass> type)
+    : cls(std::move(type)), layout(cls->rootShape()) {
+    values.reserve(cls->expectedSize());
+    track();
+}
+
+bool PyInstance::lookupSlow(const std::string& name, InlineCache& cache,
+                            AttributeSlot& slot) const {
+    uint32_t index = layout->find(name);
+    if (index != Shape::notFound) {
+        slot = AttributeSlot{false, index};
+    } else {
+        // Not on the instance, which its shape records, so a class slot
+        // is as good as the shape
+        index = cls->attributeSlot(name);
+        if (index == Shape::notFound) return false;
+        slot = AttributeSlot{true, index};
+    }
+    cache.add(layout->id(), slot);
+    return true;
+}
+
+void PyInstance::set(const std::string& name, PyValue value, InlineCache& cache) {
+    AttributeSlot slot;
+    if (cache.find(layout->id(), slot) && !slot.inClass) {
+        values[slot.index] = std::move(value);
+        return;
+    }
+    uint32_t index = layout->find(name);
+    if (index != Shape::notFound) {
+        cache.add(layout->id(), AttributeSlot{false, index});
+        values[index] = std::move(value);
+        return;
+    }
+    // A new attribute: on to the next shape, shared with every instance
+    // that added the same names in the same order
+    layout = layout->withAttribute(name);
+    values.push_back(std::move(value));
+    cls->noteInstanceSize(layout->size());
+}
+
+std::shared_ptr<PyInstance> PyInstance::shallowCopy(std::shared_ptr<PyClass> type) const {
+    auto copy = std::make_shared<PyInstance>(std::move(type));
+    if (copy->cls == cls) {
+        copy->layout = layout;
+    } else {
+        // Another class has its own shape tree; walk it by the same names
+        for (uint32_t i = 0; i < layout->size(); i++) {
+            copy->layout = copy->layout->withAttribute(layout->nameAt(i));
+        }
+        copy->cls->noteInstanceSize(layout->size());
+    }
+    copy->values = values;
+    return copy;
+}
+
+void PyInstance::traverse(Visit visit, void* context) const {
+    visit(cls.get(), context);
+    for (const PyValue& value : values) {
+        visitValue(value, visit, context);
+    }
+}
+
+void PyInstance::clearReferences() {
+    std::vector<PyValue> doomed;
+    doomed.swap(values);  // Freed once the instance is consistent again
+    layout = cls->rootShape();
+}
@@ -0,0 +1,120 @@
+#ifndef OBJECT_HPP
+#define OBJECT_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gc.hpp"
+#include "shape.hpp"
+#include "value.hpp"
+
+class Interpreter;
+
+// A class made by a class statement: its attributes (the methods and the
+// values assigned in its body), and the root of the shape tree its
+// instances move through. Like an instance's, the attributes live in a
+// dense array; a name keeps its slot once added, so a cached class slot
+// stays valid. Methods can refer back to the class, so classes are
+// tracked by the collector.
+//
+// Classes are not copied for each thread that runs a task or a pmap
+// worker, so other threads may be reading one: only the interpreter that
+// defined it sets its attributes afterwards.
+class PyClass : public GcObject, public std::enable_shared_from_this<PyClass> {
+public:
+    const std::string name;
+
+    // `definer` is the interpreter whose class statement made the class,
+    // or null for a copy made for a task scope, which nothing may change
+    explicit PyClass(std::string name, const Interpreter* definer = nullptr);
+    ~PyClass() override { untrack(); }
+
+    Shape* rootShape() { return &root; }
+    const Interpreter* definer() const { return definedBy; }
+
+    // The slot of attribute `name`, or Shape::notFound
+    uint32_t attributeSlot(const std::string& name) const;
+    const PyValue& attributeAt(uint32_t slot) const { return attributes[slot]; }
+    void setAttribute(const std::string& name, PyValue value);
+
+    // The attribute names, in slot order
+    std::vector<std::string> attributeNames() const;
+
+    // __init__, or null if the class has none
+    const PyValue* initializer() const {
+        return initSlot == Shape::notFound ? nullptr : &attributes[initSlot];
+    }
+
+    // The most attributes an instance has had, which new instances reserve
+    // room for up front
+    uint32_t expectedSize() const { return largestInstance.load(std::memory_order_relaxed); }
+    void noteInstanceSize(uint32_t size);
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+
+private:
+    const Interpreter* definedBy;
+    Shape root;
+    std::unordered_map<std::string, uint32_t> slots;
+    std::vector<PyValue> attributes;
+    uint32_t initSlot = Shape::notFound;
+    std::atomic<uint32_t> largestInstance{0};
+};
+
+// An instance of a PyClass. Its attributes are the values of its shape's
+// names, slot by slot; an attribute it does not have is looked up on the
+// class. Lookups go through the inline cache of the site doing them, so a
+// site that keeps seeing instances of one shape reads the slot directly.
+class PyInstance : public GcObject, public std::enable_shared_from_this<PyInstance> {
+public:
+    explicit PyInstance(std::shared_ptr<PyClass> type);
+    ~PyInstance() override { untrack(); }
+
+    const std::shared_ptr<PyClass>& type() const { return cls; }
+    const Shape& shape() const { return *layout; }
+
+    // Where attribute `name` is, through and into `cache`; false if
+    // neither the instance nor its class has it
+    bool lookup(const std::string& name, InlineCache& cache, AttributeSlot& slot) const {
+        if (cache.find(layout->id(), slot)) return true;
+        return lookupSlow(name, cache, slot);
+    }
+    const PyValue& get(AttributeSlot slot) const {
+        return slot.inClass ? cls->attributeAt(slot.index) : values[slot.index];
+    }
+
+    // Assigns attribute `name` on the instance (never the class), adding
+    // it if needed, through and into `cache`
+    void set(const std::string& name, PyValue value, InlineCache& cache);
+
+    // The instance's own attributes, in the order its shape names them
+    uint32_t slotCount() const { return static_cast<uint32_t>(values.size()); }
+    const PyValue& slot(uint32_t index) const { return values[index]; }
+    void setSlot(uint32_t index, PyValue value) { values[index] = std::move(value); }
+
+    // A new instance of `type` with the same attribute names, in the same
+    // order, sharing the values. For the instance's own class, the copy
+    // takes its shape as is.
+    std::shared_ptr<PyInstance> shallowCopy(std::shared_ptr<PyClass> type) const;
+
+protected:
+    void traverse(Visit visit, void* context) const override;
+    void clearReferences() override;
+    long useCount() const override { return weak_from_this().use_count(); }
+    std::shared_ptr<void> retain() override { return weak_from_this().lock(); }
+
+private:
+    bool lookupSlow(const std::string& name, InlineCache& cache, AttributeSlot& slot) const;
+
+    std::shared_ptr<PyClass> cls;
+    Shape* layout;
+    std::vector<PyValue> values;
+};
+
+#endif // OBJECT_HPP
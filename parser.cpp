@@ -1,7 +1,38 @@
 #include "parser.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
 #include <sstream>
+#include <thread>
 
-Parser::Parser(std::vector<Token> tokens) : tokens(std::move(tokens)) {}
+Parser::Parser(std::vector<Token> tokens, bool lazyFunctionBodies)
+    : tokenStore(std::make_shared<const std::vector<Token>>(std::move(tokens))),
+      tokens(*tokenStore), lazyFunctionBodies(lazyFunctionBodies) {}
+
+Parser::Parser(std::shared_ptr<const std::vector<Token>> tokens, size_t start,
+               bool lazyFunctionBodies)
+    : tokenStore(std::move(tokens)), tokens(*tokenStore), current(start),
+      lazyFunctionBodies(lazyFunctionBodies) {}
+
+Module Parser::parseDeferredBody(const DeferredBody& body, bool isAsync) {
+    Parser parser(body.tokens, body.begin, true);
+    parser.functionDepth = 1;
+    parser.inAsync = isAsync;
+    parser.module.statements = parser.block();
+    return std::move(parser.module);
+}
+
+const std::vector<Stmt>& FunctionStmt::body() const {
+    if (deferredBody.tokens) {
+        std::call_once(bodyParsed, [this] {
+            Module body = Parser::parseDeferredBody(deferredBody, isAsync);
+            parsedBody = std::move(body.statements);
+            bodyArena = std::move(body.arena);
+        });
+    }
+    return parsedBody;
+}
 
 bool Parser::isAtEnd() const {
     return peek().type == TokenType::END_OF_FILE;
@@ -15,7 +46,7 @@ const Token& Parser::previous() const {
     return tokens[current - 1];
 }
 
-Token Parser::advance() {
+const Token& Parser::advance() {
     if (!isAtEnd()) current++;
     return previous();
 }
@@ -42,7 +73,7 @@ bool Parser::match(TokenType first, Types... rest) {
     return false;
 }
 
-Token Parser::consume(TokenType type, const std::string& message) {
+const Token& Parser::consume(TokenType type, const std::string& message) {
     if (check(type)) return advance();
     throw error(peek(), message);
 }
@@ -67,10 +98,13 @@ void Parser::synchronize() {
 
         switch (peek().type) {
             case TokenType::DEF:
+            case TokenType::ASYNC:
+            case TokenType::CLASS:
             case TokenType::IF:
             case TokenType::WHILE:
             case TokenType::FOR:
             case TokenType::RETURN:
+            case TokenType::YIELD:
             case TokenType::PRINT:
                 return;
             default:
@@ -85,8 +119,8 @@ void Parser::skipNewlines() {
     while (match(TokenType::NEWLINE)) {}
 }
 
-std::vector<Stmt> Parser::parse() {
-    std::vector<Stmt> statements;
+Module Parser::parse() {
+    std::vector<Stmt>& statements = module.statements;
 
     skipNewlines();
 
@@ -99,12 +133,132 @@ std::vector<Stmt> Parser::parse() {
         skipNewlines();
     }
 
-    return statements;
+    return std::move(module);
+}
+
+bool Parser::startsStatement(TokenType type) {
+    switch (type) {
+        case TokenType::DEF:
+        case TokenType::ASYNC:
+        case TokenType::CLASS:
+        case TokenType::IF:
+        case TokenType::WHILE:
+        case TokenType::FOR:
+        case TokenType::RETURN:
+        case TokenType::YIELD:
+        case TokenType::ASSERT:
+        case TokenType::PRINT:
+            return true;
+        default:
+            // Anything else that starts a statement is an expression
+            return getRule(type).prefix != nullptr;
+    }
+}
+
+Module Parser::parseParallel(const std::vector<Token>& tokens, unsigned workers,
+                             bool lazyFunctionBodies, ParallelParseStats* stats) {
+    // Top-level statement starts: depth 0, just after a NEWLINE or DEDENT,
+    // and on a token that can begin a statement. That rules out the INDENT
+    // opening a block after its header's NEWLINE, and elif/else, which
+    // continue the preceding if.
+    std::vector<size_t> starts;
+    starts.push_back(0);
+    int depth = 0;
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        TokenType type = tokens[i].type;
+        if (type == TokenType::INDENT) depth++;
+        if (type == TokenType::DEDENT) depth--;
+        if (depth != 0 || (type != TokenType::NEWLINE && type != TokenType::DEDENT)) {
+            continue;
+        }
+        if (startsStatement(tokens[i + 1].type)) {
+            starts.push_back(i + 1);
+        }
+    }
+
+    // Group statements into a few chunks per worker of similar token count
+    size_t eof = tokens.size() - 1;
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(starts.size(), workers * 4));
+    size_t targetSize = eof / chunkCount + 1;
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t chunkBegin = 0;
+    for (size_t i = 1; i < starts.size(); i++) {
+        if (starts[i] - chunkBegin >= targetSize) {
+            chunks.emplace_back(chunkBegin, starts[i]);
+            chunkBegin = starts[i];
+        }
+    }
+    chunks.emplace_back(chunkBegin, eof);
+
+    if (stats) {
+        *stats = ParallelParseStats{};
+    }
+    if (workers <= 1 || chunks.size() == 1) {
+        return Parser(tokens, lazyFunctionBodies).parse();
+    }
+    if (stats) {
+        stats->chunks = chunks.size();
+    }
+
+    std::vector<Module> results(chunks.size());
+    std::vector<std::exception_ptr> failures(chunks.size());
+    std::atomic<size_t> nextChunk{0};
+
+    auto worker = [&] {
+        for (size_t i = nextChunk++; i < chunks.size(); i = nextChunk++) {
+            std::vector<Token> chunkTokens(tokens.begin() + chunks[i].first,
+                                           tokens.begin() + chunks[i].second);
+            chunkTokens.push_back(tokens.back());
+            try {
+                results[i] = Parser(std::move(chunkTokens), lazyFunctionBodies).parse();
+            } catch (...) {
+                failures[i] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    unsigned threadCount = std::min<unsigned>(workers, static_cast<unsigned>(chunks.size()));
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    Module module;
+    auto append = [&module](Module chunk) {
+        module.statements.insert(module.statements.end(), chunk.statements.begin(),
+                                 chunk.statements.end());
+        module.arena->adopt(std::move(*chunk.arena));
+    };
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (failures[i]) {
+            // A chunk only sees its own tokens; re-parse the rest of the
+            // module as parse() would have to get the same outcome.
+            std::vector<Token> rest(tokens.begin() + chunks[i].first, tokens.end());
+            if (stats) {
+                stats->reparsedChunks = chunks.size() - i;
+            }
+            append(Parser(std::move(rest), lazyFunctionBodies).parse());
+            return module;
+        }
+        append(std::move(results[i]));
+    }
+
+    return module;
 }
 
 Stmt Parser::declaration() {
     if (match(TokenType::DEF)) {
-        return functionDeclaration();
+        return functionDeclaration(false);
+    }
+    if (match(TokenType::ASYNC)) {
+        consume(TokenType::DEF, "Expected 'def' after 'async'");
+        return functionDeclaration(true);
+    }
+    if (match(TokenType::CLASS)) {
+        return classDeclaration();
     }
     return statement();
 }
@@ -119,9 +273,15 @@ Stmt Parser::statement() {
     if (match(TokenType::WHILE)) {
         return whileStatement();
     }
+    if (match(TokenType::FOR)) {
+        return forStatement();
+    }
     if (match(TokenType::RETURN)) {
         return returnStatement();
     }
+    if (match(TokenType::YIELD)) {
+        return yieldStatement();
+    }
     if (match(TokenType::ASSERT)) {
         return assertStatement();
     }
@@ -134,16 +294,15 @@ Stmt Parser::expressionStatement() {
     // Handle compound assignment
     if (match(TokenType::PLUS_ASSIGN, TokenType::MINUS_ASSIGN,
               TokenType::STAR_ASSIGN, TokenType::SLASH_ASSIGN)) {
-        Token op = previous();
+        const Token& op = previous();
 
-        // expr must be a variable
-        if (!std::holds_alternative<std::unique_ptr<VariableExpr>>(expr)) {
+        // expr must be a variable, a subscript or an attribute
+        if (!std::holds_alternative<NodePtr<VariableExpr>>(expr) &&
+            !std::holds_alternative<NodePtr<IndexExpr>>(expr) &&
+            !std::holds_alternative<NodePtr<GetExpr>>(expr)) {
             throw error(op, "Invalid assignment target");
         }
 
-        auto& varExpr = std::get<std::unique_ptr<VariableExpr>>(expr);
-        Token name = varExpr->name;
-
         Expr value = expression();
 
         // Convert compound assignment to binary operation
@@ -156,22 +315,41 @@ Stmt Parser::expressionStatement() {
             default: binOp = TokenType::PLUS; break;
         }
 
-        Token binToken(binOp, op.lexeme.substr(0, 1), op.line, op.column);
+        OpToken binToken(binOp, op.line, op.column);
 
-        Expr varRef = std::make_unique<VariableExpr>(name);
-        Expr binExpr = std::make_unique<BinaryExpr>(
+        if (std::holds_alternative<NodePtr<IndexExpr>>(expr)) {
+            // a[i] op= value evaluates a and i once
+            auto& indexExpr = std::get<NodePtr<IndexExpr>>(expr);
+            Expr assignExpr = make<IndexAssignExpr>(
+                std::move(indexExpr->object), indexExpr->bracket,
+                std::move(indexExpr->index), binToken, std::move(value));
+            consume(TokenType::NEWLINE, "Expected newline after statement");
+            return make<ExpressionStmt>(std::move(assignExpr));
+        }
+        if (std::holds_alternative<NodePtr<GetExpr>>(expr)) {
+            // a.x op= value evaluates a once
+            auto& getExpr = std::get<NodePtr<GetExpr>>(expr);
+            Expr assignExpr = make<AttributeAssignExpr>(
+                std::move(getExpr->object), std::move(getExpr->name), binToken, std::move(value));
+            consume(TokenType::NEWLINE, "Expected newline after statement");
+            return make<ExpressionStmt>(std::move(assignExpr));
+        }
+
+        NameToken name = std::get<NodePtr<VariableExpr>>(expr)->name;
+        Expr varRef = make<VariableExpr>(name);
+        Expr binExpr = make<BinaryExpr>(
             std::move(varRef), binToken, std::move(value));
 
         // Use AssignExpr to update existing variable (not create new one)
-        Expr assignExpr = std::make_unique<AssignExpr>(name, std::move(binExpr));
+        Expr assignExpr = make<AssignExpr>(name, std::move(binExpr));
 
         consume(TokenType::NEWLINE, "Expected newline after statement");
 
-        return std::make_unique<ExpressionStmt>(std::move(assignExpr));
+        return make<ExpressionStmt>(std::move(assignExpr));
     }
 
     consume(TokenType::NEWLINE, "Expected newline after expression");
-    return std::make_unique<ExpressionStmt>(std::move(expr));
+    return make<ExpressionStmt>(std::move(expr));
 }
 
 Stmt Parser::printStatement() {
@@ -188,7 +366,7 @@ Stmt Parser::printStatement() {
     consume(TokenType::RPAREN, "Expected ')' after print arguments");
     consume(TokenType::NEWLINE, "Expected newline after print statement");
 
-    return std::make_unique<PrintStmt>(std::move(expressions));
+    return make<PrintStmt>(std::move(expressions));
 }
 
 Stmt Parser::ifStatement() {
@@ -198,7 +376,7 @@ Stmt Parser::ifStatement() {
     consume(TokenType::INDENT, "Expected indented block after if");
 
     std::vector<Stmt> thenStatements = block();
-    Stmt thenBranch = std::make_unique<BlockStmt>(std::move(thenStatements));
+    Stmt thenBranch = make<BlockStmt>(std::move(thenStatements));
 
     std::vector<std::pair<Expr, Stmt>> elifBranches;
 
@@ -209,22 +387,22 @@ Stmt Parser::ifStatement() {
         consume(TokenType::INDENT, "Expected indented block after elif");
 
         std::vector<Stmt> elifStatements = block();
-        Stmt elifBranch = std::make_unique<BlockStmt>(std::move(elifStatements));
+        Stmt elifBranch = make<BlockStmt>(std::move(elifStatements));
         elifBranches.emplace_back(std::move(elifCondition), std::move(elifBranch));
     }
 
-    std::unique_ptr<Stmt> elseBranch = nullptr;
+    NodePtr<Stmt> elseBranch = nullptr;
     if (match(TokenType::ELSE)) {
         consume(TokenType::COLON, "Expected ':' after else");
         consume(TokenType::NEWLINE, "Expected newline after ':'");
         consume(TokenType::INDENT, "Expected indented block after else");
 
         std::vector<Stmt> elseStatements = block();
-        elseBranch = std::make_unique<Stmt>(
-            std::make_unique<BlockStmt>(std::move(elseStatements)));
+        elseBranch = make<Stmt>(
+            make<BlockStmt>(std::move(elseStatements)));
     }
 
-    return std::make_unique<IfStmt>(
+    return make<IfStmt>(
         std::move(condition), std::move(thenBranch),
         std::move(elifBranches), std::move(elseBranch));
 }
@@ -236,16 +414,31 @@ Stmt Parser::whileStatement() {
     consume(TokenType::INDENT, "Expected indented block after while");
 
     std::vector<Stmt> bodyStatements = block();
-    Stmt body = std::make_unique<BlockStmt>(std::move(bodyStatements));
+    Stmt body = make<BlockStmt>(std::move(bodyStatements));
+
+    return make<WhileStmt>(std::move(condition), std::move(body));
+}
+
+Stmt Parser::forStatement() {
+    const Token& keyword = previous();
+    const Token& variable = consume(TokenType::IDENTIFIER, "Expected loop variable after 'for'");
+    consume(TokenType::IN, "Expected 'in' after loop variable");
+    Expr iterable = expression();
+    consume(TokenType::COLON, "Expected ':' after for clause");
+    consume(TokenType::NEWLINE, "Expected newline after ':'");
+    consume(TokenType::INDENT, "Expected indented block after for");
+
+    std::vector<Stmt> bodyStatements = block();
+    Stmt body = make<BlockStmt>(std::move(bodyStatements));
 
-    return std::make_unique<WhileStmt>(std::move(condition), std::move(body));
+    return make<ForStmt>(keyword, variable, std::move(iterable), std::move(body));
 }
 
-Stmt Parser::functionDeclaration() {
-    Token name = consume(TokenType::IDENTIFIER, "Expected function name");
+Stmt Parser::functionDeclaration(bool isAsync) {
+    const Token& name = consume(TokenType::IDENTIFIER, "Expected function name");
     consume(TokenType::LPAREN, "Expected '(' after function name");
 
-    std::vector<Token> params;
+    std::vector<NameToken> params;
     if (!check(TokenType::RPAREN)) {
         do {
             params.push_back(consume(TokenType::IDENTIFIER, "Expected parameter name"));
@@ -257,36 +450,137 @@ Stmt Parser::functionDeclaration() {
     consume(TokenType::NEWLINE, "Expected newline after ':'");
     consume(TokenType::INDENT, "Expected indented block for function body");
 
+    if (lazyFunctionBodies) {
+        // Pre-parse: only find the end of the body, and whether a yield
+        // outside any nested def makes this a generator
+        DeferredBody deferred{tokenStore, current, current};
+        int depth = 1;
+        bool isGenerator = false;
+        std::vector<int> nestedDefs;  // Depths of the enclosing nested defs
+        while (!isAtEnd()) {
+            TokenType type = peek().type;
+            if (type == TokenType::INDENT) {
+                depth++;
+            } else if (type == TokenType::DEDENT) {
+                if (--depth == 0) break;
+                while (!nestedDefs.empty() && nestedDefs.back() >= depth) {
+                    nestedDefs.pop_back();
+                }
+            } else if (type == TokenType::DEF) {
+                nestedDefs.push_back(depth);
+            } else if (type == TokenType::YIELD && nestedDefs.empty()) {
+                if (isAsync) throw error(peek(), "'yield' inside async function");
+                isGenerator = true;
+            }
+            advance();
+        }
+        deferred.end = current;
+        if (!isAtEnd()) {
+            advance();  // Closing DEDENT
+        }
+        return make<FunctionStmt>(name, std::move(params), std::move(deferred),
+                                              isGenerator, isAsync);
+    }
+
+    // A nested def has its own yields, and may await only if it is async
+    bool enclosingSawYield = sawYield;
+    bool enclosingInAsync = inAsync;
+    sawYield = false;
+    inAsync = isAsync;
+    functionDepth++;
     std::vector<Stmt> body = block();
+    functionDepth--;
+    bool isGenerator = sawYield;
+    sawYield = enclosingSawYield;
+    inAsync = enclosingInAsync;
 
-    return std::make_unique<FunctionStmt>(name, std::move(params), std::move(body));
+    return make<FunctionStmt>(name, std::move(params), std::move(body),
+                                          isGenerator, isAsync);
+}
+
+Stmt Parser::classDeclaration() {
+    const Token& name = consume(TokenType::IDENTIFIER, "Expected class name");
+    if (match(TokenType::LPAREN)) {
+        if (!check(TokenType::RPAREN)) throw error(peek(), "Base classes are not supported");
+        advance();
+    }
+    consume(TokenType::COLON, "Expected ':' after class name");
+    consume(TokenType::NEWLINE, "Expected newline after ':'");
+    consume(TokenType::INDENT, "Expected indented block for class body");
+
+    // Methods and attribute assignments only; a docstring is dropped
+    std::vector<Stmt> body;
+    while (!check(TokenType::DEDENT) && !isAtEnd()) {
+        skipNewlines();
+        if (check(TokenType::DEDENT) || isAtEnd()) break;
+        const Token& start = peek();
+        Stmt stmt = declaration();
+        if (std::holds_alternative<NodePtr<FunctionStmt>>(stmt)) {
+            body.push_back(std::move(stmt));
+            continue;
+        }
+        if (const auto* expression = std::get_if<NodePtr<ExpressionStmt>>(&stmt)) {
+            const Expr& expr = (*expression)->expression;
+            if (std::holds_alternative<NodePtr<AssignExpr>>(expr)) {
+                body.push_back(std::move(stmt));
+                continue;
+            }
+            if (std::holds_alternative<NodePtr<LiteralExpr>>(expr)) continue;
+        }
+        throw error(start, "Expected a method or an attribute assignment in class body");
+    }
+    if (!isAtEnd()) {
+        consume(TokenType::DEDENT, "Expected dedent at end of block");
+    }
+
+    return make<ClassStmt>(name, std::move(body));
 }
 
 Stmt Parser::returnStatement() {
-    Token keyword = previous();
-    std::unique_ptr<Expr> value = nullptr;
+    const Token& keyword = previous();
+    NodePtr<Expr> value = nullptr;
 
     if (!check(TokenType::NEWLINE)) {
-        value = std::make_unique<Expr>(expression());
+        value = make<Expr>(expression());
     }
 
     consume(TokenType::NEWLINE, "Expected newline after return");
 
-    return std::make_unique<ReturnStmt>(keyword, std::move(value));
+    return make<ReturnStmt>(keyword, std::move(value));
+}
+
+Stmt Parser::yieldStatement() {
+    const Token& keyword = previous();
+    if (functionDepth == 0) {
+        throw error(keyword, "'yield' outside function");
+    }
+    if (inAsync) {
+        throw error(keyword, "'yield' inside async function");
+    }
+    sawYield = true;
+
+    NodePtr<Expr> value = nullptr;
+    if (!check(TokenType::NEWLINE)) {
+        value = make<Expr>(expression());
+    }
+
+    consume(TokenType::NEWLINE, "Expected newline after yield");
+
+    return make<YieldStmt>(keyword, std::move(value));
 }
 
 Stmt Parser::assertStatement() {
-    Token keyword = previous();
+    const Token& keyword = previous();
     Expr condition = expression();
 
-    std::unique_ptr<Expr> message = nullptr;
+    NodePtr<Expr> message = nullptr;
     if (match(TokenType::COMMA)) {
-        message = std::make_unique<Expr>(expression());
+        message = make<Expr>(expression());
     }
 
     consume(TokenType::NEWLINE, "Expected newline after assert");
 
-    return std::make_unique<AssertStmt>(keyword, std::move(condition), std::move(message));
+    return make<AssertStmt>(keyword, std::move(condition), std::move(message));
 }
 
 std::vector<Stmt> Parser::block() {
@@ -312,16 +606,27 @@ Expr Parser::expression() {
 }
 
 Expr Parser::assignment() {
-    Expr expr = orExpr();
+    Expr expr = parsePrecedence(Precedence::OR);
 
     if (match(TokenType::ASSIGN)) {
-        Token equals = previous();
+        const Token& equals = previous();
         Expr value = assignment();
 
-        if (std::holds_alternative<std::unique_ptr<VariableExpr>>(expr)) {
-            auto& varExpr = std::get<std::unique_ptr<VariableExpr>>(expr);
-            Token name = varExpr->name;
-            return std::make_unique<AssignExpr>(name, std::move(value));
+        if (std::holds_alternative<NodePtr<VariableExpr>>(expr)) {
+            auto& varExpr = std::get<NodePtr<VariableExpr>>(expr);
+            return make<AssignExpr>(varExpr->name, std::move(value));
+        }
+        if (std::holds_alternative<NodePtr<IndexExpr>>(expr)) {
+            auto& indexExpr = std::get<NodePtr<IndexExpr>>(expr);
+            return make<IndexAssignExpr>(
+                std::move(indexExpr->object), indexExpr->bracket, std::move(indexExpr->index),
+                OpToken(equals), std::move(value));
+        }
+        if (std::holds_alternative<NodePtr<GetExpr>>(expr)) {
+            auto& getExpr = std::get<NodePtr<GetExpr>>(expr);
+            return make<AttributeAssignExpr>(
+                std::move(getExpr->object), std::move(getExpr->name), OpToken(equals),
+                std::move(value));
         }
 
         throw error(equals, "Invalid assignment target");
@@ -330,115 +635,159 @@ Expr Parser::assignment() {
     return expr;
 }
 
-Expr Parser::orExpr() {
-    Expr expr = andExpr();
-
-    while (match(TokenType::OR)) {
-        Token op = previous();
-        Expr right = andExpr();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+namespace {
+
+constexpr size_t tokenTypeCount = static_cast<size_t>(TokenType::INVALID) + 1;
+
+} // namespace
+
+const Parser::ParseRule& Parser::getRule(TokenType type) {
+    static const auto rules = [] {
+        std::array<ParseRule, tokenTypeCount> table{};
+
+        auto prefix = [&](TokenType type, PrefixFn fn, Precedence precedence) {
+            table[static_cast<size_t>(type)].prefix = fn;
+            table[static_cast<size_t>(type)].prefixPrecedence = precedence;
+        };
+        auto infix = [&](TokenType type, InfixFn fn, Precedence precedence,
+                         Precedence rightPrecedence) {
+            table[static_cast<size_t>(type)].infix = fn;
+            table[static_cast<size_t>(type)].precedence = precedence;
+            table[static_cast<size_t>(type)].rightPrecedence = rightPrecedence;
+        };
+
+        prefix(TokenType::INTEGER, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::FLOAT, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::STRING, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::TRUE, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::FALSE, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::NONE, &Parser::literal, Precedence::PRIMARY);
+        prefix(TokenType::IDENTIFIER, &Parser::variable, Precedence::PRIMARY);
+        prefix(TokenType::LPAREN, &Parser::grouping, Precedence::PRIMARY);
+        prefix(TokenType::LBRACKET, &Parser::list, Precedence::PRIMARY);
+        prefix(TokenType::LBRACE, &Parser::braces, Precedence::PRIMARY);
+        prefix(TokenType::MINUS, &Parser::unary, Precedence::UNARY);
+        prefix(TokenType::NOT, &Parser::unary, Precedence::NOT);
+        // await binds tighter than any operator: await f() ** 2 is
+        // (await f()) ** 2
+        prefix(TokenType::AWAIT, &Parser::awaitExpr, Precedence::UNARY);
+
+        // Left-associative operators parse their right operand one level
+        // tighter; ** takes a unary operand so that 2 ** -1 and 2 ** 3 ** 2
+        // (right-associative) both work.
+        infix(TokenType::OR, &Parser::binary, Precedence::OR, Precedence::AND);
+        infix(TokenType::AND, &Parser::binary, Precedence::AND, Precedence::NOT);
+        infix(TokenType::EQ, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::NE, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::LT, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::LE, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::GT, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::GE, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::IN, &Parser::binary, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::NOT, &Parser::notIn, Precedence::COMPARISON, Precedence::TERM);
+        infix(TokenType::PLUS, &Parser::binary, Precedence::TERM, Precedence::FACTOR);
+        infix(TokenType::MINUS, &Parser::binary, Precedence::TERM, Precedence::FACTOR);
+        infix(TokenType::STAR, &Parser::binary, Precedence::FACTOR, Precedence::UNARY);
+        infix(TokenType::SLASH, &Parser::binary, Precedence::FACTOR, Precedence::UNARY);
+        infix(TokenType::DOUBLE_SLASH, &Parser::binary, Precedence::FACTOR, Precedence::UNARY);
+        infix(TokenType::PERCENT, &Parser::binary, Precedence::FACTOR, Precedence::UNARY);
+        infix(TokenType::DOUBLE_STAR, &Parser::binary, Precedence::POWER, Precedence::UNARY);
+        infix(TokenType::LPAREN, &Parser::call, Precedence::CALL, Precedence::NONE);
+        infix(TokenType::DOT, &Parser::attribute, Precedence::CALL, Precedence::NONE);
+        infix(TokenType::LBRACKET, &Parser::subscript, Precedence::CALL, Precedence::NONE);
+
+        return table;
+    }();
+
+    return rules[static_cast<size_t>(type)];
+}
+
+Expr Parser::parsePrecedence(Precedence precedence) {
+    const ParseRule& prefixRule = getRule(peek().type);
+    if (!prefixRule.prefix || prefixRule.prefixPrecedence < precedence) {
+        throw error(peek(), "Expected expression");
     }
 
-    return expr;
-}
-
-Expr Parser::andExpr() {
-    Expr expr = notExpr();
+    advance();
+    Expr expr = (this->*prefixRule.prefix)();
 
-    while (match(TokenType::AND)) {
-        Token op = previous();
-        Expr right = notExpr();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+    while (true) {
+        const ParseRule& infixRule = getRule(peek().type);
+        if (!infixRule.infix || infixRule.precedence < precedence) {
+            break;
+        }
+        advance();
+        expr = (this->*infixRule.infix)(std::move(expr));
     }
 
     return expr;
 }
 
-Expr Parser::notExpr() {
-    if (match(TokenType::NOT)) {
-        Token op = previous();
-        Expr operand = notExpr();
-        return std::make_unique<UnaryExpr>(op, std::move(operand));
-    }
-
-    return comparison();
-}
-
-Expr Parser::comparison() {
-    Expr expr = term();
+Expr Parser::literal() {
+    const Token& token = previous();
 
-    while (match(TokenType::LT, TokenType::LE, TokenType::GT,
-                 TokenType::GE, TokenType::EQ, TokenType::NE)) {
-        Token op = previous();
-        Expr right = term();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+    switch (token.type) {
+        case TokenType::TRUE:
+            return make<LiteralExpr>(true);
+        case TokenType::FALSE:
+            return make<LiteralExpr>(false);
+        case TokenType::INTEGER:
+            return make<LiteralExpr>(std::get<long long>(token.literal));
+        case TokenType::FLOAT:
+            return make<LiteralExpr>(std::get<double>(token.literal));
+        case TokenType::STRING:
+            return make<LiteralExpr>(std::get<std::string>(token.literal));
+        default:
+            return make<LiteralExpr>(PyNone{});
     }
-
-    return expr;
 }
 
-Expr Parser::term() {
-    Expr expr = factor();
-
-    while (match(TokenType::PLUS, TokenType::MINUS)) {
-        Token op = previous();
-        Expr right = factor();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
-    }
+Expr Parser::variable() {
+    return make<VariableExpr>(previous());
+}
 
-    return expr;
+Expr Parser::grouping() {
+    Expr expr = expression();
+    consume(TokenType::RPAREN, "Expected ')' after expression");
+    return make<GroupingExpr>(std::move(expr));
 }
 
-Expr Parser::factor() {
-    Expr expr = unary();
+Expr Parser::list() {
+    const Token& bracket = previous();
+    std::vector<Expr> elements;
 
-    while (match(TokenType::STAR, TokenType::SLASH,
-                 TokenType::DOUBLE_SLASH, TokenType::PERCENT)) {
-        Token op = previous();
-        Expr right = unary();
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+    // Elements are comma separated, with an optional trailing comma
+    while (!check(TokenType::RBRACKET)) {
+        elements.push_back(expression());
+        if (!match(TokenType::COMMA)) break;
     }
+    consume(TokenType::RBRACKET, "Expected ']' after list elements");
 
-    return expr;
+    return make<ListExpr>(bracket, std::move(elements));
 }
 
 Expr Parser::unary() {
-    if (match(TokenType::MINUS)) {
-        Token op = previous();
-        Expr operand = unary();
-        return std::make_unique<UnaryExpr>(op, std::move(operand));
-    }
-
-    return power();
+    const Token& op = previous();
+    Expr operand = parsePrecedence(getRule(op.type).prefixPrecedence);
+    return make<UnaryExpr>(op, std::move(operand));
 }
 
-Expr Parser::power() {
-    Expr expr = call();
-
-    if (match(TokenType::DOUBLE_STAR)) {
-        Token op = previous();
-        Expr right = unary(); // Right-associative
-        expr = std::make_unique<BinaryExpr>(std::move(expr), op, std::move(right));
+Expr Parser::awaitExpr() {
+    const Token& keyword = previous();
+    if (!inAsync) {
+        throw error(keyword, "'await' outside async function");
     }
-
-    return expr;
+    Expr operand = parsePrecedence(Precedence::CALL);
+    return make<AwaitExpr>(keyword, std::move(operand));
 }
 
-Expr Parser::call() {
-    Expr expr = primary();
-
-    while (true) {
-        if (match(TokenType::LPAREN)) {
-            expr = finishCall(std::move(expr));
-        } else {
-            break;
-        }
-    }
-
-    return expr;
+Expr Parser::binary(Expr left) {
+    const Token& op = previous();
+    Expr right = parsePrecedence(getRule(op.type).rightPrecedence);
+    return make<BinaryExpr>(std::move(left), op, std::move(right));
 }
 
-Expr Parser::finishCall(Expr callee) {
+Expr Parser::call(Expr callee) {
     std::vector<Expr> arguments;
 
     if (!check(TokenType::RPAREN)) {
@@ -447,44 +796,82 @@ Expr Parser::finishCall(Expr callee) {
         } while (match(TokenType::COMMA));
     }
 
-    Token paren = consume(TokenType::RPAREN, "Expected ')' after arguments");
+    const Token& paren = consume(TokenType::RPAREN, "Expected ')' after arguments");
 
-    return std::make_unique<CallExpr>(std::move(callee), paren, std::move(arguments));
+    return make<CallExpr>(std::move(callee), paren, std::move(arguments));
 }
 
-Expr Parser::primary() {
-    if (match(TokenType::TRUE)) {
-        return std::make_unique<LiteralExpr>(true);
-    }
-    if (match(TokenType::FALSE)) {
-        return std::make_unique<LiteralExpr>(false);
-    }
-    if (match(TokenType::NONE)) {
-        return std::make_unique<LiteralExpr>(PyNone{});
-    }
+Expr Parser::braces() {
+    const Token& brace = previous();
+    std::vector<Expr> keys;
+    std::vector<Expr> values;
 
-    if (match(TokenType::INTEGER)) {
-        return std::make_unique<LiteralExpr>(
-            std::get<long long>(previous().literal));
+    if (match(TokenType::RBRACE)) {
+        return make<DictExpr>(brace, std::move(keys), std::move(values));
     }
-    if (match(TokenType::FLOAT)) {
-        return std::make_unique<LiteralExpr>(
-            std::get<double>(previous().literal));
+
+    Expr first = expression();
+    if (!match(TokenType::COLON)) {
+        // Set display
+        std::vector<Expr> elements;
+        elements.push_back(std::move(first));
+        while (match(TokenType::COMMA) && !check(TokenType::RBRACE)) {
+            elements.push_back(expression());
+        }
+        consume(TokenType::RBRACE, "Expected '}' after set elements");
+        return make<SetExpr>(brace, std::move(elements));
     }
-    if (match(TokenType::STRING)) {
-        return std::make_unique<LiteralExpr>(
-            std::get<std::string>(previous().literal));
+
+    keys.push_back(std::move(first));
+    values.push_back(expression());
+    while (match(TokenType::COMMA) && !check(TokenType::RBRACE)) {
+        keys.push_back(expression());
+        consume(TokenType::COLON, "Expected ':' after dict key");
+        values.push_back(expression());
     }
+    consume(TokenType::RBRACE, "Expected '}' after dict entries");
+    return make<DictExpr>(brace, std::move(keys), std::move(values));
+}
+
+// `a not in b` parses as `not (a in b)`
+Expr Parser::notIn(Expr left) {
+    const Token& notToken = previous();
+    const Token& in = consume(TokenType::IN, "Expected 'in' after 'not'");
+    Expr right = parsePrecedence(getRule(TokenType::IN).rightPrecedence);
+    Expr test = make<BinaryExpr>(std::move(left), in, std::move(right));
+    return make<UnaryExpr>(notToken, std::move(test));
+}
+
+Expr Parser::subscript(Expr object) {
+    const Token& bracket = previous();
 
-    if (match(TokenType::IDENTIFIER)) {
-        return std::make_unique<VariableExpr>(previous());
+    NodePtr<Expr> lower;
+    if (!check(TokenType::COLON)) {
+        Expr index = expression();
+        if (!check(TokenType::COLON)) {
+            consume(TokenType::RBRACKET, "Expected ']' after index");
+            return make<IndexExpr>(std::move(object), bracket, std::move(index));
+        }
+        lower = make<Expr>(std::move(index));
     }
 
-    if (match(TokenType::LPAREN)) {
-        Expr expr = expression();
-        consume(TokenType::RPAREN, "Expected ')' after expression");
-        return std::make_unique<GroupingExpr>(std::move(expr));
+    // Slice: [lower]:[upper][:[step]]
+    consume(TokenType::COLON, "Expected ':' in slice");
+    NodePtr<Expr> upper;
+    if (!check(TokenType::COLON) && !check(TokenType::RBRACKET)) {
+        upper = make<Expr>(expression());
     }
+    NodePtr<Expr> step;
+    if (match(TokenType::COLON) && !check(TokenType::RBRACKET)) {
+        step = make<Expr>(expression());
+    }
+    consume(TokenType::RBRACKET, "Expected ']' after slice");
+
+    return make<SliceExpr>(std::move(object), bracket, std::move(lower),
+                                       std::move(upper), std::move(step));
+}
 
-    throw error(peek(), "Expected expression");
+Expr Parser::attribute(Expr object) {
+    const Token& name = consume(TokenType::IDENTIFIER, "Expected attribute name after '.'");
+    return make<GetExpr>(std::move(object), name);
 }
@@ -13,31 +13,72 @@ public:
         : std::runtime_error(msg), token(std::move(token)) {}
 };
 
+// What Parser::parseParallel did with a module
+struct ParallelParseStats {
+    size_t chunks = 0;          // Parsed concurrently; 0 if parsed sequentially
+    size_t reparsedChunks = 0;  // From the first failing one on, re-parsed sequentially
+};
+
 class Parser {
 public:
-    explicit Parser(std::vector<Token> tokens);
-    std::vector<Stmt> parse();
+    // With lazyFunctionBodies, `def` bodies are only skipped over (by
+    // INDENT/DEDENT balance) and parsed the first time they are needed;
+    // syntax errors inside them are reported at that point.
+    explicit Parser(std::vector<Token> tokens, bool lazyFunctionBodies = false);
+    Module parse();
+
+    // Parses a body recorded by a lazy Parser; `isAsync` if it belongs to
+    // an async def
+    static Module parseDeferredBody(const DeferredBody& body, bool isAsync);
+
+    // Parses a whole module on up to `workers` threads. The token stream is
+    // split between top-level (column 0) statements and each chunk is parsed
+    // independently. If any chunk fails, parsing resumes sequentially from
+    // the first failing chunk, so errors are reported exactly as by parse().
+    // The chunks' arenas are merged into the module's.
+    static Module parseParallel(const std::vector<Token>& tokens, unsigned workers,
+                                bool lazyFunctionBodies = false,
+                                ParallelParseStats* stats = nullptr);
 
 private:
-    std::vector<Token> tokens;
+    Parser(std::shared_ptr<const std::vector<Token>> tokens, size_t start,
+           bool lazyFunctionBodies);
+
+    // Shared so that deferred function bodies can keep referring to it
+    std::shared_ptr<const std::vector<Token>> tokenStore;
+    const std::vector<Token>& tokens;
     size_t current = 0;
+    bool lazyFunctionBodies = false;
+    // The module being built; every node goes in its arena
+    Module module;
+    // Number of defs being parsed around the current token (yield is only
+    // valid inside one), and whether the innermost has a yield so far
+    int functionDepth = 0;
+    bool sawYield = false;
+    // The innermost def is an async def, so await is valid
+    bool inAsync = false;
 
     // Utility methods
     bool isAtEnd() const;
     const Token& peek() const;
     const Token& previous() const;
-    Token advance();
+    const Token& advance();
     bool check(TokenType type) const;
     bool match(TokenType type);
     template<typename... Types>
     bool match(TokenType first, Types... rest);
-    Token consume(TokenType type, const std::string& message);
+    const Token& consume(TokenType type, const std::string& message);
     ParseError error(const Token& token, const std::string& message);
     void synchronize();
 
     // Skip newlines helper
     void skipNewlines();
 
+    template<typename T, typename... Args>
+    NodePtr<T> make(Args&&... args) {
+        return module.arena->make<T>(std::forward<Args>(args)...);
+    }
+
     // Grammar rules - Statements
     Stmt declaration();
     Stmt statement();
@@ -45,25 +86,68 @@ private:
     Stmt printStatement();
     Stmt ifStatement();
     Stmt whileStatement();
-    Stmt functionDeclaration();
+    Stmt forStatement();
+    Stmt functionDeclaration(bool isAsync);
+    Stmt classDeclaration();
     Stmt returnStatement();
+    Stmt yieldStatement();
     Stmt assertStatement();
     std::vector<Stmt> block();
 
     // Grammar rules - Expressions
+    //
+    // Expressions use a Pratt parser: each token type maps to a ParseRule
+    // giving its prefix parselet, infix parselet and binding power, so a
+    // new operator is one table entry in parser.cpp.
+    enum class Precedence {
+        NONE,
+        OR,          // or
+        AND,         // and
+        NOT,         // not (prefix)
+        COMPARISON,  // == != < <= > >=
+        TERM,        // + -
+        FACTOR,      // * / // %
+        UNARY,       // - (prefix)
+        POWER,       // ** (right-associative)
+        CALL,        // ()
+        PRIMARY
+    };
+
+    using PrefixFn = Expr (Parser::*)();
+    using InfixFn = Expr (Parser::*)(Expr left);
+
+    struct ParseRule {
+        PrefixFn prefix = nullptr;
+        Precedence prefixPrecedence = Precedence::NONE;  // Lowest context a prefix may start in
+        InfixFn infix = nullptr;
+        Precedence precedence = Precedence::NONE;        // Left binding power of the infix
+        Precedence rightPrecedence = Precedence::NONE;   // Binding power for the right operand
+    };
+
+    static const ParseRule& getRule(TokenType type);
+
+    // Whether a statement can begin with a token of this type
+    static bool startsStatement(TokenType type);
+
     Expr expression();
     Expr assignment();
-    Expr orExpr();
-    Expr andExpr();
-    Expr notExpr();
-    Expr comparison();
-    Expr term();
-    Expr factor();
+    Expr parsePrecedence(Precedence precedence);
+
+    // Prefix parselets
+    Expr literal();
+    Expr variable();
+    Expr grouping();
+    Expr list();
+    Expr braces();
     Expr unary();
-    Expr power();
-    Expr call();
-    Expr primary();
-    Expr finishCall(Expr callee);
+    Expr awaitExpr();
+
+    // Infix parselets
+    Expr binary(Expr left);
+    Expr call(Expr callee);
+    Expr attribute(Expr object);
+    Expr subscript(Expr object);
+    Expr notIn(Expr left);
 };
 
 #endif // PARSER_HPP
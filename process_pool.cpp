@@ -0,0 +1,308 @@
+#include "process_pool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "environment.hpp"
+
+namespace {
+
+// A frame on a worker's socket: a kind byte, a 64-bit length, then that
+// many bytes of Marshal data (or, for an error reply, the message). The
+// descriptor of the frame's SharedSegment, if it has one, rides along
+// with the header.
+enum class FrameKind : uint8_t { VALUE, ERROR };
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = ::read(fd, data, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeFrame(int fd, FrameKind kind, const std::string& payload, int segmentFd = -1) {
+    char header[1 + sizeof(uint64_t)];
+    header[0] = static_cast<char>(kind);
+    uint64_t length = payload.size();
+    std::memcpy(header + 1, &length, sizeof(length));
+
+    iovec part{header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    if (segmentFd >= 0) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* rights = CMSG_FIRSTHDR(&message);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(rights), &segmentFd, sizeof(int));
+    }
+    ssize_t sent;
+    while ((sent = sendmsg(fd, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) {
+    }
+    if (sent <= 0) return false;
+    return writeAll(fd, header + sent, sizeof(header) - static_cast<size_t>(sent)) &&
+           writeAll(fd, payload.data(), payload.size());
+}
+
+// False on end of file, which is how a worker's exit shows up. `segment`
+// is set to the frame's segment, or null if it came without one.
+bool readFrame(int fd, FrameKind& kind, std::string& payload,
+               std::shared_ptr<const SharedSegment>& segment) {
+    char header[1 + sizeof(uint64_t)];
+    iovec part{header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t got;
+    while ((got = recvmsg(fd, &message, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+    }
+    if (got <= 0) return false;
+
+    segment = nullptr;
+    cmsghdr* rights = CMSG_FIRSTHDR(&message);
+    if (rights && rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS) {
+        int segmentFd;
+        std::memcpy(&segmentFd, CMSG_DATA(rights), sizeof(int));
+        try {
+            segment = std::make_shared<const SharedSegment>(segmentFd);
+        } catch (const RuntimeError&) {
+            // Loading the frame's value reports it, if it uses the segment
+        }
+    }
+    if (!readAll(fd, header + got, sizeof(header) - static_cast<size_t>(got))) return false;
+    kind = static_cast<FrameKind>(header[0]);
+    uint64_t length;
+    std::memcpy(&length, header + 1, sizeof(length));
+    payload.resize(length);
+    return readAll(fd, payload.data(), length);
+}
+
+}  // namespace
+
+ProcessPool::ProcessPool(unsigned workerCount, Handler handler) : handler(std::move(handler)) {
+    // A worker that dies mid-request must not take the parent with it
+    // when the parent writes to its socket
+    std::signal(SIGPIPE, SIG_IGN);
+
+    workers.resize(std::max(1u, workerCount));
+    for (Worker& worker : workers) {
+        start(worker);
+    }
+}
+
+ProcessPool::~ProcessPool() {
+    for (Worker& worker : workers) {
+        stop(worker);
+    }
+}
+
+void ProcessPool::start(Worker& worker) {
+    // Sockets rather than pipes, so segment descriptors can be sent
+    int requestSocket[2];
+    int replySocket[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, requestSocket) != 0) {
+        throw RuntimeError("could not create worker socket");
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, replySocket) != 0) {
+        close(requestSocket[0]);
+        close(requestSocket[1]);
+        throw RuntimeError("could not create worker socket");
+    }
+
+    // Anything still buffered would otherwise be written by both processes
+    std::cout.flush();
+    std::cerr.flush();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        for (int fd : {requestSocket[0], requestSocket[1], replySocket[0], replySocket[1]}) close(fd);
+        throw RuntimeError("could not fork worker process");
+    }
+    if (pid == 0) {
+        close(requestSocket[1]);
+        close(replySocket[0]);
+        worker.requestFd = requestSocket[0];
+        worker.replyFd = replySocket[1];
+        serve(worker);
+    }
+
+    close(requestSocket[0]);
+    close(replySocket[1]);
+    worker.pid = pid;
+    worker.requestFd = requestSocket[1];
+    worker.replyFd = replySocket[0];
+}
+
+void ProcessPool::serve(Worker& self) {
+    // The other workers' sockets came along with the fork; holding their
+    // write ends open would keep them from seeing the parent close them
+    for (Worker& other : workers) {
+        if (&other == &self || other.pid < 0) continue;
+        close(other.requestFd);
+        close(other.replyFd);
+    }
+
+    FrameKind kind;
+    std::string payload;
+    std::shared_ptr<const SharedSegment> received;
+    while (readFrame(self.requestFd, kind, payload, received)) {
+        std::string error;
+        PyValue reply;
+        try {
+            reply = handler(Marshal::load(payload, std::move(received)));
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        std::unique_ptr<SharedSegment> segment;
+        int segmentFd = -1;
+        if (error.empty()) {
+            try {
+                payload = Marshal::dump(reply, &segment);
+                if (segment) segmentFd = segment->finish();
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+        reply = PyNone{};  // Unmaps the request's segment, unless the handler kept it
+        bool sent = error.empty() ? writeFrame(self.replyFd, FrameKind::VALUE, payload, segmentFd)
+                                  : writeFrame(self.replyFd, FrameKind::ERROR, error);
+        if (!sent) break;
+    }
+    // Skip the parent's atexit handlers and static destructors
+    _exit(0);
+}
+
+std::string ProcessPool::reap(Worker& worker) {
+    close(worker.requestFd);
+    close(worker.replyFd);
+    worker.requestFd = worker.replyFd = -1;
+
+    int status = 0;
+    while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    worker.pid = -1;
+    if (WIFSIGNALED(status)) {
+        return std::string("worker process killed by signal ") +
+               std::to_string(WTERMSIG(status)) + " (" + strsignal(WTERMSIG(status)) + ")";
+    }
+    return "worker process exited with status " + std::to_string(WEXITSTATUS(status));
+}
+
+void ProcessPool::stop(Worker& worker) {
+    if (worker.pid < 0) return;
+    reap(worker);  // Closing the request socket tells the worker to exit
+}
+
+void ProcessPool::run(const std::vector<PyValue>& requests,
+                      const std::function<void(size_t, Reply)>& done) {
+    constexpr size_t idle = static_cast<size_t>(-1);
+    std::vector<size_t> running(workers.size(), idle);  // Request index per worker
+    size_t next = 0;
+    size_t outstanding = 0;
+
+    // Hands the next request that can be encoded to worker `w`
+    auto dispatch = [&](size_t w) {
+        Worker& worker = workers[w];
+        while (next < requests.size()) {
+            size_t index = next++;
+            std::string payload;
+            std::unique_ptr<SharedSegment> segment;
+            int segmentFd = -1;
+            try {
+                payload = Marshal::dump(requests[index], &segment);
+                if (segment) segmentFd = segment->finish();
+            } catch (const RuntimeError& e) {
+                done(index, Reply{PyNone{}, e.what()});
+                continue;
+            }
+            // Once sent, the worker's mapping keeps the segment's memory
+            if (!writeFrame(worker.requestFd, FrameKind::VALUE, payload, segmentFd)) {
+                std::string error = reap(worker);
+                start(worker);
+                done(index, Reply{PyNone{}, error});
+                continue;
+            }
+            running[w] = index;
+            outstanding++;
+            return;
+        }
+    };
+
+    for (size_t w = 0; w < workers.size(); w++) {
+        dispatch(w);
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<size_t> polled;
+    while (outstanding > 0) {
+        fds.clear();
+        polled.clear();
+        for (size_t w = 0; w < workers.size(); w++) {
+            if (running[w] == idle) continue;
+            fds.push_back(pollfd{workers[w].replyFd, POLLIN, 0});
+            polled.push_back(w);
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw RuntimeError("could not wait for worker processes");
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents == 0) continue;
+            size_t w = polled[i];
+            Worker& worker = workers[w];
+            size_t index = running[w];
+            running[w] = idle;
+            outstanding--;
+
+            Reply reply;
+            FrameKind kind;
+            std::string payload;
+            std::shared_ptr<const SharedSegment> segment;
+            if (!readFrame(worker.replyFd, kind, payload, segment)) {
+                reply.error = reap(worker);
+                start(worker);
+            } else if (kind == FrameKind::ERROR) {
+                reply.error = payload;
+            } else {
+                try {
+                    reply.value = Marshal::load(payload, std::move(segment));
+                } catch (const RuntimeError& e) {
+                    reply.error = e.what();
+                }
+            }
+            done(index, std::move(reply));
+            dispatch(w);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef PROCESS_POOL_HPP
+#define PROCESS_POOL_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "marshal.hpp"
+
+// A set of forked worker processes that each apply `handler` to the
+// requests sent to them. Requests and replies are Marshal-encoded PyValues
+// sent over a pair of Unix sockets per worker. Large strings and arrays go
+// in a SharedSegment of their own, whose descriptor is sent along, so an
+// array arrives without being copied. A worker that crashes fails only
+// the request it was running; it is replaced by a fresh fork.
+//
+// Workers are forked from the calling process, so the handler can use
+// anything set up beforehand. Fork before starting any threads.
+class ProcessPool {
+public:
+    using Handler = std::function<PyValue(const PyValue& request)>;
+
+    struct Reply {
+        PyValue value;
+        std::string error;  // Set instead of value if the handler threw or the worker died
+    };
+
+    ProcessPool(unsigned workerCount, Handler handler);
+    // Closes the request sockets and waits for the workers to exit
+    ~ProcessPool();
+
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Sends every request to the next free worker. `done` is called with
+    // each request's index and reply as they arrive, in any order.
+    void run(const std::vector<PyValue>& requests,
+             const std::function<void(size_t, Reply)>& done);
+
+private:
+    struct Worker {
+        pid_t pid = -1;
+        int requestFd = -1;  // Parent to worker
+        int replyFd = -1;    // Worker to parent
+    };
+
+    Handler handler;
+    std::vector<Worker> workers;
+
+    void start(Worker& worker);
+    void stop(Worker& worker);
+    // The reason a worker that closed its reply socket exited
+    std::string reap(Worker& worker);
+    [[noreturn]] void serve(Worker& worker);
+};
+
+#endif // PROCESS_POOL_HPP
@@ -0,0 +1,38 @@
+#include "program.hpp"
+#include <thread>
+#include "lexer.hpp"
+#include "parser.hpp"
+
+namespace {
+
+// Sources at least this large are lexed, and modules with at least this
+// many tokens are parsed, on all cores
+constexpr size_t parallelLexThreshold = 1 << 20;
+constexpr size_t parallelParseThreshold = 50000;
+
+}  // namespace
+
+Program::Program(Module module)
+    : body(std::make_shared<const Module>(std::move(module))) {}
+
+Program Program::compile(const SourceBuffer& source, bool lazyFunctionBodies) {
+    unsigned workers = std::thread::hardware_concurrency();
+
+    std::vector<Token> tokens;
+    if (source.text().size() >= parallelLexThreshold && workers > 1) {
+        tokens = Lexer::tokenizeParallel(source.text(), workers);
+    } else {
+        Lexer lexer(source);
+        tokens = lexer.tokenize();
+    }
+
+    if (tokens.size() >= parallelParseThreshold && workers > 1) {
+        return Program(Parser::parseParallel(tokens, workers, lazyFunctionBodies));
+    }
+    Parser parser(std::move(tokens), lazyFunctionBodies);
+    return Program(parser.parse());
+}
+
+Program Program::compile(std::string source, bool lazyFunctionBodies) {
+    return compile(SourceBuffer(std::move(source)), lazyFunctionBodies);
+}
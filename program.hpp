@@ -0,0 +1,31 @@
+#ifndef PROGRAM_HPP
+#define PROGRAM_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "source_buffer.hpp"
+
+// A compiled module. The AST is immutable once built (lazily parsed
+// function bodies are filled in under std::call_once), so one Program can
+// be shared freely between threads and run by any number of Interpreters.
+// Copies are cheap and share the same AST.
+class Program {
+public:
+    explicit Program(Module module);
+
+    // Lexes and parses `source`; throws LexerError or ParseError. Large
+    // sources are lexed and parsed on all cores. With lazyFunctionBodies,
+    // function bodies are parsed on first call.
+    static Program compile(const SourceBuffer& source, bool lazyFunctionBodies = true);
+    static Program compile(std::string source, bool lazyFunctionBodies = true);
+
+    const std::vector<Stmt>& statements() const { return body->statements; }
+
+private:
+    friend class Interpreter;
+    std::shared_ptr<const Module> body;
+};
+
+#endif // PROGRAM_HPP
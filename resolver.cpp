@@ -0,0 +1,261 @@
+#include "resolver.hpp"
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// The names of one function, while its outermost function is resolved
+struct Scope {
+    const FunctionStmt* function;
+    Scope* enclosing;  // Null for a def outside any function
+    std::unordered_map<std::string, uint32_t> locals;  // By order of binding
+    std::vector<bool> captured;                         // Per local
+    std::vector<VariableSlot> localSlots;               // Per local, once laid out
+    std::unordered_map<std::string, uint32_t> free;     // Closure index by name
+    std::vector<std::string> freeNames;
+    std::unordered_set<std::string> globals;  // Looked up here or in a nested def
+
+    Scope(const FunctionStmt* function, Scope* enclosing)
+        : function(function), enclosing(enclosing) {}
+
+    void bind(const std::string& name) {
+        if (locals.emplace(name, static_cast<uint32_t>(captured.size())).second) {
+            captured.push_back(false);
+        }
+    }
+
+    void addFree(const std::string& name) {
+        if (free.emplace(name, static_cast<uint32_t>(freeNames.size())).second) {
+            freeNames.push_back(name);
+        }
+    }
+
+    VariableSlot slotFor(const std::string& name) const {
+        auto local = locals.find(name);
+        if (local != locals.end()) return localSlots[local->second];
+        auto closed = free.find(name);
+        if (closed != free.end()) return VariableSlot{VariableSlot::Kind::FREE, closed->second};
+        return VariableSlot{};
+    }
+};
+
+// A name used in a scope, and the slot to fill in for it
+struct Use {
+    Scope* scope;
+    const std::string* name;
+    VariableSlot* slot;
+};
+
+// Walks a function's body twice: first for the names it binds, then for
+// every use of a name, descending into nested defs on the second pass
+class Walker {
+public:
+    std::deque<Scope> scopes;  // Stable addresses
+    std::vector<Use> uses;
+
+    void function(const FunctionStmt& function, Scope* enclosing) {
+        Scope& scope = scopes.emplace_back(&function, enclosing);
+        function.paramSlots.assign(function.params.size(), VariableSlot{});
+        for (size_t i = 0; i < function.params.size(); i++) {
+            scope.bind(function.params[i].lexeme);
+            uses.push_back(Use{&scope, &function.params[i].lexeme, &function.paramSlots[i]});
+        }
+
+        const std::vector<Stmt>& body = function.body();
+        Scope* outer = current;
+        current = &scope;
+        binding = true;
+        stmts(body);
+        binding = false;
+        stmts(body);
+        current = outer;
+    }
+
+private:
+    Scope* current = nullptr;
+    bool binding = false;  // First pass
+
+    void name(const NameToken& name, VariableSlot& slot, bool binds) {
+        if (binding) {
+            if (binds) current->bind(name.lexeme);
+        } else {
+            uses.push_back(Use{current, &name.lexeme, &slot});
+        }
+    }
+
+    void optionalExpr(const NodePtr<Expr>& expr) {
+        if (expr) this->expr(*expr);
+    }
+
+    void exprs(const std::vector<Expr>& list) {
+        for (const auto& e : list) expr(e);
+    }
+
+    void stmts(const std::vector<Stmt>& list) {
+        for (const auto& s : list) stmt(s);
+    }
+
+    void expr(const Expr& expr) {
+        std::visit([this](auto&& node) {
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, NodePtr<BinaryExpr>>) {
+                this->expr(node->left);
+                this->expr(node->right);
+            } else if constexpr (std::is_same_v<T, NodePtr<UnaryExpr>>) {
+                this->expr(node->operand);
+            } else if constexpr (std::is_same_v<T, NodePtr<VariableExpr>>) {
+                name(node->name, node->slot, false);
+            } else if constexpr (std::is_same_v<T, NodePtr<AssignExpr>>) {
+                name(node->name, node->slot, true);
+                this->expr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<CallExpr>>) {
+                this->expr(node->callee);
+                exprs(node->arguments);
+            } else if constexpr (std::is_same_v<T, NodePtr<GroupingExpr>>) {
+                this->expr(node->expression);
+            } else if constexpr (std::is_same_v<T, NodePtr<GetExpr>>) {
+                this->expr(node->object);
+            } else if constexpr (std::is_same_v<T, NodePtr<ListExpr>>) {
+                exprs(node->elements);
+            } else if constexpr (std::is_same_v<T, NodePtr<IndexExpr>>) {
+                this->expr(node->object);
+                this->expr(node->index);
+            } else if constexpr (std::is_same_v<T, NodePtr<SliceExpr>>) {
+                this->expr(node->object);
+                optionalExpr(node->lower);
+                optionalExpr(node->upper);
+                optionalExpr(node->step);
+            } else if constexpr (std::is_same_v<T, NodePtr<DictExpr>>) {
+                exprs(node->keys);
+                exprs(node->values);
+            } else if constexpr (std::is_same_v<T, NodePtr<SetExpr>>) {
+                exprs(node->elements);
+            } else if constexpr (std::is_same_v<T, NodePtr<AwaitExpr>>) {
+                this->expr(node->operand);
+            } else if constexpr (std::is_same_v<T, NodePtr<IndexAssignExpr>>) {
+                this->expr(node->object);
+                this->expr(node->index);
+                this->expr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<AttributeAssignExpr>>) {
+                this->expr(node->object);
+                this->expr(node->value);
+            }
+        }, expr);
+    }
+
+    void stmt(const Stmt& stmt) {
+        std::visit([this](auto&& node) {
+            using T = std::decay_t<decltype(node)>;
+            if constexpr (std::is_same_v<T, NodePtr<ExpressionStmt>>) {
+                expr(node->expression);
+            } else if constexpr (std::is_same_v<T, NodePtr<PrintStmt>>) {
+                exprs(node->expressions);
+            } else if constexpr (std::is_same_v<T, NodePtr<VarStmt>>) {
+                name(node->name, node->slot, true);
+                expr(node->initializer);
+            } else if constexpr (std::is_same_v<T, NodePtr<BlockStmt>>) {
+                stmts(node->statements);
+            } else if constexpr (std::is_same_v<T, NodePtr<IfStmt>>) {
+                expr(node->condition);
+                this->stmt(node->thenBranch);
+                for (const auto& [condition, branch] : node->elifBranches) {
+                    expr(condition);
+                    this->stmt(branch);
+                }
+                if (node->elseBranch) this->stmt(*node->elseBranch);
+            } else if constexpr (std::is_same_v<T, NodePtr<WhileStmt>>) {
+                expr(node->condition);
+                this->stmt(node->body);
+            } else if constexpr (std::is_same_v<T, NodePtr<ForStmt>>) {
+                name(node->variable, node->slot, true);
+                expr(node->iterable);
+                this->stmt(node->body);
+            } else if constexpr (std::is_same_v<T, NodePtr<FunctionStmt>>) {
+                name(node->name, node->slot, true);
+                if (!binding) function(*node, current);
+            } else if constexpr (std::is_same_v<T, NodePtr<ReturnStmt>>) {
+                optionalExpr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<AssertStmt>>) {
+                expr(node->condition);
+                optionalExpr(node->message);
+            } else if constexpr (std::is_same_v<T, NodePtr<YieldStmt>>) {
+                optionalExpr(node->value);
+            } else if constexpr (std::is_same_v<T, NodePtr<ClassStmt>>) {
+                name(node->name, node->slot, true);
+                classBody(node->body);
+            }
+        }, stmt);
+    }
+
+    // A class body binds nothing here: its methods are functions defined
+    // in this scope, and its attribute values are evaluated in it
+    void classBody(const std::vector<Stmt>& body) {
+        for (const Stmt& member : body) {
+            if (const auto* method = std::get_if<NodePtr<FunctionStmt>>(&member)) {
+                if (!binding) function(**method, current);
+            } else {
+                const auto& assignment = std::get<NodePtr<ExpressionStmt>>(member);
+                expr(std::get<NodePtr<AssignExpr>>(assignment->expression)->value);
+            }
+        }
+    }
+};
+
+}  // namespace
+
+void Resolver::resolve(const FunctionStmt& function) {
+    std::call_once(function.resolved, [&function] {
+        Walker walker;
+        walker.function(function, nullptr);
+
+        // A use of a name the scope does not bind refers to the nearest
+        // enclosing function that binds it, which keeps it in a cell; the
+        // functions in between pass the cell on in their closures
+        for (const Use& use : walker.uses) {
+            const std::string& name = *use.name;
+            if (use.scope->locals.count(name)) continue;
+            Scope* owner = use.scope->enclosing;
+            while (owner && !owner->locals.count(name)) owner = owner->enclosing;
+            if (!owner) {
+                for (Scope* scope = use.scope; scope; scope = scope->enclosing) {
+                    scope->globals.insert(name);
+                }
+                continue;
+            }
+            owner->captured[owner->locals.at(name)] = true;
+            for (Scope* scope = use.scope; scope != owner; scope = scope->enclosing) {
+                scope->addFree(name);
+            }
+        }
+
+        for (Scope& scope : walker.scopes) {
+            uint32_t localCount = 0;
+            uint32_t cellCount = 0;
+            for (bool captured : scope.captured) {
+                scope.localSlots.push_back(
+                    captured ? VariableSlot{VariableSlot::Kind::CELL, cellCount++}
+                             : VariableSlot{VariableSlot::Kind::LOCAL, localCount++});
+            }
+            scope.function->localCount = localCount;
+            scope.function->cellCount = cellCount;
+            scope.function->globalNames.assign(scope.globals.begin(), scope.globals.end());
+        }
+
+        for (const Use& use : walker.uses) {
+            *use.slot = use.scope->slotFor(*use.name);
+        }
+
+        for (Scope& scope : walker.scopes) {
+            if (!scope.enclosing) continue;
+            scope.function->captures.clear();
+            for (const std::string& name : scope.freeNames) {
+                scope.function->captures.push_back(scope.enclosing->slotFor(name));
+            }
+            // Nested defs are done; calls to them need not resolve again
+            std::call_once(scope.function->resolved, [] {});
+        }
+    });
+}
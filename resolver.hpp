@@ -0,0 +1,25 @@
+#ifndef RESOLVER_HPP
+#define RESOLVER_HPP
+
+#include "ast.hpp"
+
+// Works out where each name used in a function lives (see VariableSlot).
+// As in Python, a name the body binds anywhere (by assignment, a for loop,
+// a def or a class) is local to the function throughout, as are the
+// parameters. A class's methods are resolved as if defined where the
+// class is, since they do not see its names.
+// A local that a nested def uses becomes a cell; in the nested def, and in
+// any def between the two, the name is a FREE slot in the closure. Other
+// names are global.
+//
+// A function is resolved together with every def nested in it, the first
+// time the outermost one is called. Nested bodies are parsed then, if they
+// were deferred, since what they use decides the outer function's layout.
+class Resolver {
+public:
+    // Resolves a function about to be called, once; thread-safe. Defs
+    // nested in another function are resolved with it already.
+    static void resolve(const FunctionStmt& function);
+};
+
+#endif // RESOLVER_HPP
@@ -0,0 +1,31 @@
+#include "scheduler.hpp"
+
+void Scheduler::spawn(Interpreter& interpreter, std::function<void()> body) {
+    auto task = std::make_unique<Task>(&interpreter, std::move(body));
+    // The hook runs on the task's own stack (or a generator's, nested in
+    // it), so suspending hands control back to run()
+    Fiber* fiber = &task->fiber;
+    interpreter.setPreemption(budget, [fiber] { fiber->suspend(); });
+    ready.push_back(std::move(task));
+}
+
+void Scheduler::run() {
+    std::exception_ptr failure;
+    while (!ready.empty()) {
+        std::unique_ptr<Task> task = std::move(ready.front());
+        ready.pop_front();
+
+        try {
+            task->fiber.resume();
+        } catch (...) {
+            if (!failure) failure = std::current_exception();
+        }
+
+        if (task->fiber.finished()) {
+            task->interpreter->setPreemption(0, nullptr);
+        } else {
+            ready.push_back(std::move(task));
+        }
+    }
+    if (failure) std::rethrow_exception(failure);
+}
@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include "fiber.hpp"
+#include "interpreter.hpp"
+
+// Runs many scripts concurrently on the calling thread. Each task is a
+// Fiber (a lightweight stack, not an OS thread) whose Interpreter is
+// preempted every `budget` statements; the scheduler then resumes the
+// next task, round-robin, until all have finished. Thousands of tasks
+// cost only the stack pages each actually touches.
+//
+// A task's Interpreter must be used only by that task while it runs, and
+// must outlive it. Preemption is turned off again when the task finishes.
+class Scheduler {
+public:
+    static constexpr unsigned defaultBudget = 1000;
+
+    explicit Scheduler(unsigned budget = defaultBudget) : budget(budget) {}
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Queues `body` (typically interpreter.run(program)) to run as a task
+    // that is preempted on `interpreter`. May be called while run() is
+    // running, from inside a task.
+    void spawn(Interpreter& interpreter, std::function<void()> body);
+
+    // Runs the queued tasks until every one has finished. An exception
+    // escaping a task ends only that task; the first one is rethrown once
+    // the rest have finished.
+    void run();
+
+    size_t pending() const { return ready.size(); }
+
+private:
+    struct Task {
+        Interpreter* interpreter;
+        Fiber fiber;
+
+        Task(Interpreter* interpreter, std::function<void()> body)
+            : interpreter(interpreter), fiber(std::move(body)) {}
+    };
+
+    unsigned budget;
+    std::deque<std::unique_ptr<Task>> ready;
+};
+
+#endif // SCHEDULER_HPP
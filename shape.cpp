@@ -0,0 +1,68 @@
+#include "shape.hpp"
+
+namespace {
+
+// Ids start at 1; 0 marks a free cache entry
+std::atomic<uint64_t> nextShapeId{1};
+
+// Shapes with this many names or fewer are searched linearly
+constexpr size_t linearNames = 8;
+
+}  // namespace
+
+Shape::Shape() : identity(nextShapeId.fetch_add(1, std::memory_order_relaxed)) {}
+
+Shape::Shape(const Shape& parent, const std::string& name)
+    : identity(nextShapeId.fetch_add(1, std::memory_order_relaxed)), names(parent.names) {
+    names.push_back(name);
+    if (names.size() > linearNames) {
+        for (uint32_t i = 0; i < names.size(); i++) index.emplace(names[i], i);
+    }
+}
+
+Shape::~Shape() {
+    Transition* transition = transitions.load(std::memory_order_relaxed);
+    while (transition) {
+        Transition* next = transition->next;
+        delete transition;
+        transition = next;
+    }
+}
+
+uint32_t Shape::find(const std::string& name) const {
+    if (names.size() > linearNames) {
+        auto found = index.find(name);
+        return found == index.end() ? notFound : found->second;
+    }
+    for (uint32_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return i;
+    }
+    return notFound;
+}
+
+Shape* Shape::withAttribute(const std::string& name) {
+    Transition* head = transitions.load(std::memory_order_acquire);
+    for (Transition* transition = head; transition; transition = transition->next) {
+        if (transition->name == name) return transition->shape.get();
+    }
+
+    std::lock_guard<std::mutex> guard(transitionLock);
+    // Another thread may have added it since
+    Transition* latest = transitions.load(std::memory_order_relaxed);
+    for (Transition* transition = latest; transition != head; transition = transition->next) {
+        if (transition->name == name) return transition->shape.get();
+    }
+    auto* transition = new Transition{name, std::unique_ptr<Shape>(new Shape(*this, name)), latest};
+    transitions.store(transition, std::memory_order_release);
+    return transition->shape.get();
+}
+
+void InlineCache::add(uint64_t shapeId, AttributeSlot slot) {
+    if (shapeId >> (64 - shapeShift) || slot.index > indexMask) return;  // Does not fit
+    uint64_t word = shapeId << shapeShift | (slot.inClass ? classBit : 0) | slot.index;
+    for (auto& entry : entries) {
+        uint64_t expected = 0;
+        if (entry.compare_exchange_strong(expected, word, std::memory_order_relaxed)) return;
+        if (expected == word) return;  // Another thread cached the same
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef SHAPE_HPP
+#define SHAPE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A hidden class: the attribute names an instance has, in the order they
+// were first assigned. An instance keeps its attribute values in a dense
+// array, the value of the shape's i-th name in slot i, so the shape is all
+// a lookup needs to find a slot.
+//
+// Shapes form a tree per class. Adding an attribute moves an instance to
+// the child shape for that name, made the first time any instance takes
+// the step, so instances that are filled in the same order (as __init__
+// does) share every shape along the way. A shape is owned by its parent
+// and lives as long as the class; its id is never reused, so a cache
+// keyed by id cannot mistake a new shape for a freed one.
+class Shape {
+public:
+    static constexpr uint32_t notFound = UINT32_MAX;
+
+    Shape();  // The empty shape a class's instances start from
+    ~Shape();
+
+    Shape(const Shape&) = delete;
+    Shape& operator=(const Shape&) = delete;
+
+    uint64_t id() const { return identity; }
+    uint32_t size() const { return static_cast<uint32_t>(names.size()); }
+    const std::string& nameAt(uint32_t slot) const { return names[slot]; }
+
+    // The slot of `name`, or notFound
+    uint32_t find(const std::string& name) const;
+
+    // The shape with `name` added after this one's names. Thread-safe:
+    // existing transitions are followed without locking.
+    Shape* withAttribute(const std::string& name);
+
+private:
+    struct Transition {
+        std::string name;
+        std::unique_ptr<Shape> shape;
+        Transition* next;
+    };
+
+    Shape(const Shape& parent, const std::string& name);
+
+    uint64_t identity;
+    std::vector<std::string> names;
+    // Past a few names, find() hashes instead of scanning
+    std::unordered_map<std::string, uint32_t> index;
+    // A list that only grows, so readers need no lock
+    std::atomic<Transition*> transitions{nullptr};
+    std::mutex transitionLock;
+};
+
+// Where an attribute was found: a slot of the instance, or of its class's
+// attributes (see PyClass)
+struct AttributeSlot {
+    bool inClass;
+    uint32_t index;
+};
+
+// The inline cache of one attribute-access site in the AST: the slots the
+// site found for the shapes it has seen. A site that sees one shape is
+// answered by the first entry, which is a load and a compare; up to
+// `entryCount` shapes are cached, and a site that sees more (megamorphic)
+// keeps those and looks the rest up on the shape.
+//
+// Programs run on many threads at once, so an entry packs the shape id and
+// the slot into one word that is read and written atomically.
+class InlineCache {
+public:
+    static constexpr size_t entryCount = 4;
+
+    // The slot cached for the shape `shapeId`, if any
+    bool find(uint64_t shapeId, AttributeSlot& slot) const {
+        for (const auto& entry : entries) {
+            uint64_t word = entry.load(std::memory_order_relaxed);
+            if ((word >> shapeShift) == shapeId) {
+                slot = AttributeSlot{(word & classBit) != 0,
+                                     static_cast<uint32_t>(word & indexMask)};
+                return true;
+            }
+            if (word == 0) return false;  // Entries fill in order
+        }
+        return false;
+    }
+
+    // Caches `slot` for `shapeId` in the first free entry, if there is one
+    void add(uint64_t shapeId, AttributeSlot slot);
+
+private:
+    // Shape id in the high bits, then whether the slot is the class's,
+    // then the slot. Id 0 is no shape, so a zero word is a free entry.
+    static constexpr unsigned shapeShift = 25;
+    static constexpr uint64_t classBit = uint64_t(1) << 24;
+    static constexpr uint64_t indexMask = classBit - 1;
+
+    std::atomic<uint64_t> entries[entryCount] = {};
+};
+
+#endif // SHAPE_HPP
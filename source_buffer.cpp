@@ -0,0 +1,86 @@
+#include "source_buffer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::SourceBuffer(std::string text) : owned(std::move(text)), view(owned) {}
+
+SourceBuffer::~SourceBuffer() {
+    release();
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        owned = std::move(other.owned);
+        mapping = other.mapping;
+        mappingSize = other.mappingSize;
+        regularFile = other.regularFile;
+        // A moved std::string may change address (small-string buffer)
+        view = mapping ? other.view : std::string_view(owned);
+
+        other.mapping = nullptr;
+        other.mappingSize = 0;
+        other.view = std::string_view();
+    }
+    return *this;
+}
+
+void SourceBuffer::release() {
+    if (mapping) {
+        ::munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+SourceBuffer SourceBuffer::open(const std::string& path) {
+    bool isStdin = path == "-";
+    int fd = isStdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(std::strerror(errno));
+    }
+
+    SourceBuffer buffer;
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && !isStdin) {
+        buffer.regularFile = true;
+        if (info.st_size > 0) {
+            void* mapping = ::mmap(nullptr, static_cast<size_t>(info.st_size),
+                                   PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                ::close(fd);
+                buffer.mapping = mapping;
+                buffer.mappingSize = static_cast<size_t>(info.st_size);
+                buffer.view = std::string_view(static_cast<const char*>(mapping),
+                                               buffer.mappingSize);
+                return buffer;
+            }
+        }
+    }
+
+    // Pipes, stdin, and anything that cannot be mapped
+    char chunk[65536];
+    while (true) {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            int error = errno;
+            if (!isStdin) ::close(fd);
+            throw std::runtime_error(std::strerror(error));
+        }
+        if (count == 0) break;
+        buffer.owned.append(chunk, static_cast<size_t>(count));
+    }
+    if (!isStdin) ::close(fd);
+
+    buffer.view = buffer.owned;
+    return buffer;
+}
@@ -0,0 +1,40 @@
+#ifndef SOURCE_BUFFER_HPP
+#define SOURCE_BUFFER_HPP
+
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+// Script source text. Regular files are mmap'd read-only and lexed in
+// place; pipes, FIFOs and stdin ("-") fall back to a buffered read, and
+// REPL input is owned directly.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(std::string text);
+    ~SourceBuffer();
+
+    SourceBuffer(SourceBuffer&& other) noexcept;
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    // Throws std::runtime_error if the file cannot be read
+    static SourceBuffer open(const std::string& path);
+
+    std::string_view text() const { return view; }
+
+    // True if the text came from a regular file (so it can be cached by path)
+    bool isRegularFile() const { return regularFile; }
+
+private:
+    SourceBuffer() = default;
+    void release();
+
+    std::string owned;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    bool regularFile = false;
+    std::string_view view;
+};
+
+#endif // SOURCE_BUFFER_HPP
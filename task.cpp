@@ -0,0 +1,212 @@
+#include "task.hpp"
+#include <chrono>
+#include <sstream>
+#include "function.hpp"
+#include "gc.hpp"
+#include "interpreter.hpp"
+#include "work_pool.hpp"
+
+// An Interpreter a task runs on, printing to an output of its own
+struct TaskContext {
+    std::ostringstream out;
+    Interpreter interpreter{out};
+};
+
+// The snapshot of the spawner's globals that a group of tasks copy theirs
+// from, and for each pool thread the contexts made from it that no task is
+// running on. A context is only ever touched by its own thread, lent to
+// one task at a time, and kept for the next only while its globals still
+// match the snapshot. The spawner keeps the scope while the snapshot
+// matches its globals, and each of its tasks until it has run.
+struct TaskScope : std::enable_shared_from_this<TaskScope> {
+    std::shared_ptr<const GlobalsSnapshot> snapshot;
+    std::vector<std::vector<std::unique_ptr<TaskContext>>> idle;
+
+    explicit TaskScope(size_t workers) : idle(workers) {}
+};
+
+std::shared_ptr<PyTask> PyTask::spawn(Interpreter& spawner, ArgSpan args) {
+    const PyValue& function = args[0];
+    std::string name;
+    if (const auto* pyFunction = std::get_if<std::shared_ptr<PyFunction>>(&function)) {
+        const FunctionStmt* declaration = (*pyFunction)->declaration;
+        if (declaration->isGenerator || declaration->isAsync) {
+            throw RuntimeError("spawn() function must not be a generator or async");
+        }
+        name = (*pyFunction)->name;
+    } else if (const auto* native = std::get_if<std::shared_ptr<NativeFunction>>(&function)) {
+        name = (*native)->name;
+    } else {
+        throw RuntimeError("'" + pyTypeName(function) + "' object is not callable");
+    }
+
+    // A task's own spawns share its scope, whose classes they take as is;
+    // a spawn from outside any task goes to the spawner's scope, or to a
+    // new one if the globals the task can reach have changed since
+    WorkPool& pool = WorkPool::shared();
+    std::vector<std::string> roots;
+    for (size_t i = 0; i < args.size(); i++) {
+        referencedGlobals(args[i], roots);
+    }
+    std::shared_ptr<TaskScope> scope;
+    CopyMemo memo;
+    if (spawner.taskScope) {
+        scope = spawner.taskScope->shared_from_this();
+    } else {
+        scope = spawner.spawnScope;
+        if (!scope || !scope->snapshot->matches(*spawner.globalEnv, roots)) {
+            auto fresh = std::make_shared<TaskScope>(pool.size());
+            fresh->snapshot = std::make_shared<const GlobalsSnapshot>(
+                *spawner.globalEnv, roots, scope ? scope->snapshot.get() : nullptr, true);
+            scope = spawner.spawnScope = std::move(fresh);
+        }
+        // The arguments get copies of their own, of the snapshot's classes
+        memo.copyClasses = true;
+        for (const auto& [original, copy] : *scope->snapshot->classes()) {
+            memo[original.get()] = copy;
+        }
+    }
+
+    PyValue callee = copyValue(function, memo);  // A closure's cells included
+    std::vector<PyValue> copied;
+    for (size_t i = 1; i < args.size(); i++) {
+        copied.push_back(copyValue(args[i], memo));
+    }
+
+    auto task = std::make_shared<PyTask>(std::move(name), std::move(callee), std::move(copied));
+    task->roots = std::move(roots);
+    task->programs = spawner.programs;
+    task->classes = scope->snapshot->classes();
+    task->argumentClasses = std::move(memo.classes);
+    pool.submit([task, scope](unsigned worker) mutable {
+        task->run(std::move(scope), worker);
+    });
+    return task;
+}
+
+void PyTask::run(std::shared_ptr<TaskScope> scope, unsigned worker) {
+    // A task run while another waits in join() on this thread finds that
+    // one's context taken, and gets another
+    std::vector<std::unique_ptr<TaskContext>>& idle = scope->idle[worker];
+    std::unique_ptr<TaskContext> context;
+    PyValue callee;
+    std::vector<PyValue> arguments;
+    {
+        // The snapshot and the spawner's copies are on the spawner's heap;
+        // the task runs on copies on this thread's, which it can collect
+        GarbageCollector::Pause pauseCollection;
+        if (idle.empty()) {
+            context = std::make_unique<TaskContext>();
+            scope->snapshot->copyInto(*context->interpreter.globalEnv);
+            context->interpreter.defineContextNatives();  // The snapshot's are bound to the spawner
+            context->interpreter.taskScope = scope.get();
+        } else {
+            context = std::move(idle.back());
+            idle.pop_back();
+        }
+        CopyMemo memo;
+        callee = copyValue(function, memo);
+        for (const PyValue& arg : args) {
+            arguments.push_back(copyValue(arg, memo));
+        }
+    }
+    function = PyNone{};
+    args.clear();
+    Interpreter& interpreter = context->interpreter;
+    // Function values point into the spawner's programs
+    if (interpreter.programs.size() < programs.size()) {
+        interpreter.programs = programs;
+    }
+
+    PyValue value;
+    std::exception_ptr failure;
+    try {
+        // Errors report the line of the join
+        OpToken paren(TokenType::RPAREN, 0, 0);
+        value = interpreter.callValue(callee, ArgSpan(arguments.data(), arguments.size()),
+                                      paren);
+        CopyMemo memo;
+        value = copyValue(value, memo);
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    callee = PyNone{};
+    arguments.clear();
+
+    std::string printed = context->out.str();
+    context->out.str("");
+    // The next task gets the context only if this one left the globals it
+    // could reach as they were copied
+    bool unchanged;
+    {
+        GarbageCollector::Pause pauseCollection;
+        unchanged = scope->snapshot->matches(*interpreter.globalEnv, roots);
+    }
+    if (unchanged) {
+        idle.push_back(std::move(context));
+    }
+    context.reset();
+    scope.reset();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        result = std::move(value);
+        error = failure;
+        output = std::move(printed);
+        done = true;
+    }
+    finished.notify_all();
+}
+
+bool PyTask::isDone() {
+    std::lock_guard<std::mutex> guard(lock);
+    return done;
+}
+
+PyValue PyTask::join(Interpreter& joiner) {
+    WorkPool& pool = WorkPool::shared();
+    if (pool.isWorkerThread()) {
+        // Blocking here could leave every pool thread waiting on a task
+        // that none of them is free to run
+        while (!isDone()) {
+            if (!pool.runPending()) {
+                std::unique_lock<std::mutex> guard(lock);
+                finished.wait_for(guard, std::chrono::milliseconds(1), [this] { return done; });
+            }
+        }
+    } else {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this] { return done; });
+    }
+
+    std::string printed;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        printed.swap(output);
+    }
+    joiner.out << printed;
+
+    // Each joiner gets its own copy of the error, as of the result
+    if (error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const RuntimeError& e) {
+            throw RuntimeError(e.what(), e.line);
+        } catch (const AssertionError& e) {
+            throw AssertionError(e.what(), e.line);
+        }
+    }
+    // Outside the task's scope, its classes are the spawner's again
+    CopyMemo memo;
+    if (!joiner.taskScope || joiner.taskScope->snapshot->classes() != classes) {
+        for (const auto& [original, copy] : *classes) {
+            memo[copy.get()] = original;
+        }
+        for (const auto& [original, copy] : argumentClasses) {
+            memo[copy.get()] = original;
+        }
+    }
+    // The result is on the heap of the thread that ran the task
+    GarbageCollector::Pause pauseCollection;
+    return copyValue(result, memo);
+}
@@ -0,0 +1,76 @@
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "copy.hpp"
+#include "environment.hpp"
+
+class Interpreter;
+struct TaskScope;
+
+// A call started by spawn(f, args...) on the shared WorkPool, and the
+// handle join() waits on. Tasks run on the contexts of a TaskScope: a
+// snapshot of the spawner's globals (see GlobalsSnapshot), from which
+// pool threads make Interpreters, each lent to one task at a time. A
+// spawner keeps its scope for as long as the snapshot still matches its
+// globals, so repeated spawns copy nothing but the function and its
+// arguments. A task spawned inside another task joins its parent's scope.
+//
+// The snapshot holds deep copies of the globals the task can reach,
+// classes included, and each Interpreter a deep copy of the snapshot.
+// Arguments (and the values a closure captured) are deep-copied into the
+// task and its result deep-copied back out, so no container is ever
+// reachable from two threads. An Interpreter is only lent again while its
+// globals match the snapshot, so every task starts from the globals as
+// they were copied. Classes alone are shared by the threads of a scope,
+// and cannot be assigned to (see PyClass).
+class PyTask {
+public:
+
+    // Queues function(args...) to run on the shared pool
+    static std::shared_ptr<PyTask> spawn(Interpreter& spawner, ArgSpan args);
+
+    PyTask(std::string name, PyValue function, std::vector<PyValue> args)
+        : taskName(std::move(name)), function(std::move(function)), args(std::move(args)) {}
+
+    PyTask(const PyTask&) = delete;
+    PyTask& operator=(const PyTask&) = delete;
+
+    const std::string& name() const { return taskName; }
+
+    // Waits for the task and returns a copy of its result, or raises its
+    // error. Its print output is written to the joiner's output the
+    // first time it is joined. On a pool thread, waiting runs other
+    // queued tasks.
+    PyValue join(Interpreter& joiner);
+
+private:
+    std::string taskName;
+    // The spawner's copies, released once copied again by the thread that
+    // runs the task
+    PyValue function;
+    std::vector<PyValue> args;
+    std::vector<std::string> roots;  // The globals it reaches directly
+    std::vector<std::shared_ptr<const Module>> programs;  // The spawner's
+    std::shared_ptr<const ClassCopies> classes;  // Of the task's snapshot
+    ClassCopies argumentClasses;  // Copied for the arguments alone
+
+    std::mutex lock;
+    std::condition_variable finished;
+    bool done = false;
+    PyValue result;
+    std::exception_ptr error;
+    std::string output;  // Printed by the task; handed to the first joiner
+
+    // Takes the job's reference to the scope and drops it, and its context
+    // if not kept, before the task is done
+    void run(std::shared_ptr<TaskScope> scope, unsigned worker);
+    bool isDone();
+};
+
+#endif // TASK_HPP
@@ -0,0 +1,222 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../array_kernels.hpp"
+
+// Simple test framework
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "  " << #name << "... "; \
+    test_##name(); \
+    std::cout << "PASS" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(a, b) do { \
+    if ((a) != (b)) { \
+        std::cerr << "FAIL at line " << __LINE__ << std::endl; \
+        assert(false); \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(x) assert(x)
+#define ASSERT_FALSE(x) assert(!(x))
+
+// Every kernel set is checked against the scalar one, over lengths that
+// cover the vector loops and every tail length
+const size_t maxLength = 21;
+
+const ArrayOp ops[] = {ArrayOp::ADD, ArrayOp::SUB, ArrayOp::MUL, ArrayOp::DIV};
+const ArrayCompare compares[] = {ArrayCompare::LT, ArrayCompare::LE, ArrayCompare::GT,
+                                 ArrayCompare::GE, ArrayCompare::EQ, ArrayCompare::NE};
+
+// Small integers (and integral floats), so float sums are exact in any
+// order; some elements repeat so == and != see both outcomes
+std::vector<long long> intData(size_t n, long long seed) {
+    std::vector<long long> data(n);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = static_cast<long long>((i * 7 + static_cast<size_t>(seed) * 13) % 11) - 5;
+    }
+    return data;
+}
+
+std::vector<double> floatData(size_t n, long long seed) {
+    std::vector<long long> ints = intData(n, seed);
+    return std::vector<double>(ints.begin(), ints.end());
+}
+
+// Bitwise, so NaN results compare equal to themselves
+bool sameDoubles(const std::vector<double>& a, const std::vector<double>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+}
+
+const ArrayKernels& scalarKernels() {
+    return *ArrayKernels::available().front();
+}
+
+//=============================================================================
+// Dispatch Tests
+//=============================================================================
+
+TEST(scalar_always_available) {
+    auto sets = ArrayKernels::available();
+    ASSERT_TRUE(!sets.empty());
+    ASSERT_EQ(std::string(sets.front()->name), "scalar");
+    ASSERT_EQ(&ArrayKernels::best(), sets.back());
+    std::cout << "(best: " << ArrayKernels::best().name << ") ";
+}
+
+//=============================================================================
+// Elementwise Tests
+//=============================================================================
+
+TEST(float_binary_matches_scalar) {
+    for (const ArrayKernels* set : ArrayKernels::available()) {
+        for (ArrayOp op : ops) {
+            for (size_t n = 0; n <= maxLength; n++) {
+                std::vector<double> a = floatData(n, 1);
+                std::vector<double> b = floatData(n, 2);
+                double scalar = 3.0;
+                for (int mode = 0; mode < 3; mode++) {
+                    const double* left = mode == 1 ? &scalar : a.data();
+                    const double* right = mode == 2 ? &scalar : b.data();
+                    std::vector<double> expected(n), actual(n);
+                    scalarKernels().binaryF64(op, left, mode == 1, right, mode == 2,
+                                              expected.data(), n);
+                    set->binaryF64(op, left, mode == 1, right, mode == 2, actual.data(), n);
+                    ASSERT_TRUE(sameDoubles(expected, actual));
+                }
+            }
+        }
+    }
+}
+
+TEST(int_binary_matches_scalar) {
+    for (const ArrayKernels* set : ArrayKernels::available()) {
+        for (ArrayOp op : {ArrayOp::ADD, ArrayOp::SUB, ArrayOp::MUL}) {
+            for (size_t n = 0; n <= maxLength; n++) {
+                std::vector<long long> a = intData(n, 3);
+                std::vector<long long> b = intData(n, 4);
+                long long scalar = -2;
+                for (int mode = 0; mode < 3; mode++) {
+                    const long long* left = mode == 1 ? &scalar : a.data();
+                    const long long* right = mode == 2 ? &scalar : b.data();
+                    std::vector<long long> expected(n), actual(n);
+                    scalarKernels().binaryI64(op, left, mode == 1, right, mode == 2,
+                                              expected.data(), n);
+                    set->binaryI64(op, left, mode == 1, right, mode == 2, actual.data(), n);
+                    ASSERT_TRUE(expected == actual);
+                }
+            }
+        }
+    }
+}
+
+TEST(compare_matches_scalar) {
+    for (const ArrayKernels* set : ArrayKernels::available()) {
+        for (ArrayCompare op : compares) {
+            for (size_t n = 0; n <= maxLength; n++) {
+                std::vector<double> a = floatData(n, 5);
+                std::vector<double> b = floatData(n, 6);
+                if (n > 3) a[3] = std::nan("");  // Unordered: only != holds
+                std::vector<long long> c = intData(n, 5);
+                std::vector<long long> d = intData(n, 6);
+
+                std::vector<long long> expected(n), actual(n);
+                scalarKernels().compareF64(op, a.data(), false, b.data(), false,
+                                           expected.data(), n);
+                set->compareF64(op, a.data(), false, b.data(), false, actual.data(), n);
+                ASSERT_TRUE(expected == actual);
+
+                long long pivot = 1;
+                scalarKernels().compareI64(op, c.data(), false, &pivot, true, expected.data(), n);
+                set->compareI64(op, c.data(), false, &pivot, true, actual.data(), n);
+                ASSERT_TRUE(expected == actual);
+                scalarKernels().compareI64(op, c.data(), false, d.data(), false,
+                                           expected.data(), n);
+                set->compareI64(op, c.data(), false, d.data(), false, actual.data(), n);
+                ASSERT_TRUE(expected == actual);
+            }
+        }
+    }
+}
+
+TEST(compare_writes_ones_and_zeros) {
+    double a[] = {1.0, 2.0, 3.0, 4.0, 5.0};
+    double pivot = 3.0;
+    long long out[5];
+    ArrayKernels::best().compareF64(ArrayCompare::GE, a, false, &pivot, true, out, 5);
+    long long expected[] = {0, 0, 1, 1, 1};
+    for (int i = 0; i < 5; i++) ASSERT_EQ(out[i], expected[i]);
+}
+
+//=============================================================================
+// Reduction Tests
+//=============================================================================
+
+TEST(reductions_match_scalar) {
+    for (const ArrayKernels* set : ArrayKernels::available()) {
+        for (size_t n = 0; n <= maxLength; n++) {
+            std::vector<double> a = floatData(n, 7);
+            std::vector<double> b = floatData(n, 8);
+            std::vector<long long> c = intData(n, 7);
+            std::vector<long long> d = intData(n, 8);
+            const ArrayKernels& scalar = scalarKernels();
+
+            ASSERT_EQ(set->sumF64(a.data(), n), scalar.sumF64(a.data(), n));
+            ASSERT_EQ(set->dotF64(a.data(), b.data(), n), scalar.dotF64(a.data(), b.data(), n));
+            ASSERT_EQ(set->sumI64(c.data(), n), scalar.sumI64(c.data(), n));
+            ASSERT_EQ(set->dotI64(c.data(), d.data(), n), scalar.dotI64(c.data(), d.data(), n));
+            if (n == 0) continue;
+            ASSERT_EQ(set->minF64(a.data(), n), scalar.minF64(a.data(), n));
+            ASSERT_EQ(set->maxF64(a.data(), n), scalar.maxF64(a.data(), n));
+            ASSERT_EQ(set->minI64(c.data(), n), scalar.minI64(c.data(), n));
+            ASSERT_EQ(set->maxI64(c.data(), n), scalar.maxI64(c.data(), n));
+        }
+    }
+}
+
+TEST(extremes_anywhere) {
+    // The extreme element in every position, including the tails
+    for (const ArrayKernels* set : ArrayKernels::available()) {
+        for (size_t n = 1; n <= maxLength; n++) {
+            for (size_t at = 0; at < n; at++) {
+                std::vector<long long> ints(n, 0);
+                std::vector<double> floats(n, 0.0);
+                ints[at] = -1000000000000LL;
+                floats[at] = 1e300;
+                ASSERT_EQ(set->minI64(ints.data(), n), -1000000000000LL);
+                ASSERT_EQ(set->maxF64(floats.data(), n), 1e300);
+            }
+        }
+    }
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main() {
+    std::cout << "Running Array Kernel Tests..." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Dispatch Tests:" << std::endl;
+    RUN_TEST(scalar_always_available);
+
+    std::cout << "\nElementwise Tests:" << std::endl;
+    RUN_TEST(float_binary_matches_scalar);
+    RUN_TEST(int_binary_matches_scalar);
+    RUN_TEST(compare_matches_scalar);
+    RUN_TEST(compare_writes_ones_and_zeros);
+
+    std::cout << "\nReduction Tests:" << std::endl;
+    RUN_TEST(reductions_match_scalar);
+    RUN_TEST(extremes_anywhere);
+
+    std::cout << "\n========================================" << std::endl;
+    std::cout << "All Array Kernel tests passed!" << std::endl;
+
+    return 0;
+}
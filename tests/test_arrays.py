@@ -0,0 +1,75 @@
+# Test construction and element types
+ints = array([1, 2, 3, 4])
+floats = array([0.5, 1.5, 2.5, 3.5])
+assert len(ints) == 4
+assert str(ints) == "array([1, 2, 3, 4])"
+assert str(floats) == "array([0.5, 1.5, 2.5, 3.5])"
+assert str(array([1, 2.5])) == "array([1.0, 2.5])"
+assert str(array([1, 2], "float64")) == "array([1.0, 2.0])"
+assert len(array(range(100))) == 100
+assert len(array([])) == 0
+assert not array([])
+
+# Test indexing, slicing and item assignment
+assert ints[0] == 1
+assert ints[-1] == 4
+assert floats[1] == 1.5
+assert str(ints[1:3]) == "array([2, 3])"
+assert str(ints[::-1]) == "array([4, 3, 2, 1])"
+ints[0] = 10
+assert ints[0] == 10
+ints[0] -= 9
+assert ints[0] == 1
+floats[0] = 2
+assert floats[0] == 2.0
+floats[0] = 0.5
+
+# Test elementwise arithmetic
+assert str(ints + ints) == "array([2, 4, 6, 8])"
+assert str(ints * 2) == "array([2, 4, 6, 8])"
+assert str(10 - ints) == "array([9, 8, 7, 6])"
+assert str(ints / 2) == "array([0.5, 1.0, 1.5, 2.0])"
+assert str(ints + 0.5) == "array([1.5, 2.5, 3.5, 4.5])"
+assert str(floats - ints) == "array([-0.5, -0.5, -0.5, -0.5])"
+assert str(floats * floats) == "array([0.25, 2.25, 6.25, 12.25])"
+
+# Test elementwise comparisons give 1s and 0s
+assert str(ints > 2) == "array([0, 0, 1, 1])"
+assert str(floats <= 1.5) == "array([1, 1, 0, 0])"
+assert str(ints == array([1, 0, 3, 0])) == "array([1, 0, 1, 0])"
+assert sum(floats > 1) == 3
+
+# Test reductions
+assert ints.sum() == 10
+assert floats.sum() == 8.0
+assert sum(ints) == 10
+assert sum(ints, 5) == 15
+assert ints.min() == 1
+assert ints.max() == 4
+assert min(floats) == 0.5
+assert max(floats) == 3.5
+assert ints.dot(ints) == 30
+assert floats.dot(ints) == 25.0
+
+# Test larger arrays (vector loops plus tails)
+big = array(range(1003))
+assert big.sum() == 502503
+assert big.max() == 1002
+assert (big * 2).sum() == 1005006
+assert sum(big >= 500) == 503
+scores = array(range(1003), "float64") / 4
+assert scores.max() == 250.5
+weights = array([2.0] * 1003)
+assert scores.dot(weights) == 251251.5
+
+# Test iteration and conversion
+total = 0
+for x in ints:
+    total += x
+assert total == 10
+assert ints.tolist() == [1, 2, 3, 4]
+assert list(floats) == [0.5, 1.5, 2.5, 3.5]
+assert 3 in ints
+assert 7 not in ints
+
+print("test_arrays.py: All tests passed!")
@@ -0,0 +1,116 @@
+# Test that calling an async def only makes a coroutine
+async def add(a, b):
+    return a + b
+
+c = add(1, 2)
+assert str(c) == "<coroutine object add>"
+assert asyncio.run(c) == 3
+
+# Test awaiting coroutines inside coroutines
+async def double(x):
+    y = await add(x, x)
+    return y
+
+async def chain():
+    return await double(await add(1, 2)) * 10
+assert asyncio.run(chain()) == 60
+
+# Test sleeps that overlap: each task wakes in deadline order, not in the
+# order it was started
+log = []
+async def sleeper(name, delay):
+    await asyncio.sleep(delay)
+    log.append(name)
+    return name
+
+async def sleepers():
+    slow = sleeper("slow", 0.06)
+    return await asyncio.gather(slow, sleeper("fast", 0.02), sleeper("middle", 0.04))
+assert asyncio.run(sleepers()) == ["slow", "fast", "middle"]
+assert log == ["fast", "middle", "slow"]
+
+# Test sleep(0), which lets the other ready tasks run first
+order = []
+async def step(name, n):
+    for i in range(n):
+        order.append(name)
+        await asyncio.sleep(0)
+
+async def steps():
+    await asyncio.gather(step("a", 3), step("b", 3))
+asyncio.run(steps())
+assert order == ["a", "b", "a", "b", "a", "b"]
+
+# Test a pipe between a reader and a writer that starts later
+async def writer(fd):
+    await asyncio.sleep(0.01)
+    await asyncio.write(fd, "hello ")
+    await asyncio.sleep(0.01)
+    await asyncio.write(fd, "pipe")
+    asyncio.close(fd)
+
+async def reader(fd):
+    data = ""
+    chunk = await asyncio.read(fd)
+    while chunk != "":
+        data = data + chunk
+        chunk = await asyncio.read(fd)
+    asyncio.close(fd)
+    return data
+
+async def transfer():
+    ends = asyncio.pipe()
+    results = await asyncio.gather(reader(ends[0]), writer(ends[1]))
+    return results[0]
+assert asyncio.run(transfer()) == "hello pipe"
+
+# Test a Unix socket pair in both directions
+async def echo(fd):
+    request = await asyncio.read(fd)
+    await asyncio.write(fd, request + "!")
+
+async def ask(fd):
+    await asyncio.write(fd, "ping")
+    return await asyncio.read(fd)
+
+async def talk():
+    ends = asyncio.socketpair()
+    results = await asyncio.gather(ask(ends[0]), echo(ends[1]))
+    asyncio.close(ends[0])
+    asyncio.close(ends[1])
+    return results[0]
+assert asyncio.run(talk()) == "ping!"
+
+# Test regular files, which complete without waiting
+async def roundTrip(path):
+    fd = asyncio.open(path, "w")
+    await asyncio.write(fd, "line 1\nline 2\n")
+    asyncio.close(fd)
+    fd = asyncio.open(path)
+    text = await asyncio.read(fd)
+    asyncio.close(fd)
+    return text
+assert asyncio.run(roundTrip("/tmp/minipython_test_async.txt")) == "line 1\nline 2\n"
+
+# Test that sleep hands back its result and gather of nothing is empty
+async def results():
+    a = await asyncio.sleep(0.001, "done")
+    b = await asyncio.gather()
+    return [a, b]
+assert asyncio.run(results()) == ["done", []]
+
+# Test many overlapping waits: 512 tasks sleeping at once, fanned out
+# two at a time
+async def tick(i):
+    await asyncio.sleep(0.01)
+    return i
+
+async def fan(lo, hi):
+    if hi - lo == 1:
+        return await tick(lo)
+    mid = (lo + hi) // 2
+    halves = await asyncio.gather(fan(lo, mid), fan(mid, hi))
+    return halves[0] + halves[1]
+assert asyncio.run(fan(0, 512)) == 130816
+
+print("test_async.py: All tests passed!")
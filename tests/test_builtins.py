@@ -0,0 +1,76 @@
+# Test len
+assert len("") == 0
+assert len("hello") == 5
+assert len(range(10)) == 10
+assert len(range(1, 10, 3)) == 3
+assert len(range(10, 0, -2)) == 5
+assert len(range(5, 1)) == 0
+
+# Test abs
+assert abs(-7) == 7
+assert abs(7) == 7
+assert abs(-2.5) == 2.5
+
+# Test sum
+assert sum([]) == 0
+assert sum([1, 2, 3]) == 6
+assert sum([1, 2, 3], 10) == 16
+assert sum([0.5, 0.25]) == 0.75
+assert sum([1, 2.5]) == 3.5
+assert sum(range(101)) == 5050
+assert sum({1: "a", 2: "b"}) == 3
+assert sum([1, 2], 0.5) == 3.5
+
+# Test min and max
+assert min(3, 1, 2) == 1
+assert max(3, 1, 2) == 3
+assert min(2, 1.5) == 1.5
+assert max("apple", "banana") == "banana"
+assert max(range(1, 10, 3)) == 7
+assert min(range(10, 0, -3)) == 1
+
+# Test conversions
+assert int("42") == 42
+assert int(" -7 ") == -7
+assert int(3.9) == 3
+assert int(-3.9) == -3
+assert int(True) == 1
+assert float("2.5") == 2.5
+assert float(3) == 3.0
+assert str(12) == "12"
+assert str(None) == "None"
+assert str(1.5) + "!" == "1.5!"
+assert bool(0) == False
+assert bool("x") == True
+assert bool() == False
+
+# Test range values
+assert range(5) == range(0, 5)
+assert range(0) == range(3, 1)
+assert range(1, 10, 2) != range(1, 10)
+
+# Test math module
+assert math.sqrt(16) == 4.0
+assert math.floor(2.7) == 2
+assert math.ceil(2.1) == 3
+assert math.floor(-2.5) == -3
+assert math.pow(2, 10) == 1024.0
+assert math.fabs(-1.5) == 1.5
+assert math.pi > 3.14 and math.pi < 3.15
+assert math.exp(0) == 1.0
+
+# Test builtins are first-class values
+f = len
+assert f("abc") == 3
+assert f == len
+sqrt = math.sqrt
+assert sqrt(9) == 3.0
+
+# Test builtins can be shadowed
+def shadow(len):
+    return len
+
+assert shadow(5) == 5
+assert len("ab") == 2
+
+print("test_builtins.py: All tests passed!")
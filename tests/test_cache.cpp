@@ -0,0 +1,155 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <string>
+#include "../lexer.hpp"
+#include "../parser.hpp"
+#include "../cache.hpp"
+
+// Simple test framework
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "  " << #name << "... "; \
+    test_##name(); \
+    std::cout << "PASS" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(a, b) do { \
+    if ((a) != (b)) { \
+        std::cerr << "FAIL at line " << __LINE__ << std::endl; \
+        assert(false); \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(x) assert(x)
+#define ASSERT_FALSE(x) assert(!(x))
+
+// Helper to parse source code
+Module parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+const std::string sampleSource =
+    "def fib(n):\n"
+    "    if n <= 1:\n"
+    "        return n\n"
+    "    elif n == 2:\n"
+    "        return 1\n"
+    "    else:\n"
+    "        return fib(n - 1) + fib(n - 2)\n"
+    "x = 2 ** -1.5\n"
+    "while x < 10:\n"
+    "    x += 1\n"
+    "print('fib', fib(10), None, True, not False)\n"
+    "assert fib(10) == 55, \"fib\"\n"
+    "y = math.sqrt(x)\n"
+    "for i in range(0, 10, 2):\n"
+    "    y += i\n"
+    "items = [1, 'a', [2.5]]\n"
+    "items[0] += items[2][0]\n"
+    "print(items[1:], items[::-1])\n"
+    "counts = {'a': 1, 2: items}\n"
+    "print({1, 2}, 'a' in counts, 3 not in counts)\n"
+    "class Point:\n"
+    "    origin = 0\n"
+    "    def __init__(self, x):\n"
+    "        self.x = x\n"
+    "        self.x *= 2\n"
+    "async def fetch(n):\n"
+    "    return await later(n) ** 2\n"
+    "def evens(n):\n"
+    "    for i in range(n):\n"
+    "        yield i * 2\n"
+    "    yield\n";
+
+//=============================================================================
+// Serialization Tests
+//=============================================================================
+
+TEST(round_trip) {
+    auto module = parse(sampleSource);
+    std::string bytes = CodeCache::serialize(module.statements);
+
+    Module loaded;
+    ASSERT_TRUE(CodeCache::deserialize(bytes.data(), bytes.size(), loaded));
+    ASSERT_EQ(loaded.size(), module.size());
+    ASSERT_EQ(CodeCache::serialize(loaded.statements), bytes);
+}
+
+TEST(round_trip_preserves_names_and_lines) {
+    auto module = parse(sampleSource);
+    std::string bytes = CodeCache::serialize(module.statements);
+
+    Module loaded;
+    ASSERT_TRUE(CodeCache::deserialize(bytes.data(), bytes.size(), loaded));
+    auto& function = std::get<NodePtr<FunctionStmt>>(loaded[0]);
+    ASSERT_EQ(function->name.lexeme, "fib");
+    ASSERT_EQ(function->params[0].lexeme, "n");
+    ASSERT_EQ(function->params[0].line, 1);
+    ASSERT_FALSE(function->isGenerator);
+    ASSERT_FALSE(function->isAsync);
+    ASSERT_TRUE(std::get<NodePtr<FunctionStmt>>(loaded.statements.back())->isGenerator);
+    ASSERT_TRUE(std::get<NodePtr<FunctionStmt>>(loaded[loaded.size() - 2])->isAsync);
+}
+
+TEST(truncated_data_rejected) {
+    auto module = parse(sampleSource);
+    std::string bytes = CodeCache::serialize(module.statements);
+
+    for (size_t size = 0; size < bytes.size(); size += 7) {
+        Module loaded;
+        ASSERT_FALSE(CodeCache::deserialize(bytes.data(), size, loaded));
+    }
+}
+
+TEST(deferred_bodies_stay_deferred) {
+    Lexer lexer(sampleSource);
+    Parser parser(lexer.tokenize(), true);
+    auto module = parser.parse();
+    std::string bytes = CodeCache::serialize(module.statements);
+
+    Module loaded;
+    ASSERT_TRUE(CodeCache::deserialize(bytes.data(), bytes.size(), loaded));
+    auto& function = std::get<NodePtr<FunctionStmt>>(loaded[0]);
+    ASSERT_TRUE(function->hasDeferredBody());
+    ASSERT_EQ(function->body().size(), 1u);
+    ASSERT_EQ(CodeCache::serialize(loaded.statements), bytes);
+}
+
+//=============================================================================
+// Cache Path Tests
+//=============================================================================
+
+TEST(cache_path) {
+    ASSERT_EQ(CodeCache::cachePath("script.py"), "__pycache__/script.py.mpyc");
+    ASSERT_EQ(CodeCache::cachePath("a/b/run.py"), "a/b/__pycache__/run.py.mpyc");
+    ASSERT_EQ(CodeCache::cachePath("/abs/noext"), "/abs/__pycache__/noext.mpyc");
+    ASSERT_EQ(CodeCache::cachePath("a/foo.txt"), "a/__pycache__/foo.txt.mpyc");
+    ASSERT_EQ(CodeCache::cachePath(".hidden"), "__pycache__/.hidden.mpyc");
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main() {
+    std::cout << "Running Cache Tests..." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Serialization Tests:" << std::endl;
+    RUN_TEST(round_trip);
+    RUN_TEST(round_trip_preserves_names_and_lines);
+    RUN_TEST(truncated_data_rejected);
+    RUN_TEST(deferred_bodies_stay_deferred);
+
+    std::cout << "\nCache Path Tests:" << std::endl;
+    RUN_TEST(cache_path);
+
+    std::cout << "\n========================================" << std::endl;
+    std::cout << "All Cache tests passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+# Class, instance and attribute tests
+
+class Point:
+    "A point in the plane"
+    dimensions = 2
+
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+    def norm2(self):
+        return self.x * self.x + self.y * self.y
+
+    def move(self, dx, dy):
+        self.x += dx
+        self.y += dy
+        return self
+
+p = Point(3, 4)
+assert p.x == 3
+assert p.y == 4
+assert p.norm2() == 25
+p.move(1, 1)
+assert p.x == 4 and p.y == 5
+assert p.move(1, 0).move(0, 1).x == 5
+assert str(Point) == "<class 'Point'>"
+assert str(p) == "<Point object>"
+
+# Class attributes are seen through instances until shadowed
+q = Point(0, 0)
+assert q.dimensions == 2
+assert Point.dimensions == 2
+q.dimensions = 3
+assert q.dimensions == 3
+assert p.dimensions == 2
+Point.dimensions = 4
+assert p.dimensions == 4
+assert q.dimensions == 3
+
+# Compound assignment reads the class attribute, writes the instance
+class Counter:
+    count = 0
+
+    def bump(self):
+        self.count += 1
+        return self.count
+
+c = Counter()
+assert c.bump() == 1
+assert c.bump() == 2
+assert Counter.count == 0
+
+# Class attributes updated through the class
+class Registry:
+    made = 0
+
+    def __init__(self):
+        Registry.made += 1
+
+Registry()
+Registry()
+assert Registry.made == 2
+
+# Bound methods remember their instance
+norm = p.norm2
+assert norm() == 61
+p.x = 0
+assert norm() == 36
+assert p.norm2 == p.norm2
+assert p.norm2 != q.norm2
+assert str(norm) == "<bound method Point.norm2>"
+
+# A method looked up on the class is a plain function
+assert Point.norm2(q) == 0
+
+# Attributes can be added after construction, and hold anything
+p.tags = ["a", "b"]
+p.tags.append("c")
+assert len(p.tags) == 3
+p.origin = Point(0, 0)
+assert p.origin.norm2() == 0
+p.origin.x = 2
+assert p.origin.norm2() == 4
+
+# Functions stored on an instance are not bound
+def triple(n):
+    return n * 3
+
+p.scale = triple
+assert p.scale(2) == 6
+
+# Classes without __init__
+class Empty:
+    kind = "empty"
+
+e = Empty()
+e.value = 1
+assert e.value == 1
+assert e.kind == "empty"
+
+# The same call site sees instances of many shapes and classes
+class A:
+    def __init__(self):
+        self.v = 1
+
+class B:
+    def __init__(self):
+        self.w = 0
+        self.v = 2
+
+class C:
+    v = 3
+
+class D:
+    def __init__(self):
+        self.a = 0
+        self.b = 0
+        self.v = 4
+
+class E:
+    def __init__(self):
+        self.v = 5
+        self.e = 0
+
+class F:
+    def value(self):
+        return 6
+
+    def __init__(self):
+        self.v = 6
+
+def total(items):
+    result = 0
+    for item in items:
+        result += item.v
+    return result
+
+items = [A(), B(), C(), D(), E(), F(), A(), B(), C(), D(), E(), F()]
+assert total(items) == 42
+assert total(items) == 42
+assert F().value() == 6
+
+# Instances of one class that diverge in shape
+def make(flag):
+    item = A()
+    if flag:
+        item.extra = 10
+    else:
+        item.other = 20
+    return item
+
+first = make(True)
+second = make(False)
+assert first.v == 1 and first.extra == 10
+assert second.v == 1 and second.other == 20
+
+# Methods can be generators
+class Range2:
+    def __init__(self, n):
+        self.n = n
+
+    def items(self):
+        i = 0
+        while i < self.n:
+            yield i
+            i += 1
+
+assert list(Range2(4).items()) == [0, 1, 2, 3]
+
+# Classes defined in functions close over the function's variables
+def make_scaler(factor):
+    class Scaler:
+        def __init__(self, base):
+            self.base = base
+
+        def apply(self, n):
+            return self.base + n * factor
+    return Scaler
+
+Scaler = make_scaler(10)
+assert Scaler(1).apply(2) == 21
+assert make_scaler(3)(0).apply(2) == 6
+
+# Instances work as dict keys and set members, by identity
+seen = {p: "p", q: "q"}
+assert seen[p] == "p"
+assert len({p, q, p}) == 2
+assert p == p and p != q
+
+# Instances in cycles are collected
+gc.collect()
+node = Point(0, 0)
+node.me = node
+node = None
+assert gc.collect() == 1
+
+# Instances and bound methods are copied into tasks
+def bump_all(points):
+    for point in points:
+        point.x += 1
+    return points[0].x
+
+points = [Point(1, 1), Point(2, 2)]
+assert join(spawn(bump_all, points)) == 2
+assert points[0].x == 1
+assert join(spawn(points[1].norm2)) == 8
+
+print("test_classes.py: All tests passed!")
@@ -0,0 +1,99 @@
+# Closures and function scopes
+
+# Names bound in a function are local to it
+x = 10
+def shadow():
+    x = 1
+    return x
+assert shadow() == 1
+assert x == 10
+
+def loop_local():
+    for i in range(3):
+        last = i
+    return last
+assert loop_local() == 2
+
+def reads_global():
+    return x
+assert reads_global() == 10
+
+# A nested def sees its defining scope
+def adder(n):
+    def add(m):
+        return n + m
+    return add
+add5 = adder(5)
+add7 = adder(7)
+assert add5(1) == 6
+assert add7(1) == 8
+
+# Closures see the variable's latest value, not a copy
+def late():
+    value = 1
+    def get():
+        return value
+    value = 2
+    return get
+assert late()() == 2
+
+# Several closures share one cell
+def pair():
+    items = []
+    def push(item):
+        items.append(item)
+        return len(items)
+    def peek():
+        return items[len(items) - 1]
+    return [push, peek]
+fns = pair()
+push = fns[0]
+peek = fns[1]
+assert push("a") == 1
+assert push("b") == 2
+assert peek() == "b"
+
+# Variables pass through intermediate functions
+def outer():
+    secret = "deep"
+    def middle():
+        def inner():
+            return secret
+        return inner()
+    return middle()
+assert outer() == "deep"
+
+# Recursive nested functions
+def factorial(n):
+    def go(k):
+        if k <= 1:
+            return 1
+        return k * go(k - 1)
+    return go(n)
+assert factorial(10) == 3628800
+
+# Parameters can be captured
+def counter(start):
+    def next_value(step):
+        return start + step
+    return next_value
+assert counter(100)(5) == 105
+
+# Closures in generators
+def numbers(limit):
+    def double(v):
+        return v * 2
+    for i in range(limit):
+        yield double(i)
+assert list(numbers(4)) == [0, 2, 4, 6]
+
+# Recursive closures are freed by the cycle collector
+def churn(n):
+    for i in range(n):
+        factorial(3)
+    return n
+assert churn(2000) == 2000
+gc.collect()
+assert gc.collect() == 0
+
+print("test_closures.py: All tests passed!")
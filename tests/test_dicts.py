@@ -0,0 +1,119 @@
+# Test dict literals and lookup
+empty = {}
+assert len(empty) == 0
+ages = {"alice": 30, "bob": 25,}
+assert len(ages) == 2
+assert ages["alice"] == 30
+assert ages["bob"] == 25
+
+# Test insertion, update and compound assignment
+ages["carol"] = 41
+assert len(ages) == 3
+ages["alice"] = 31
+assert len(ages) == 3
+assert ages["alice"] == 31
+ages["bob"] += 1
+assert ages["bob"] == 26
+
+# Test the in operator
+assert "alice" in ages
+assert "dave" not in ages
+assert not ("dave" in ages)
+assert 2 in [1, 2, 3]
+assert 4 not in [1, 2, 3]
+assert "ell" in "hello"
+assert "xyz" not in "hello"
+assert 4 in range(0, 10, 2)
+assert 5 not in range(0, 10, 2)
+assert 10 not in range(0, 10, 2)
+
+# Test methods
+assert ages.get("alice") == 31
+assert ages.get("dave") == None
+assert ages.get("dave", 0) == 0
+assert ages.pop("carol") == 41
+assert "carol" not in ages
+assert ages.pop("carol", -1) == -1
+assert ages.keys() == ["alice", "bob"]
+assert ages.values() == [31, 26]
+assert ages.items() == [["alice", 31], ["bob", 26]]
+
+# Test iteration follows insertion order, also after deletes
+order = {}
+for key in ["c", "a", "b", "d"]:
+    order[key] = len(order)
+order.pop("a")
+order["a"] = 99
+seen = []
+for key in order:
+    seen.append(key)
+assert seen == ["c", "b", "d", "a"]
+
+# Test counting words
+words = ["the", "cat", "the", "hat", "the", "cat"]
+counts = {}
+for w in words:
+    counts[w] = counts.get(w, 0) + 1
+assert counts["the"] == 3
+assert counts["cat"] == 2
+assert counts["hat"] == 1
+assert counts == {"hat": 1, "cat": 2, "the": 3}
+
+# Test numeric keys: equal numbers are the same key
+nums = {1: "one"}
+nums[1.0] = "uno"
+assert len(nums) == 1
+assert nums[1] == "uno"
+nums[-1] = "minus"
+assert nums[-1] == "minus"
+
+# Test growth across many keys and deletes
+big = {}
+for i in range(1000):
+    big[i] = i * i
+assert len(big) == 1000
+assert big[999] == 998001
+for i in range(0, 1000, 2):
+    big.pop(i)
+assert len(big) == 500
+assert 500 not in big
+assert 501 in big
+for i in range(1000, 2000):
+    big[i] = i
+assert len(big) == 1500
+assert big[1999] == 1999
+
+# Test set literals and operations
+colors = {"red", "green", "blue", "red"}
+assert len(colors) == 3
+assert "red" in colors
+colors.add("yellow")
+colors.add("red")
+assert len(colors) == 4
+colors.remove("green")
+assert "green" not in colors
+colors.discard("purple")
+assert len(colors) == 3
+assert colors == {"blue", "yellow", "red"}
+
+# Test the constructors
+assert set() == set([])
+assert len(set("hello")) == 4
+assert set(range(5)) == {0, 1, 2, 3, 4}
+assert dict() == {}
+pairs = dict([["a", 1], ["b", 2]])
+assert pairs["b"] == 2
+copy = dict(pairs)
+copy["c"] = 3
+assert "c" not in pairs
+assert list(pairs) == ["a", "b"]
+
+# Test truthiness and str
+assert not {}
+assert {1: 2}
+assert not set()
+assert str({"a": 1, 2: [3]}) == "{'a': 1, 2: [3]}"
+assert str({1}) == "{1}"
+assert str(set()) == "set()"
+
+print("test_dicts.py: All tests passed!")
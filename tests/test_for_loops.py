@@ -0,0 +1,104 @@
+# Test for loop over range(stop)
+total = 0
+for i in range(5):
+    total += i
+assert total == 10
+
+# Test range(start, stop)
+total = 0
+for i in range(3, 7):
+    total += i
+assert total == 18
+
+# Test range with a step
+values = ""
+for i in range(1, 10, 3):
+    values = values + str(i)
+assert values == "147"
+
+# Test negative step
+values = ""
+for i in range(5, 0, -2):
+    values = values + str(i)
+assert values == "531"
+
+# Test empty ranges run zero times
+count = 0
+for i in range(0):
+    count += 1
+for i in range(5, 1):
+    count += 1
+assert count == 0
+
+# Test loop variable keeps its last value
+for k in range(4):
+    last = k
+assert k == 3 and last == 3
+
+# Test reassigning the loop variable does not affect iteration
+count = 0
+for i in range(3):
+    i = 100
+    count += 1
+assert count == 3
+
+# Test nested loops
+pairs = 0
+for i in range(4):
+    for j in range(i):
+        pairs += 1
+assert pairs == 6
+
+# Test ranges wider than the largest int
+wide = range(-9223372036854775807, 9223372036854775807, 4611686018427387904)
+assert len(wide) == 4
+assert max(wide) == 4611686018427387905
+assert 1 in wide
+assert 0 not in wide
+down = range(9223372036854775807, -9223372036854775807, -4611686018427387904)
+assert len(down) == 4
+assert min(down) == -4611686018427387905
+assert -1 in down
+assert len(range(-9223372036854775807, 9223372036854775807, 9223372036854775807)) == 2
+assert len(range(0, 9223372036854775807, 4611686018427387904)) == 2
+assert len(range(5, 5, 9223372036854775807)) == 0
+
+# Test loops whose last element is within a step of the largest int
+seen = []
+for i in range(0, 9223372036854775807, 4611686018427387904):
+    seen.append(i)
+assert seen == [0, 4611686018427387904]
+seen = []
+for i in range(-9223372036854775807, 9223372036854775807, 4611686018427387904):
+    seen.append(i)
+assert seen == [-9223372036854775807, -4611686018427387903, 1, 4611686018427387905]
+seen = []
+for i in range(-1, -9223372036854775807, -4611686018427387904):
+    seen.append(i)
+assert seen == [-1, -4611686018427387905]
+assert list(range(9223372036854775806, 9223372036854775807, 5)) == [9223372036854775806]
+assert sum(range(9223372036854775805, 9223372036854775807, 9223372036854775807)) == 9223372036854775805
+
+# Test range stored in a variable
+r = range(2, 5)
+total = 0
+for i in r:
+    total += i
+assert total == 9
+
+# Test iterating a string
+letters = ""
+for c in "abc":
+    letters = c + letters
+assert letters == "cba"
+
+# Test return from inside a loop
+def first_multiple(n, m):
+    for i in range(1, 100):
+        if i % m == 0 and i > n:
+            return i
+    return -1
+
+assert first_multiple(10, 7) == 14
+
+print("test_for_loops.py: All tests passed!")
@@ -0,0 +1,66 @@
+# Cycle collector tests
+
+# A list that contains itself
+a = [1, 2]
+a.append(a)
+assert a[2][2][0] == 1
+a = None
+gc.collect()
+
+# Cycles through dicts
+d = {"name": "d"}
+e = {"name": "e", "d": d}
+d["e"] = e
+assert d["e"]["d"]["name"] == "d"
+d = None
+e = None
+assert gc.collect() == 2
+
+# Reachable cycles survive
+keep = []
+keep.append(keep)
+keep.append({"keep": keep, "value": 42})
+assert gc.collect() == 0
+assert keep[1]["keep"][1]["value"] == 42
+keep = None
+assert gc.collect() == 2
+
+# Collecting the youngest generation only
+young = [0]
+young.append(young)
+young = None
+assert gc.collect(0) == 1
+assert gc.collect() == 0
+
+# Many short-lived cycles are freed as they go
+def churn(n):
+    for i in range(n):
+        x = [i]
+        y = {"x": x}
+        x.append(y)
+    return n
+assert churn(5000) == 5000
+count = gc.get_count()
+assert len(count) == 3
+assert count[0] <= gc.get_threshold()[0]
+
+# Thresholds
+saved = gc.get_threshold()
+assert saved == [700, 10, 10]
+gc.set_threshold(100)
+assert gc.get_threshold() == [100, 10, 10]
+gc.set_threshold(200, 5, 3)
+assert gc.get_threshold() == [200, 5, 3]
+gc.set_threshold(saved[0], saved[1], saved[2])
+assert gc.get_threshold() == saved
+
+# Turning automatic collection off
+assert gc.isenabled()
+gc.disable()
+assert not gc.isenabled()
+assert churn(1000) == 1000
+assert gc.collect() > 0
+gc.enable()
+assert gc.isenabled()
+
+print("test_gc.py: All tests passed!")
@@ -0,0 +1,102 @@
+# Test a simple generator
+def count(n):
+    i = 0
+    while i < n:
+        yield i
+        i = i + 1
+
+seen = []
+for x in count(4):
+    seen.append(x)
+assert seen == [0, 1, 2, 3]
+assert list(count(0)) == []
+
+# Test that the body runs lazily, one step per next()
+steps = []
+def traced():
+    steps.append("start")
+    yield 1
+    steps.append("middle")
+    yield 2
+    steps.append("end")
+
+g = traced()
+assert steps == []
+assert next(g) == 1
+assert steps == ["start"]
+assert next(g) == 2
+assert steps == ["start", "middle"]
+assert next(g, "done") == "done"
+assert steps == ["start", "middle", "end"]
+assert next(g, None) == None
+
+# Test bare yield and return
+def early():
+    yield
+    return 5
+    yield 1
+assert list(early()) == [None]
+
+# Test pipelines of generators
+def evens(source):
+    for v in source:
+        if v % 2 == 0:
+            yield v
+
+def squares(source):
+    for v in source:
+        yield v * v
+
+assert list(squares(evens(count(10)))) == [0, 4, 16, 36, 64]
+assert sum(squares(count(4))) == 14
+assert max(count(5)) == 4
+assert min(squares(range(3, 6))) == 9
+
+# Test recursive generators
+def walk(n):
+    if n > 0:
+        for v in walk(n - 1):
+            yield v
+        yield n
+assert list(walk(5)) == [1, 2, 3, 4, 5]
+
+# Test independent generators over one function, each with its own frame
+def countFrom(i, n):
+    while i < n:
+        yield i
+        i = i + 1
+
+a = countFrom(0, 3)
+b = countFrom(0, 3)
+assert next(a) == 0
+assert next(a) == 1
+assert next(b) == 0
+assert list(a) == [2]
+assert list(b) == [1, 2]
+
+# Test generators in builtins and containers
+assert set(count(3)) == {0, 1, 2}
+def pairs(n):
+    for i in range(n):
+        yield [i, i * i]
+assert dict(pairs(3)) == {0: 0, 1: 1, 2: 4}
+assert str(count(1)) == "<generator object count>"
+assert bool(count(0))
+
+# Test abandoned generators
+def holder():
+    items = [1, 2, 3]
+    for item in items:
+        yield item
+
+for i in range(1000):
+    h = holder()
+    next(h)
+
+# Test a long stream in constant memory
+total = 0
+for v in count(100000):
+    total += v
+assert total == 4999950000
+
+print("test_generators.py: All tests passed!")
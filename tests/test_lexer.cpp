@@ -196,6 +196,14 @@ TEST(print_and_assert) {
     ASSERT_EQ(types[1], TokenType::ASSERT);
 }
 
+TEST(keyword_lookalikes_are_identifiers) {
+    // Same length / first / last character as a keyword, or a keyword prefix
+    auto types = tokenTypes("dof iff ix Fals true none printer assertt e _in");
+    for (size_t i = 0; i < 10; i++) {
+        ASSERT_EQ(types[i], TokenType::IDENTIFIER);
+    }
+}
+
 //=============================================================================
 // Identifier Tests
 //=============================================================================
@@ -353,6 +361,72 @@ TEST(line_numbers) {
     ASSERT_EQ(tokens[4].line, 3);  // c
 }
 
+//=============================================================================
+// Parallel Lexing Tests
+//=============================================================================
+
+void assertSameTokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        ASSERT_EQ(a[i].type, b[i].type);
+        ASSERT_EQ(a[i].lexeme, b[i].lexeme);
+        ASSERT_EQ(a[i].line, b[i].line);
+        ASSERT_EQ(a[i].column, b[i].column);
+    }
+}
+
+TEST(parallel_matches_sequential) {
+    std::string source;
+    for (int i = 0; i < 40; i++) {
+        std::string n = std::to_string(i);
+        source += "def f" + n + "(x):\n";
+        source += "    # comment\n\n";
+        source += "    while x < " + n + ":\n";
+        source += "        x += 1\r\n";
+        source += "  \n";
+        source += "    return 'v" + n + "'\n";
+        source += "print(f" + n + "(0))\n";
+    }
+    source += "if True:\n    if True:\n        x = 1";  // Unterminated blocks
+
+    Lexer lexer(source);
+    auto sequential = lexer.tokenize();
+    for (unsigned workers : {2u, 3u, 8u, 64u}) {
+        assertSameTokens(Lexer::tokenizeParallel(source, workers), sequential);
+    }
+}
+
+TEST(parallel_errors_match_sequential) {
+    std::string source;
+    for (int i = 0; i < 20; i++) {
+        source += "if x:\n    y = 1\n";
+    }
+    source += "if x:\n        y = 1\n    z = 2\n";  // Inconsistent dedent
+    for (int i = 0; i < 20; i++) {
+        source += "a = 'b'\n";
+    }
+
+    int line = 0, column = 0;
+    try {
+        Lexer lexer(source);
+        lexer.tokenize();
+    } catch (const LexerError& e) {
+        line = e.line;
+        column = e.column;
+    }
+    ASSERT_TRUE(line > 0);
+
+    bool threw = false;
+    try {
+        Lexer::tokenizeParallel(source, 4);
+    } catch (const LexerError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, line);
+        ASSERT_EQ(e.column, column);
+    }
+    ASSERT_TRUE(threw);
+}
+
 //=============================================================================
 // Main
 //=============================================================================
@@ -387,6 +461,7 @@ int main() {
     RUN_TEST(keywords);
     RUN_TEST(boolean_keywords);
     RUN_TEST(print_and_assert);
+    RUN_TEST(keyword_lookalikes_are_identifiers);
 
     std::cout << "\nIdentifier Tests:" << std::endl;
     RUN_TEST(simple_identifier);
@@ -416,6 +491,10 @@ int main() {
     std::cout << "\nLine/Column Tests:" << std::endl;
     RUN_TEST(line_numbers);
 
+    std::cout << "\nParallel Lexing Tests:" << std::endl;
+    RUN_TEST(parallel_matches_sequential);
+    RUN_TEST(parallel_errors_match_sequential);
+
     std::cout << "\n========================================" << std::endl;
     std::cout << "All Lexer tests passed!" << std::endl;
 
@@ -0,0 +1,136 @@
+# Test list literals
+empty = []
+assert len(empty) == 0
+nums = [1, 2, 3]
+assert len(nums) == 3
+trailing = [1, 2,]
+assert len(trailing) == 2
+mixed = [1, "two", 3.0, None, True]
+assert len(mixed) == 5
+
+# Test indexing
+assert nums[0] == 1
+assert nums[2] == 3
+assert nums[-1] == 3
+assert nums[-3] == 1
+assert mixed[1] == "two"
+
+# Test item assignment
+nums[1] = 20
+assert nums[1] == 20
+nums[-1] = 30
+assert nums == [1, 20, 30]
+nums[0] += 5
+assert nums[0] == 6
+
+# Test append and pop
+items = []
+for i in range(5):
+    items.append(i * i)
+assert items == [0, 1, 4, 9, 16]
+assert items.pop() == 16
+assert items.pop(0) == 0
+assert items == [1, 4, 9]
+
+# Test lists are shared by reference
+alias = items
+alias.append(100)
+assert items[-1] == 100
+
+# Test slicing
+letters = ["a", "b", "c", "d", "e"]
+assert letters[1:3] == ["b", "c"]
+assert letters[:2] == ["a", "b"]
+assert letters[3:] == ["d", "e"]
+assert letters[:] == letters
+assert letters[::2] == ["a", "c", "e"]
+assert letters[::-1] == ["e", "d", "c", "b", "a"]
+assert letters[-2:] == ["d", "e"]
+assert letters[10:] == []
+assert letters[4:1:-2] == ["e", "c"]
+
+# Test slices are copies
+copy = letters[:]
+copy[0] = "z"
+assert letters[0] == "a"
+
+# Test string indexing and slicing
+word = "hello"
+assert word[0] == "h"
+assert word[-1] == "o"
+assert word[1:4] == "ell"
+assert word[::-1] == "olleh"
+
+# Test concatenation and repetition
+assert [1, 2] + [3] == [1, 2, 3]
+assert [0] * 3 == [0, 0, 0]
+assert 2 * ["x"] == ["x", "x"]
+
+# Test iteration
+total = 0
+for n in [1, 2, 3, 4]:
+    total += n
+assert total == 10
+
+# Test equality
+assert [1, 2] == [1, 2]
+assert [1, 2] != [2, 1]
+assert [1, [2, 3]] == [1, [2, 3]]
+assert [1] != 1
+
+# Test builtins with lists
+assert list(range(4)) == [0, 1, 2, 3]
+assert list("ab") == ["a", "b"]
+assert max([3, 9, 2]) == 9
+assert min([3, 9, 2]) == 2
+assert str([1, "a", None]) == "[1, 'a', None]"
+
+# Test truthiness
+assert not []
+assert [0]
+
+# Test nested lists
+grid = [[0] * 3, [0] * 3]
+grid[1][2] = 5
+assert grid[1][2] == 5
+assert grid[0][2] == 0
+
+# Test lists that change element types (int and float lists are stored
+# packed until something else is stored in them)
+ints = [1, 2, 3]
+ints.append(4)
+assert ints == [1, 2, 3, 4]
+ints[0] = 1.5
+assert ints == [1.5, 2, 3, 4]
+ints.append("x")
+assert ints[-1] == "x"
+assert ints.pop() == "x"
+assert ints == [1.5, 2, 3, 4]
+floats = [0.5] * 3
+floats.append(2)
+assert floats == [0.5, 0.5, 0.5, 2]
+assert [1, 2] == [1.0, 2.0]
+assert [1, 2] + [3.5] == [1, 2, 3.5]
+assert [] + [1, 2] == [1, 2]
+assert [1, 2] + [] == [1, 2]
+assert [1.5, 2.5] + [3.5] == [1.5, 2.5, 3.5]
+assert 2 in [1, 2, 3]
+assert 2.0 in [1, 2, 3]
+assert 2 in [1.0, 2.0]
+assert 2.5 not in [1, 2, 3]
+assert [5, 6, 7, 8][::-2] == [8, 6]
+assert [0.25, 0.5][1:] == [0.5]
+mixed_start = []
+mixed_start.append(True)
+mixed_start.append(1)
+assert mixed_start[0] == True
+assert mixed_start[1] == 1
+assert max([2.5, 9.5, 1.0]) == 9.5
+assert min([2.5, 9.5, 1.0]) == 1.0
+
+# Test bound methods
+push = items.append
+push(7)
+assert items[-1] == 7
+
+print("test_lists.py: All tests passed!")
@@ -24,7 +24,7 @@
 #define ASSERT_FALSE(x) assert(!(x))
 
 // Helper to parse source code
-std::vector<Stmt> parse(const std::string& source) {
+Module parse(const std::string& source) {
     Lexer lexer(source);
     auto tokens = lexer.tokenize();
     Parser parser(tokens);
@@ -44,13 +44,13 @@ bool parses(const std::string& source) {
 // Helper to check statement type
 template<typename T>
 bool isStmtType(const Stmt& stmt) {
-    return std::holds_alternative<std::unique_ptr<T>>(stmt);
+    return std::holds_alternative<NodePtr<T>>(stmt);
 }
 
 // Helper to check expression type
 template<typename T>
 bool isExprType(const Expr& expr) {
-    return std::holds_alternative<std::unique_ptr<T>>(expr);
+    return std::holds_alternative<NodePtr<T>>(expr);
 }
 
 //=============================================================================
@@ -62,48 +62,48 @@ TEST(integer_expression) {
     ASSERT_EQ(stmts.size(), 1u);
     ASSERT_TRUE(isStmtType<ExpressionStmt>(stmts[0]));
 
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<LiteralExpr>(exprStmt->expression));
 
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_TRUE(std::holds_alternative<long long>(literal->value));
     ASSERT_EQ(std::get<long long>(literal->value), 42LL);
 }
 
 TEST(float_expression) {
     auto stmts = parse("3.14\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_TRUE(std::holds_alternative<double>(literal->value));
 }
 
 TEST(string_expression) {
     auto stmts = parse("\"hello\"\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_TRUE(std::holds_alternative<std::string>(literal->value));
     ASSERT_EQ(std::get<std::string>(literal->value), "hello");
 }
 
 TEST(boolean_true) {
     auto stmts = parse("True\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_TRUE(std::holds_alternative<bool>(literal->value));
     ASSERT_TRUE(std::get<bool>(literal->value));
 }
 
 TEST(boolean_false) {
     auto stmts = parse("False\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_FALSE(std::get<bool>(literal->value));
 }
 
 TEST(none_literal) {
     auto stmts = parse("None\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& literal = std::get<std::unique_ptr<LiteralExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& literal = std::get<NodePtr<LiteralExpr>>(exprStmt->expression);
     ASSERT_TRUE(std::holds_alternative<PyNone>(literal->value));
 }
 
@@ -113,45 +113,45 @@ TEST(none_literal) {
 
 TEST(addition) {
     auto stmts = parse("1 + 2\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<BinaryExpr>(exprStmt->expression));
 
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::PLUS);
 }
 
 TEST(subtraction) {
     auto stmts = parse("5 - 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::MINUS);
 }
 
 TEST(multiplication) {
     auto stmts = parse("2 * 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::STAR);
 }
 
 TEST(division) {
     auto stmts = parse("10 / 2\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::SLASH);
 }
 
 TEST(floor_division) {
     auto stmts = parse("10 // 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::DOUBLE_SLASH);
 }
 
 TEST(power) {
     auto stmts = parse("2 ** 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::DOUBLE_STAR);
 }
 
@@ -166,15 +166,15 @@ TEST(comparison_operators) {
 
 TEST(logical_and) {
     auto stmts = parse("True and False\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::AND);
 }
 
 TEST(logical_or) {
     auto stmts = parse("True or False\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
     ASSERT_EQ(binExpr->op.type, TokenType::OR);
 }
 
@@ -184,17 +184,17 @@ TEST(logical_or) {
 
 TEST(unary_minus) {
     auto stmts = parse("-5\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<UnaryExpr>(exprStmt->expression));
 
-    auto& unaryExpr = std::get<std::unique_ptr<UnaryExpr>>(exprStmt->expression);
+    auto& unaryExpr = std::get<NodePtr<UnaryExpr>>(exprStmt->expression);
     ASSERT_EQ(unaryExpr->op.type, TokenType::MINUS);
 }
 
 TEST(logical_not) {
     auto stmts = parse("not True\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& unaryExpr = std::get<std::unique_ptr<UnaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& unaryExpr = std::get<NodePtr<UnaryExpr>>(exprStmt->expression);
     ASSERT_EQ(unaryExpr->op.type, TokenType::NOT);
 }
 
@@ -205,22 +205,22 @@ TEST(logical_not) {
 TEST(mult_before_add) {
     // 1 + 2 * 3 should parse as 1 + (2 * 3)
     auto stmts = parse("1 + 2 * 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
 
     // Top level should be +
     ASSERT_EQ(binExpr->op.type, TokenType::PLUS);
     // Right side should be *
     ASSERT_TRUE(isExprType<BinaryExpr>(binExpr->right));
-    auto& rightExpr = std::get<std::unique_ptr<BinaryExpr>>(binExpr->right);
+    auto& rightExpr = std::get<NodePtr<BinaryExpr>>(binExpr->right);
     ASSERT_EQ(rightExpr->op.type, TokenType::STAR);
 }
 
 TEST(parentheses_override_precedence) {
     // (1 + 2) * 3 should parse as (1 + 2) * 3
     auto stmts = parse("(1 + 2) * 3\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& binExpr = std::get<std::unique_ptr<BinaryExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
 
     // Top level should be *
     ASSERT_EQ(binExpr->op.type, TokenType::STAR);
@@ -228,25 +228,65 @@ TEST(parentheses_override_precedence) {
     ASSERT_TRUE(isExprType<GroupingExpr>(binExpr->left));
 }
 
+TEST(power_is_right_associative) {
+    // 2 ** 3 ** 2 should parse as 2 ** (3 ** 2)
+    auto stmts = parse("2 ** 3 ** 2\n");
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& binExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
+
+    ASSERT_EQ(binExpr->op.type, TokenType::DOUBLE_STAR);
+    ASSERT_TRUE(isExprType<LiteralExpr>(binExpr->left));
+    ASSERT_TRUE(isExprType<BinaryExpr>(binExpr->right));
+}
+
+TEST(unary_minus_below_power) {
+    // -2 ** 2 should parse as -(2 ** 2)
+    auto stmts = parse("-2 ** 2\n");
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& unaryExpr = std::get<NodePtr<UnaryExpr>>(exprStmt->expression);
+    ASSERT_EQ(unaryExpr->op.type, TokenType::MINUS);
+    ASSERT_TRUE(isExprType<BinaryExpr>(unaryExpr->operand));
+}
+
+TEST(not_below_comparison) {
+    // not a == b and c should parse as (not (a == b)) and c
+    auto stmts = parse("not a == b and c\n");
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& andExpr = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
+    ASSERT_EQ(andExpr->op.type, TokenType::AND);
+
+    auto& notExpr = std::get<NodePtr<UnaryExpr>>(andExpr->left);
+    ASSERT_EQ(notExpr->op.type, TokenType::NOT);
+    auto& eqExpr = std::get<NodePtr<BinaryExpr>>(notExpr->operand);
+    ASSERT_EQ(eqExpr->op.type, TokenType::EQ);
+}
+
+TEST(not_inside_operand_rejected) {
+    ASSERT_FALSE(parses("a < not b\n"));
+    ASSERT_FALSE(parses("x * not y\n"));
+    ASSERT_TRUE(parses("not -x\n"));
+    ASSERT_TRUE(parses("2 ** -1\n"));
+}
+
 //=============================================================================
 // Variable Tests
 //=============================================================================
 
 TEST(variable_reference) {
     auto stmts = parse("foo\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<VariableExpr>(exprStmt->expression));
 
-    auto& varExpr = std::get<std::unique_ptr<VariableExpr>>(exprStmt->expression);
+    auto& varExpr = std::get<NodePtr<VariableExpr>>(exprStmt->expression);
     ASSERT_EQ(varExpr->name.lexeme, "foo");
 }
 
 TEST(assignment) {
     auto stmts = parse("x = 5\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<AssignExpr>(exprStmt->expression));
 
-    auto& assignExpr = std::get<std::unique_ptr<AssignExpr>>(exprStmt->expression);
+    auto& assignExpr = std::get<NodePtr<AssignExpr>>(exprStmt->expression);
     ASSERT_EQ(assignExpr->name.lexeme, "x");
 }
 
@@ -263,27 +303,128 @@ TEST(compound_assignment) {
 
 TEST(function_call_no_args) {
     auto stmts = parse("foo()\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
     ASSERT_TRUE(isExprType<CallExpr>(exprStmt->expression));
 
-    auto& callExpr = std::get<std::unique_ptr<CallExpr>>(exprStmt->expression);
+    auto& callExpr = std::get<NodePtr<CallExpr>>(exprStmt->expression);
     ASSERT_EQ(callExpr->arguments.size(), 0u);
 }
 
 TEST(function_call_one_arg) {
     auto stmts = parse("foo(1)\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& callExpr = std::get<std::unique_ptr<CallExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& callExpr = std::get<NodePtr<CallExpr>>(exprStmt->expression);
     ASSERT_EQ(callExpr->arguments.size(), 1u);
 }
 
 TEST(function_call_multiple_args) {
     auto stmts = parse("foo(1, 2, 3)\n");
-    auto& exprStmt = std::get<std::unique_ptr<ExpressionStmt>>(stmts[0]);
-    auto& callExpr = std::get<std::unique_ptr<CallExpr>>(exprStmt->expression);
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& callExpr = std::get<NodePtr<CallExpr>>(exprStmt->expression);
     ASSERT_EQ(callExpr->arguments.size(), 3u);
 }
 
+TEST(list_literal) {
+    auto stmts = parse("[1, x + 1, [],]\n");
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    ASSERT_TRUE(isExprType<ListExpr>(exprStmt->expression));
+
+    auto& listExpr = std::get<NodePtr<ListExpr>>(exprStmt->expression);
+    ASSERT_EQ(listExpr->elements.size(), 3u);
+    ASSERT_TRUE(isExprType<ListExpr>(listExpr->elements[2]));
+    ASSERT_FALSE(parses("[1, 2\n"));
+    ASSERT_FALSE(parses("[,]\n"));
+}
+
+TEST(index_and_slice) {
+    auto stmts = parse("a[i][0]\na[1:]\na[::-1]\n");
+    auto& first = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& outer = std::get<NodePtr<IndexExpr>>(first->expression);
+    ASSERT_TRUE(isExprType<IndexExpr>(outer->object));
+
+    auto& second = std::get<NodePtr<ExpressionStmt>>(stmts[1]);
+    auto& slice = std::get<NodePtr<SliceExpr>>(second->expression);
+    ASSERT_TRUE(slice->lower != nullptr);
+    ASSERT_TRUE(slice->upper == nullptr);
+    ASSERT_TRUE(slice->step == nullptr);
+
+    auto& third = std::get<NodePtr<ExpressionStmt>>(stmts[2]);
+    auto& reversed = std::get<NodePtr<SliceExpr>>(third->expression);
+    ASSERT_TRUE(reversed->lower == nullptr);
+    ASSERT_TRUE(reversed->upper == nullptr);
+    ASSERT_TRUE(reversed->step != nullptr);
+}
+
+TEST(index_assignment) {
+    auto stmts = parse("a[0] = 1\na[i] += 2\n");
+    auto& plain = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& assign = std::get<NodePtr<IndexAssignExpr>>(plain->expression);
+    ASSERT_EQ(assign->op.type, TokenType::ASSIGN);
+
+    auto& compound = std::get<NodePtr<ExpressionStmt>>(stmts[1]);
+    auto& update = std::get<NodePtr<IndexAssignExpr>>(compound->expression);
+    ASSERT_EQ(update->op.type, TokenType::PLUS);
+    ASSERT_FALSE(parses("a[1:2] = 3\n"));
+}
+
+TEST(attribute_assignment) {
+    auto stmts = parse("p.x = 1\np.y -= 2\n");
+    auto& plain = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& assign = std::get<NodePtr<AttributeAssignExpr>>(plain->expression);
+    ASSERT_EQ(assign->name.lexeme, std::string("x"));
+    ASSERT_EQ(assign->op.type, TokenType::ASSIGN);
+
+    auto& compound = std::get<NodePtr<ExpressionStmt>>(stmts[1]);
+    auto& update = std::get<NodePtr<AttributeAssignExpr>>(compound->expression);
+    ASSERT_EQ(update->op.type, TokenType::MINUS);
+    ASSERT_FALSE(parses("p.f() = 3\n"));
+}
+
+TEST(dict_and_set_literals) {
+    auto stmts = parse("{}\n{'a': 1, 'b': 2,}\n{1, 2}\n");
+    auto& empty = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& emptyDict = std::get<NodePtr<DictExpr>>(empty->expression);
+    ASSERT_EQ(emptyDict->keys.size(), 0u);
+
+    auto& pairs = std::get<NodePtr<ExpressionStmt>>(stmts[1]);
+    auto& dict = std::get<NodePtr<DictExpr>>(pairs->expression);
+    ASSERT_EQ(dict->keys.size(), 2u);
+    ASSERT_EQ(dict->values.size(), 2u);
+
+    auto& elements = std::get<NodePtr<ExpressionStmt>>(stmts[2]);
+    auto& set = std::get<NodePtr<SetExpr>>(elements->expression);
+    ASSERT_EQ(set->elements.size(), 2u);
+    ASSERT_FALSE(parses("{1: 2, 3}\n"));
+    ASSERT_FALSE(parses("{1, 2: 3}\n"));
+}
+
+TEST(in_and_not_in) {
+    auto stmts = parse("x in d\nx not in d\n");
+    auto& first = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& in = std::get<NodePtr<BinaryExpr>>(first->expression);
+    ASSERT_EQ(in->op.type, TokenType::IN);
+
+    // `not in` is the negation of `in`
+    auto& second = std::get<NodePtr<ExpressionStmt>>(stmts[1]);
+    auto& notIn = std::get<NodePtr<UnaryExpr>>(second->expression);
+    ASSERT_EQ(notIn->op.type, TokenType::NOT);
+    ASSERT_TRUE(isExprType<BinaryExpr>(notIn->operand));
+    ASSERT_FALSE(parses("x not d\n"));
+}
+
+TEST(attribute_call) {
+    auto stmts = parse("math.sqrt(x) + 1\n");
+    auto& exprStmt = std::get<NodePtr<ExpressionStmt>>(stmts[0]);
+    auto& sum = std::get<NodePtr<BinaryExpr>>(exprStmt->expression);
+    auto& callExpr = std::get<NodePtr<CallExpr>>(sum->left);
+    ASSERT_TRUE(isExprType<GetExpr>(callExpr->callee));
+
+    auto& getExpr = std::get<NodePtr<GetExpr>>(callExpr->callee);
+    ASSERT_EQ(getExpr->name.lexeme, "sqrt");
+    ASSERT_TRUE(isExprType<VariableExpr>(getExpr->object));
+    ASSERT_FALSE(parses("math.\n"));
+}
+
 //=============================================================================
 // Print Statement Tests
 //=============================================================================
@@ -292,19 +433,19 @@ TEST(print_no_args) {
     auto stmts = parse("print()\n");
     ASSERT_TRUE(isStmtType<PrintStmt>(stmts[0]));
 
-    auto& printStmt = std::get<std::unique_ptr<PrintStmt>>(stmts[0]);
+    auto& printStmt = std::get<NodePtr<PrintStmt>>(stmts[0]);
     ASSERT_EQ(printStmt->expressions.size(), 0u);
 }
 
 TEST(print_one_arg) {
     auto stmts = parse("print(42)\n");
-    auto& printStmt = std::get<std::unique_ptr<PrintStmt>>(stmts[0]);
+    auto& printStmt = std::get<NodePtr<PrintStmt>>(stmts[0]);
     ASSERT_EQ(printStmt->expressions.size(), 1u);
 }
 
 TEST(print_multiple_args) {
     auto stmts = parse("print(1, 2, 3)\n");
-    auto& printStmt = std::get<std::unique_ptr<PrintStmt>>(stmts[0]);
+    auto& printStmt = std::get<NodePtr<PrintStmt>>(stmts[0]);
     ASSERT_EQ(printStmt->expressions.size(), 3u);
 }
 
@@ -319,20 +460,20 @@ TEST(if_statement) {
 
 TEST(if_else_statement) {
     auto stmts = parse("if True:\n    x\nelse:\n    y\n");
-    auto& ifStmt = std::get<std::unique_ptr<IfStmt>>(stmts[0]);
+    auto& ifStmt = std::get<NodePtr<IfStmt>>(stmts[0]);
     ASSERT_TRUE(ifStmt->elseBranch != nullptr);
 }
 
 TEST(if_elif_else_statement) {
     auto stmts = parse("if a:\n    x\nelif b:\n    y\nelse:\n    z\n");
-    auto& ifStmt = std::get<std::unique_ptr<IfStmt>>(stmts[0]);
+    auto& ifStmt = std::get<NodePtr<IfStmt>>(stmts[0]);
     ASSERT_EQ(ifStmt->elifBranches.size(), 1u);
     ASSERT_TRUE(ifStmt->elseBranch != nullptr);
 }
 
 TEST(multiple_elif) {
     auto stmts = parse("if a:\n    x\nelif b:\n    y\nelif c:\n    z\n");
-    auto& ifStmt = std::get<std::unique_ptr<IfStmt>>(stmts[0]);
+    auto& ifStmt = std::get<NodePtr<IfStmt>>(stmts[0]);
     ASSERT_EQ(ifStmt->elifBranches.size(), 2u);
 }
 
@@ -345,6 +486,17 @@ TEST(while_statement) {
     ASSERT_TRUE(isStmtType<WhileStmt>(stmts[0]));
 }
 
+TEST(for_statement) {
+    auto stmts = parse("for i in range(1, 10, 2):\n    x\n");
+    ASSERT_TRUE(isStmtType<ForStmt>(stmts[0]));
+
+    auto& forStmt = std::get<NodePtr<ForStmt>>(stmts[0]);
+    ASSERT_EQ(forStmt->variable.lexeme, "i");
+    ASSERT_TRUE(isExprType<CallExpr>(forStmt->iterable));
+    ASSERT_FALSE(parses("for i range(3):\n    x\n"));
+    ASSERT_FALSE(parses("for 1 in range(3):\n    x\n"));
+}
+
 //=============================================================================
 // Function Definition Tests
 //=============================================================================
@@ -353,21 +505,21 @@ TEST(function_def_no_params) {
     auto stmts = parse("def foo():\n    return 1\n");
     ASSERT_TRUE(isStmtType<FunctionStmt>(stmts[0]));
 
-    auto& funcStmt = std::get<std::unique_ptr<FunctionStmt>>(stmts[0]);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
     ASSERT_EQ(funcStmt->name.lexeme, "foo");
     ASSERT_EQ(funcStmt->params.size(), 0u);
 }
 
 TEST(function_def_one_param) {
     auto stmts = parse("def foo(x):\n    return x\n");
-    auto& funcStmt = std::get<std::unique_ptr<FunctionStmt>>(stmts[0]);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
     ASSERT_EQ(funcStmt->params.size(), 1u);
     ASSERT_EQ(funcStmt->params[0].lexeme, "x");
 }
 
 TEST(function_def_multiple_params) {
     auto stmts = parse("def foo(a, b, c):\n    return a\n");
-    auto& funcStmt = std::get<std::unique_ptr<FunctionStmt>>(stmts[0]);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
     ASSERT_EQ(funcStmt->params.size(), 3u);
 }
 
@@ -377,21 +529,110 @@ TEST(function_def_multiple_params) {
 
 TEST(return_with_value) {
     auto stmts = parse("def f():\n    return 42\n");
-    auto& funcStmt = std::get<std::unique_ptr<FunctionStmt>>(stmts[0]);
-    ASSERT_EQ(funcStmt->body.size(), 1u);
-    ASSERT_TRUE(isStmtType<ReturnStmt>(funcStmt->body[0]));
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_EQ(funcStmt->body().size(), 1u);
+    ASSERT_TRUE(isStmtType<ReturnStmt>(funcStmt->body()[0]));
 
-    auto& retStmt = std::get<std::unique_ptr<ReturnStmt>>(funcStmt->body[0]);
+    auto& retStmt = std::get<NodePtr<ReturnStmt>>(funcStmt->body()[0]);
     ASSERT_TRUE(retStmt->value != nullptr);
 }
 
 TEST(return_without_value) {
     auto stmts = parse("def f():\n    return\n");
-    auto& funcStmt = std::get<std::unique_ptr<FunctionStmt>>(stmts[0]);
-    auto& retStmt = std::get<std::unique_ptr<ReturnStmt>>(funcStmt->body[0]);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    auto& retStmt = std::get<NodePtr<ReturnStmt>>(funcStmt->body()[0]);
     ASSERT_TRUE(retStmt->value == nullptr);
 }
 
+//=============================================================================
+// Yield Statement Tests
+//=============================================================================
+
+TEST(yield_makes_generator) {
+    auto stmts = parse("def f():\n    yield 1\n    yield\ndef g():\n    return 1\n");
+    auto& gen = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_TRUE(gen->isGenerator);
+    ASSERT_TRUE(isStmtType<YieldStmt>(gen->body()[0]));
+    ASSERT_TRUE(std::get<NodePtr<YieldStmt>>(gen->body()[1])->value == nullptr);
+    ASSERT_FALSE(std::get<NodePtr<FunctionStmt>>(stmts[1])->isGenerator);
+}
+
+TEST(yield_in_nested_def) {
+    // Only the def that directly contains the yield is a generator, with
+    // lazy bodies as well as parsed ones
+    const std::string source =
+        "def outer():\n    def inner():\n        if True:\n            yield 1\n"
+        "    return inner\ndef last():\n    yield 2\n";
+    for (bool lazy : {false, true}) {
+        Lexer lexer(source);
+        auto stmts = Parser(lexer.tokenize(), lazy).parse();
+        auto& outer = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+        ASSERT_FALSE(outer->isGenerator);
+        ASSERT_TRUE(std::get<NodePtr<FunctionStmt>>(outer->body()[0])->isGenerator);
+        ASSERT_TRUE(std::get<NodePtr<FunctionStmt>>(stmts[1])->isGenerator);
+    }
+}
+
+TEST(yield_outside_function) {
+    ASSERT_FALSE(parses("yield 1\n"));
+    ASSERT_FALSE(parses("if True:\n    yield 1\n"));
+}
+
+//=============================================================================
+// Async Tests
+//=============================================================================
+
+TEST(async_def_and_await) {
+    auto stmts = parse("async def f(x):\n    return await g(x) ** 2\n");
+    auto& function = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_TRUE(function->isAsync);
+    ASSERT_FALSE(function->isGenerator);
+
+    // await binds tighter than **
+    auto& ret = std::get<NodePtr<ReturnStmt>>(function->body()[0]);
+    auto& power = std::get<NodePtr<BinaryExpr>>(*ret->value);
+    ASSERT_EQ(power->op.type, TokenType::DOUBLE_STAR);
+    auto& await = std::get<NodePtr<AwaitExpr>>(power->left);
+    ASSERT_TRUE(isExprType<CallExpr>(await->operand));
+}
+
+TEST(await_only_in_async_def) {
+    ASSERT_FALSE(parses("await f()\n"));
+    ASSERT_FALSE(parses("def f():\n    await g()\n"));
+    ASSERT_FALSE(parses("async def f():\n    def g():\n        await h()\n"));
+    ASSERT_FALSE(parses("async def f():\n    yield 1\n"));
+    ASSERT_FALSE(parses("async f():\n    return 1\n"));
+    ASSERT_TRUE(parses("def f():\n    async def g():\n        await h()\n"));
+}
+
+//=============================================================================
+// Class Tests
+//=============================================================================
+
+TEST(class_definition) {
+    auto stmts = parse("class Point():\n"
+                       "    \"A docstring\"\n"
+                       "    origin = 0\n"
+                       "    def __init__(self, x):\n"
+                       "        self.x = x\n"
+                       "    def get(self):\n"
+                       "        return self.x\n");
+    auto& cls = std::get<NodePtr<ClassStmt>>(stmts[0]);
+    ASSERT_EQ(cls->name.lexeme, std::string("Point"));
+    ASSERT_EQ(cls->body.size(), 3u);  // The docstring is dropped
+    ASSERT_TRUE(isStmtType<ExpressionStmt>(cls->body[0]));
+    auto& init = std::get<NodePtr<FunctionStmt>>(cls->body[1]);
+    ASSERT_EQ(init->params.size(), 2u);
+}
+
+TEST(class_body_holds_methods_and_attributes) {
+    ASSERT_FALSE(parses("class A(B):\n    x = 1\n"));
+    ASSERT_FALSE(parses("class A:\n    print(1)\n"));
+    ASSERT_FALSE(parses("class A:\n    if x:\n        y = 1\n"));
+    ASSERT_FALSE(parses("class A:\n    return 1\n"));
+    ASSERT_TRUE(parses("def f():\n    class A:\n        def g(self):\n            yield 1\n"));
+}
+
 //=============================================================================
 // Assert Statement Tests
 //=============================================================================
@@ -403,7 +644,7 @@ TEST(assert_simple) {
 
 TEST(assert_with_message) {
     auto stmts = parse("assert False, \"error\"\n");
-    auto& assertStmt = std::get<std::unique_ptr<AssertStmt>>(stmts[0]);
+    auto& assertStmt = std::get<NodePtr<AssertStmt>>(stmts[0]);
     ASSERT_TRUE(assertStmt->message != nullptr);
 }
 
@@ -441,6 +682,162 @@ TEST(nested_blocks) {
     ASSERT_EQ(stmts.size(), 1u);
 }
 
+//=============================================================================
+// Arena Tests
+//=============================================================================
+
+TEST(nodes_live_in_module_arena) {
+    // PrintStmt, BinaryExpr and two LiteralExprs
+    auto stmts = parse("print(1 + 2)\n");
+    ASSERT_EQ(stmts.arena->size(), 4u);
+
+    // Copying a node reference shares the node
+    Stmt copy = stmts[0];
+    ASSERT_EQ(std::get<NodePtr<PrintStmt>>(copy).get(),
+              std::get<NodePtr<PrintStmt>>(stmts[0]).get());
+}
+
+TEST(arena_outlives_parser) {
+    Module module;
+    {
+        Lexer lexer("def f(a, b):\n    return a * b\n");
+        module = Parser(lexer.tokenize()).parse();
+    }
+    auto& function = std::get<NodePtr<FunctionStmt>>(module[0]);
+    auto& ret = std::get<NodePtr<ReturnStmt>>(function->body()[0]);
+    ASSERT_TRUE(isExprType<BinaryExpr>(*ret->value));
+}
+
+//=============================================================================
+// Lazy Function Body Tests
+//=============================================================================
+
+Module parseLazy(const std::string& source) {
+    Lexer lexer(source);
+    Parser parser(lexer.tokenize(), true);
+    return parser.parse();
+}
+
+TEST(lazy_body_parsed_on_demand) {
+    auto stmts = parseLazy("def f(x):\n    if x:\n        return 1\n    return 2\ny = 3\n");
+    ASSERT_EQ(stmts.size(), 2u);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_TRUE(funcStmt->hasDeferredBody());
+    ASSERT_EQ(funcStmt->params.size(), 1u);
+
+    ASSERT_EQ(funcStmt->body().size(), 2u);
+    ASSERT_TRUE(isStmtType<IfStmt>(funcStmt->body()[0]));
+    ASSERT_TRUE(isStmtType<ExpressionStmt>(stmts[1]));
+}
+
+TEST(lazy_body_defers_syntax_errors) {
+    auto stmts = parseLazy("def f():\n    return (1 +\nx = 1\n");
+    ASSERT_EQ(stmts.size(), 2u);
+    auto& funcStmt = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+
+    bool threw = false;
+    try {
+        funcStmt->body();
+    } catch (const ParseError& e) {
+        threw = true;
+        ASSERT_EQ(e.token.line, 2);
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(lazy_async_body) {
+    // The await is checked when the body is parsed, knowing it is async
+    auto stmts = parseLazy("async def f():\n    await g()\ndef h():\n    await g()\n");
+    auto& f = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_TRUE(f->isAsync);
+    ASSERT_TRUE(f->hasDeferredBody());
+    auto& statement = std::get<NodePtr<ExpressionStmt>>(f->body()[0]);
+    ASSERT_TRUE(isExprType<AwaitExpr>(statement->expression));
+
+    bool threw = false;
+    try {
+        std::get<NodePtr<FunctionStmt>>(stmts[1])->body();
+    } catch (const ParseError& e) {
+        threw = true;
+        ASSERT_EQ(e.token.line, 4);
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(lazy_nested_functions) {
+    auto stmts = parseLazy("def outer():\n    def inner():\n        return 1\n    return inner\n");
+    auto& outer = std::get<NodePtr<FunctionStmt>>(stmts[0]);
+    ASSERT_EQ(outer->body().size(), 2u);
+    auto& inner = std::get<NodePtr<FunctionStmt>>(outer->body()[0]);
+    ASSERT_TRUE(inner->hasDeferredBody());
+    ASSERT_EQ(inner->body().size(), 1u);
+}
+
+//=============================================================================
+// Parallel Parsing Tests
+//=============================================================================
+
+std::string generatedModule(int functions) {
+    std::string source;
+    for (int i = 0; i < functions; i++) {
+        std::string n = std::to_string(i);
+        source += "def f" + n + "(x):\n";
+        source += "    if x > " + n + ":\n";
+        source += "        return x\n";
+        source += "    else:\n";
+        source += "        return " + n + "\n";
+        source += "y" + n + " = f" + n + "(1)\n";
+        source += "if y" + n + ":\n    print(y" + n + ")\nelif y" + n + " == 0:\n    pass_ = 1\n";
+    }
+    return source;
+}
+
+std::string parseErrorMessage(const std::vector<Token>& tokens, bool parallel) {
+    try {
+        if (parallel) {
+            Parser::parseParallel(tokens, 4);
+        } else {
+            Parser(tokens).parse();
+        }
+    } catch (const ParseError& e) {
+        return e.what();
+    }
+    return "";
+}
+
+TEST(parallel_matches_sequential) {
+    Lexer lexer(generatedModule(50));
+    auto tokens = lexer.tokenize();
+    auto sequential = Parser(tokens).parse();
+    ParallelParseStats stats;
+    auto parallel = Parser::parseParallel(tokens, 4, false, &stats);
+
+    // Every chunk parsed on its own: none started inside a block (such as
+    // on the INDENT of a def body) and had to be re-parsed sequentially
+    ASSERT_TRUE(stats.chunks > 1);
+    ASSERT_EQ(stats.reparsedChunks, 0u);
+
+    ASSERT_EQ(parallel.size(), sequential.size());
+    ASSERT_EQ(parallel.arena->size(), sequential.arena->size());
+    for (size_t i = 0; i < sequential.size(); i++) {
+        ASSERT_EQ(parallel[i].index(), sequential[i].index());
+    }
+    // if/elif chains must not be split across chunks
+    ASSERT_TRUE(isStmtType<IfStmt>(parallel[2]));
+    ASSERT_EQ(std::get<NodePtr<IfStmt>>(parallel[2])->elifBranches.size(), 1u);
+}
+
+TEST(parallel_error_matches_sequential) {
+    std::string source = generatedModule(20) + "def broken(:\n    return 1\n" +
+                         generatedModule(20) + "x = (1 +\n";
+    Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+
+    std::string expected = parseErrorMessage(tokens, false);
+    ASSERT_FALSE(expected.empty());
+    ASSERT_EQ(parseErrorMessage(tokens, true), expected);
+}
+
 //=============================================================================
 // Main
 //=============================================================================
@@ -475,6 +872,10 @@ int main() {
     std::cout << "\nOperator Precedence Tests:" << std::endl;
     RUN_TEST(mult_before_add);
     RUN_TEST(parentheses_override_precedence);
+    RUN_TEST(power_is_right_associative);
+    RUN_TEST(unary_minus_below_power);
+    RUN_TEST(not_below_comparison);
+    RUN_TEST(not_inside_operand_rejected);
 
     std::cout << "\nVariable Tests:" << std::endl;
     RUN_TEST(variable_reference);
@@ -485,6 +886,13 @@ int main() {
     RUN_TEST(function_call_no_args);
     RUN_TEST(function_call_one_arg);
     RUN_TEST(function_call_multiple_args);
+    RUN_TEST(attribute_call);
+    RUN_TEST(list_literal);
+    RUN_TEST(index_and_slice);
+    RUN_TEST(index_assignment);
+    RUN_TEST(attribute_assignment);
+    RUN_TEST(dict_and_set_literals);
+    RUN_TEST(in_and_not_in);
 
     std::cout << "\nPrint Statement Tests:" << std::endl;
     RUN_TEST(print_no_args);
@@ -499,6 +907,7 @@ int main() {
 
     std::cout << "\nWhile Statement Tests:" << std::endl;
     RUN_TEST(while_statement);
+    RUN_TEST(for_statement);
 
     std::cout << "\nFunction Definition Tests:" << std::endl;
     RUN_TEST(function_def_no_params);
@@ -509,6 +918,19 @@ int main() {
     RUN_TEST(return_with_value);
     RUN_TEST(return_without_value);
 
+    std::cout << "\nYield Statement Tests:" << std::endl;
+    RUN_TEST(yield_makes_generator);
+    RUN_TEST(yield_in_nested_def);
+    RUN_TEST(yield_outside_function);
+
+    std::cout << "\nAsync Tests:" << std::endl;
+    RUN_TEST(async_def_and_await);
+    RUN_TEST(await_only_in_async_def);
+
+    std::cout << "\nClass Tests:" << std::endl;
+    RUN_TEST(class_definition);
+    RUN_TEST(class_body_holds_methods_and_attributes);
+
     std::cout << "\nAssert Statement Tests:" << std::endl;
     RUN_TEST(assert_simple);
     RUN_TEST(assert_with_message);
@@ -523,6 +945,20 @@ int main() {
     RUN_TEST(multiple_statements);
     RUN_TEST(nested_blocks);
 
+    std::cout << "\nArena Tests:" << std::endl;
+    RUN_TEST(nodes_live_in_module_arena);
+    RUN_TEST(arena_outlives_parser);
+
+    std::cout << "\nLazy Function Body Tests:" << std::endl;
+    RUN_TEST(lazy_body_parsed_on_demand);
+    RUN_TEST(lazy_body_defers_syntax_errors);
+    RUN_TEST(lazy_nested_functions);
+    RUN_TEST(lazy_async_body);
+
+    std::cout << "\nParallel Parsing Tests:" << std::endl;
+    RUN_TEST(parallel_matches_sequential);
+    RUN_TEST(parallel_error_matches_sequential);
+
     std::cout << "\n========================================" << std::endl;
     std::cout << "All Parser tests passed!" << std::endl;
 
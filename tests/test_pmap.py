@@ -0,0 +1,59 @@
+# Test that results come back in the order of the items
+def square(x):
+    return x * x
+
+assert pmap(square, range(10), 3) == [0, 1, 4, 9, 16, 25, 36, 49, 64, 81]
+assert pmap(square, [5]) == [25]
+assert pmap(square, []) == []
+
+# Test more workers than items, and the default worker count
+assert pmap(square, [1, 2], 16) == [1, 4]
+expected = []
+for x in range(100):
+    expected.append(x * x)
+assert pmap(square, range(100)) == expected
+
+# Test builtins and other iterables
+assert pmap(str, [1, 2.5, True], 2) == ["1", "2.5", "True"]
+assert pmap(len, ["ab", "", "abcd"], 2) == [2, 0, 4]
+assert pmap(str, "abc", 2) == ["a", "b", "c"]
+assert pmap(square, array([1, 2, 3]), 2) == [1, 4, 9]
+
+# Test functions that call other functions and read globals
+scale = 10
+def fib(n):
+    if n < 2:
+        return n
+    return fib(n - 1) + fib(n - 2)
+
+def scaled(n):
+    return fib(n) * scale
+
+assert pmap(scaled, range(12), 4) == [0, 10, 10, 20, 30, 50, 80, 130, 210, 340, 550, 890]
+
+# Test that workers see the caller's containers without changing them
+table = {"a": 1, "b": 2}
+def lookup(key):
+    return table[key]
+
+assert pmap(lookup, ["b", "a", "b"], 2) == [2, 1, 2]
+assert table == {"a": 1, "b": 2}
+
+# Test that each call sees the globals as they are when it is made
+table["a"] = 5
+assert pmap(lookup, ["a"], 2) == [5]
+scale = 3
+assert pmap(scaled, [5, 6], 2) == [15, 24]
+
+# Test that what one call changes in a worker's globals is gone by the next
+seen = []
+def record(x):
+    seen.append(x)
+    return len(seen)
+
+first = pmap(record, range(4), 1)
+assert sum(first) == 10
+assert pmap(record, range(4), 1) == first
+assert seen == []
+
+print("test_pmap.py: All tests passed!")
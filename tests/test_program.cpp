@@ -0,0 +1,1467 @@
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../parser.hpp"
+#include "../array.hpp"
+#include "../dict.hpp"
+#include "../gc.hpp"
+#include "../generator.hpp"
+#include "../interpreter.hpp"
+#include "../list.hpp"
+#include "../marshal.hpp"
+#include "../object.hpp"
+#include "../process_pool.hpp"
+#include "../program.hpp"
+#include "../scheduler.hpp"
+#include "../work_pool.hpp"
+
+// Simple test framework
+#define TEST(name) void test_##name()
+#define RUN_TEST(name) do { \
+    std::cout << "  " << #name << "... "; \
+    test_##name(); \
+    std::cout << "PASS" << std::endl; \
+} while(0)
+
+#define ASSERT_EQ(a, b) do { \
+    if ((a) != (b)) { \
+        std::cerr << "FAIL at line " << __LINE__ << std::endl; \
+        assert(false); \
+    } \
+} while(0)
+
+#define ASSERT_TRUE(x) assert(x)
+#define ASSERT_FALSE(x) assert(!(x))
+
+const std::string requestSource =
+    "def fib(n):\n"
+    "    if n <= 1:\n"
+    "        return n\n"
+    "    return fib(n - 1) + fib(n - 2)\n"
+    "\n"
+    "result = fib(x) * scale\n"
+    "print(\"fib\", x)\n";
+
+//=============================================================================
+// Program Tests
+//=============================================================================
+
+TEST(injected_inputs_and_results) {
+    Program program = Program::compile(requestSource);
+
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.setGlobal("x", 10LL);
+    interpreter.setGlobal("scale", 2LL);
+    interpreter.run(program);
+
+    ASSERT_TRUE(interpreter.hasGlobal("result"));
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("result")), 110LL);
+    ASSERT_EQ(out.str(), "fib 10\n");
+}
+
+TEST(runs_are_isolated) {
+    Program program = Program::compile("y = 1\n");
+    Program reader = Program::compile("z = y\n");
+
+    std::ostringstream out;
+    Interpreter first(out);
+    first.run(program);
+
+    Interpreter second(out);
+    ASSERT_FALSE(second.hasGlobal("y"));
+    bool threw = false;
+    try {
+        second.run(reader);
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(program_outlives_its_handle) {
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    {
+        Program program = Program::compile("def twice(n):\n    return n * 2\n");
+        interpreter.run(program);
+    }
+    interpreter.run(Program::compile("r = twice(21)\n"));
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("r")), 42LL);
+}
+
+TEST(shared_across_threads) {
+    // Function bodies are deferred, so the threads also race to parse them
+    Program program = Program::compile(requestSource);
+
+    const int threadCount = 8;
+    std::vector<long long> results(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            std::ostringstream out;
+            for (int i = 0; i < 20; i++) {
+                Interpreter interpreter(out);
+                interpreter.setGlobal("x", static_cast<long long>(t + 5));
+                interpreter.setGlobal("scale", 1LL);
+                interpreter.run(program);
+                results[t] = std::get<long long>(interpreter.getGlobal("result"));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const long long fibs[] = {5, 8, 13, 21, 34, 55, 89, 144};
+    for (int t = 0; t < threadCount; t++) {
+        ASSERT_EQ(results[t], fibs[t]);
+    }
+}
+
+TEST(embedder_natives) {
+    Program program = Program::compile("total = scaled(3) + scaled(4)\n");
+
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    long long factor = 10;
+    interpreter.defineNative("scaled", 1, 1, [factor](ArgSpan args) -> PyValue {
+        return std::get<long long>(args[0]) * factor;
+    });
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("total")), 70LL);
+
+    // Arity is checked before the native runs
+    bool threw = false;
+    try {
+        interpreter.run(Program::compile("scaled(1, 2)\n"));
+    } catch (const RuntimeError& e) {
+        threw = e.line == 1;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(compile_errors_throw) {
+    bool threw = false;
+    try {
+        Program::compile("x = (1 +\n");
+    } catch (const ParseError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(generators_closed_with_interpreter) {
+    // A generator suspended inside a loop when its interpreter goes away is
+    // unwound; one that outlives it is simply exhausted
+    std::ostringstream out;
+    PyValue survivor;
+    {
+        Interpreter interpreter(out);
+        interpreter.run(Program::compile(
+            "def numbers(items):\n"
+            "    for item in items:\n"
+            "        yield item\n"
+            "g = numbers([[1], [2], [3]])\n"
+            "first = next(g)\n"));
+        ASSERT_EQ(pyValueToString(interpreter.getGlobal("first")), "[1]");
+        survivor = interpreter.getGlobal("g");
+    }
+    auto generator = std::get<std::shared_ptr<PyGenerator>>(survivor);
+    ASSERT_FALSE(generator->next());
+}
+
+//=============================================================================
+// Scheduler Tests
+//=============================================================================
+
+TEST(tasks_interleave) {
+    // Both scripts log to one shared list; with a small budget the tasks
+    // take turns instead of running one after the other
+    Program program = Program::compile(
+        "i = 0\n"
+        "while i < 20:\n"
+        "    log(name)\n"
+        "    i += 1\n");
+    std::vector<std::string> log;
+    std::ostringstream out;
+    Interpreter first(out);
+    Interpreter second(out);
+    Scheduler scheduler(5);
+    auto spawn = [&](Interpreter& interpreter, const char* name) {
+        interpreter.setGlobal("name", std::string(name));
+        interpreter.defineNative("log", 1, 1, [&log](ArgSpan args) -> PyValue {
+            log.push_back(std::get<std::string>(args[0]));
+            return PyNone{};
+        });
+        scheduler.spawn(interpreter, [&interpreter, &program] { interpreter.run(program); });
+    };
+    spawn(first, "a");
+    spawn(second, "b");
+    scheduler.run();
+
+    ASSERT_EQ(log.size(), 40u);
+    ASSERT_EQ(log.front(), "a");
+    size_t switches = 0;
+    for (size_t i = 1; i < log.size(); i++) {
+        if (log[i] != log[i - 1]) switches++;
+    }
+    ASSERT_TRUE(switches >= 10);
+    ASSERT_EQ(std::get<long long>(first.getGlobal("i")), 20LL);
+    ASSERT_EQ(std::get<long long>(second.getGlobal("i")), 20LL);
+}
+
+TEST(many_tasks) {
+    Program program = Program::compile(
+        "def evens(n):\n"
+        "    for k in range(n):\n"
+        "        if k % 2 == 0:\n"
+        "            yield k\n"
+        "total = sum(evens(seed))\n");
+    const int taskCount = 2000;
+    std::ostringstream out;
+    std::vector<std::unique_ptr<Interpreter>> interpreters;
+    Scheduler scheduler(7);
+    for (int i = 0; i < taskCount; i++) {
+        interpreters.push_back(std::make_unique<Interpreter>(out));
+        Interpreter* interpreter = interpreters.back().get();
+        interpreter->setGlobal("seed", static_cast<long long>(i % 50));
+        scheduler.spawn(*interpreter, [interpreter, &program] { interpreter->run(program); });
+    }
+    ASSERT_EQ(scheduler.pending(), static_cast<size_t>(taskCount));
+    scheduler.run();
+    ASSERT_EQ(scheduler.pending(), 0u);
+
+    for (int i = 0; i < taskCount; i++) {
+        long long n = i % 50;
+        long long expected = 0;
+        for (long long k = 0; k < n; k += 2) expected += k;
+        ASSERT_EQ(std::get<long long>(interpreters[i]->getGlobal("total")), expected);
+    }
+}
+
+TEST(failing_task_does_not_stop_others) {
+    std::ostringstream out;
+    Interpreter failing(out);
+    Interpreter working(out);
+    Scheduler scheduler(2);
+    scheduler.spawn(failing, [&failing] { failing.run(Program::compile("x = 1\ny = x / 0\n")); });
+    scheduler.spawn(working, [&working] {
+        working.run(Program::compile("n = 0\nwhile n < 10:\n    n += 1\n"));
+    });
+
+    bool threw = false;
+    try {
+        scheduler.run();
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQ(std::get<long long>(working.getGlobal("n")), 10LL);
+
+    // Preemption is off again once a task has finished
+    working.run(Program::compile("n = 0\nwhile n < 10:\n    n += 1\n"));
+    ASSERT_EQ(std::get<long long>(working.getGlobal("n")), 10LL);
+}
+
+//=============================================================================
+// Event Loop Tests
+//=============================================================================
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(sleeps_overlap) {
+    // 256 tasks each sleep 0.1s; run one after another they would take 25s
+    Program program = Program::compile(
+        "async def tick(i):\n"
+        "    await asyncio.sleep(0.1)\n"
+        "    return 1\n"
+        "async def fan(lo, hi):\n"
+        "    if hi - lo == 1:\n"
+        "        return await tick(lo)\n"
+        "    halves = await asyncio.gather(fan(lo, (lo + hi) // 2), fan((lo + hi) // 2, hi))\n"
+        "    return halves[0] + halves[1]\n"
+        "count = asyncio.run(fan(0, 256))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    auto start = std::chrono::steady_clock::now();
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("count")), 256LL);
+    ASSERT_TRUE(secondsSince(start) < 2.0);
+}
+
+TEST(read_does_not_block_other_tasks) {
+    // The pipe is written from another thread 50ms in; meanwhile the
+    // ticker task keeps running
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+    Program program = Program::compile(
+        "done = []\n"
+        "ticks = []\n"
+        "async def reader():\n"
+        "    done.append(await asyncio.read(fd))\n"
+        "async def ticker():\n"
+        "    while len(done) == 0:\n"
+        "        ticks.append(1)\n"
+        "        await asyncio.sleep(0.005)\n"
+        "async def main():\n"
+        "    await asyncio.gather(reader(), ticker())\n"
+        "asyncio.run(main())\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.setGlobal("fd", static_cast<long long>(fds[0]));
+
+    std::thread writer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(write(fds[1], "data", 4), 4);
+    });
+    interpreter.run(program);
+    writer.join();
+    close(fds[0]);
+    close(fds[1]);
+
+    auto done = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("done"));
+    ASSERT_EQ(std::get<std::string>(done->get(0)), "data");
+    auto ticks = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("ticks"));
+    ASSERT_TRUE(ticks->size() >= 3);
+}
+
+TEST(failure_cancels_waiting_tasks) {
+    // The error ends the run at once; the task sleeping for 1000s is
+    // cancelled rather than waited for, and the next run starts afresh
+    Program program = Program::compile(
+        "async def forever():\n"
+        "    await asyncio.sleep(1000)\n"
+        "async def fails():\n"
+        "    await asyncio.sleep(0.01)\n"
+        "    return 1 // 0\n"
+        "async def main():\n"
+        "    await asyncio.gather(forever(), fails())\n"
+        "asyncio.run(main())\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    auto start = std::chrono::steady_clock::now();
+    bool threw = false;
+    try {
+        interpreter.run(program);
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 5);
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_TRUE(secondsSince(start) < 2.0);
+
+    interpreter.run(Program::compile(
+        "async def answer():\n"
+        "    return await asyncio.sleep(0, 42)\n"
+        "result = asyncio.run(answer())\n"));
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("result")), 42LL);
+}
+
+//=============================================================================
+// Parallel Map Tests
+//=============================================================================
+
+TEST(pool_steals_from_busy_worker) {
+    // Every job lands on the deque of the worker that submitted them, so
+    // any job run elsewhere was stolen
+    WorkPool pool(4);
+    std::mutex lock;
+    std::vector<unsigned> ranOn;
+    pool.submit([&](unsigned) {
+        for (int i = 0; i < 64; i++) {
+            pool.submit([&](unsigned worker) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::lock_guard<std::mutex> guard(lock);
+                ranOn.push_back(worker);
+            });
+        }
+    });
+    pool.wait();
+    ASSERT_EQ(ranOn.size(), static_cast<size_t>(64));
+    bool stolen = false;
+    for (unsigned worker : ranOn) {
+        if (worker != ranOn[0]) stolen = true;
+    }
+    ASSERT_TRUE(stolen);
+}
+
+TEST(pmap_keeps_order) {
+    // Items cost very different amounts, so they finish out of order
+    Program program = Program::compile(
+        "def work(n):\n"
+        "    total = 0\n"
+        "    for i in range(n * 200):\n"
+        "        total = total + i\n"
+        "    return [n, total]\n"
+        "results = pmap(work, [9, 1, 7, 0, 5, 3, 8, 2, 6, 4], 4)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto results = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("results"));
+    ASSERT_EQ(results->size(), static_cast<size_t>(10));
+    long long expected[] = {9, 1, 7, 0, 5, 3, 8, 2, 6, 4};
+    for (size_t i = 0; i < 10; i++) {
+        auto pair = std::get<std::shared_ptr<PyList>>(results->get(i));
+        long long n = expected[i] * 200;
+        ASSERT_EQ(std::get<long long>(pair->get(0)), expected[i]);
+        ASSERT_EQ(std::get<long long>(pair->get(1)), n * (n - 1) / 2);
+    }
+}
+
+TEST(pmap_workers_get_own_globals) {
+    // Each worker assigns to a snapshot of the globals; print output is
+    // passed on once the map is done
+    Program program = Program::compile(
+        "last = -1\n"
+        "def visit(x):\n"
+        "    last = x\n"
+        "    print(\"item\", x)\n"
+        "    return last * 2\n"
+        "results = pmap(visit, range(6), 3)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("last")), -1LL);
+    auto results = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("results"));
+    ASSERT_EQ(std::get<long long>(results->get(5)), 10LL);
+    for (int i = 0; i < 6; i++) {
+        ASSERT_TRUE(out.str().find("item " + std::to_string(i) + "\n") != std::string::npos);
+    }
+}
+
+TEST(pmap_workers_mutate_their_own_globals) {
+    // Every call appends to a global list and changes its item; each
+    // worker has its own copy of the list, and the caller's list and
+    // items are left alone
+    Program program = Program::compile(
+        "log = []\n"
+        "items = []\n"
+        "for i in range(16):\n"
+        "    items.append([i])\n"
+        "def work(item):\n"
+        "    log.append(item[0])\n"
+        "    item.append(len(log))\n"
+        "    return item[0]\n"
+        "total = 0\n"
+        "for round in range(20):\n"
+        "    for x in pmap(work, items, 8):\n"
+        "        total += x\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("total")), 20LL * 120);
+    auto log = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("log"));
+    ASSERT_EQ(log->size(), static_cast<size_t>(0));
+    auto items = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("items"));
+    ASSERT_EQ(std::get<std::shared_ptr<PyList>>(items->get(3))->size(), static_cast<size_t>(1));
+}
+
+TEST(pmap_raises_earliest_error) {
+    // Items 30 and 70 both fail; whichever worker gets there first, the
+    // error from item 30 is the one raised
+    Program program = Program::compile(
+        "def check(x):\n"
+        "    if x == 30:\n"
+        "        return x // 0\n"
+        "    if x == 70:\n"
+        "        return [][x]\n"
+        "    return x\n"
+        "pmap(check, range(100), 4)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    bool threw = false;
+    try {
+        interpreter.run(program);
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 3);
+    }
+    ASSERT_TRUE(threw);
+
+    threw = false;
+    try {
+        interpreter.run(Program::compile("pmap(len, [[1], 2], 2)\n"));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 1);
+    }
+    ASSERT_TRUE(threw);
+
+    // A call the workers make themselves fails at the pmap call's line
+    threw = false;
+    try {
+        interpreter.run(Program::compile(
+            "def pair(a, b):\n"
+            "    return a\n"
+            "results = pmap(pair, [1, 2], 2)\n"));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 3);
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(pmap_copies_only_what_workers_reach) {
+    // A large global the function never reads costs nothing per call, and
+    // one it reads is compared on each call rather than copied
+    Program program = Program::compile(
+        "big = {}\n"
+        "for i in range(20000):\n"
+        "    big[i] = [i, i + 1]\n"
+        "def square(x):\n"
+        "    return x * x\n"
+        "def score(k):\n"
+        "    return big[k][1]\n"
+        "total = 0\n"
+        "for i in range(50):\n"
+        "    total += len(pmap(square, range(8), 2))\n"
+        "    total += pmap(score, [i], 2)[0]\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    auto start = std::chrono::steady_clock::now();
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("total")), 50LL * 8 + 50 * 51 / 2);
+    ASSERT_TRUE(secondsSince(start) < 2.0);
+}
+
+TEST(pmap_sees_globals_changed_between_calls) {
+    // The globals the workers copy are taken again once those they reach
+    // change, in place or rebound
+    Program program = Program::compile(
+        "scale = 1\n"
+        "table = {\"k\": [1]}\n"
+        "def f(x):\n"
+        "    return x * scale + table[\"k\"][0]\n"
+        "a = pmap(f, [1, 2], 2)\n"
+        "scale = 3\n"
+        "b = pmap(f, [1, 2], 2)\n"
+        "table[\"k\"][0] = 10\n"
+        "c = pmap(f, [1, 2], 2)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto first = [&](const char* name) {
+        auto results = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal(name));
+        return std::get<long long>(results->get(1));
+    };
+    ASSERT_EQ(first("a"), 3LL);
+    ASSERT_EQ(first("b"), 7LL);
+    ASSERT_EQ(first("c"), 16LL);
+}
+
+TEST(pmap_calls_start_from_fresh_globals) {
+    // What f changes in a worker's globals is gone by the next call, so
+    // identical calls return identical results
+    Program program = Program::compile(
+        "seen = []\n"
+        "def f(x):\n"
+        "    seen.append(x)\n"
+        "    return len(seen)\n"
+        "runs = []\n"
+        "for i in range(3):\n"
+        "    runs.append(pmap(f, range(4), 1))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto runs = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("runs"));
+    ASSERT_EQ(runs->size(), static_cast<size_t>(3));
+    auto first = std::get<std::shared_ptr<PyList>>(runs->get(0));
+    long long total = 0;
+    for (size_t j = 0; j < first->size(); j++) {
+        total += std::get<long long>(first->get(j));
+    }
+    ASSERT_EQ(total, 1LL + 2 + 3 + 4);
+    for (size_t i = 1; i < runs->size(); i++) {
+        auto results = std::get<std::shared_ptr<PyList>>(runs->get(i));
+        ASSERT_EQ(results->size(), first->size());
+        for (size_t j = 0; j < results->size(); j++) {
+            ASSERT_EQ(std::get<long long>(results->get(j)),
+                      std::get<long long>(first->get(j)));
+        }
+    }
+    auto seen = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("seen"));
+    ASSERT_EQ(seen->size(), static_cast<size_t>(0));
+}
+
+//=============================================================================
+// Worker Process Tests
+//=============================================================================
+
+TEST(marshal_round_trip) {
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "value = [None, True, -7, 2.5, \"text\", range(1, 9, 2), [1, 2], [0.5], "
+        "{\"k\": [3, \"v\"], 4: {5}}, array([1.5, 2.5]), array([1, 2])]\n"));
+    PyValue value = interpreter.getGlobal("value");
+    PyValue loaded = Marshal::load(Marshal::dump(value));
+    ASSERT_TRUE(pyEquals(loaded, value));
+    ASSERT_EQ(pyValueToString(loaded), pyValueToString(value));
+
+    // Packed lists stay packed
+    auto list = std::get<std::shared_ptr<PyList>>(loaded);
+    auto ints = std::get<std::shared_ptr<PyList>>(list->get(6));
+    ASSERT_TRUE(ints->storage() == PyList::Storage::INT);
+}
+
+TEST(marshal_shares_large_values) {
+    // With a segment, only a reference to the string goes in the encoding
+    std::unique_ptr<SharedSegment> segment;
+    PyValue text = std::string(Marshal::sharedThreshold * 4, 'x');
+    std::string encoded = Marshal::dump(text, &segment);
+    ASSERT_TRUE(segment != nullptr);
+    ASSERT_TRUE(encoded.size() < 64);
+    auto received = std::make_shared<const SharedSegment>(dup(segment->finish()));
+    ASSERT_TRUE(pyEquals(Marshal::load(encoded, received), text));
+    ASSERT_TRUE(Marshal::dump(text).size() > Marshal::sharedThreshold * 4);
+
+    // Small values need no segment
+    std::unique_ptr<SharedSegment> unused;
+    Marshal::dump(std::string("small"), &unused);
+    ASSERT_TRUE(unused == nullptr);
+}
+
+TEST(marshal_reads_shared_arrays_in_place) {
+    // The array borrows its elements from the mapping, which outlives the
+    // segment it was received as; setting an element copies them first
+    std::vector<long long> data(Marshal::sharedThreshold, 7);
+    std::unique_ptr<SharedSegment> segment;
+    std::string encoded = Marshal::dump(std::make_shared<PyArray>(PyArray::Data(data)), &segment);
+    auto received = std::make_shared<const SharedSegment>(dup(segment->finish()));
+    std::string_view mapped = received->view(0, data.size() * sizeof(long long));
+    auto array = std::get<std::shared_ptr<PyArray>>(Marshal::load(encoded, std::move(received)));
+    segment.reset();
+
+    ASSERT_TRUE(array->isBorrowed());
+    ASSERT_TRUE(static_cast<const void*>(array->elementData<long long>()) == mapped.data());
+    ASSERT_EQ(std::get<long long>(array->sum()), 7LL * static_cast<long long>(data.size()));
+    auto copy = std::make_shared<PyArray>(*array);
+    array->set(0, 1LL);
+    ASSERT_FALSE(array->isBorrowed());
+    ASSERT_EQ(std::get<long long>(array->get(0)), 1LL);
+    ASSERT_EQ(std::get<long long>(copy->get(0)), 7LL);
+    ASSERT_EQ(std::get<long long>(array->get(data.size() - 1)), 7LL);
+}
+
+TEST(marshal_rejects_unsendable_values) {
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "def f():\n"
+        "    return 1\n"
+        "loop = [1]\n"
+        "loop.append(loop)\n"));
+    bool threw = false;
+    try {
+        Marshal::dump(interpreter.getGlobal("f"));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(std::string(e.what()), "cannot marshal 'function' object");
+    }
+    ASSERT_TRUE(threw);
+
+    threw = false;
+    try {
+        Marshal::dump(interpreter.getGlobal("loop"));
+    } catch (const RuntimeError&) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+
+    threw = false;
+    try {
+        Marshal::load(std::string("\x07\xff\xff\xff\xff\xff\xff\xff\x7f", 9));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(std::string(e.what()), "bad marshal data");
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(process_pool_survives_crashes) {
+    // Request 3 kills its worker; the rest are answered, and the pool
+    // replaces the worker for the next run
+    ProcessPool pool(2, [](const PyValue& request) -> PyValue {
+        long long n = std::get<long long>(request);
+        if (n == 3) abort();
+        if (n == 5) throw RuntimeError("five");
+        return n * 10;
+    });
+    std::vector<PyValue> requests;
+    for (long long n = 0; n < 8; n++) requests.push_back(n);
+
+    for (int run = 0; run < 2; run++) {
+        std::vector<ProcessPool::Reply> replies(requests.size());
+        pool.run(requests, [&](size_t index, ProcessPool::Reply reply) {
+            replies[index] = std::move(reply);
+        });
+        for (long long n = 0; n < 8; n++) {
+            if (n == 3) {
+                ASSERT_TRUE(replies[n].error.find("signal 6") != std::string::npos);
+            } else if (n == 5) {
+                ASSERT_EQ(replies[n].error, "five");
+            } else {
+                ASSERT_EQ(std::get<long long>(replies[n].value), n * 10);
+            }
+        }
+    }
+}
+
+TEST(process_pool_large_replies) {
+    // A 16 MiB array comes back through a shared segment, in place
+    ProcessPool pool(1, [](const PyValue& request) -> PyValue {
+        std::vector<double> data(static_cast<size_t>(std::get<long long>(request)));
+        for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<double>(i);
+        return std::make_shared<PyArray>(PyArray::Data(std::move(data)));
+    });
+    std::vector<PyValue> requests = {2LL << 20, 5LL};
+    std::vector<ProcessPool::Reply> replies(requests.size());
+    pool.run(requests, [&](size_t index, ProcessPool::Reply reply) {
+        replies[index] = std::move(reply);
+    });
+    auto big = std::get<std::shared_ptr<PyArray>>(replies[0].value);
+    ASSERT_EQ(big->size(), static_cast<size_t>(2 << 20));
+    ASSERT_TRUE(big->isBorrowed());
+    ASSERT_EQ(std::get<double>(big->get((2 << 20) - 1)), static_cast<double>((2 << 20) - 1));
+    ASSERT_EQ(std::get<std::shared_ptr<PyArray>>(replies[1].value)->size(), static_cast<size_t>(5));
+}
+
+//=============================================================================
+// Task Tests
+//=============================================================================
+
+TEST(fork_join_on_few_threads) {
+    // Hundreds of joins nest on a pool of two threads; a join that blocked
+    // its thread would deadlock
+    Program program = Program::compile(
+        "def fib(n):\n"
+        "    if n < 2:\n"
+        "        return n\n"
+        "    return fib(n - 1) + fib(n - 2)\n"
+        "def combine(t, n):\n"
+        "    return pfib(n - 2) + join(t)\n"
+        "def pfib(n):\n"
+        "    if n < 8:\n"
+        "        return fib(n)\n"
+        "    return combine(spawn(pfib, n - 1), n)\n"
+        "result = pfib(18)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    ASSERT_EQ(WorkPool::shared().size(), 2u);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("result")), 2584LL);
+}
+
+TEST(task_values_are_copied) {
+    // The task changes its own copy of the argument, and the caller gets
+    // a copy of the result that nothing else can reach
+    Program program = Program::compile(
+        "items = [1, [2, 3]]\n"
+        "def change(xs):\n"
+        "    xs[1].append(4)\n"
+        "    return xs\n"
+        "result = join(spawn(change, items))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto items = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("items"));
+    auto inner = std::get<std::shared_ptr<PyList>>(items->get(1));
+    ASSERT_EQ(inner->size(), static_cast<size_t>(2));
+    auto result = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("result"));
+    ASSERT_EQ(std::get<std::shared_ptr<PyList>>(result->get(1))->size(), static_cast<size_t>(3));
+    ASSERT_TRUE(result != items);
+}
+
+TEST(join_prints_and_raises) {
+    // Output appears at the join; an error is raised there with the line
+    // it happened on in the task
+    Program program = Program::compile(
+        "def greet(name):\n"
+        "    print(\"hello\", name)\n"
+        "    return len(name) // 0\n"
+        "t = spawn(greet, \"task\")\n"
+        "print(\"spawned\")\n"
+        "join(t)\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    bool threw = false;
+    try {
+        interpreter.run(program);
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 3);
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQ(out.str(), "spawned\nhello task\n");
+
+    threw = false;
+    try {
+        interpreter.run(Program::compile("join(spawn(1))\n"));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(e.line, 1);
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(tasks_see_a_copy_of_the_globals) {
+    // The spawner keeps appending to a global list, and assigning to a
+    // class attribute, while the tasks read them; the tasks see both as
+    // they were at the spawn
+    Program program = Program::compile(
+        "data = [1]\n"
+        "class Box:\n"
+        "    size = 1\n"
+        "    def __init__(self, n):\n"
+        "        self.n = n\n"
+        "def total():\n"
+        "    s = 0\n"
+        "    for x in data:\n"
+        "        s += x\n"
+        "    return s + Box.size\n"
+        "def make(n):\n"
+        "    return Box(n)\n"
+        "t = spawn(total)\n"
+        "for i in range(200000):\n"
+        "    data.append(1)\n"
+        "Box.size = 5\n"
+        "result = join(t)\n"
+        "box = join(spawn(make, 3))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("result")), 2LL);
+    auto data = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("data"));
+    ASSERT_EQ(data->size(), static_cast<size_t>(200001));
+
+    // A result made from the task's copy of a class comes back as one of
+    // the spawner's
+    auto box = std::get<std::shared_ptr<PyInstance>>(interpreter.getGlobal("box"));
+    ASSERT_TRUE(box->type() == std::get<std::shared_ptr<PyClass>>(interpreter.getGlobal("Box")));
+}
+
+TEST(spawns_copy_only_what_tasks_reach) {
+    // Spawning with a large global is as cheap as without it when the task
+    // never reads it, and a task that reads it runs on a copy made for an
+    // earlier one, only compared, while neither side has changed it
+    Program program = Program::compile(
+        "big = {}\n"
+        "for i in range(20000):\n"
+        "    big[i] = [i, i + 1]\n"
+        "def add(a, b):\n"
+        "    return a + b\n"
+        "def score(k):\n"
+        "    return big[k][1]\n"
+        "total = 0\n"
+        "for i in range(200):\n"
+        "    total += join(spawn(add, i, 1))\n"
+        "scores = 0\n"
+        "for i in range(200):\n"
+        "    scores += join(spawn(score, i))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    auto start = std::chrono::steady_clock::now();
+    interpreter.run(program);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("total")), 200LL * 201 / 2);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("scores")), 200LL * 201 / 2);
+    ASSERT_TRUE(secondsSince(start) < 3.0);
+}
+
+TEST(tasks_see_globals_changed_between_spawns) {
+    // The spawner's changes to what a task reaches, in place, by rebinding
+    // a name or by redefining a function it calls, are seen by the next
+    // spawn, as is a global that has become another's alias
+    Program program = Program::compile(
+        "data = [1]\n"
+        "def total():\n"
+        "    s = 0\n"
+        "    for x in data:\n"
+        "        s += x\n"
+        "    return s\n"
+        "results = [join(spawn(total))]\n"
+        "data.append(2)\n"
+        "results.append(join(spawn(total)))\n"
+        "data = [5]\n"
+        "results.append(join(spawn(total)))\n"
+        "def helper():\n"
+        "    return 1\n"
+        "def call():\n"
+        "    return helper()\n"
+        "results.append(join(spawn(call)))\n"
+        "def helper():\n"
+        "    return 2\n"
+        "results.append(join(spawn(call)))\n"
+        "x = [1]\n"
+        "y = [1]\n"
+        "def alias():\n"
+        "    x.append(2)\n"
+        "    return len(y)\n"
+        "results.append(join(spawn(alias)))\n"
+        "y = x\n"
+        "results.append(join(spawn(alias)))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto results = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("results"));
+    long long expected[] = {1, 3, 5, 1, 2, 1, 2};
+    ASSERT_EQ(results->size(), static_cast<size_t>(7));
+    for (size_t i = 0; i < 7; i++) {
+        ASSERT_EQ(std::get<long long>(results->get(i)), expected[i]);
+    }
+}
+
+TEST(tasks_start_from_the_snapshot) {
+    // What a task changes in its globals is gone for the next task, on any
+    // thread, including one run while another waits in join()
+    Program program = Program::compile(
+        "seen = []\n"
+        "def f():\n"
+        "    seen.append(1)\n"
+        "    return len(seen)\n"
+        "def g():\n"
+        "    seen.append(1)\n"
+        "    return len(seen) * 10 + join(spawn(f))\n"
+        "counts = []\n"
+        "for i in range(20):\n"
+        "    counts.append(join(spawn(f)))\n"
+        "    counts.append(join(spawn(g)))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto counts = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("counts"));
+    ASSERT_EQ(counts->size(), static_cast<size_t>(40));
+    for (size_t i = 0; i < counts->size(); i++) {
+        ASSERT_EQ(std::get<long long>(counts->get(i)), i % 2 == 0 ? 1LL : 11LL);
+    }
+    auto seen = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("seen"));
+    ASSERT_EQ(seen->size(), static_cast<size_t>(0));
+}
+
+TEST(nested_tasks_mutate_their_own_globals) {
+    // Tasks spawned by a task append to a global list on every pool
+    // thread at once; each task has its own copy, and the script's own
+    // stays empty
+    Program program = Program::compile(
+        "log = []\n"
+        "counts = {}\n"
+        "def work(i):\n"
+        "    log.append(i)\n"
+        "    counts[i] = len(log)\n"
+        "    return i * len(log)\n"
+        "def parent():\n"
+        "    tasks = []\n"
+        "    for i in range(16):\n"
+        "        tasks.append(spawn(work, i))\n"
+        "    total = 0\n"
+        "    for t in tasks:\n"
+        "        total += join(t)\n"
+        "    return total\n"
+        "totals = []\n"
+        "for round in range(20):\n"
+        "    totals.append(join(spawn(parent)))\n");
+    std::ostringstream out;
+    Interpreter interpreter(out);
+    interpreter.run(program);
+    auto totals = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("totals"));
+    for (size_t i = 0; i < totals->size(); i++) {
+        ASSERT_EQ(std::get<long long>(totals->get(i)), 120LL);
+    }
+    auto log = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("log"));
+    ASSERT_EQ(log->size(), static_cast<size_t>(0));
+
+    // Classes are shared between the threads, so a task cannot assign to one
+    bool threw = false;
+    try {
+        interpreter.run(Program::compile(
+            "class Counter:\n"
+            "    n = 0\n"
+            "def bump():\n"
+            "    Counter.n += 1\n"
+            "join(spawn(bump))\n"));
+    } catch (const RuntimeError& e) {
+        threw = true;
+        ASSERT_EQ(std::string(e.what()),
+                  "cannot set attribute 'n' of class 'Counter' here: other threads share the class");
+    }
+    ASSERT_TRUE(threw);
+}
+
+//=============================================================================
+// Garbage Collector Tests
+//=============================================================================
+
+TEST(gc_frees_unreachable_cycles) {
+    GarbageCollector::collect();
+    auto list = std::make_shared<PyList>();
+    auto dict = std::make_shared<PyDict>();
+    list->append(dict);
+    list->append(list);
+    dict->table.findOrInsert(std::string("list")).value = list;
+    std::weak_ptr<PyList> weakList = list;
+    std::weak_ptr<PyDict> weakDict = dict;
+
+    list.reset();
+    dict.reset();
+    ASSERT_TRUE(!weakList.expired());  // Reference counting alone leaks them
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(2));
+    ASSERT_TRUE(weakList.expired());
+    ASSERT_TRUE(weakDict.expired());
+}
+
+TEST(gc_keeps_reachable_objects) {
+    GarbageCollector::collect();
+    auto root = std::make_shared<PyList>();
+    auto inner = std::make_shared<PyList>();
+    inner->append(inner);
+    inner->append(std::string("kept"));
+    root->append(inner);
+    root->append(root);
+    std::weak_ptr<PyList> weakInner = inner;
+    inner.reset();
+
+    // Only reachable from a cycle that is itself referenced from outside
+    ASSERT_EQ(GarbageCollector::collect(0), static_cast<size_t>(0));
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(0));
+    ASSERT_TRUE(!weakInner.expired());
+    ASSERT_EQ(pyValueToString(weakInner.lock()->get(1)), std::string("kept"));
+
+    // Stack objects are never owned by a shared_ptr, and count as roots
+    PyList local;
+    local.append(root);
+    root->set(1, PyNone{});
+    root.reset();
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(0));
+    ASSERT_TRUE(!weakInner.expired());
+}
+
+TEST(gc_objects_outlive_their_thread) {
+    // A list made here can be freed on another thread, and a cycle made on
+    // a thread that exits moves to the orphan heap
+    GarbageCollector::collect();
+    auto here = std::make_shared<PyList>();
+    std::weak_ptr<PyList> weakHere = here;
+    std::shared_ptr<PyList> there;
+    std::thread([&] {
+        here.reset();
+        there = std::make_shared<PyList>();
+        there->append(there);
+        there->append(std::string("orphan"));
+        GarbageCollector::collect();
+    }).join();
+    ASSERT_TRUE(weakHere.expired());
+    ASSERT_EQ(there->size(), static_cast<size_t>(2));
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(0));
+
+    there->set(0, PyNone{});
+    std::weak_ptr<PyList> weakThere = there;
+    there.reset();
+    ASSERT_TRUE(weakThere.expired());
+}
+
+TEST(gc_collects_orphaned_cycles) {
+    // A cycle left by a thread that exits is freed by the next full
+    // collection on any thread
+    GarbageCollector::collect();
+    std::weak_ptr<PyList> weakCycle;
+    std::thread([&] {
+        auto cycle = std::make_shared<PyList>();
+        cycle->append(cycle);
+        weakCycle = cycle;
+    }).join();
+    ASSERT_EQ(GarbageCollector::collect(0), static_cast<size_t>(0));
+    ASSERT_TRUE(!weakCycle.expired());
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(1));
+    ASSERT_TRUE(weakCycle.expired());
+}
+
+TEST(gc_pause_holds_off_collect) {
+    GarbageCollector::collect();
+    auto cycle = std::make_shared<PyList>();
+    cycle->append(cycle);
+    std::weak_ptr<PyList> weakCycle = cycle;
+    cycle.reset();
+    {
+        GarbageCollector::Pause pause;
+        ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(0));
+        ASSERT_TRUE(!weakCycle.expired());
+    }
+    ASSERT_EQ(GarbageCollector::collect(), static_cast<size_t>(1));
+}
+
+TEST(gc_collects_between_statements) {
+    auto saved = GarbageCollector::thresholds();
+    GarbageCollector::setThresholds(50, 2, 2);
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "def churn(n):\n"
+        "    for i in range(n):\n"
+        "        a = [i]\n"
+        "        b = {\"a\": a}\n"
+        "        a.append(b)\n"
+        "    return n\n"
+        "churn(1000)\n"
+        "count = gc.get_count()\n"));
+    GarbageCollector::setThresholds(saved[0], saved[1], saved[2]);
+
+    auto count = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("count"));
+    ASSERT_TRUE(std::get<long long>(count->get(0)) <= 60);
+    ASSERT_TRUE(std::get<long long>(count->get(1)) <= 2);
+}
+
+TEST(gc_collects_while_tasks_run) {
+    // Collection is only held off while values are copied between threads,
+    // so a task or a pmap worker frees the cycles it makes as it runs
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "def cycles(n):\n"
+        "    for i in range(n):\n"
+        "        a = [i]\n"
+        "        a.append(a)\n"
+        "    return gc.collect()\n"
+        "spawned = join(spawn(cycles, 100))\n"
+        "mapped = pmap(cycles, [100], 1)[0]\n"));
+    ASSERT_TRUE(std::get<long long>(interpreter.getGlobal("spawned")) >= 99);
+    ASSERT_TRUE(std::get<long long>(interpreter.getGlobal("mapped")) >= 99);
+}
+
+//=============================================================================
+// Closure Tests
+//=============================================================================
+
+TEST(closures_resolved_once_across_threads) {
+    // The threads race to resolve (and parse) the outer function, whose
+    // nested defs are resolved along with it
+    Program program = Program::compile(
+        "def make(base):\n"
+        "    def scale(k):\n"
+        "        def apply(v):\n"
+        "            return base + k * v\n"
+        "        return apply\n"
+        "    return scale\n"
+        "result = make(seed)(2)(10)\n");
+
+    const int threadCount = 8;
+    std::vector<long long> results(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            Interpreter interpreter;
+            interpreter.setGlobal("seed", static_cast<long long>(t));
+            interpreter.run(program);
+            results[t] = std::get<long long>(interpreter.getGlobal("result"));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < threadCount; t++) {
+        ASSERT_EQ(results[t], static_cast<long long>(t + 20));
+    }
+}
+
+TEST(unbound_variables_raise) {
+    Interpreter interpreter;
+    std::string message;
+    int line = 0;
+    try {
+        interpreter.run(Program::compile(
+            "total = 1\n"
+            "def f():\n"
+            "    total = total + 1\n"
+            "f()\n"));
+    } catch (const RuntimeError& e) {
+        message = e.what();
+        line = e.line;
+    }
+    ASSERT_EQ(message, std::string("local variable 'total' referenced before assignment"));
+    ASSERT_EQ(line, 3);
+
+    message.clear();
+    try {
+        interpreter.run(Program::compile(
+            "def g():\n"
+            "    def early():\n"
+            "        return later\n"
+            "    value = early()\n"
+            "    later = 1\n"
+            "g()\n"));
+    } catch (const RuntimeError& e) {
+        message = e.what();
+    }
+    ASSERT_EQ(message,
+              std::string("free variable 'later' referenced before assignment in enclosing scope"));
+}
+
+TEST(closures_copied_into_tasks) {
+    // The task's closure gets its own cells, holding copies of the values
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "def make():\n"
+        "    items = [1]\n"
+        "    def add(item):\n"
+        "        items.append(item)\n"
+        "        return len(items)\n"
+        "    return add\n"
+        "add = make()\n"
+        "in_task = join(spawn(add, 2))\n"
+        "here = add(3)\n"));
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("in_task")), 2LL);
+    ASSERT_EQ(std::get<long long>(interpreter.getGlobal("here")), 2LL);
+}
+
+//=============================================================================
+// Class Tests
+//=============================================================================
+
+TEST(instances_share_shapes) {
+    // Instances given the same attributes in the same order share a shape
+    Interpreter interpreter;
+    interpreter.run(Program::compile(
+        "class Point:\n"
+        "    def __init__(self, x, y):\n"
+        "        self.x = x\n"
+        "        self.y = y\n"
+        "p = Point(1, 2)\n"
+        "q = Point(3, 4)\n"
+        "r = Point(5, 6)\n"
+        "r.z = 7\n"
+        "s = Point(0, 0)\n"
+        "s.z = 1\n"
+        "t = Point(0, 0)\n"
+        "t.w = 1\n"));
+    auto instance = [&](const char* name) {
+        return std::get<std::shared_ptr<PyInstance>>(interpreter.getGlobal(name));
+    };
+    ASSERT_EQ(instance("p")->shape().id(), instance("q")->shape().id());
+    ASSERT_EQ(instance("r")->shape().id(), instance("s")->shape().id());
+    ASSERT_TRUE(instance("r")->shape().id() != instance("p")->shape().id());
+    ASSERT_TRUE(instance("t")->shape().id() != instance("s")->shape().id());
+
+    const Shape& shape = instance("r")->shape();
+    ASSERT_EQ(shape.size(), 3u);
+    ASSERT_EQ(shape.find("x"), 0u);
+    ASSERT_EQ(shape.find("z"), 2u);
+    ASSERT_EQ(shape.find("w"), Shape::notFound);
+    ASSERT_EQ(std::get<long long>(instance("r")->slot(2)), 7LL);
+}
+
+TEST(inline_cache_degrades_when_megamorphic) {
+    InlineCache cache;
+    AttributeSlot slot;
+    ASSERT_FALSE(cache.find(1, slot));
+    for (uint64_t shape = 1; shape <= InlineCache::entryCount + 1; shape++) {
+        cache.add(shape, AttributeSlot{shape % 2 == 0, static_cast<uint32_t>(shape * 10)});
+    }
+    // The first shapes seen keep their entries; the rest go uncached
+    for (uint64_t shape = 1; shape <= InlineCache::entryCount; shape++) {
+        ASSERT_TRUE(cache.find(shape, slot));
+        ASSERT_EQ(slot.inClass, shape % 2 == 0);
+        ASSERT_EQ(slot.index, static_cast<uint32_t>(shape * 10));
+    }
+    ASSERT_FALSE(cache.find(InlineCache::entryCount + 1, slot));
+}
+
+TEST(attribute_errors_raise) {
+    auto errorOf = [](const std::string& source) {
+        Interpreter interpreter;
+        try {
+            interpreter.run(Program::compile(source));
+        } catch (const RuntimeError& e) {
+            return std::to_string(e.line) + ": " + e.what();
+        }
+        return std::string();
+    };
+    ASSERT_EQ(errorOf("class A:\n"
+                      "    def __init__(self):\n"
+                      "        self.x = 1\n"
+                      "a = A()\n"
+                      "y = a.y\n"),
+              std::string("5: 'A' object has no attribute 'y'"));
+    ASSERT_EQ(errorOf("class A:\n"
+                      "    n = 1\n"
+                      "A(1)\n"),
+              std::string("3: A() takes no arguments"));
+    ASSERT_EQ(errorOf("class A:\n"
+                      "    def __init__(self):\n"
+                      "        return 1\n"
+                      "A()\n"),
+              std::string("4: __init__() should return None, not 'int'"));
+    ASSERT_EQ(errorOf("x = 5\n"
+                      "x.y = 1\n"),
+              std::string("2: 'int' object has no attribute 'y'"));
+}
+
+TEST(cached_sites_shared_across_threads) {
+    // Every thread runs the same AST, so they race to fill in the same
+    // inline caches and to add the same shape transitions
+    Program program = Program::compile(
+        "class Pair:\n"
+        "    def __init__(self, a, b):\n"
+        "        self.a = a\n"
+        "        self.b = b\n"
+        "    def sum(self):\n"
+        "        return self.a + self.b\n"
+        "class Triple:\n"
+        "    def __init__(self, a, b):\n"
+        "        self.c = 0\n"
+        "        self.b = b\n"
+        "        self.a = a\n"
+        "    def sum(self):\n"
+        "        return self.a + self.b + self.c\n"
+        "def total(n):\n"
+        "    result = 0\n"
+        "    for i in range(n):\n"
+        "        if i % 2 == 0:\n"
+        "            item = Pair(i, seed)\n"
+        "        else:\n"
+        "            item = Triple(i, seed)\n"
+        "        result += item.sum() + item.a\n"
+        "    return result\n"
+        "result = total(2000)\n");
+
+    const int threadCount = 8;
+    std::vector<long long> results(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            Interpreter interpreter;
+            interpreter.setGlobal("seed", static_cast<long long>(t));
+            interpreter.run(program);
+            results[t] = std::get<long long>(interpreter.getGlobal("result"));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < threadCount; t++) {
+        // 2 * (0 + ... + 1999) + 2000 * seed
+        ASSERT_EQ(results[t], 3998000LL + 2000LL * t);
+    }
+}
+
+//=============================================================================
+// List Tests
+//=============================================================================
+
+TEST(list_item_assignment_checks_index_after_value) {
+    // The value is evaluated before the index is checked, so a value that
+    // shrinks the list makes the index out of range
+    Interpreter interpreter;
+    std::string message;
+    int line = 0;
+    try {
+        interpreter.run(Program::compile(
+            "a = [1, 2, 3]\n"
+            "a[2] = a.pop()\n"));
+    } catch (const RuntimeError& e) {
+        message = e.what();
+        line = e.line;
+    }
+    ASSERT_EQ(message, std::string("list index out of range"));
+    ASSERT_EQ(line, 2);
+    auto list = std::get<std::shared_ptr<PyList>>(interpreter.getGlobal("a"));
+    ASSERT_EQ(list->size(), static_cast<size_t>(2));
+
+    // A value that grows the list makes a negative index land further on
+    interpreter.run(Program::compile(
+        "b = [1, 2]\n"
+        "def grow():\n"
+        "    b.append(3)\n"
+        "    return 9\n"
+        "b[-1] = grow()\n"));
+    ASSERT_EQ(pyRepr(interpreter.getGlobal("b")), std::string("[1, 2, 9]"));
+}
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main() {
+    std::cout << "Running Program Tests..." << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "Embedding Tests:" << std::endl;
+
+    RUN_TEST(injected_inputs_and_results);
+    RUN_TEST(runs_are_isolated);
+    RUN_TEST(program_outlives_its_handle);
+    RUN_TEST(shared_across_threads);
+    RUN_TEST(embedder_natives);
+    RUN_TEST(compile_errors_throw);
+    RUN_TEST(generators_closed_with_interpreter);
+
+    std::cout << "\nScheduler Tests:" << std::endl;
+    RUN_TEST(tasks_interleave);
+    RUN_TEST(many_tasks);
+    RUN_TEST(failing_task_does_not_stop_others);
+
+    std::cout << "\nEvent Loop Tests:" << std::endl;
+    RUN_TEST(sleeps_overlap);
+    RUN_TEST(read_does_not_block_other_tasks);
+    RUN_TEST(failure_cancels_waiting_tasks);
+
+    std::cout << "\nParallel Map Tests:" << std::endl;
+    RUN_TEST(pool_steals_from_busy_worker);
+    RUN_TEST(pmap_keeps_order);
+    RUN_TEST(pmap_workers_get_own_globals);
+    RUN_TEST(pmap_workers_mutate_their_own_globals);
+    RUN_TEST(pmap_raises_earliest_error);
+    RUN_TEST(pmap_copies_only_what_workers_reach);
+    RUN_TEST(pmap_sees_globals_changed_between_calls);
+    RUN_TEST(pmap_calls_start_from_fresh_globals);
+
+    std::cout << "\nWorker Process Tests:" << std::endl;
+    RUN_TEST(marshal_round_trip);
+    RUN_TEST(marshal_shares_large_values);
+    RUN_TEST(marshal_reads_shared_arrays_in_place);
+    RUN_TEST(marshal_rejects_unsendable_values);
+    RUN_TEST(process_pool_survives_crashes);
+    RUN_TEST(process_pool_large_replies);
+
+    std::cout << "\nTask Tests:" << std::endl;
+    WorkPool::setDefaultSize(2);
+    RUN_TEST(fork_join_on_few_threads);
+    RUN_TEST(task_values_are_copied);
+    RUN_TEST(join_prints_and_raises);
+    RUN_TEST(tasks_see_a_copy_of_the_globals);
+    RUN_TEST(spawns_copy_only_what_tasks_reach);
+    RUN_TEST(tasks_see_globals_changed_between_spawns);
+    RUN_TEST(tasks_start_from_the_snapshot);
+    RUN_TEST(nested_tasks_mutate_their_own_globals);
+
+    std::cout << "\nGarbage Collector Tests:" << std::endl;
+    RUN_TEST(gc_frees_unreachable_cycles);
+    RUN_TEST(gc_keeps_reachable_objects);
+    RUN_TEST(gc_objects_outlive_their_thread);
+    RUN_TEST(gc_collects_orphaned_cycles);
+    RUN_TEST(gc_pause_holds_off_collect);
+    RUN_TEST(gc_collects_between_statements);
+    RUN_TEST(gc_collects_while_tasks_run);
+
+    std::cout << "\nClosure Tests:" << std::endl;
+    RUN_TEST(closures_resolved_once_across_threads);
+    RUN_TEST(unbound_variables_raise);
+    RUN_TEST(closures_copied_into_tasks);
+
+    std::cout << "\nClass Tests:" << std::endl;
+    RUN_TEST(instances_share_shapes);
+    RUN_TEST(inline_cache_degrades_when_megamorphic);
+    RUN_TEST(attribute_errors_raise);
+    RUN_TEST(cached_sites_shared_across_threads);
+
+    std::cout << "\nList Tests:" << std::endl;
+    RUN_TEST(list_item_assignment_checks_index_after_value);
+
+    std::cout << "\n========================================" << std::endl;
+    std::cout << "All Program tests passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+# Test spawning a call and joining it
+def add(a, b):
+    return a + b
+
+t = spawn(add, 2, 3)
+assert str(t) == "<task add>"
+assert join(t) == 5
+assert join(t) == 5
+
+# Test builtins and calls with no arguments
+def answer():
+    return 42
+
+assert join(spawn(answer)) == 42
+assert join(spawn(len, "four")) == 4
+
+# Test recursive fork-join: each level spawns one half and computes the
+# other itself
+def fib(n):
+    if n < 2:
+        return n
+    return fib(n - 1) + fib(n - 2)
+
+def combine(t, n):
+    return pfib(n - 2) + join(t)
+
+def pfib(n):
+    if n < 10:
+        return fib(n)
+    return combine(spawn(pfib, n - 1), n)
+
+assert pfib(16) == 987
+
+# Test that arguments and results are copies
+numbers = [1, 2, 3]
+def grow(xs):
+    xs.append(4)
+    return xs
+
+grown = join(spawn(grow, numbers))
+assert grown == [1, 2, 3, 4]
+assert numbers == [1, 2, 3]
+
+config = {"depth": 2, "tags": ["a"]}
+def tag(d):
+    d["tags"].append("b")
+    return d
+
+assert join(spawn(tag, config)) == {"depth": 2, "tags": ["a", "b"]}
+assert config == {"depth": 2, "tags": ["a"]}
+
+# Test many tasks joined in order
+def square(x):
+    return x * x
+
+tasks = []
+for i in range(50):
+    tasks.append(spawn(square, i))
+total = 0
+for t in tasks:
+    total = total + join(t)
+assert total == 40425
+
+# Test that each spawn sees the globals as they are when it is made
+factor = 2
+def scaled(x):
+    return x * factor
+
+assert join(spawn(scaled, 3)) == 6
+factor = 5
+assert join(spawn(scaled, 3)) == 15
+
+# Test that what a task changes in its globals is gone for the next task
+seen = []
+def record():
+    seen.append(1)
+    return len(seen)
+
+for i in range(5):
+    assert join(spawn(record)) == 1
+assert seen == []
+
+print("test_tasks.py: All tests passed!")
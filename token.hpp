@@ -38,14 +38,21 @@ enum class TokenType {
     // Delimiters
     LPAREN,
     RPAREN,
+    LBRACKET,
+    RBRACKET,
+    LBRACE,
+    RBRACE,
     COLON,
     COMMA,
+    DOT,
     NEWLINE,
     INDENT,
     DEDENT,
 
     // Keywords
     DEF,
+    ASYNC,
+    AWAIT,
     RETURN,
     IF,
     ELIF,
@@ -61,6 +68,8 @@ enum class TokenType {
     NONE,
     PRINT,
     ASSERT,
+    YIELD,
+    CLASS,
 
     // Special
     END_OF_FILE,
@@ -113,12 +122,19 @@ inline std::string tokenTypeToString(TokenType type) {
         case TokenType::SLASH_ASSIGN: return "SLASH_ASSIGN";
         case TokenType::LPAREN: return "LPAREN";
         case TokenType::RPAREN: return "RPAREN";
+        case TokenType::LBRACKET: return "LBRACKET";
+        case TokenType::RBRACKET: return "RBRACKET";
+        case TokenType::LBRACE: return "LBRACE";
+        case TokenType::RBRACE: return "RBRACE";
         case TokenType::COLON: return "COLON";
         case TokenType::COMMA: return "COMMA";
+        case TokenType::DOT: return "DOT";
         case TokenType::NEWLINE: return "NEWLINE";
         case TokenType::INDENT: return "INDENT";
         case TokenType::DEDENT: return "DEDENT";
         case TokenType::DEF: return "DEF";
+        case TokenType::ASYNC: return "ASYNC";
+        case TokenType::AWAIT: return "AWAIT";
         case TokenType::RETURN: return "RETURN";
         case TokenType::IF: return "IF";
         case TokenType::ELIF: return "ELIF";
@@ -134,6 +150,7 @@ inline std::string tokenTypeToString(TokenType type) {
         case TokenType::NONE: return "NONE";
         case TokenType::PRINT: return "PRINT";
         case TokenType::ASSERT: return "ASSERT";
+        case TokenType::YIELD: return "YIELD";
         case TokenType::END_OF_FILE: return "EOF";
         case TokenType::INVALID: return "INVALID";
         default: return "UNKNOWN";
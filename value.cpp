@@ -0,0 +1,470 @@
+#include "value.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "array.hpp"
+#include "environment.hpp"
+#include "dict.hpp"
+#include "coroutine.hpp"
+#include "function.hpp"
+#include "generator.hpp"
+#include "list.hpp"
+#include "object.hpp"
+#include "task.hpp"
+
+namespace {
+
+bool isNumeric(const PyValue& value) {
+    return std::holds_alternative<long long>(value) || std::holds_alternative<double>(value);
+}
+
+double toDouble(const PyValue& value) {
+    return std::holds_alternative<double>(value)
+        ? std::get<double>(value)
+        : static_cast<double>(std::get<long long>(value));
+}
+
+// Containers currently being printed, so a container that contains
+// itself prints as [...] or {...} instead of recursing forever
+thread_local std::vector<const void*> printing;
+
+std::string listToString(const PyList& list) {
+    if (std::find(printing.begin(), printing.end(), &list) != printing.end()) {
+        return "[...]";
+    }
+    printing.push_back(&list);
+
+    std::string s = "[";
+    for (size_t i = 0; i < list.size(); i++) {
+        if (i > 0) s += ", ";
+        s += pyRepr(list.get(i));
+    }
+    printing.pop_back();
+    return s + "]";
+}
+
+std::string tableToString(const HashTable& table, const void* owner, bool withValues) {
+    if (std::find(printing.begin(), printing.end(), owner) != printing.end()) {
+        return "{...}";
+    }
+    printing.push_back(owner);
+
+    std::string s = "{";
+    bool first = true;
+    for (const auto& entry : table.entries()) {
+        if (entry.erased) continue;
+        if (!first) s += ", ";
+        first = false;
+        s += pyRepr(entry.key);
+        if (withValues) s += ": " + pyRepr(entry.value);
+    }
+    printing.pop_back();
+    return s + "}";
+}
+
+// splitmix64 finalizer: spreads small integers over all 64 bits, since the
+// hash table takes its control bits from the bottom and its starting
+// group from the top
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+long long sliceIndex(const PyValue& value) {
+    if (std::holds_alternative<long long>(value)) return std::get<long long>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1 : 0;
+    throw RuntimeError("slice indices must be integers or None");
+}
+
+}  // namespace
+
+std::string pyTypeName(const PyValue& value) {
+    return std::visit([](auto&& arg) -> std::string {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, PyNone>) {
+            return "NoneType";
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return "bool";
+        } else if constexpr (std::is_same_v<T, long long>) {
+            return "int";
+        } else if constexpr (std::is_same_v<T, double>) {
+            return "float";
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return "str";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
+            return arg && arg->self ? "method" : "function";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<NativeFunction>>) {
+            return "builtin_function_or_method";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyModule>>) {
+            return "module";
+        } else if constexpr (std::is_same_v<T, PyRange>) {
+            return "range";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyList>>) {
+            return "list";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyDict>>) {
+            return "dict";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PySet>>) {
+            return "set";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyArray>>) {
+            return "array";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyGenerator>>) {
+            return "generator";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyCoroutine>> ||
+                             std::is_same_v<T, std::shared_ptr<PyAwaitable>>) {
+            return "coroutine";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyTask>>) {
+            return "task";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyClass>>) {
+            return "type";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyInstance>>) {
+            return arg->type()->name;
+        }
+    }, value);
+}
+
+std::string pyValueToString(const PyValue& value) {
+    return std::visit([](auto&& arg) -> std::string {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, PyNone>) {
+            return "None";
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return arg ? "True" : "False";
+        } else if constexpr (std::is_same_v<T, long long>) {
+            return std::to_string(arg);
+        } else if constexpr (std::is_same_v<T, double>) {
+            std::string s = std::to_string(arg);
+            // Remove trailing zeros
+            size_t dot = s.find('.');
+            if (dot != std::string::npos) {
+                size_t last = s.find_last_not_of('0');
+                if (last > dot) {
+                    s = s.substr(0, last + 1);
+                } else {
+                    s = s.substr(0, dot + 2);
+                }
+            }
+            return s;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return arg;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
+            if (arg->self) {
+                return "<bound method " + arg->self->type()->name + "." + arg->name + ">";
+            }
+            return "<function " + arg->name + ">";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<NativeFunction>>) {
+            return "<built-in function " + arg->name + ">";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyModule>>) {
+            return "<module '" + arg->name + "'>";
+        } else if constexpr (std::is_same_v<T, PyRange>) {
+            std::string s = "range(" + std::to_string(arg.start) + ", " + std::to_string(arg.stop);
+            if (arg.step != 1) s += ", " + std::to_string(arg.step);
+            return s + ")";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyList>>) {
+            return listToString(*arg);
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyDict>>) {
+            return tableToString(arg->table, arg.get(), true);
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PySet>>) {
+            if (arg->table.size() == 0) return "set()";
+            return tableToString(arg->table, arg.get(), false);
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyArray>>) {
+            std::string s = "array([";
+            for (size_t i = 0; i < arg->size(); i++) {
+                if (i > 0) s += ", ";
+                s += pyRepr(arg->get(i));
+            }
+            return s + "])";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyGenerator>>) {
+            return "<generator object " + arg->name() + ">";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyCoroutine>> ||
+                             std::is_same_v<T, std::shared_ptr<PyAwaitable>>) {
+            return std::string("<coroutine object ") + arg->name() + ">";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyTask>>) {
+            return "<task " + arg->name() + ">";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyClass>>) {
+            return "<class '" + arg->name + "'>";
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyInstance>>) {
+            return "<" + arg->type()->name + " object>";
+        }
+    }, value);
+}
+
+std::string pyRepr(const PyValue& value) {
+    if (std::holds_alternative<std::string>(value)) {
+        const std::string& text = std::get<std::string>(value);
+        // Like Python, prefer single quotes unless the text contains one
+        char quote = text.find('\'') != std::string::npos &&
+                     text.find('"') == std::string::npos ? '"' : '\'';
+        std::string s(1, quote);
+        for (char c : text) {
+            switch (c) {
+                case '\n': s += "\\n"; break;
+                case '\t': s += "\\t"; break;
+                case '\r': s += "\\r"; break;
+                case '\\': s += "\\\\"; break;
+                default:
+                    if (c == quote) s += '\\';
+                    s += c;
+            }
+        }
+        return s + quote;
+    }
+    return pyValueToString(value);
+}
+
+bool isTruthy(const PyValue& value) {
+    return std::visit([](auto&& arg) -> bool {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, PyNone>) {
+            return false;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return arg;
+        } else if constexpr (std::is_same_v<T, long long>) {
+            return arg != 0;
+        } else if constexpr (std::is_same_v<T, double>) {
+            return arg != 0.0;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return !arg.empty();
+        } else if constexpr (std::is_same_v<T, PyRange>) {
+            return arg.length() != 0;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyList>>) {
+            return arg->size() != 0;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyDict>> ||
+                             std::is_same_v<T, std::shared_ptr<PySet>>) {
+            return arg->table.size() != 0;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyArray>>) {
+            return arg->size() != 0;
+        } else {
+            return true;  // Functions, modules, classes, instances, generators and coroutines
+        }
+    }, value);
+}
+
+bool pyEquals(const PyValue& left, const PyValue& right) {
+    if (isNumeric(left) && isNumeric(right)) {
+        if (std::holds_alternative<long long>(left) && std::holds_alternative<long long>(right)) {
+            return std::get<long long>(left) == std::get<long long>(right);
+        }
+        return toDouble(left) == toDouble(right);
+    }
+    if (left.index() != right.index()) {
+        return false;  // Different types are not equal
+    }
+
+    return std::visit([&](auto&& arg) -> bool {
+        using T = std::decay_t<decltype(arg)>;
+        const T& other = std::get<T>(right);
+        if constexpr (std::is_same_v<T, PyNone>) {
+            return true;
+        } else if constexpr (std::is_same_v<T, PyRange>) {
+            // Ranges are equal if they produce the same sequence
+            long long length = arg.length();
+            if (length != other.length()) return false;
+            if (length == 0) return true;
+            return arg.start == other.start && (length == 1 || arg.step == other.step);
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyList>>) {
+            return arg == other || arg->equals(*other);
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyDict>>) {
+            if (arg == other) return true;
+            if (arg->table.size() != other->table.size()) return false;
+            for (const auto& entry : arg->table.entries()) {
+                if (entry.erased) continue;
+                const HashTable::Entry* match = other->table.find(entry.key);
+                if (!match || !pyEquals(entry.value, match->value)) return false;
+            }
+            return true;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PySet>>) {
+            if (arg == other) return true;
+            if (arg->table.size() != other->table.size()) return false;
+            for (const auto& entry : arg->table.entries()) {
+                if (!entry.erased && !other->table.find(entry.key)) return false;
+            }
+            return true;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyArray>>) {
+            // Used for containers; == on arrays themselves is elementwise
+            if (arg == other) return true;
+            if (arg->size() != other->size()) return false;
+            for (size_t i = 0; i < arg->size(); i++) {
+                if (!pyEquals(arg->get(i), other->get(i))) return false;
+            }
+            return true;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
+            // Each lookup of a method binds it anew; the bindings of one
+            // function to one instance are equal
+            if (arg == other) return true;
+            return arg && other && arg->self && arg->self == other->self &&
+                   arg->declaration == other->declaration;
+        } else {
+            // Scalars by value; modules, classes, instances, generators and
+            // coroutines by identity
+            return arg == other;
+        }
+    }, left);
+}
+
+uint64_t pyHash(const PyValue& value) {
+    return std::visit([](auto&& arg) -> uint64_t {
+        using T = std::decay_t<decltype(arg)>;
+        if constexpr (std::is_same_v<T, PyNone>) {
+            return mix(0x9e3779b97f4a7c15ULL);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return mix(arg ? 0x2545f4914f6cdd1dULL : 0x2545f4914f6cdd1cULL);
+        } else if constexpr (std::is_same_v<T, long long>) {
+            return mix(static_cast<uint64_t>(arg));
+        } else if constexpr (std::is_same_v<T, double>) {
+            // Integral floats hash like the equal int
+            if (std::trunc(arg) == arg && std::fabs(arg) < 9.2e18) {
+                return mix(static_cast<uint64_t>(static_cast<long long>(arg)));
+            }
+            uint64_t bits;
+            std::memcpy(&bits, &arg, sizeof bits);
+            return mix(bits);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return mix(std::hash<std::string>()(arg));
+        } else if constexpr (std::is_same_v<T, PyRange>) {
+            // Equal ranges (same elements) must hash alike
+            long long length = arg.length();
+            uint64_t h = mix(static_cast<uint64_t>(length));
+            if (length > 0) h = mix(h ^ static_cast<uint64_t>(arg.start));
+            if (length > 1) h = mix(h ^ static_cast<uint64_t>(arg.step));
+            return h;
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyList>> ||
+                             std::is_same_v<T, std::shared_ptr<PyDict>> ||
+                             std::is_same_v<T, std::shared_ptr<PySet>> ||
+                             std::is_same_v<T, std::shared_ptr<PyArray>>) {
+            throw RuntimeError("unhashable type: '" + pyTypeName(arg) + "'");
+        } else if constexpr (std::is_same_v<T, std::shared_ptr<PyFunction>>) {
+            // Bound methods hash like the equal bindings (see pyEquals)
+            if (arg && arg->self) {
+                return mix(reinterpret_cast<uintptr_t>(arg->self.get()) ^
+                           mix(reinterpret_cast<uintptr_t>(arg->declaration)));
+            }
+            return mix(reinterpret_cast<uintptr_t>(arg.get()));
+        } else {
+            // Functions, modules, classes, instances, generators and
+            // coroutines hash by identity
+            return mix(reinterpret_cast<uintptr_t>(arg.get()));
+        }
+    }, value);
+}
+
+bool pyContains(const PyValue& container, const PyValue& item) {
+    if (std::holds_alternative<std::shared_ptr<PyDict>>(container)) {
+        return std::get<std::shared_ptr<PyDict>>(container)->table.find(item) != nullptr;
+    }
+    if (std::holds_alternative<std::shared_ptr<PySet>>(container)) {
+        return std::get<std::shared_ptr<PySet>>(container)->table.find(item) != nullptr;
+    }
+    if (std::holds_alternative<std::shared_ptr<PyList>>(container)) {
+        return std::get<std::shared_ptr<PyList>>(container)->contains(item);
+    }
+    if (std::holds_alternative<std::shared_ptr<PyArray>>(container)) {
+        const auto& array = std::get<std::shared_ptr<PyArray>>(container);
+        for (size_t i = 0; i < array->size(); i++) {
+            if (pyEquals(array->get(i), item)) return true;
+        }
+        return false;
+    }
+    if (std::holds_alternative<std::string>(container)) {
+        if (!std::holds_alternative<std::string>(item)) {
+            throw RuntimeError("'in <string>' requires string as left operand, not " +
+                               pyTypeName(item));
+        }
+        return std::get<std::string>(container).find(std::get<std::string>(item)) !=
+               std::string::npos;
+    }
+    if (std::holds_alternative<PyRange>(container)) {
+        // Arithmetic rather than a scan; only integral values can match
+        long long value;
+        if (std::holds_alternative<long long>(item)) {
+            value = std::get<long long>(item);
+        } else if (std::holds_alternative<bool>(item)) {
+            value = std::get<bool>(item);
+        } else if (std::holds_alternative<double>(item)) {
+            double d = std::get<double>(item);
+            if (d != std::floor(d) || std::abs(d) > 9.0e18) return false;
+            value = static_cast<long long>(d);
+        } else {
+            return false;
+        }
+        const PyRange& range = std::get<PyRange>(container);
+        using Span = unsigned long long;
+        if (range.step > 0) {
+            if (value < range.start || value >= range.stop) return false;
+            return (Span(value) - Span(range.start)) % Span(range.step) == 0;
+        }
+        if (value > range.start || value <= range.stop) return false;
+        return (Span(range.start) - Span(value)) % (0 - Span(range.step)) == 0;
+    }
+    throw RuntimeError("argument of type '" + pyTypeName(container) + "' is not iterable");
+}
+
+void forEachElement(const PyValue& iterable, const std::function<void(const PyValue&)>& visit) {
+    if (std::holds_alternative<std::shared_ptr<PyList>>(iterable)) {
+        auto list = std::get<std::shared_ptr<PyList>>(iterable);
+        for (size_t i = 0; i < list->size(); i++) visit(list->get(i));
+    } else if (std::holds_alternative<std::shared_ptr<PyArray>>(iterable)) {
+        auto array = std::get<std::shared_ptr<PyArray>>(iterable);
+        for (size_t i = 0; i < array->size(); i++) visit(array->get(i));
+    } else if (std::holds_alternative<PyRange>(iterable)) {
+        // Stepped unsigned, like a for loop over a range
+        const PyRange& range = std::get<PyRange>(iterable);
+        using Span = unsigned long long;
+        Span value = Span(range.start);
+        for (long long i = range.length(); i > 0; i--, value += Span(range.step)) {
+            visit(static_cast<long long>(value));
+        }
+    } else if (std::holds_alternative<std::string>(iterable)) {
+        for (char c : std::get<std::string>(iterable)) visit(std::string(1, c));
+    } else if (std::holds_alternative<std::shared_ptr<PyDict>>(iterable) ||
+               std::holds_alternative<std::shared_ptr<PySet>>(iterable)) {
+        const HashTable& table = std::holds_alternative<std::shared_ptr<PyDict>>(iterable)
+            ? std::get<std::shared_ptr<PyDict>>(iterable)->table
+            : std::get<std::shared_ptr<PySet>>(iterable)->table;
+        // Snapshot the keys: `visit` may modify the container
+        std::vector<PyValue> keys;
+        keys.reserve(table.size());
+        for (const auto& entry : table.entries()) {
+            if (!entry.erased) keys.push_back(entry.key);
+        }
+        for (const PyValue& key : keys) visit(key);
+    } else if (std::holds_alternative<std::shared_ptr<PyGenerator>>(iterable)) {
+        auto generator = std::get<std::shared_ptr<PyGenerator>>(iterable);
+        while (generator->next()) visit(generator->current());
+    } else {
+        throw RuntimeError("'" + pyTypeName(iterable) + "' object is not iterable");
+    }
+}
+
+SliceBounds resolveSlice(size_t length, const PyValue& lower, const PyValue& upper,
+                         const PyValue& step) {
+    long long n = static_cast<long long>(length);
+    long long stride = std::holds_alternative<PyNone>(step) ? 1 : sliceIndex(step);
+    if (stride == 0) {
+        throw RuntimeError("slice step cannot be zero");
+    }
+
+    // Negative bounds count from the end; out-of-range bounds are clamped.
+    // With a negative step the valid range runs from n - 1 down to -1
+    // (one before the first element).
+    long long low = stride > 0 ? 0 : -1;
+    long long high = stride > 0 ? n : n - 1;
+    auto clamp = [&](const PyValue& bound, long long missing) {
+        if (std::holds_alternative<PyNone>(bound)) return missing;
+        long long index = sliceIndex(bound);
+        if (index < 0) index += n;
+        return std::min(std::max(index, low), high);
+    };
+    long long start = clamp(lower, stride > 0 ? low : high);
+    long long stop = clamp(upper, stride > 0 ? high : low);
+
+    size_t count = 0;
+    if (stride > 0 && start < stop) {
+        count = static_cast<size_t>((stop - start - 1) / stride + 1);
+    } else if (stride < 0 && start > stop) {
+        count = static_cast<size_t>((start - stop - 1) / -stride + 1);
+    }
+    return SliceBounds{start, stride, count};
+}
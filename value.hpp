@@ -0,0 +1,169 @@
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+struct FunctionStmt;
+
+// Python value type
+struct PyNone {};
+struct PyFunction;
+struct NativeFunction;
+struct PyModule;
+class PyList;
+class PyDict;
+class PySet;
+class PyArray;
+class PyGenerator;
+class PyCoroutine;
+struct PyAwaitable;
+class PyTask;
+class PyClass;
+class PyInstance;
+
+// range(start, stop, step). Iterated lazily; the values are never
+// materialized.
+struct PyRange {
+    long long start;
+    long long stop;
+    long long step;  // Never zero
+
+    // The span is counted unsigned, since it can exceed LLONG_MAX. Only a
+    // range of step 1 over nearly all of long long is longer than that,
+    // and is taken to be LLONG_MAX long.
+    long long length() const {
+        using Span = unsigned long long;
+        Span count = 0;
+        if (step > 0 && start < stop) {
+            count = (Span(stop) - Span(start) - 1) / Span(step) + 1;
+        } else if (step < 0 && start > stop) {
+            count = (Span(start) - Span(stop) - 1) / (0 - Span(step)) + 1;
+        }
+        return static_cast<long long>(std::min<Span>(count, LLONG_MAX));
+    }
+};
+
+using PyValue = std::variant<
+    PyNone,
+    bool,
+    long long,
+    double,
+    std::string,
+    std::shared_ptr<PyFunction>,
+    std::shared_ptr<NativeFunction>,
+    std::shared_ptr<PyModule>,
+    PyRange,
+    std::shared_ptr<PyList>,
+    std::shared_ptr<PyDict>,
+    std::shared_ptr<PySet>,
+    std::shared_ptr<PyArray>,
+    std::shared_ptr<PyGenerator>,
+    std::shared_ptr<PyCoroutine>,
+    std::shared_ptr<PyAwaitable>,
+    std::shared_ptr<PyTask>,
+    std::shared_ptr<PyClass>,
+    std::shared_ptr<PyInstance>
+>;
+
+// Arguments to a native function: a view of the values the caller
+// evaluated, usually into a buffer on its own stack, so a call does not
+// allocate a std::vector
+class ArgSpan {
+public:
+    ArgSpan(const PyValue* data, size_t count) : data(data), count(count) {}
+
+    size_t size() const { return count; }
+    const PyValue& operator[](size_t i) const { return data[i]; }
+    const PyValue* begin() const { return data; }
+    const PyValue* end() const { return data + count; }
+
+private:
+    const PyValue* data;
+    size_t count;
+};
+
+// Native functions report errors by throwing RuntimeError; the interpreter
+// fills in the line of the call
+using NativeFn = std::function<PyValue(ArgSpan)>;
+
+// Builtin implemented in C++. The interpreter checks the argument count
+// against [minArity, maxArity] before calling; maxArity is -1 for
+// variadic functions.
+struct NativeFunction {
+    std::string name;
+    int minArity;
+    int maxArity;
+    NativeFn fn;
+
+    NativeFunction(std::string name, int minArity, int maxArity, NativeFn fn)
+        : name(std::move(name)), minArity(minArity), maxArity(maxArity), fn(std::move(fn)) {}
+};
+
+// Method of a builtin type (e.g. list.append), called with its receiver.
+// Types expose their methods through a static findMethod(name).
+struct NativeMethod {
+    const char* name;
+    int minArity;
+    int maxArity;
+    PyValue (*fn)(const PyValue& self, ArgSpan args);
+};
+
+// Namespace of values reached through attribute access, e.g. math.sqrt
+struct PyModule {
+    std::string name;
+    std::unordered_map<std::string, PyValue> members;
+
+    explicit PyModule(std::string name) : name(std::move(name)) {}
+};
+
+// Python type name, for error messages
+std::string pyTypeName(const PyValue& value);
+
+// str(value)
+std::string pyValueToString(const PyValue& value);
+
+// repr(value): like str(), but strings are quoted. Used for container
+// elements.
+std::string pyRepr(const PyValue& value);
+
+bool isTruthy(const PyValue& value);
+
+// The == operator: numbers compare by value across int and float, strings
+// and lists by contents, functions, modules and instances by identity
+bool pyEquals(const PyValue& left, const PyValue& right);
+
+// Hash for dict keys and set elements, consistent with pyEquals (1 and 1.0
+// hash alike). Throws RuntimeError for unhashable (mutable) values.
+uint64_t pyHash(const PyValue& value);
+
+// The `in` operator: `item in container` for lists, strings (substring),
+// ranges, dicts (keys), sets and arrays. Throws RuntimeError for other containers.
+bool pyContains(const PyValue& container, const PyValue& item);
+
+// Calls visit(element) for each element of a list, range, string, dict
+// (its keys), set, array or generator (which it runs to the end); throws
+// RuntimeError for anything else
+void forEachElement(const PyValue& iterable, const std::function<void(const PyValue&)>& visit);
+
+// A slice a[lower:upper:step] resolved against a sequence of `length`
+// elements: the selected indices are start, start + step, ... (count of
+// them). Missing bounds are PyNone. Throws RuntimeError for non-integer
+// bounds or a zero step.
+struct SliceBounds {
+    long long start;
+    long long step;
+    size_t count;
+};
+
+SliceBounds resolveSlice(size_t length, const PyValue& lower, const PyValue& upper,
+                         const PyValue& step);
+
+#endif // VALUE_HPP
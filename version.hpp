@@ -0,0 +1,6 @@
+#ifndef VERSION_HPP
+#define VERSION_HPP
+
+#define PYINTERP_VERSION "0.1"
+
+#endif // VERSION_HPP
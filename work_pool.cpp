@@ -0,0 +1,138 @@
+#include "work_pool.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// The pool and worker index of the calling thread, if it is a worker
+thread_local const WorkPool* currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+std::atomic<unsigned> configuredSize{0};
+
+}  // namespace
+
+unsigned WorkPool::defaultSize() {
+    unsigned size = configuredSize.load();
+    return size != 0 ? size : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void WorkPool::setDefaultSize(unsigned threadCount) {
+    configuredSize = threadCount;
+}
+
+WorkPool& WorkPool::shared() {
+    static WorkPool pool(defaultSize());
+    return pool;
+}
+
+WorkPool::WorkPool(unsigned threadCount) {
+    threadCount = std::max(1u, threadCount);
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::unique_lock<std::mutex> guard(stateLock);
+        allDone.wait(guard, [this] { return unfinished == 0; });
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+void WorkPool::submit(Job job) {
+    // A job submitted by a worker goes on that worker's own deque, where
+    // it runs next unless another worker steals it first
+    unsigned target = currentPool == this ? currentWorker : nextWorker++ % size();
+    {
+        std::lock_guard<std::mutex> state(stateLock);
+        std::lock_guard<std::mutex> deque(workers[target]->lock);
+        workers[target]->jobs.push_back(std::move(job));
+        queued++;
+        unfinished++;
+    }
+    workAvailable.notify_one();
+}
+
+void WorkPool::wait() {
+    std::unique_lock<std::mutex> guard(stateLock);
+    allDone.wait(guard, [this] { return unfinished == 0; });
+    if (failure) {
+        std::exception_ptr error = failure;
+        failure = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool WorkPool::isWorkerThread() const {
+    return currentPool == this;
+}
+
+bool WorkPool::runPending() {
+    if (!isWorkerThread()) return false;
+    unsigned self = currentWorker;
+    Job job;
+    if (!takeJob(self, job)) return false;
+    runJob(self, job);
+    return true;
+}
+
+bool WorkPool::takeJob(unsigned self, Job& job) {
+    {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+        }
+    }
+    for (unsigned i = 1; !job && i < size(); i++) {
+        Worker& victim = *workers[(self + i) % size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+        }
+    }
+    if (!job) return false;
+
+    std::lock_guard<std::mutex> state(stateLock);
+    queued--;
+    return true;
+}
+
+void WorkPool::runJob(unsigned self, Job& job) {
+    try {
+        job(self);
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(stateLock);
+        if (!failure) failure = std::current_exception();
+    }
+    job = nullptr;  // Release what the job holds before reporting it done
+
+    std::lock_guard<std::mutex> guard(stateLock);
+    if (--unfinished == 0) allDone.notify_all();
+}
+
+void WorkPool::workerLoop(unsigned self) {
+    currentPool = this;
+    currentWorker = self;
+
+    while (true) {
+        Job job;
+        if (takeJob(self, job)) {
+            runJob(self, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(stateLock);
+        workAvailable.wait(guard, [this] { return queued > 0 || stopping; });
+        if (stopping && queued == 0) return;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef WORK_POOL_HPP
+#define WORK_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads with one job deque each. Jobs submitted
+// from outside the pool are dealt round-robin; a worker runs the newest
+// job on its own deque first and, once that is empty, steals the oldest
+// job from another worker's. Each job is told which worker runs it, so it
+// can use per-worker state (such as an Interpreter) without locking.
+//
+// A job may wait for other jobs with runPending(), which runs queued work
+// on the waiting thread instead of blocking it, so fork-join code cannot
+// run out of threads.
+class WorkPool {
+public:
+    using Job = std::function<void(unsigned worker)>;
+
+    // The number of threads pools are given when the caller has no
+    // preference: set by --threads, otherwise one per core
+    static unsigned defaultSize();
+    static void setDefaultSize(unsigned threadCount);
+
+    // The process-wide pool behind spawn(), of defaultSize() threads,
+    // started on first use
+    static WorkPool& shared();
+
+    explicit WorkPool(unsigned threadCount);
+    // Waits for the queued jobs, then stops the threads
+    ~WorkPool();
+
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    void submit(Job job);
+
+    // Blocks until every submitted job has finished. If a job threw, the
+    // first exception is rethrown here. Not for use from inside a job.
+    void wait();
+
+    // True when called from one of this pool's threads
+    bool isWorkerThread() const;
+
+    // From one of this pool's threads: takes one queued job, its own
+    // newest first, and runs it here. Returns false if there was none.
+    bool runPending();
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> nextWorker{0};  // Round-robin target for submit()
+
+    std::mutex stateLock;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    size_t queued = 0;      // Jobs sitting in a deque
+    size_t unfinished = 0;  // Jobs submitted and not yet finished
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void workerLoop(unsigned self);
+    bool takeJob(unsigned self, Job& job);
+    void runJob(unsigned self, Job& job);
+};
+
+#endif // WORK_POOL_HPP